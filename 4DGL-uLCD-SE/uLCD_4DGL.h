@@ -21,6 +21,7 @@
 // @author Stephane Rochon
 
 #include "mbed.h"
+#include "rtos.h"
 #ifndef _uLCD
 #define _uLCD 0
 // Debug Verbose off - SGE commands echoed to USB serial for debugmode=1
@@ -31,6 +32,21 @@
 // Common WAIT value in milliseconds between commands
 #define TEMPO 0
 
+// Command transport
+// Commands up to FAST_BYTES long are queued and sent from the TX interrupt,
+// with at most WINDOW of them waiting for their ACK at any time so the next
+// command is already in the screen's receive buffer when it finishes one.
+// Longer commands, and those answering with data, are sent paced after the
+// queue drains. The caller sleeps on a semaphore released by the UART
+// interrupts while it waits, so lower priority threads keep running.
+#ifndef ULCD_WINDOW
+#define ULCD_WINDOW     2
+#endif
+#define ULCD_FAST_BYTES 16   // screen receive buffer
+#define ULCD_TX_SIZE    64   // queued bytes, power of two, >= WINDOW*(FAST_BYTES+1)
+#define ULCD_RX_SIZE    32   // reply bytes, power of two
+#define ULCD_BAUD_TIMEOUT 150 // ms to wait for the ACK at the new baud rate
+
 // 4DGL SGE Function values for Goldelox Processor
 #define CLS          '\xD7'
 #define BAUDRATE     '\x0B' //null prefix
@@ -289,6 +305,21 @@ public :
     void display_image(int, int);
     void display_video(int, int);
     void display_frame(int, int, int);
+// Transport
+    /** Wait until every queued command is sent and answered
+     *
+     * @returns 1 if all were ACKed since the last flush(), -1 if any was not
+     */
+    int flush();
+// Statistics
+    /** Bytes sent to the screen since power up, for measuring redraw cost */
+    unsigned int bytes_sent() {
+        return tx_count;
+    }
+    /** Queued commands answered with anything but ACK, since power up */
+    unsigned int nak_count() {
+        return naks;
+    }
 
 // Screen Data
     int type;
@@ -312,8 +343,25 @@ public :
 
 protected :
 
-    Serial     _cmd;
+    RawSerial  _cmd;
     DigitalOut _rst;
+    unsigned int tx_count;
+    // Command queue: written by the caller, drained by txIRQ()
+    char tx_buf[ULCD_TX_SIZE];
+    volatile unsigned int tx_head;
+    volatile unsigned int tx_tail;
+    volatile bool tx_busy;
+    // Replies owed for queued commands, matched in order by rxIRQ()
+    volatile int pending;
+    volatile unsigned int naks;
+    volatile bool nak_seen;  // since the last flush(), returned by queued commands
+    // Wakes the caller waiting on the transport, released by the interrupts
+    Semaphore irq_wake;
+    volatile bool woken;
+    // Reply data to commands that are not queued
+    char rx_buf[ULCD_RX_SIZE];
+    volatile unsigned int rx_head;
+    volatile unsigned int rx_tail;
     //used by printf
     virtual int _putc(int c) {
         putc(c);
@@ -326,8 +374,19 @@ protected :
     void freeBUFFER  (void);
     void writeBYTE   (char);
     void writeBYTEfast   (char);
+    // 1 on ACK, -1 on NAK and 0 without an answer; a queued command
+    // returns -1 once any command queued since the last flush() got a NAK
     int  writeCOMMAND(char *, int);
     int  writeCOMMANDnull(char *, int);
+    int  queueCOMMAND(char, char *, int);
+    int  sendCOMMAND (char, char *, int);
+    bool rxREADY     (void);
+    char readBYTE    (void);
+    void txIRQ       (void);
+    void rxIRQ       (void);
+    void wakeIRQ     (void);
+    void waitIRQ     (uint32_t ms = osWaitForever);
+    void waitIDLE    (void);
     int  readVERSION (char *, int);
     int  getSTATUS   (char *, int);
     int  version     (void);
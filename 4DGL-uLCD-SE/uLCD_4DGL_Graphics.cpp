@@ -242,8 +242,8 @@ void uLCD_4DGL :: BLIT(int x, int y, int w, int h, int *colors)     // draw a bl
         writeBYTEfast(((green6 << 5) + (blue5 >> 0)) & 0xFF);  // second part of 16 bits color
     }
     int resp=0;
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) resp = _cmd.getc();           // read response if any
+    while (!rxREADY()) waitIRQ();                   // wait for screen answer
+    if (rxREADY()) resp = readBYTE();           // read response if any
     switch (resp) {
         case ACK :                                     // if OK return   1
             resp =  1;
@@ -283,10 +283,10 @@ int uLCD_4DGL :: read_pixel(int x, int y)   // read screen info and populate dat
         writeBYTE(command[i]);
     }
 
-    while (!_cmd.readable()) wait_ms(TEMPO);    // wait a bit for screen answer
+    while (!rxREADY()) waitIRQ();         // wait a bit for screen answer
 
     while ( resp < ARRAY_SIZE(response)) {   //read ack and 16-bit color response
-        temp = _cmd.getc();
+        temp = readBYTE();
         response[resp++] = (char)temp;
     }
 
@@ -29,11 +29,9 @@ int uLCD_4DGL :: media_init()
     int resp = 0;
     char command[1] = "";
     command[0] = MINIT;
-    writeCOMMAND(command, 1);
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) {
-        resp = _cmd.getc();           // read response
-        resp = resp << 8 + _cmd.getc();
+    if (sendCOMMAND('\xFF', command, 1) == 1) {     // not queued, the reply follows the ACK
+        resp = readBYTE();           // read response
+        resp = (resp << 8) + readBYTE();
     }
     return resp;
 }
@@ -73,11 +71,9 @@ char uLCD_4DGL :: read_byte()
     char resp = 0;
     char command[1] = "";
     command[0] = READBYTE;
-    writeCOMMAND(command, 1);
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) {
-        resp = _cmd.getc();           // read response
-        resp = _cmd.getc();
+    if (sendCOMMAND('\xFF', command, 1) == 1) {     // not queued, the reply follows the ACK
+        resp = readBYTE();           // read response
+        resp = readBYTE();
     }
     return resp;
 }
@@ -88,11 +84,9 @@ int  uLCD_4DGL :: read_word()
     int resp=0;
     char command[1] = "";
     command[0] = READWORD;
-    writeCOMMAND(command, 1);
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) {
-        resp = _cmd.getc();           // read response
-        resp = resp << 8 + _cmd.getc();
+    if (sendCOMMAND('\xFF', command, 1) == 1) {     // not queued, the reply follows the ACK
+        resp = readBYTE();           // read response
+        resp = (resp << 8) + readBYTE();
     }
     return resp;
 }
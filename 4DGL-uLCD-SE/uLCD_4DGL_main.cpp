@@ -27,13 +27,24 @@
 
 //******************************************************************************************************
 uLCD_4DGL :: uLCD_4DGL(PinName tx, PinName rx, PinName rst) : _cmd(tx, rx),
-    _rst(rst)
+    _rst(rst),
+    tx_count(0),
+    tx_head(0),
+    tx_tail(0),
+    tx_busy(false),
+    pending(0),
+    naks(0),
+    nak_seen(false),
+    woken(false),
+    rx_head(0),
+    rx_tail(0)
 #if DEBUGMODE
     ,pc(USBTX, USBRX)
 #endif // DEBUGMODE
 {
     // Constructor
     _cmd.baud(9600);
+    _cmd.attach(callback(this, &uLCD_4DGL::rxIRQ), RawSerial::RxIrq);
 #if DEBUGMODE
     pc.baud(115200);
 
@@ -60,7 +71,9 @@ uLCD_4DGL :: uLCD_4DGL(PinName tx, PinName rx, PinName rst) : _cmd(tx, rx),
 void uLCD_4DGL :: writeBYTE(char c)   // send a BYTE command to screen
 {
 
+    waitIDLE();    // direct writes only once the command queue is idle
     _cmd.putc(c);
+    tx_count++;
     wait_us(500);  //mbed is too fast for LCD at high baud rates in some long commands
 
 #if DEBUGMODE
@@ -73,7 +86,9 @@ void uLCD_4DGL :: writeBYTE(char c)   // send a BYTE command to screen
 void uLCD_4DGL :: writeBYTEfast(char c)   // send a BYTE command to screen
 {
 
+    waitIDLE();    // direct writes only once the command queue is idle
     _cmd.putc(c);
+    tx_count++;
     //wait_ms(0.0);  //mbed is too fast for LCD at high baud rates - but not in short commands
 
 #if DEBUGMODE
@@ -85,11 +100,120 @@ void uLCD_4DGL :: writeBYTEfast(char c)   // send a BYTE command to screen
 void uLCD_4DGL :: freeBUFFER(void)         // Clear serial buffer before writing command
 {
 
-    while (_cmd.readable()) _cmd.getc();  // clear buffer garbage
+    rx_tail = rx_head;  // clear buffer garbage
 }
 
 //******************************************************************************************************
-int uLCD_4DGL :: writeCOMMAND(char *command, int number)   // send several BYTES making a command and return an answer
+bool uLCD_4DGL :: rxREADY(void)            // reply data waiting
+{
+    return rx_tail != rx_head;
+}
+
+//******************************************************************************************************
+char uLCD_4DGL :: readBYTE(void)           // next reply byte, waits for it
+{
+    while (!rxREADY()) waitIRQ();
+    return rx_buf[rx_tail++ & (ULCD_RX_SIZE - 1)];
+}
+
+//******************************************************************************************************
+void uLCD_4DGL :: rxIRQ(void)              // match answers to queued commands, keep anything else
+{
+    while (_cmd.readable()) {
+        char c = _cmd.getc();
+        if (pending > 0) {
+            if (c != ACK) {
+                naks++;
+                nak_seen = true;
+            }
+            pending--;
+        } else if (rx_head - rx_tail < ULCD_RX_SIZE) {
+            rx_buf[rx_head++ & (ULCD_RX_SIZE - 1)] = c;
+        }
+    }
+    wakeIRQ();
+}
+
+//******************************************************************************************************
+void uLCD_4DGL :: txIRQ(void)              // feed queued bytes to the UART
+{
+    while (tx_tail != tx_head && _cmd.writeable()) {
+        _cmd.putc(tx_buf[tx_tail & (ULCD_TX_SIZE - 1)]);
+        tx_tail++;
+    }
+    if (tx_tail == tx_head) {
+        _cmd.attach(Callback<void()>(), RawSerial::TxIrq);
+        tx_busy = false;
+    }
+    wakeIRQ();
+}
+
+//******************************************************************************************************
+void uLCD_4DGL :: wakeIRQ(void)            // wake the caller in waitIRQ(), one token at most
+{
+    if (!woken) {
+        woken = true;
+        irq_wake.release();
+    }
+}
+
+//******************************************************************************************************
+void uLCD_4DGL :: waitIRQ(uint32_t ms)          // sleep until an interrupt may have moved the transport on
+{
+    // The caller tests its condition again afterwards, so a token left from
+    // an earlier interrupt only costs one extra test; clearing woken after
+    // the wait lets the next interrupt post again
+    irq_wake.wait(ms);
+    woken = false;
+}
+
+//******************************************************************************************************
+void uLCD_4DGL :: waitIDLE(void)           // wait for every queued command to be answered
+{
+    while (tx_busy || pending > 0) waitIRQ();
+}
+
+//******************************************************************************************************
+int uLCD_4DGL :: flush(void)               // wait for the queue, then report and clear any NAK
+{
+    waitIDLE();
+    int resp = nak_seen ? -1 : 1;
+    nak_seen = false;
+    return resp;
+}
+
+//******************************************************************************************************
+int uLCD_4DGL :: queueCOMMAND(char prefix, char *command, int number)   // queue a short command, answer matched later
+{
+
+#if DEBUGMODE
+    pc.printf("\n");
+    pc.printf("Queued COMMAND : 0x%02X\n", command[0]);
+#endif
+    while (pending >= ULCD_WINDOW) waitIRQ();          // wait for a free slot in the window
+    core_util_critical_section_enter();
+    pending++;                                         // owed before the first byte goes out
+    core_util_critical_section_exit();
+
+    for (int i = -1; i < number; i++) {
+        while (tx_head - tx_tail >= ULCD_TX_SIZE) waitIRQ();
+        tx_buf[tx_head & (ULCD_TX_SIZE - 1)] = (i < 0) ? prefix : command[i];
+        tx_head++;
+    }
+    tx_count += number + 1;
+
+    core_util_critical_section_enter();
+    if (!tx_busy) {
+        tx_busy = true;
+        _cmd.attach(callback(this, &uLCD_4DGL::txIRQ), RawSerial::TxIrq);
+        txIRQ();                                       // start sending if the UART is idle
+    }
+    core_util_critical_section_exit();
+    return nak_seen ? -1 : 1;                          // a NAK of any command queued since the last flush()
+}
+
+//******************************************************************************************************
+int uLCD_4DGL :: sendCOMMAND(char prefix, char *command, int number)   // send a long command paced and wait for its answer
 {
 
 #if DEBUGMODE
@@ -97,16 +221,15 @@ int uLCD_4DGL :: writeCOMMAND(char *command, int number)   // send several BYTES
     pc.printf("New COMMAND : 0x%02X\n", command[0]);
 #endif
     int i, resp = 0;
+    writeBYTE(prefix);                                 // drains the queue first
     freeBUFFER();
-    writeBYTE(0xFF);
     for (i = 0; i < number; i++) {
-        if (i<16)
+        if (i<ULCD_FAST_BYTES) //don't overflow LCD UART buffer
             writeBYTEfast(command[i]); // send command to serial port
         else
             writeBYTE(command[i]); // send command to serial port but slower
     }
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) resp = _cmd.getc();           // read response if any
+    resp = readBYTE();                                 // wait for screen answer
     switch (resp) {
         case ACK :                                     // if OK return   1
             resp =  1;
@@ -125,6 +248,13 @@ int uLCD_4DGL :: writeCOMMAND(char *command, int number)   // send several BYTES
     return resp;
 }
 
+//******************************************************************************************************
+int uLCD_4DGL :: writeCOMMAND(char *command, int number)   // send several BYTES making a command
+{
+    if (number <= ULCD_FAST_BYTES) return queueCOMMAND('\xFF', command, number);
+    return sendCOMMAND('\xFF', command, number);
+}
+
 //**************************************************************************
 void uLCD_4DGL :: reset()    // Reset Screen
 {
@@ -137,40 +267,10 @@ void uLCD_4DGL :: reset()    // Reset Screen
     freeBUFFER();           // clean buffer from possible garbage
 }
 //******************************************************************************************************
-int uLCD_4DGL :: writeCOMMANDnull(char *command, int number)   // send several BYTES making a command and return an answer
+int uLCD_4DGL :: writeCOMMANDnull(char *command, int number)   // send several BYTES making a command, null prefix
 {
-
-#if DEBUGMODE
-    pc.printf("\n");
-    pc.printf("New COMMAND : 0x%02X\n", command[0]);
-#endif
-    int i, resp = 0;
-    freeBUFFER();
-    writeBYTE(0x00); //command has a null prefix byte
-    for (i = 0; i < number; i++) {
-        if (i<16) //don't overflow LCD UART buffer
-            writeBYTEfast(command[i]); // send command to serial port
-        else
-            writeBYTE(command[i]); // send command to serial port with delay
-    }
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) resp = _cmd.getc();           // read response if any
-    switch (resp) {
-        case ACK :                                     // if OK return   1
-            resp =  1;
-            break;
-        case NAK :                                     // if NOK return -1
-            resp = -1;
-            break;
-        default :
-            resp =  0;                                 // else return   0
-            break;
-    }
-#if DEBUGMODE
-    pc.printf("   Answer received : %d\n",resp);
-#endif
-
-    return resp;
+    if (number <= ULCD_FAST_BYTES) return queueCOMMAND('\x00', command, number);
+    return sendCOMMAND('\x00', command, number);
 }
 
 //**************************************************************************
@@ -288,6 +388,7 @@ void uLCD_4DGL :: baudrate(int speed)    // set screen baud rate
     }
 
     int i, resp = 0;
+    Timer answer;
 
     freeBUFFER();
     command[1] = char(newbaud >>8);
@@ -297,12 +398,11 @@ void uLCD_4DGL :: baudrate(int speed)    // set screen baud rate
     for (i = 0; i<10; i++) wait_ms(1); 
     //dont change baud until all characters get sent out
     _cmd.baud(speed);                                  // set mbed to same speed
-    i=0;
-    while ((!_cmd.readable()) && (i<25000)) {
-        wait_ms(TEMPO);           // wait for screen answer - comes 100ms after change
-        i++; //timeout if ack character missed by baud change
-    }
-    if (_cmd.readable()) resp = _cmd.getc();           // read response if any
+    answer.start();
+    while ((!rxREADY()) && (answer.read_ms() < ULCD_BAUD_TIMEOUT)) {
+        waitIRQ(ULCD_BAUD_TIMEOUT - answer.read_ms());  // wait for screen answer - comes 100ms after change
+    }                                                   // timeout if ack character missed by baud change
+    if (rxREADY()) resp = readBYTE();           // read response if any
     switch (resp) {
         case ACK :                                     // if OK return   1
             resp =  1;
@@ -327,10 +427,10 @@ int uLCD_4DGL :: readVERSION(char *command, int number)   // read screen info an
 
     for (i = 0; i < number; i++) writeBYTE(command[i]);    // send all chars to serial port
 
-    while (!_cmd.readable()) wait_ms(TEMPO);               // wait for screen answer
+    while (!rxREADY()) waitIRQ();                    // wait for screen answer
 
-    while (_cmd.readable() && resp < ARRAY_SIZE(response)) {
-        temp = _cmd.getc();
+    while (rxREADY() && resp < ARRAY_SIZE(response)) {
+        temp = readBYTE();
         response[resp++] = (char)temp;
     }
     switch (resp) {
@@ -445,10 +545,10 @@ int uLCD_4DGL :: getSTATUS(char *command, int number)   // read screen info and
 
     for (i = 0; i < number; i++) writeBYTE(command[i]);    // send all chars to serial port
 
-    while (!_cmd.readable()) wait_ms(TEMPO);    // wait for screen answer
+    while (!rxREADY()) waitIRQ();         // wait for screen answer
 
-    while (_cmd.readable() && resp < ARRAY_SIZE(response)) {
-        temp = _cmd.getc();
+    while (rxREADY() && resp < ARRAY_SIZE(response)) {
+        temp = readBYTE();
         response[resp++] = (char)temp;
     }
     switch (resp) {
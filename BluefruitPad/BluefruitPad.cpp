@@ -0,0 +1,309 @@
+#include "BluefruitPad.h"
+#include "TableCRC.h"
+
+#define BLE_RX_SIGNAL 0x1
+
+static const char sensorTypes[] = "QAGML";
+
+BluefruitPad::BluefruitPad(RawSerial &serial, EventQueue &events):_serial(serial),
+    _events(events),
+    _thread(osPriorityAboveNormal, BLE_PARSER_STACK_SIZE),
+    _head(0),
+    _tail(0),
+    _txHead(0),
+    _txTail(0),
+    _length(0),
+    _replayPos(0),
+    _replayLength(0),
+    _frames(0),
+    _badChecksums(0),
+    _skipped(0),
+    _overruns(0),
+    _txDropped(0)
+{
+    memset(_sensorValid, 0, sizeof(_sensorValid));
+}
+
+void BluefruitPad::start()
+{
+    _thread.start(callback(this, &BluefruitPad::parser));
+    _serial.attach(callback(this, &BluefruitPad::rxIrq), RawSerial::RxIrq);
+}
+
+void BluefruitPad::attach(Callback<void(const uint8_t *, int)> data)
+{
+    _data = data;
+}
+
+bool BluefruitPad::send(const uint8_t *payload, int length)
+{
+    if (length > BLE_DATA_MAX) {
+        return false;
+    }
+    uint8_t header[3] = {'!', 'J', (uint8_t)length};
+    uint16_t crc = crc16(payload, length, crc16(header, 3));
+    uint8_t trailer[2] = {(uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)};
+
+    _txLock.lock();
+    if (BLE_TX_RING_SIZE - (_txHead - _txTail) < (uint32_t)length + 5) {
+        _txDropped++;
+        _txLock.unlock();
+        return false;
+    }
+    // The whole frame is queued before the head moves, so the ISR never
+    // sends part of one
+    uint32_t head = _txHead;
+    for (int i = 0; i < 3; i++) {
+        _txRing[head++ & (BLE_TX_RING_SIZE - 1)] = header[i];
+    }
+    for (int i = 0; i < length; i++) {
+        _txRing[head++ & (BLE_TX_RING_SIZE - 1)] = payload[i];
+    }
+    for (int i = 0; i < 2; i++) {
+        _txRing[head++ & (BLE_TX_RING_SIZE - 1)] = trailer[i];
+    }
+    _txHead = head;
+
+    // Enable the TX interrupt and fill the UART, the interrupt takes over
+    // from there and disables itself once the ring is empty
+    core_util_critical_section_enter();
+    _serial.attach(callback(this, &BluefruitPad::txIrq), RawSerial::TxIrq);
+    txIrq();
+    core_util_critical_section_exit();
+    _txLock.unlock();
+    return true;
+}
+
+int BluefruitPad::txPending()
+{
+    return _txHead - _txTail;
+}
+
+uint16_t BluefruitPad::crc16(const uint8_t *data, int length, uint16_t crc)
+{
+    // CRC-16/CCITT-FALSE with the MSB first table from TableCRC.h
+    for (int i = 0; i < length; i++) {
+        crc = (crc << 8) ^ Table_CRC_16bit_CCITT[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+void BluefruitPad::rxIrq()
+{
+    // Empty the UART FIFO, a full ring drops the newest bytes
+    while (_serial.readable()) {
+        uint8_t c = _serial.getc();
+        if (_head - _tail < BLE_RX_RING_SIZE) {
+            _ring[_head & (BLE_RX_RING_SIZE - 1)] = c;
+            _head++;
+        } else {
+            _overruns++;
+        }
+    }
+    _thread.signal_set(BLE_RX_SIGNAL);
+}
+
+void BluefruitPad::txIrq()
+{
+    while (_txTail != _txHead && _serial.writeable()) {
+        _serial.putc(_txRing[_txTail & (BLE_TX_RING_SIZE - 1)]);
+        _txTail++;
+    }
+    if (_txTail == _txHead) {
+        _serial.attach(Callback<void()>(), RawSerial::TxIrq);
+    }
+}
+
+void BluefruitPad::parser()
+{
+    while (true) {
+        Thread::signal_wait(BLE_RX_SIGNAL);
+        while (_tail != _head) {
+            uint8_t c = _ring[_tail & (BLE_RX_RING_SIZE - 1)];
+            _tail++;
+            receive(c);
+        }
+    }
+}
+
+void BluefruitPad::parse(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++) {
+        receive(data[i]);
+    }
+}
+
+void BluefruitPad::receive(uint8_t c)
+{
+    scan(c);
+    while (_replayPos < _replayLength) {
+        scan(_replay[_replayPos++]);
+    }
+}
+
+void BluefruitPad::scan(uint8_t c)
+{
+    if (_length == 0 && c != '!') {
+        _skipped++;
+        return;
+    }
+    _frame[_length++] = c;
+    if (_length < 2) {
+        return;
+    }
+    int expected = frameLength(_frame[1]);
+    if (expected == 0) {
+        _skipped++;
+        resync();
+        return;
+    }
+    if (_frame[1] == 'J') {
+        // Data frames are as long as their length byte says
+        if (_length < 3) {
+            return;
+        }
+        if (_frame[2] > BLE_DATA_MAX) {
+            _skipped++;
+            resync();
+            return;
+        }
+        expected = _frame[2] + 5;
+    }
+    if (_length < expected) {
+        return;
+    }
+
+    bool valid;
+    if (_frame[1] == 'J') {
+        uint16_t crc = crc16(_frame, _length - 2);
+        valid = _frame[_length - 2] == (crc & 0xFF) && _frame[_length - 1] == (crc >> 8);
+    } else {
+        uint8_t sum = 0;
+        for (int i = 0; i < _length - 1; i++) {
+            sum += _frame[i];
+        }
+        valid = (uint8_t)~sum == _frame[_length - 1];
+    }
+    if (!valid) {
+        _badChecksums++;
+        resync();
+        return;
+    }
+    decode();
+    _frames++;
+    _length = 0;
+}
+
+void BluefruitPad::resync()
+{
+    // Drop the '!' that started the rejected frame and scan the bytes after
+    // it again ahead of any still waiting, they may hold the next frame.
+    // They all came from one frame, so they fit the replay buffer.
+    int pending = _replayLength - _replayPos;
+    memmove(_replay + _length - 1, _replay + _replayPos, pending);
+    memcpy(_replay, _frame + 1, _length - 1);
+    _replayPos = 0;
+    _replayLength = _length - 1 + pending;
+    _length = 0;
+}
+
+void BluefruitPad::decode()
+{
+    uint8_t type = _frame[1];
+    if (type == 'J') {
+        if (_data) {
+            _data(_frame + 3, _frame[2]);
+        }
+        return;
+    }
+    if (type == 'B') {
+        int button = _frame[2] - '0';
+        int pressed = _frame[3] - '0';
+        if (button >= 1 && button <= 8 && (pressed == 0 || pressed == 1)) {
+            _events.post(EVENT_BUTTON, (button << 4) | pressed);
+        }
+        return;
+    }
+    if (type == 'C') {
+        uint16_t rgb565 = ((_frame[2] & 0xF8) << 8) | ((_frame[3] & 0xFC) << 3) | (_frame[4] >> 3);
+        _events.post(EVENT_FRAME, type, rgb565);
+        return;
+    }
+    int index = sensorIndex(type);
+    _lock.lock();
+    memcpy(_sensors[index], _frame + 2, frameLength(type) - 3);
+    _sensorValid[index] = true;
+    _lock.unlock();
+    _events.post(EVENT_FRAME, type);
+}
+
+bool BluefruitPad::read(char type, float *values)
+{
+    int index = sensorIndex(type);
+    if (index < 0) {
+        return false;
+    }
+    _lock.lock();
+    bool valid = _sensorValid[index];
+    if (valid) {
+        memcpy(values, _sensors[index], frameLength(type) - 3);
+    }
+    _lock.unlock();
+    return valid;
+}
+
+int BluefruitPad::frameLength(uint8_t type)
+{
+    switch (type) {
+        case 'B':
+            return 5;
+        case 'C':
+            return 6;
+        case 'Q':
+            return 19;
+        case 'A':
+        case 'G':
+        case 'M':
+        case 'L':
+            return 15;
+        case 'J':
+            return 5; // shortest, the length byte gives the rest
+        default:
+            return 0;
+    }
+}
+
+int BluefruitPad::sensorIndex(uint8_t type)
+{
+    for (int i = 0; sensorTypes[i]; i++) {
+        if (sensorTypes[i] == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int BluefruitPad::frames()
+{
+    return _frames;
+}
+
+int BluefruitPad::badChecksums()
+{
+    return _badChecksums;
+}
+
+int BluefruitPad::skipped()
+{
+    return _skipped;
+}
+
+int BluefruitPad::overruns()
+{
+    return _overruns;
+}
+
+int BluefruitPad::txDropped()
+{
+    return _txDropped;
+}
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef BLUEFRUIT_PAD_H
+#define BLUEFRUIT_PAD_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "StateMachine.h"
+
+#ifndef BLE_RX_RING_SIZE
+#define BLE_RX_RING_SIZE 64 // bytes buffered between the RX interrupt and the parser, a power of two
+#endif
+
+#ifndef BLE_TX_RING_SIZE
+#define BLE_TX_RING_SIZE 256 // bytes of data frames waiting for the UART, a power of two
+#endif
+
+#ifndef BLE_DATA_MAX
+#define BLE_DATA_MAX 128 // longest '!J' data frame payload, sets the frame buffers
+#endif
+
+#define BLE_FRAME_MAX (BLE_DATA_MAX + 5) // '!', 'J', length, payload, CRC-16
+
+#ifndef BLE_PARSER_STACK_SIZE
+#define BLE_PARSER_STACK_SIZE 1024 // bytes, the parser and data callbacks that copy and post, never file I/O
+#endif
+
+/** Adafruit Bluefruit LE Connect controller frames from a serial link
+ *
+ * The RX interrupt only moves bytes into a single-producer single-consumer
+ * ring, the interrupt writes the head and the parser thread the tail, and
+ * wakes the parser with a signal. The parser assembles frames of the form
+ * '!', type, payload, checksum, where the checksum is the inverted sum of
+ * the bytes before it, and posts every valid one to an EventQueue:
+ *
+ * - '!B' control pad buttons as EVENT_BUTTON, code (button << 4) | pressed
+ * - '!C' colour picker as EVENT_FRAME 'C', value the colour as RGB565
+ * - '!Q' quaternion, '!A' accelerometer, '!G' gyro, '!M' magnetometer and
+ *   '!L' location as EVENT_FRAME with the type as code; the floats of the
+ *   newest frame of each are kept for read()
+ *
+ * Besides the controller frames the link carries binary data frames of
+ * '!', 'J', a length byte, up to BLE_DATA_MAX bytes of payload and a
+ * CRC-16/CCITT of everything before it, low byte first. Their payloads go
+ * to the function given to attach(), and send() writes them the other way:
+ * frames are copied into a second ring that the TX interrupt empties, so
+ * sending never waits on the UART.
+ *
+ * A frame that fails its checksum or has an unknown type is rescanned from
+ * its next '!', so a lost byte costs at most the frame it was in.
+ *
+ * Example:
+ * @code
+ * RawSerial ble(p13, p14);
+ * EventQueue events;
+ * BluefruitPad pad(ble, events);
+ *
+ * pad.start();
+ * Event event;
+ * while (events.wait(event)) {
+ *     if (event.type == EVENT_BUTTON && event.code == 0x51) {
+ *         // UP pressed
+ *     }
+ * }
+ * @endcode
+ */
+class BluefruitPad
+{
+public:
+    /** Create a parser for a serial link
+     *
+     * @param serial Link to the Bluefruit module
+     * @param events Queue decoded frames are posted to
+     */
+    BluefruitPad(RawSerial &serial, EventQueue &events);
+
+    /** Attach the RX interrupt and start the parser thread */
+    void start();
+
+    /** Call a function with the payload of every valid data frame
+     *
+     * It runs on the parser thread, above normal priority and on a stack
+     * of BLE_PARSER_STACK_SIZE, so it may only copy the payload and post
+     * events or send frames. File I/O, or anything else that blocks or
+     * takes much stack, belongs on the thread the event is posted to.
+     */
+    void attach(Callback<void(const uint8_t *, int)> data);
+
+    /** Queue a data frame for the TX interrupt, never waits, safe from any thread
+     *
+     * @returns false if the payload is longer than BLE_DATA_MAX or the
+     *   frame does not fit the TX ring; nothing is sent then
+     */
+    bool send(const uint8_t *payload, int length);
+
+    /** Bytes queued by send() that have not gone out yet */
+    int txPending();
+
+    /** CRC-16/CCITT as used by data frames
+     *
+     * @param crc CRC of the bytes before data, to run one on in pieces
+     */
+    static uint16_t crc16(const uint8_t *data, int length, uint16_t crc = 0xFFFF);
+
+    /** Parse bytes as if they had been received, on the calling thread
+     *
+     * Only for use while the parser thread is not running, e.g. to replay
+     * a capture.
+     */
+    void parse(const uint8_t *data, int length);
+
+    /** Copy out the newest floats of a sensor frame
+     *
+     * @param type 'Q' (4 values), 'A', 'G', 'M' or 'L' (3 values)
+     * @returns false if no frame of that type has arrived
+     */
+    bool read(char type, float *values);
+
+    /** Valid frames decoded since boot, data frames included */
+    int frames();
+
+    /** Frames that failed their checksum or CRC */
+    int badChecksums();
+
+    /** Bytes outside any frame, including frames of unknown type */
+    int skipped();
+
+    /** Bytes lost because the RX ring was full */
+    int overruns();
+
+    /** Frames send() turned away because the TX ring was full */
+    int txDropped();
+
+private:
+    void rxIrq();
+    void txIrq();
+    void parser();
+    void receive(uint8_t c);
+    void scan(uint8_t c);
+    void resync();
+    void decode();
+    static int frameLength(uint8_t type);
+    static int sensorIndex(uint8_t type);
+
+    RawSerial &_serial;
+    EventQueue &_events;
+    Thread _thread;
+    Mutex _lock;
+    Mutex _txLock;
+    Callback<void(const uint8_t *, int)> _data;
+
+    uint8_t _ring[BLE_RX_RING_SIZE];
+    volatile uint32_t _head; // total bytes received, written by the ISR only
+    volatile uint32_t _tail; // total bytes parsed, written by the parser only
+
+    uint8_t _txRing[BLE_TX_RING_SIZE];
+    volatile uint32_t _txHead; // total bytes queued, written by send() only
+    volatile uint32_t _txTail; // total bytes sent, written by the ISR only
+
+    uint8_t _frame[BLE_FRAME_MAX];
+    int _length;
+    uint8_t _replay[BLE_FRAME_MAX]; // bytes of a rejected frame to scan again
+    int _replayPos;
+    int _replayLength;
+    float _sensors[5][4];
+    bool _sensorValid[5];
+
+    int _frames;
+    int _badChecksums;
+    int _skipped;
+    volatile int _overruns;
+    int _txDropped;
+};
+
+#endif
\ No newline at end of file
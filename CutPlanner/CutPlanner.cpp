@@ -0,0 +1,164 @@
+#include "CutPlanner.h"
+#include <math.h>
+
+CutPlanner::CutPlanner(float stripPos, float cutPos, const CutCostModel &model):_stripPos(stripPos),
+    _cutPos(cutPos),
+    _model(model)
+{
+}
+
+int CutPlanner::wireOps(const Job &job, float &guide, CutOp *ops)
+{
+    // Written so NaN fails too; strips that overlap would need the wire fed backwards
+    if (!(isfinite(job.length) && job.length > 0 && job.leftStrip >= 0 && job.rightStrip >= 0 &&
+          job.leftStrip <= job.length - job.rightStrip)) {
+        return -1;
+    }
+
+    int n = 0;
+    float pending = 0; // feed not yet emitted, merged into one move
+
+    // Incisions measured from the start of the wire, then the cut at its end.
+    // One on either end of the wire lands on a cut, ours or the last wire's
+    float marks[3];
+    float where[3];
+    int count = 0;
+    float strips[2] = {job.leftStrip, job.length - job.rightStrip};
+    for (int i = 0; i < 2; i++) {
+        if (strips[i] >= CUT_PLANNER_MERGE && job.length - strips[i] >= CUT_PLANNER_MERGE) {
+            marks[count] = strips[i];
+            where[count++] = _stripPos;
+        }
+    }
+    marks[count] = job.length;
+    where[count++] = _cutPos;
+
+    float at = 0;
+    for (int i = 0; i < count; i++) {
+        if (i > 0 && marks[i] - marks[i - 1] < CUT_PLANNER_MERGE && where[i] == where[i - 1]) {
+            continue; // same stroke twice
+        }
+        pending += marks[i] - at;
+        at = marks[i];
+        if (pending > 0) {
+            ops[n].type = OP_FEED;
+            ops[n++].arg = pending;
+            pending = 0;
+        }
+        if (guide != where[i]) {
+            guide = where[i];
+            ops[n].type = OP_GUIDE;
+            ops[n++].arg = guide;
+        }
+        ops[n].type = OP_STROKE;
+        ops[n++].arg = 0;
+    }
+    return n;
+}
+
+// Feeds and swings wait for the blade to clear; strokes wait for everything since the last stroke
+bool CutPlanner::buildWire(const Job &job, float &guide, CycleGraph &graph)
+{
+    CutOp ops[CUT_PLANNER_MAX_OPS];
+    int count = wireOps(job, guide, ops);
+
+    graph.clear();
+    if (count < 0) {
+        return false;
+    }
+    uint32_t lastStroke = 0;
+    uint32_t sinceStroke = 0;
+    for (int i = 0; i < count; i++) {
+        int a;
+        switch (ops[i].type) {
+            case OP_FEED:
+                a = graph.add(ACTION_FEED, ops[i].arg, 0, lastStroke);
+                sinceStroke |= ACTION_BIT(a);
+                break;
+            case OP_GUIDE:
+                a = graph.add(ACTION_GUIDE, ops[i].arg, 0, lastStroke);
+                sinceStroke |= ACTION_BIT(a);
+                break;
+            case OP_STROKE:
+                a = graph.add(ACTION_CUT, 0, sinceStroke);
+                lastStroke = ACTION_BIT(a);
+                sinceStroke = 0;
+                break;
+        }
+    }
+    return true;
+}
+
+// An invalid wire, count -1, costs nothing
+int CutPlanner::cost(const CutOp *ops, int count)
+{
+    int ms = 0;
+    for (int i = 0; i < count; i++) {
+        switch (ops[i].type) {
+            case OP_FEED:
+                ms += _model.feedOverheadMs + (int)(1000 * ops[i].arg / _model.feedSpeed);
+                break;
+            case OP_GUIDE:
+                ms += _model.guideMs;
+                break;
+            case OP_STROKE:
+                ms += _model.strokeMs;
+                break;
+        }
+    }
+    return ms;
+}
+
+void CutPlanner::order(Job *jobs, int count, float guide)
+{
+    // Selection sort: highest priority first, then the job that is cheapest
+    // to start from where the guide is, ties kept in queue order
+    for (int i = 0; i < count; i++) {
+        int best = i;
+        int bestCost = 0;
+        for (int j = i; j < count; j++) {
+            CutOp ops[CUT_PLANNER_MAX_OPS];
+            float g = guide;
+            int c = cost(ops, wireOps(jobs[j], g, ops));
+            if (j == i || jobs[j].priority > jobs[best].priority ||
+                (jobs[j].priority == jobs[best].priority && c < bestCost)) {
+                best = j;
+                bestCost = c;
+            }
+        }
+        Job pick = jobs[best];
+        for (int j = best; j > i; j--) {
+            jobs[j] = jobs[j - 1];
+        }
+        jobs[i] = pick;
+        CutOp ops[CUT_PLANNER_MAX_OPS];
+        for (int w = jobs[i].done; w < jobs[i].quantity; w++) {
+            wireOps(jobs[i], guide, ops);
+        }
+    }
+}
+
+int CutPlanner::estimate(const Job *jobs, int count, float guide, bool optimized)
+{
+    int ms = 0;
+    for (int j = 0; j < count; j++) {
+        const Job &job = jobs[j];
+        int wires = job.quantity - job.done;
+        if (wires <= 0) {
+            continue;
+        }
+        if (!optimized) {
+            // Fixed cycle: three feeds, both guide swings and three strokes every wire
+            ms += wires * (3 * _model.feedOverheadMs + (int)(1000 * job.length / _model.feedSpeed) +
+                           2 * _model.guideMs + 3 * _model.strokeMs);
+            continue;
+        }
+        CutOp ops[CUT_PLANNER_MAX_OPS];
+        // The first wire can differ from the rest by the guide position it starts at
+        ms += cost(ops, wireOps(job, guide, ops));
+        if (wires > 1) {
+            ms += (wires - 1) * cost(ops, wireOps(job, guide, ops));
+        }
+    }
+    return ms;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef CUT_PLANNER_H
+#define CUT_PLANNER_H
+
+#include "JobQueue.h"
+#include "CycleExecutor.h"
+
+#define CUT_PLANNER_MAX_OPS 8 // per wire
+#define GUIDE_UNKNOWN -1
+
+#ifndef CUT_PLANNER_MERGE
+#define CUT_PLANNER_MERGE 0.01 // in, marks closer than this are made with one stroke
+#endif
+
+typedef enum {
+    OP_FEED,   // arg: length, in
+    OP_GUIDE,  // arg: servo angle
+    OP_STROKE  // one cutter stroke at the current guide position
+} CutOpType;
+
+typedef struct {
+    CutOpType type;
+    float arg;
+} CutOp;
+
+/** Serial time of each operation, used to compare plans */
+typedef struct {
+    float feedSpeed;    // in/s
+    int feedOverheadMs; // ramp up/down and approach per feed
+    int guideMs;        // one guide swing
+    int strokeMs;       // one full cutter stroke
+} CutCostModel;
+
+/** Plans the operations for each wire of a batch
+ *
+ * The straightforward cycle always feeds three segments, swings the guide
+ * twice and makes three strokes per wire. The planner merges strokes that
+ * land on the same spot and the feeds around them, and only swings the
+ * guide when it is not already where the next stroke needs it.
+ *
+ * The cut that ends one wire also starts the next, so merging works across
+ * wires: a wire without a right incision has its trailing strip made by its
+ * own cut, and the next wire's leading strip, when it has no left incision,
+ * by that same cut. The guide position is tracked across wires, so a run of
+ * wires without incisions never swings the guide at all.
+ *
+ * Since the wire only feeds forward, every wire with an incision needs a
+ * swing to the stripper and back; ordering can only save the swing into the
+ * first wire of a job, and strokes and feeds not at all.
+ */
+class CutPlanner
+{
+public:
+    CutPlanner(float stripPos, float cutPos, const CutCostModel &model);
+
+    /** Minimal operations for one wire
+     *
+     * @param job Wire spec
+     * @param guide Guide position before the wire, updated to the position after it
+     * @param ops Filled with up to CUT_PLANNER_MAX_OPS operations
+     * @returns Number of operations, -1 if the length is not positive, a
+     *   strip is negative or the incisions overlap; guide is then unchanged
+     */
+    int wireOps(const Job &job, float &guide, CutOp *ops);
+
+    /** Build the executor graph for one wire from wireOps()
+     *
+     * @returns false, with an empty graph, for a wire wireOps() rejects
+     */
+    bool buildWire(const Job &job, float &guide, CycleGraph &graph);
+
+    /** Order jobs to start each one from the guide position the last left
+     *
+     * Priority still comes first; within a priority the job cheapest to start
+     * from the current guide position goes next.
+     */
+    void order(Job *jobs, int count, float guide);
+
+    /** Estimated serial time for the wires left in a list of jobs, ms
+     *
+     * @param optimized false to cost the fixed three-feed, three-stroke cycle
+     */
+    int estimate(const Job *jobs, int count, float guide, bool optimized);
+
+private:
+    int cost(const CutOp *ops, int count);
+
+    float _stripPos;
+    float _cutPos;
+    CutCostModel _model;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,235 @@
+#include "CycleExecutor.h"
+
+CycleExecutor::CycleExecutor(FeedController &feeder, Servo &guide, Motor &cutter,
+                             GroupPin &upperLimit, GroupPin &lowerLimit, float cutterSpeed):_feeder(feeder),
+    _guide(guide),
+    _cutter(cutter),
+    _upperLimit(upperLimit),
+    _lowerLimit(lowerLimit),
+    _cutterSpeed(cutterSpeed),
+    _profiler(NULL),
+    _threadStarted(false),
+    _feedStart(0),
+    _feedDone(0),
+    _feedLength(0),
+    _feedAction(-1),
+    _guideAction(-1),
+    _guideDoneAt(0),
+    _cutAction(-1),
+    _cutterState(CUTTER_IDLE),
+    _cutterClearAt(0),
+    _done(0),
+    _clear(0),
+    _workMs(0),
+    _strokeMs(0),
+    _fed(0),
+    _faults(0)
+{
+    _feedResult.measured = 0;
+    _feedResult.fault = false;
+}
+
+void CycleExecutor::setProfiler(CycleProfiler *profiler)
+{
+    _profiler = profiler;
+}
+
+void CycleExecutor::markBegin(ProfilePhase phase)
+{
+    if (_profiler) {
+        _profiler->begin(phase);
+    }
+}
+
+void CycleExecutor::markEnd(ProfilePhase phase)
+{
+    if (_profiler) {
+        _profiler->end(phase);
+    }
+}
+
+// Feeds block the caller, so they get a thread of their own
+void CycleExecutor::feedTask()
+{
+    while (true) {
+        _feedStart.wait();
+        _feedResult = _feeder.feed(_feedLength);
+        _feedDone.release();
+    }
+}
+
+void CycleExecutor::start(int i, const CycleAction &a)
+{
+    _startedAt[i] = _timer.read_ms();
+    switch (a.type) {
+        case ACTION_FEED:
+            _feedAction = i;
+            _feedLength = a.arg;
+            _feedStart.release();
+            break;
+        case ACTION_GUIDE:
+            _guideAction = i;
+            _guide.position(a.arg);
+            _guideDoneAt = _startedAt[i] + CYCLE_GUIDE_SETTLE_MS;
+            markBegin(PHASE_GUIDE);
+            break;
+        case ACTION_CUT:
+            _cutAction = i;
+            _cutterState = CUTTER_DOWN;
+            _cutter.speed(-_cutterSpeed);
+            _strokeTimer.reset();
+            _strokeTimer.start();
+            markBegin(PHASE_CUT_DOWN);
+            break;
+    }
+}
+
+void CycleExecutor::poll()
+{
+    int now = _timer.read_ms();
+
+    if (_feedAction >= 0 && _feedDone.wait(0) > 0) {
+        _done |= ACTION_BIT(_feedAction);
+        _clear |= ACTION_BIT(_feedAction);
+        _workMs += now - _startedAt[_feedAction];
+        _fed += _feedResult.measured;
+        if (_feedResult.fault) {
+            _faults |= CYCLE_FAULT_FEED;
+        }
+        _feedAction = -1;
+    }
+
+    if (_guideAction >= 0 && now >= _guideDoneAt) {
+        _done |= ACTION_BIT(_guideAction);
+        _clear |= ACTION_BIT(_guideAction);
+        _workMs += now - _startedAt[_guideAction];
+        _guideAction = -1;
+        markEnd(PHASE_GUIDE);
+    }
+
+    switch (_cutterState) {
+        case CUTTER_DOWN:
+            if (_lowerLimit) {
+                int downMs = _strokeTimer.read_ms();
+                if (downMs > _strokeMs) {
+                    _strokeMs = downMs;
+                }
+                _cutter.speed(_cutterSpeed);
+                _strokeTimer.reset();
+                _cutterState = CUTTER_UP;
+                markEnd(PHASE_CUT_DOWN);
+                markBegin(PHASE_CUT_UP);
+                // Up at the speed it came down, so it clears the wire the same fraction of the stroke later
+                _cutterClearAt = now + (int)(downMs * CYCLE_CUTTER_CLEAR_FRACTION + 0.5f);
+            } else if (_strokeTimer.read_ms() > CYCLE_STROKE_TIMEOUT_MS) {
+                markEnd(PHASE_CUT_DOWN);
+                strokeFault();
+            }
+            break;
+        case CUTTER_UP:
+            if (_cutAction >= 0 && !(_clear & ACTION_BIT(_cutAction)) && now >= _cutterClearAt) {
+                _clear |= ACTION_BIT(_cutAction);
+                _workMs += now - _startedAt[_cutAction];
+            }
+            if (_upperLimit) {
+                _cutter.speed(0.0);
+                _cutterState = CUTTER_IDLE;
+                markEnd(PHASE_CUT_UP);
+                if (_cutAction >= 0) {
+                    if (!(_clear & ACTION_BIT(_cutAction))) {
+                        _clear |= ACTION_BIT(_cutAction);
+                        _workMs += now - _startedAt[_cutAction];
+                    }
+                    _done |= ACTION_BIT(_cutAction);
+                    _cutAction = -1;
+                }
+            } else if (_strokeTimer.read_ms() > CYCLE_STROKE_TIMEOUT_MS) {
+                markEnd(PHASE_CUT_UP);
+                strokeFault();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// The cutter missed a limit: stop it where it is and leave the stroke unfinished
+void CycleExecutor::strokeFault()
+{
+    _cutter.speed(0.0);
+    _strokeTimer.stop();
+    _cutterState = CUTTER_IDLE;
+    _cutAction = -1;
+    _faults |= CYCLE_FAULT_STROKE;
+}
+
+CycleReport CycleExecutor::run(const CycleGraph &graph)
+{
+    if (!_threadStarted) {
+        _feedThread.start(callback(this, &CycleExecutor::feedTask));
+        _threadStarted = true;
+    }
+
+    uint32_t all = graph.size() >= 32 ? 0xFFFFFFFF : ACTION_BIT(graph.size()) - 1;
+    uint32_t started = 0;
+    _done = 0;
+    _clear = 0;
+    _workMs = 0;
+    _strokeMs = 0;
+    _fed = 0;
+    _faults = 0;
+    // A stroke left over from the previous cycle belongs to no action here
+    _cutAction = -1;
+
+    _timer.reset();
+    _timer.start();
+    markBegin(PHASE_CYCLE);
+    while (_clear != all) {
+        if (_faults & CYCLE_FAULT_STROKE) {
+            // Start nothing more, only wait for the feed and swing in flight
+            if (_feedAction < 0 && _guideAction < 0) {
+                break;
+            }
+            Thread::wait(1);
+            poll();
+            continue;
+        }
+        for (int i = 0; i < graph.size(); i++) {
+            const CycleAction &a = graph[i];
+            if ((started & ACTION_BIT(i)) ||
+                (a.after & _done) != a.after ||
+                (a.afterClear & _clear) != a.afterClear) {
+                continue;
+            }
+            if ((a.type == ACTION_FEED && _feedAction >= 0) ||
+                (a.type == ACTION_GUIDE && _guideAction >= 0) ||
+                (a.type == ACTION_CUT && _cutterState != CUTTER_IDLE)) {
+                continue; // resource busy
+            }
+            start(i, a);
+            started |= ACTION_BIT(i);
+        }
+        Thread::wait(1);
+        poll();
+    }
+    _timer.stop();
+    markEnd(PHASE_CYCLE);
+
+    CycleReport report;
+    report.cycleMs = _timer.read_ms();
+    report.workMs = _workMs;
+    report.strokeMs = _strokeMs;
+    report.fed = _fed;
+    report.faults = _faults;
+    return report;
+}
+
+bool CycleExecutor::finish()
+{
+    _faults = 0;
+    while (_cutterState != CUTTER_IDLE) {
+        Thread::wait(1);
+        poll();
+    }
+    return !(_faults & CYCLE_FAULT_STROKE);
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef CYCLE_EXECUTOR_H
+#define CYCLE_EXECUTOR_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "FeedController.h"
+#include "Servo.h"
+#include "Motor.h"
+#include "PinDetectGroup.h"
+#include "CycleProfiler.h"
+
+#define CYCLE_MAX_ACTIONS 32 // dependencies are kept as bit masks
+
+#ifndef CYCLE_GUIDE_SETTLE_MS
+#define CYCLE_GUIDE_SETTLE_MS 150 // ms for the guide servo to finish a swing
+#endif
+
+#ifndef CYCLE_CUTTER_CLEAR_FRACTION
+#define CYCLE_CUTTER_CLEAR_FRACTION 0.3 // of the measured down stroke, time after leaving the lower limit until the blade clears the wire
+#endif
+
+#ifndef CYCLE_STROKE_TIMEOUT_MS
+#define CYCLE_STROKE_TIMEOUT_MS 3000 // ms for the cutter to reach a limit before it is stopped as jammed
+#endif
+
+typedef enum {
+    ACTION_FEED,  // arg: length, in
+    ACTION_GUIDE, // arg: servo angle
+    ACTION_CUT    // full stroke, down to the lower limit and back up
+} ActionType;
+
+typedef struct {
+    ActionType type;
+    float arg;
+    uint32_t after;      // actions that must be done first
+    uint32_t afterClear; // actions that must only be clear (blade out of the wire)
+} CycleAction;
+
+#define ACTION_BIT(i) (1u << (i))
+
+/** Actions for one cycle and the dependencies between them */
+class CycleGraph
+{
+public:
+    CycleGraph() : _count(0) {}
+
+    /** Add an action, returning its index (-1 if the graph is full) */
+    int add(ActionType type, float arg, uint32_t after = 0, uint32_t afterClear = 0) {
+        if (_count >= CYCLE_MAX_ACTIONS) {
+            return -1;
+        }
+        CycleAction &a = _actions[_count];
+        a.type = type;
+        a.arg = arg;
+        a.after = after;
+        a.afterClear = afterClear;
+        return _count++;
+    }
+
+    void clear() { _count = 0; }
+    int size() const { return _count; }
+    const CycleAction &operator[](int i) const { return _actions[i]; }
+
+private:
+    CycleAction _actions[CYCLE_MAX_ACTIONS];
+    int _count;
+};
+
+typedef enum {
+    CYCLE_FAULT_FEED   = 0x01, // a feed faulted, see FeedResult
+    CYCLE_FAULT_STROKE = 0x02  // the cutter missed a limit and was stopped
+} CycleFault;
+
+/** Timing of one executed cycle */
+typedef struct {
+    int cycleMs;  // wall time from start until every action was clear
+    int workMs;   // sum of the individual action times, i.e. the serial cycle time
+    float fed;    // measured wire fed, in
+    int strokeMs; // longest cutter down stroke, start to lower limit
+    int faults;   // CycleFault bits
+} CycleReport;
+
+/** Runs a CycleGraph, overlapping actions on independent resources
+ *
+ * The feeder, guide servo and cutter are separate resources. Any action
+ * whose dependencies are met starts as soon as its resource is free, so a
+ * guide swing runs during a feed, and the next feed can start once the
+ * blade is clear of the wire instead of waiting for the full return stroke.
+ *
+ * Feeds run on a worker thread since FeedController blocks; the servo and
+ * cutter are polled from the calling thread.
+ *
+ * The blade is taken as clear a fixed fraction of the measured down stroke
+ * after it leaves the lower limit, so a slower cutter waits longer. A cutter
+ * that misses a limit for CYCLE_STROKE_TIMEOUT_MS is stopped, and the cycle
+ * ends with CYCLE_FAULT_STROKE once the actions in flight are done.
+ */
+class CycleExecutor
+{
+public:
+    CycleExecutor(FeedController &feeder, Servo &guide, Motor &cutter,
+                  GroupPin &upperLimit, GroupPin &lowerLimit, float cutterSpeed);
+
+    /** Run a graph, returning once every action is clear or a stroke faulted
+     *
+     * The cutter may still be finishing its return stroke when this returns;
+     * the next run() or finish() picks it up.
+     */
+    CycleReport run(const CycleGraph &graph);
+
+    /** Wait for any stroke still in progress to reach the upper limit
+     *
+     * @returns false if the stroke timed out and the cutter was stopped
+     */
+    bool finish();
+
+    /** Mark cycles, guide swings and cutter strokes on a profiler, NULL to stop
+     *
+     * Limits and the guide settling are seen by the 1 ms poll, so those
+     * phases end up to a millisecond late.
+     */
+    void setProfiler(CycleProfiler *profiler);
+
+private:
+    typedef enum {
+        CUTTER_IDLE,
+        CUTTER_DOWN,
+        CUTTER_UP
+    } CutterState;
+
+    void start(int i, const CycleAction &a);
+    void poll();
+    void strokeFault();
+    void feedTask();
+    void markBegin(ProfilePhase phase);
+    void markEnd(ProfilePhase phase);
+
+    FeedController &_feeder;
+    Servo &_guide;
+    Motor &_cutter;
+    GroupPin &_upperLimit;
+    GroupPin &_lowerLimit;
+    float _cutterSpeed;
+    CycleProfiler *_profiler;
+
+    Thread _feedThread;
+    bool _threadStarted;
+    Semaphore _feedStart;
+    Semaphore _feedDone; // released once _feedResult holds the finished feed
+    float _feedLength;
+    FeedResult _feedResult;
+
+    Timer _timer;
+    int _feedAction;
+    int _guideAction;
+    int _guideDoneAt;
+    int _cutAction;
+    CutterState _cutterState;
+    Timer _strokeTimer; // since the cutter last started or reversed, runs across cycles
+    int _cutterClearAt;
+
+    uint32_t _done;
+    uint32_t _clear;
+    int _startedAt[CYCLE_MAX_ACTIONS];
+    int _workMs;
+    int _strokeMs;
+    float _fed;
+    int _faults;
+};
+
+#endif
\ No newline at end of file
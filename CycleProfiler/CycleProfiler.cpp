@@ -0,0 +1,174 @@
+#include "CycleProfiler.h"
+
+static const char *const phaseNames[PROFILE_PHASES] = {
+    "cycle", "feed", "feed main", "feed approach", "guide", "cut down", "cut up", "home"
+};
+
+CycleProfiler::CycleProfiler():_head(0),
+    _markerCycles(0),
+    _tickCycles(0)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t CycleProfiler::calibrate()
+{
+    const int marks = 32;
+    uint32_t start = DWT->CYCCNT;
+    for (int i = 0; i < marks / 2; i++) {
+        begin(PHASE_CYCLE);
+        end(PHASE_CYCLE);
+    }
+    _markerCycles = (DWT->CYCCNT - start) / marks;
+    _head = 0;
+    _tickCycles = SystemCoreClock / 1000 * PROFILE_TICK_MS;
+    _ticker.attach_us(callback(this, &CycleProfiler::tick), PROFILE_TICK_MS * 1000);
+    return _markerCycles;
+}
+
+void CycleProfiler::tick()
+{
+    // Only into a quiet ring, a busy one stays all phases
+    uint32_t head = _head;
+    if (head == 0 || DWT->CYCCNT - _time[(head - 1) & (PROFILE_RING_SIZE - 1)] < _tickCycles) {
+        return;
+    }
+    mark(PROFILE_TICK_TAG);
+}
+
+uint32_t CycleProfiler::markerCycles()
+{
+    return _markerCycles;
+}
+
+uint32_t CycleProfiler::markers()
+{
+    return _head;
+}
+
+static int compareDurations(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+void CycleProfiler::report(PhaseStats *stats)
+{
+    uint32_t head = _head;
+    uint32_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+    uint32_t cyclesPerUs = SystemCoreClock / 1000000;
+
+    // One pass per phase so a single scratch array holds the durations for p99
+    for (int p = 0; p < PROFILE_PHASES; p++) {
+        PhaseStats &s = stats[p];
+        memset(&s, 0, sizeof(s));
+        bool open = false;
+        int64_t started = 0;
+        int64_t at = 0;
+        uint32_t last = _time[first & (PROFILE_RING_SIZE - 1)];
+        uint64_t sum = 0;
+        for (uint32_t i = first; i != head; i++) {
+            uint32_t n = i & (PROFILE_RING_SIZE - 1);
+            // Cycles since the first marker, across wraps. Neighbours are under
+            // half a wrap apart, and one may be a little behind the one before
+            // if an interrupt marked between its slot and its time.
+            at += (int32_t)(_time[n] - last);
+            last = _time[n];
+            if ((_tag[n] >> 1) != p) {
+                continue;
+            }
+            if (!(_tag[n] & 1)) {
+                open = true;
+                started = at;
+                continue;
+            }
+            if (!open) {
+                continue; // its begin was overwritten
+            }
+            open = false;
+            int64_t cycles = at - started - _markerCycles;
+            if (cycles > (int64_t)UINT32_MAX) {
+                s.excluded++;
+                continue;
+            }
+            uint32_t us = cycles > 0 ? (uint32_t)cycles / cyclesPerUs : 0;
+            _durations[s.count++] = us;
+            sum += us;
+            if (s.count == 1 || us < s.min) {
+                s.min = us;
+            }
+            if (us > s.max) {
+                s.max = us;
+            }
+            int bin = 0;
+            while (bin < PROFILE_HIST_BINS - 1 && (us >> (bin + 1))) {
+                bin++;
+            }
+            s.hist[bin]++;
+        }
+        if (s.count > 0) {
+            s.mean = sum / s.count;
+            qsort(_durations, s.count, sizeof(_durations[0]), compareDurations);
+            s.p99 = _durations[(s.count * 99 + 99) / 100 - 1];
+        }
+    }
+}
+
+// One phase, a line of statistics and a line of the non-empty histogram bins
+int CycleProfiler::format(const PhaseStats &s, int phase, char *line, int size)
+{
+    int n = snprintf(line, size, "%-13s %4d x  min %8lu  mean %8lu  max %8lu  p99 %8lu us\r\n ",
+                     phaseNames[phase], s.count, (unsigned long)s.min, (unsigned long)s.mean,
+                     (unsigned long)s.max, (unsigned long)s.p99);
+    for (int i = 0; i < PROFILE_HIST_BINS && n < size; i++) {
+        if (s.hist[i] == 0) {
+            continue;
+        }
+        uint32_t low = 1u << i;
+        if (low < 1000) {
+            n += snprintf(line + n, size - n, " %luus:%u", (unsigned long)low, s.hist[i]);
+        } else if (low < 1000000) {
+            n += snprintf(line + n, size - n, " %lums:%u", (unsigned long)(low / 1000), s.hist[i]);
+        } else {
+            n += snprintf(line + n, size - n, " %lus:%u", (unsigned long)(low / 1000000), s.hist[i]);
+        }
+    }
+    if (s.excluded > 0 && n < size) {
+        n += snprintf(line + n, size - n, "  %d over the counter wrap", s.excluded);
+    }
+    if (n < size) {
+        n += snprintf(line + n, size - n, "\r\n");
+    }
+    return n < size ? n : size - 1;
+}
+
+void CycleProfiler::print(RawSerial &out)
+{
+    report(_stats);
+    out.printf("Profile: %lu markers, %lu cycles each\r\n", (unsigned long)_head, (unsigned long)_markerCycles);
+    for (int p = 0; p < PROFILE_PHASES; p++) {
+        if (_stats[p].count > 0 || _stats[p].excluded > 0) {
+            format(_stats[p], p, _line, sizeof(_line));
+            out.puts(_line);
+        }
+    }
+}
+
+bool CycleProfiler::save(const char *path)
+{
+    FILE *fp = fopen(path, "a");
+    if (fp == NULL) {
+        return false;
+    }
+    report(_stats);
+    bool ok = fprintf(fp, "Profile: %lu markers, %lu cycles each\r\n", (unsigned long)_head, (unsigned long)_markerCycles) > 0;
+    for (int p = 0; p < PROFILE_PHASES; p++) {
+        if (_stats[p].count > 0 || _stats[p].excluded > 0) {
+            format(_stats[p], p, _line, sizeof(_line));
+            ok = fputs(_line, fp) >= 0 && ok;
+        }
+    }
+    return fclose(fp) == 0 && ok;
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef CYCLE_PROFILER_H
+#define CYCLE_PROFILER_H
+
+#include "mbed.h"
+
+#ifndef PROFILE_RING_SIZE
+#define PROFILE_RING_SIZE 256 // markers kept, a power of two; a wire takes about 12
+#endif
+
+#if PROFILE_RING_SIZE & (PROFILE_RING_SIZE - 1)
+#error PROFILE_RING_SIZE must be a power of two
+#endif
+
+#ifndef PROFILE_TICK_MS
+#define PROFILE_TICK_MS 10000 // ms, a wrap marker when nothing marked for this long; under a quarter of the DWT wrap
+#endif
+
+#define PROFILE_HIST_BINS 24 // octaves of microseconds, 1 us to 16 s
+
+typedef enum {
+    PHASE_CYCLE = 0,     // CycleExecutor::run(), start until every action is clear
+    PHASE_FEED,          // FeedController::feed(), one segment
+    PHASE_FEED_MAIN,     // the profiled main move of a segment
+    PHASE_FEED_APPROACH, // one approach move at start speed
+    PHASE_GUIDE,         // guide servo swing, command until settled
+    PHASE_CUT_DOWN,      // cutter down stroke, waiting on the lower limit
+    PHASE_CUT_UP,        // cutter return stroke, waiting on the upper limit
+    PHASE_HOME,          // homing, waiting on the upper limit
+    PROFILE_PHASES
+} ProfilePhase;
+
+#define PROFILE_TICK_TAG (PROFILE_PHASES << 1) // wrap marker, pairs with no phase
+
+/** Statistics of one phase over the markers in the ring, in microseconds */
+typedef struct {
+    int count;
+    uint32_t min;
+    uint32_t mean;
+    uint32_t max;
+    uint32_t p99;
+    uint16_t hist[PROFILE_HIST_BINS]; // bin i counts 2^i to 2^(i+1)-1 us
+    int excluded; // longer than the counter wraps, left out of the rest
+} PhaseStats;
+
+/** Begin and end markers for the phases of the cut cycle
+ *
+ * A marker stores the DWT cycle counter and a phase tag in a ring of
+ * PROFILE_RING_SIZE entries. The slot is taken with LDREX/STREX so any
+ * thread or interrupt may mark without a lock, and nothing is computed
+ * until report(). Inline, a marker is LDREX, ADD, STREX and the branch
+ * back, the slot mask, the load of the DWT address, the CYCCNT read, two
+ * stores and their address arithmetic: about 11 instructions and 16
+ * cycles by the Cortex-M3 timings, 0.17 us at 96 MHz, more with flash wait
+ * states. calibrate() measures the real figure at boot and print() shows
+ * it. report() takes one marker's cycles off every duration, for the parts
+ * of the begin and end markers between their two CYCCNT reads.
+ *
+ * report() pairs each end with the begin of the same phase before it and
+ * turns the cycle counts into microseconds. The counter wraps every 44 s
+ * at 96 MHz. Once calibrate() has run, a ticker adds a wrap marker whenever
+ * nothing has marked for PROFILE_TICK_MS. Neighbouring markers are then
+ * never half a wrap apart, and report() follows the counter across its
+ * wraps. Phases longer than a whole wrap are counted as excluded and left
+ * out of the statistics. While the machine idles, a wrap marker every
+ * PROFILE_TICK_MS slowly pushes the last batch out of the ring. Call
+ * report() between batches: markers written while it runs may be paired
+ * wrongly.
+ *
+ * Example:
+ * @code
+ * CycleProfiler profiler;
+ *
+ * profiler.begin(PHASE_GUIDE);
+ * guide.position(90);
+ * profiler.end(PHASE_GUIDE);
+ * profiler.print(pc);
+ * @endcode
+ */
+class CycleProfiler
+{
+public:
+    CycleProfiler();
+
+    /** Mark the start of a phase */
+    inline void begin(ProfilePhase phase) { mark(phase << 1); }
+
+    /** Mark the end of a phase */
+    inline void end(ProfilePhase phase) { mark(phase << 1 | 1); }
+
+    /** Measure the cycles per marker, empty the ring and start the wrap markers
+     *
+     * Call before anything else marks.
+     */
+    uint32_t calibrate();
+
+    /** Cycles per marker measured by calibrate() */
+    uint32_t markerCycles();
+
+    /** Markers written since boot, including those overwritten */
+    uint32_t markers();
+
+    /** Compute the statistics of every phase
+     *
+     * @param stats PROFILE_PHASES entries, indexed by ProfilePhase
+     */
+    void report(PhaseStats *stats);
+
+    /** Print a table of every phase that ran, with the cycles per marker */
+    void print(RawSerial &out);
+
+    /** Append the table to a text file, e.g. "/sd/profile.txt"
+     *
+     * @returns false if the file could not be written
+     */
+    bool save(const char *path);
+
+private:
+    inline void mark(uint8_t tag) {
+        uint32_t n;
+        do {
+            n = __LDREXW(&_head);
+        } while (__STREXW(n + 1, &_head));
+        n &= PROFILE_RING_SIZE - 1;
+        _time[n] = DWT->CYCCNT;
+        _tag[n] = tag;
+    }
+
+    void tick();
+    int format(const PhaseStats &s, int phase, char *line, int size);
+
+    volatile uint32_t _head; // markers written, the next slot is _head % PROFILE_RING_SIZE
+    uint32_t _time[PROFILE_RING_SIZE];
+    uint8_t _tag[PROFILE_RING_SIZE];    // phase << 1, low bit set on an end
+    uint32_t _durations[PROFILE_RING_SIZE / 2];
+    uint32_t _markerCycles;
+    uint32_t _tickCycles;
+    Ticker _ticker;
+    PhaseStats _stats[PROFILE_PHASES]; // kept off the stack of the thread printing them
+    char _line[256];
+};
+
+/** Marks a phase for the lifetime of a block */
+class ProfileScope
+{
+public:
+    ProfileScope(CycleProfiler *profiler, ProfilePhase phase):_profiler(profiler),
+        _phase(phase)
+    {
+        if (_profiler) {
+            _profiler->begin(_phase);
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if (_profiler) {
+            _profiler->end(_phase);
+        }
+    }
+
+private:
+    CycleProfiler *_profiler;
+    ProfilePhase _phase;
+};
+
+#endif
\ No newline at end of file
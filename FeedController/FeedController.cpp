@@ -0,0 +1,188 @@
+#include "FeedController.h"
+
+FeedController::FeedController(Stepper &stepper, float stepsPerInch, float inchesPerCount):_stepper(stepper),
+    _done(0),
+    _profiler(NULL),
+    _stepsPerInch(stepsPerInch),
+    _inchesPerCount(inchesPerCount),
+    _startSpeed(500), _maxSpeed(500), _accel(1000), _jerk(0),
+    _mode(PROFILE_TRAPEZOID),
+    _microstep(0),
+    _dir(0),
+    _tolerance(inchesPerCount / 2),
+    _approach(0.2),
+    _slip(1.0),
+    _moving(false),
+    _stepBase(0),
+    _counts(0),
+    _firstEdgeSteps(0),
+    _lastEdgeSteps(0)
+{
+}
+
+void FeedController::setProfile(float startSpeed, float maxSpeed, float accel, float jerk, ProfileMode mode)
+{
+    _startSpeed = startSpeed;
+    _maxSpeed = maxSpeed;
+    _accel = accel;
+    _jerk = jerk;
+    _mode = mode;
+}
+
+void FeedController::setStepping(int microstep, int dir)
+{
+    _microstep = microstep;
+    _dir = dir;
+}
+
+void FeedController::setTolerance(float tolerance, float approach)
+{
+    _tolerance = tolerance;
+    _approach = approach;
+}
+
+void FeedController::setProfiler(CycleProfiler *profiler)
+{
+    _profiler = profiler;
+}
+
+// Steps made so far in this segment
+int FeedController::steps()
+{
+    return _stepBase + (_moving ? _stepper.stepsTaken() : 0);
+}
+
+void FeedController::encoderEdge()
+{
+    int steps = this->steps();
+    if (_counts == 0) {
+        _firstEdgeSteps = steps;
+    }
+    _lastEdgeSteps = steps;
+    _counts++;
+}
+
+// Slip over this segment, measured from the first edge so the unknown wheel
+// phase at the start of the segment drops out
+float FeedController::segmentSlip()
+{
+    core_util_critical_section_enter();
+    int counts = _counts;
+    int steps = _lastEdgeSteps - _firstEdgeSteps;
+    core_util_critical_section_exit();
+
+    if (counts < FEED_MIN_SLIP_COUNTS || steps <= 0) {
+        return _slip;
+    }
+    return (counts - 1) * _inchesPerCount * _stepsPerInch / steps;
+}
+
+bool FeedController::slipValid(float slip)
+{
+    return slip >= FEED_MIN_SLIP && slip <= FEED_MAX_SLIP;
+}
+
+// A slip reading out of bounds is not trusted, the carried estimate is
+float FeedController::position()
+{
+    core_util_critical_section_enter();
+    int steps = this->steps();
+    core_util_critical_section_exit();
+    float slip = segmentSlip();
+    return steps / _stepsPerInch * (slipValid(slip) ? slip : _slip);
+}
+
+// Stepper completion, interrupt context
+void FeedController::moveDone()
+{
+    _stepBase += _stepper.stepsTaken();
+    _moving = false;
+    _done.release();
+}
+
+void FeedController::runMove(int steps, bool profiled)
+{
+    if (profiled) {
+        _profile.plan(steps, _startSpeed, _maxSpeed, _accel, _jerk, _mode);
+    }
+    // Start the move and flag it together so an edge never sees a stale step count
+    core_util_critical_section_enter();
+    if (profiled) {
+        _stepper.move(_profile, _microstep, _dir, callback(this, &FeedController::moveDone));
+    } else {
+        // Stepper::move() speed is an edge rate, two per step
+        _stepper.move(steps, _microstep, _dir, 2 * _startSpeed, callback(this, &FeedController::moveDone));
+    }
+    _moving = true;
+    core_util_critical_section_exit();
+    _done.wait();
+}
+
+FeedResult FeedController::feed(float length)
+{
+    ProfileScope segment(_profiler, PHASE_FEED);
+    FeedResult result;
+    result.commanded = length;
+
+    core_util_critical_section_enter();
+    _stepBase = 0;
+    _counts = 0;
+    core_util_critical_section_exit();
+
+    _stepper.enable();
+
+    // Main move at full speed, stopping short of the target by the approach distance
+    int steps = (int)((length - _approach) * _stepsPerInch / _slip);
+    if (steps > 0) {
+        ProfileScope move(_profiler, PHASE_FEED_MAIN);
+        runMove(steps, true);
+    }
+
+    // Approach moves, re-estimating slip from the edges seen so far; a bad
+    // reading is not chased
+    for (int i = 0; i < FEED_MAX_CORRECTIONS; i++) {
+        float slip = segmentSlip();
+        if (!slipValid(slip)) {
+            break;
+        }
+        float remaining = length - position();
+        if (remaining < _tolerance) {
+            break;
+        }
+        steps = (int)(remaining * _stepsPerInch / slip + 0.5f);
+        if (steps <= 0) {
+            break;
+        }
+        ProfileScope move(_profiler, PHASE_FEED_APPROACH);
+        runMove(steps, false);
+    }
+
+    _stepper.disable();
+
+    core_util_critical_section_enter();
+    int total = _stepBase;
+    int counts = _counts;
+    int first = _firstEdgeSteps;
+    int last = _lastEdgeSteps;
+    core_util_critical_section_exit();
+
+    result.counts = counts;
+    result.slip = segmentSlip();
+    bool measured = counts >= FEED_MIN_SLIP_COUNTS && last > first;
+    // Enough wheel travel for a few edges and none came: the wire or the encoder is stuck
+    bool silent = !measured && total / _stepsPerInch * FEED_MIN_SLIP > (FEED_MIN_SLIP_COUNTS + 1) * _inchesPerCount;
+    result.fault = silent || (measured && !slipValid(result.slip));
+    if (measured) {
+        // Between the first and last edge the wire moved a whole number of
+        // counts; only the ends, under a count each, come from the steps
+        result.measured = (counts - 1) * _inchesPerCount + (first + total - last) / _stepsPerInch * result.slip;
+    } else if (silent) {
+        result.measured = counts * _inchesPerCount;
+    } else {
+        result.measured = total / _stepsPerInch * _slip;
+    }
+    if (measured && !result.fault) {
+        _slip = 0.8f * _slip + 0.2f * result.slip;
+    }
+    return result;
+}
\ No newline at end of file
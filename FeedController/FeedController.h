@@ -0,0 +1,116 @@
+#ifndef FEED_CONTROLLER_H
+#define FEED_CONTROLLER_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "Stepper.h"
+#include "StepProfile.h"
+#include "CycleProfiler.h"
+
+#ifndef FEED_MAX_CORRECTIONS
+#define FEED_MAX_CORRECTIONS 4 // approach moves after the main move
+#endif
+
+#ifndef FEED_MIN_SLIP_COUNTS
+#define FEED_MIN_SLIP_COUNTS 3 // encoder edges needed before a segment updates the slip estimate
+#endif
+
+#ifndef FEED_MIN_SLIP
+#define FEED_MIN_SLIP 0.5 // slip below this is a slipping wheel, a jam or a dead encoder
+#endif
+
+#ifndef FEED_MAX_SLIP
+#define FEED_MAX_SLIP 1.05 // slip above this is encoder noise
+#endif
+
+/** Result of one feed segment, in inches */
+typedef struct {
+    float commanded;
+    float measured; // encoder span, plus the steps before the first and after the last edge
+    float slip;     // wire travel / stepper travel over the segment
+    int counts;     // encoder edges seen
+    bool fault;     // slip out of bounds, or no edges where there should have been
+} FeedResult;
+
+/** Closed-loop feed-to-length
+ *
+ * Wire position is dead-reckoned from the stepper's step count and scaled
+ * by a slip ratio measured between hall encoder edges. The bulk of the
+ * length is fed at full speed with a planned profile; the last stretch is
+ * fed in short approach moves at start speed until the fused estimate is
+ * within tolerance. The slip ratio carries over to the next segment so the
+ * main move lands closer every time.
+ *
+ * The encoder is the measurement: a slip outside FEED_MIN_SLIP to
+ * FEED_MAX_SLIP, or a segment long enough for several edges that saw none,
+ * is reported as a fault instead of being fed to the estimate.
+ */
+class FeedController
+{
+public:
+    /** Create a feed controller
+     *
+     * @param stepper Feeder stepper
+     * @param stepsPerInch Steps per inch of wire at zero slip
+     * @param inchesPerCount Wire travel per encoder edge
+     */
+    FeedController(Stepper &stepper, float stepsPerInch, float inchesPerCount);
+
+    /** Set the motion limits for the main move, see StepProfile::plan() */
+    void setProfile(float startSpeed, float maxSpeed, float accel, float jerk, ProfileMode mode);
+
+    /** Set stepper resolution and feed direction */
+    void setStepping(int microstep, int dir);
+
+    /** Set the stop tolerance and the distance left for the approach moves, inches
+     *
+     * The tolerance defaults to half an encoder count; a tighter one only
+     * chases the interpolation between edges.
+     */
+    void setTolerance(float tolerance, float approach);
+
+    /** Mark segments and moves on a profiler, NULL to stop */
+    void setProfiler(CycleProfiler *profiler);
+
+    /** Feed a length of wire, blocking the calling thread until done */
+    FeedResult feed(float length);
+
+    /** Live estimate of the wire fed in the current segment, inches */
+    float position();
+
+    /** Call on every encoder edge (interrupt safe) */
+    void encoderEdge();
+
+    /** Current slip estimate */
+    float slip() { return _slip; }
+
+private:
+    void moveDone();
+    void runMove(int steps, bool profiled);
+    float segmentSlip();
+    bool slipValid(float slip);
+    int steps();
+
+    Stepper &_stepper;
+    StepProfile _profile;
+    Semaphore _done;
+    CycleProfiler *_profiler;
+
+    float _stepsPerInch;
+    float _inchesPerCount;
+    float _startSpeed, _maxSpeed, _accel, _jerk;
+    ProfileMode _mode;
+    int _microstep;
+    int _dir;
+    float _tolerance;
+    float _approach;
+
+    float _slip;
+    volatile bool _moving;
+    volatile int _stepBase; // steps from finished moves of this segment
+    volatile int _counts;
+    volatile int _firstEdgeSteps;
+    volatile int _lastEdgeSteps;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "HallEncoder.h"
+
+#define RING_MASK (HALL_ENCODER_RING_SIZE - 1)
+
+HallEncoder::HallEncoder(PinName pin, PinMode mode):_in(pin, mode),
+    _head(0),
+    _tail(0),
+    _count(0),
+    _overruns(0),
+    _glitches(0),
+    _held(false),
+    _heldAt(0)
+{
+    _in.rise(callback(this, &HallEncoder::edge));
+    _in.fall(callback(this, &HallEncoder::edge));
+}
+
+void HallEncoder::attach(Callback<void()> edge)
+{
+    _edge = edge;
+}
+
+inline uint32_t HallEncoder::now()
+{
+    return (uint32_t)ticker_read_us(get_us_ticker_data());
+}
+
+void HallEncoder::edge()
+{
+    uint32_t t = now();
+    core_util_critical_section_enter();
+    if (_held && t - _heldAt < HALL_ENCODER_MIN_EDGE_US) {
+        // The second edge of a glitch, the sensor is back where it was
+        _hold.detach();
+        _held = false;
+        _glitches++;
+        core_util_critical_section_exit();
+        return;
+    }
+    core_util_critical_section_exit();
+    // The hold timeout may not have run yet
+    publish();
+    core_util_critical_section_enter();
+    _held = true;
+    _heldAt = t;
+    _hold.attach_us(callback(this, &HallEncoder::publish), HALL_ENCODER_MIN_EDGE_US);
+    core_util_critical_section_exit();
+}
+
+// Move the held edge into the ring, from the hold timeout or the next edge
+void HallEncoder::publish()
+{
+    core_util_critical_section_enter();
+    if (!_held) {
+        core_util_critical_section_exit();
+        return;
+    }
+    _held = false;
+    _hold.detach();
+    uint32_t head = _head;
+    _ring[head & RING_MASK] = _heldAt;
+    _head = head + 1;
+    _count++;
+    core_util_critical_section_exit();
+    if (_edge) {
+        _edge();
+    }
+}
+
+int HallEncoder::count()
+{
+    return _count;
+}
+
+void HallEncoder::reset()
+{
+    _count = 0;
+}
+
+bool HallEncoder::read(uint32_t &timestamp)
+{
+    uint32_t tail = _tail;
+    while (true) {
+        uint32_t head = _head;
+        if (head - tail > HALL_ENCODER_RING_SIZE) {
+            _overruns += head - tail - HALL_ENCODER_RING_SIZE;
+            tail = head - HALL_ENCODER_RING_SIZE;
+        }
+        if (tail == head) {
+            _tail = tail;
+            return false;
+        }
+        timestamp = _ring[tail & RING_MASK];
+        // The ISR may have lapped us while we copied the slot
+        if (_head - tail <= HALL_ENCODER_RING_SIZE) {
+            _tail = tail + 1;
+            return true;
+        }
+    }
+}
+
+int HallEncoder::overruns()
+{
+    return _overruns;
+}
+
+int HallEncoder::glitches()
+{
+    return _glitches;
+}
+
+float HallEncoder::rate(uint32_t newest, uint32_t oldest, int edges)
+{
+    uint32_t span = newest - oldest;
+    return span ? edges * 1000000.0f / span : 0;
+}
+
+float HallEncoder::velocity()
+{
+    uint32_t head = _head;
+    if (head < 2) {
+        return 0;
+    }
+    int n = head - 1 < HALL_ENCODER_WINDOW ? head - 1 : HALL_ENCODER_WINDOW;
+    uint32_t newest = _ring[(head - 1) & RING_MASK];
+    uint32_t oldest = _ring[(head - 1 - n) & RING_MASK];
+    float v = rate(newest, oldest, n);
+
+    // No edge for longer than the current interval: the wheel is slowing down.
+    // In 64 bits, after a long stop since * n no longer fits 32.
+    uint32_t since = now() - newest;
+    if ((uint64_t)since * n > newest - oldest) {
+        float bound = 1000000.0f / since;
+        if (bound < v) {
+            v = bound;
+        }
+    }
+    return v;
+}
+
+float HallEncoder::acceleration()
+{
+    uint32_t head = _head;
+    if (head < 2 * HALL_ENCODER_WINDOW + 1) {
+        return 0;
+    }
+    uint32_t t2 = _ring[(head - 1) & RING_MASK];
+    uint32_t t1 = _ring[(head - 1 - HALL_ENCODER_WINDOW) & RING_MASK];
+    uint32_t t0 = _ring[(head - 1 - 2 * HALL_ENCODER_WINDOW) & RING_MASK];
+    float v1 = rate(t2, t1, HALL_ENCODER_WINDOW);
+    float v0 = rate(t1, t0, HALL_ENCODER_WINDOW);
+    // Window midpoints are (t2 - t0) / 2 apart
+    uint32_t dt = (t2 - t0) / 2;
+    return dt ? (v1 - v0) * 1000000.0f / dt : 0;
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef HALL_ENCODER_H
+#define HALL_ENCODER_H
+
+#include "mbed.h"
+
+#ifndef HALL_ENCODER_RING_SIZE
+#define HALL_ENCODER_RING_SIZE 64 // edges kept, must be a power of two
+#endif
+
+#ifndef HALL_ENCODER_WINDOW
+#define HALL_ENCODER_WINDOW 4 // edges averaged per velocity estimate
+#endif
+
+#ifndef HALL_ENCODER_MIN_EDGE_US
+#define HALL_ENCODER_MIN_EDGE_US 20 // two edges closer than this are a glitch and both are dropped
+#endif
+
+/** Hall sensor encoder captured on pin interrupts
+ *
+ * Both edges of the sensor interrupt and are stamped with the us ticker, so
+ * no edge waits on a sampling period. An edge is held for
+ * HALL_ENCODER_MIN_EDGE_US: if another one follows within that time the
+ * pair was a glitch, leaves the sensor where it was, and both are dropped.
+ * Otherwise it goes into a single-producer single-consumer ring with its
+ * original timestamp: the interrupts only write the head, readers only the
+ * tail, and neither needs a lock. Velocity and acceleration are worked out
+ * from the latest timestamps in the ring whenever they are asked for.
+ */
+class HallEncoder
+{
+public:
+    HallEncoder(PinName pin, PinMode mode = PullNone);
+
+    /** Call a function on every edge, from interrupt context
+     *
+     * It runs once the edge is known not to be half of a glitch, up to
+     * HALL_ENCODER_MIN_EDGE_US after the edge.
+     */
+    void attach(Callback<void()> edge);
+
+    /** Edges counted since the last reset() */
+    int count();
+
+    /** Zero the count; ring contents and estimates are kept */
+    void reset();
+
+    /** Pop the oldest unread edge timestamp (us), returns false if none */
+    bool read(uint32_t &timestamp);
+
+    /** Edges that were overwritten before read() got to them */
+    int overruns();
+
+    /** Pairs of edges dropped as glitches */
+    int glitches();
+
+    /** Edges per second over the last HALL_ENCODER_WINDOW edges
+     *
+     * Decays towards zero once the time since the last edge grows past the
+     * measured interval, so a stopped wheel reads as stopped.
+     */
+    float velocity();
+
+    /** Edges per second squared, from the last two velocity windows */
+    float acceleration();
+
+private:
+    void edge();
+    void publish();
+    uint32_t now();
+    float rate(uint32_t newest, uint32_t oldest, int edges);
+
+    InterruptIn _in;
+    Timeout _hold;
+    Callback<void()> _edge;
+
+    uint32_t _ring[HALL_ENCODER_RING_SIZE];
+    volatile uint32_t _head; // total edges captured, written by the ISR only
+    volatile uint32_t _tail; // total edges read, written by read() only
+    volatile int _count;
+    volatile int _overruns;
+    volatile int _glitches;
+    volatile bool _held; // an edge waits out HALL_ENCODER_MIN_EDGE_US
+    uint32_t _heldAt;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "JobLink.h"
+#include <math.h>
+
+JobLink::JobLink(BluefruitPad &pad, JobQueue &jobs, EventQueue &events):_pad(pad),
+    _jobs(jobs),
+    _events(events),
+    _count(0),
+    _announced(0),
+    _next(0),
+    _status(JOB_ACK_OK),
+    _open(false),
+    _committing(false),
+    _sinceAck(0),
+    _batches(0),
+    _jobsReceived(0),
+    _outOfOrder(0)
+{
+}
+
+void JobLink::receive(const uint8_t *payload, int length)
+{
+    if (length < 2) {
+        return;
+    }
+    uint8_t kind = payload[0];
+    uint8_t seq = payload[1];
+    bool send = false;
+
+    _lock.lock();
+    if (_committing) {
+        // The sender is early, it still has to wait for JOB_ACK_COMMITTED
+        send = true;
+    } else if (kind == JOB_MSG_BEGIN) {
+        _count = 0;
+        _next = seq + 1;
+        _status = JOB_ACK_OK;
+        _open = true;
+        _sinceAck = 0;
+        send = true;
+    } else if (!_open || seq != _next) {
+        _outOfOrder++;
+        send = true;
+    } else if (kind == JOB_MSG_JOBS) {
+        _next++;
+        for (int i = 2; i + JOB_LINK_SPEC_SIZE <= length; i += JOB_LINK_SPEC_SIZE) {
+            _jobsReceived++;
+            if (_count == JOB_QUEUE_SIZE) {
+                _status = JOB_ACK_FULL;
+                continue;
+            }
+            Job &job = _staged[_count++];
+            uint16_t quantity;
+            memcpy(&job.length, payload + i, 4);
+            memcpy(&job.leftStrip, payload + i + 4, 4);
+            memcpy(&job.rightStrip, payload + i + 8, 4);
+            memcpy(&quantity, payload + i + 12, 2);
+            job.quantity = quantity;
+            job.priority = (int8_t)payload[i + 14];
+        }
+        send = ++_sinceAck >= JOB_LINK_ACK_EVERY;
+    } else if (kind == JOB_MSG_END && length >= 3) {
+        // Not taken if the commit can not be queued, the sender resends it
+        _announced = payload[2];
+        if (_events.post(EVENT_FRAME, 'J')) {
+            _next++;
+            _open = false;
+            _committing = true;
+        }
+    } else {
+        _next++;
+        send = true;
+    }
+    uint8_t next = _next;
+    uint8_t status = _status;
+    if (send) {
+        _sinceAck = 0;
+    }
+    _lock.unlock();
+
+    if (send) {
+        ack(next, status);
+    }
+}
+
+bool JobLink::commit()
+{
+    if (!_committing) {
+        return false;
+    }
+    // receive() leaves the staged jobs alone while _committing is set.
+    // The whole batch is checked first so a failed one adds nothing.
+    bool ok = _count == _announced && _jobs.pending() + _count <= JOB_QUEUE_SIZE;
+    for (int i = 0; i < _count; i++) {
+        if (!valid(_staged[i])) {
+            ok = false;
+        }
+    }
+    if (ok) {
+        int ids[JOB_QUEUE_SIZE];
+        int added = 0;
+        for (int i = 0; i < _count && ok; i++) {
+            Job &job = _staged[i];
+            ids[added] = _jobs.add(job.length, job.leftStrip, job.rightStrip, job.quantity, job.priority, false);
+            if (ids[added] < 0) {
+                ok = false;
+            } else {
+                added++;
+            }
+        }
+        ok = ok && _jobs.save();
+        // A failed batch leaves the queue as it was, the sender will resend all of it
+        if (!ok) {
+            for (int i = 0; i < added; i++) {
+                _jobs.remove(ids[i]);
+            }
+        }
+    }
+
+    _lock.lock();
+    _status = ok ? JOB_ACK_COMMITTED : JOB_ACK_FAILED;
+    if (ok) {
+        _batches++;
+    }
+    _committing = false;
+    uint8_t next = _next;
+    uint8_t status = _status;
+    _lock.unlock();
+
+    ack(next, status);
+    return ok;
+}
+
+bool JobLink::valid(const Job &job)
+{
+    // Written so NaN fails too; the strips must leave wire between them
+    return isfinite(job.length) && isfinite(job.leftStrip) && isfinite(job.rightStrip) &&
+           job.length > 0 && job.length <= JOB_LINK_LENGTH_MAX &&
+           job.leftStrip >= 0 && job.rightStrip >= 0 &&
+           job.leftStrip + job.rightStrip < job.length && job.quantity >= 1;
+}
+
+void JobLink::ack(uint8_t next, uint8_t status)
+{
+    uint8_t payload[3] = {JOB_MSG_ACK, next, status};
+    _pad.send(payload, sizeof(payload));
+}
+
+int JobLink::batches()
+{
+    return _batches;
+}
+
+int JobLink::jobsReceived()
+{
+    return _jobsReceived;
+}
+
+int JobLink::outOfOrder()
+{
+    return _outOfOrder;
+}
\ No newline at end of file
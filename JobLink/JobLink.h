@@ -0,0 +1,112 @@
+#ifndef JOB_LINK_H
+#define JOB_LINK_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "BluefruitPad.h"
+#include "JobQueue.h"
+#include "StateMachine.h"
+
+#ifndef JOB_LINK_ACK_EVERY
+#define JOB_LINK_ACK_EVERY 4 // in order messages between acknowledgements, keep below the sender's window
+#endif
+
+#ifndef JOB_LINK_LENGTH_MAX
+#define JOB_LINK_LENGTH_MAX 12000.0 // in, longest wire taken: a whole MAX_SPOOL_LENGTH spool
+#endif
+
+#define JOB_LINK_SPEC_SIZE 15 // bytes per job in a JOB_MSG_JOBS message
+#define JOB_LINK_SPECS_MAX ((BLE_DATA_MAX - 2) / JOB_LINK_SPEC_SIZE) // jobs per message
+
+typedef enum {
+    JOB_MSG_BEGIN = 'B', // start a batch, drops anything staged
+    JOB_MSG_JOBS  = 'D', // one or more job specs
+    JOB_MSG_END   = 'E', // byte 2 the number of jobs sent, commits the batch
+    JOB_MSG_ACK   = 'A'  // to the sender: next sequence number expected, JobAckStatus
+} JobMessage;
+
+typedef enum {
+    JOB_ACK_OK        = 0,
+    JOB_ACK_FULL      = 1, // more jobs than the queue holds, the batch will fail
+    JOB_ACK_COMMITTED = 2, // the batch is in the job file
+    JOB_ACK_FAILED    = 3  // job count mismatch, a job out of range, queue full or the file could not be written
+} JobAckStatus;
+
+/** Batch upload of wire specs over the BLE data frames
+ *
+ * Every message is one BluefruitPad data frame, so framing and the CRC are
+ * handled there; the payload is a JobMessage, a sequence number and data.
+ * The sender keeps a window of messages in flight and goes back to the
+ * last acknowledged one on a timeout. Messages are only taken in sequence,
+ * anything else is dropped and answered at once with an acknowledgement
+ * naming the message expected, so a lost or corrupted message is resent
+ * without waiting for the timeout. In order messages are acknowledged
+ * every JOB_LINK_ACK_EVERY. Until a JOB_MSG_BEGIN arrives the link still
+ * answers with the last batch's sequence and status, so the sender waits
+ * for the begin to be acknowledged before sending the rest.
+ *
+ * A job spec is 15 bytes, little endian: float length, left strip and
+ * right strip in inches, uint16 quantity and int8 priority. Specs are
+ * staged until JOB_MSG_END, which posts EVENT_FRAME 'J'; commit() then
+ * adds the whole batch to the JobQueue with a single save, off the parser
+ * thread, and acknowledges with JOB_ACK_COMMITTED. A batch with any job
+ * the machine can not cut, e.g. a NaN or a length over JOB_LINK_LENGTH_MAX,
+ * is refused whole with JOB_ACK_FAILED.
+ *
+ * JobLink/upload_jobs.py sends a batch from a PC.
+ */
+class JobLink
+{
+public:
+    /** Create an uploader for a link
+     *
+     * @param pad Link the messages arrive on and acknowledgements leave by
+     * @param jobs Queue committed batches are added to
+     * @param events Queue EVENT_FRAME 'J' is posted to when a batch is complete
+     */
+    JobLink(BluefruitPad &pad, JobQueue &jobs, EventQueue &events);
+
+    /** Take one message, attach to the pad's data frames */
+    void receive(const uint8_t *payload, int length);
+
+    /** Add a completed batch to the job queue and save it
+     *
+     * Call on EVENT_FRAME 'J', from a thread that may write the SD card.
+     *
+     * @returns false if the batch was not added
+     */
+    bool commit();
+
+    /** Batches committed since boot */
+    int batches();
+
+    /** Job specs received since boot */
+    int jobsReceived();
+
+    /** Messages dropped for arriving out of sequence */
+    int outOfOrder();
+
+private:
+    static bool valid(const Job &job);
+    void ack(uint8_t next, uint8_t status);
+
+    BluefruitPad &_pad;
+    JobQueue &_jobs;
+    EventQueue &_events;
+    Mutex _lock;
+
+    Job _staged[JOB_QUEUE_SIZE];
+    int _count;         // jobs staged
+    int _announced;     // jobs the sender said it sent
+    uint8_t _next;      // sequence number expected
+    uint8_t _status;    // JobAckStatus sent with every acknowledgement
+    bool _open;         // a batch has begun and not ended
+    volatile bool _committing; // staged jobs belong to commit() until it acknowledges
+    int _sinceAck;
+
+    int _batches;
+    int _jobsReceived;
+    int _outOfOrder;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""Upload a batch of wire specs to the machine's JobLink.
+
+Usage: upload_jobs.py PORT jobs.csv [--baud 9600] [--window 8] [--per-frame 8]
+
+PORT is a serial port carrying the BLE UART, e.g. a Bluefruit module or a
+USB UART wired to the board's BLE pins; needs pyserial. Each CSV line is
+length, left strip, right strip (in) and quantity, with an optional
+priority. The batch is only added to the job file if every job arrives.
+
+Messages go go-back-N: up to --window messages in flight, resent from the
+last acknowledged one on a duplicate acknowledgement or a timeout. The
+window only opens once the begin message is acknowledged, so a lost begin
+can not leave the board answering with the last batch's sequence numbers.
+Noisy links do better with fewer jobs per frame.
+"""
+import argparse
+import binascii
+import csv
+import struct
+import sys
+import time
+
+import serial
+
+MSG_BEGIN = b'B'
+MSG_JOBS = b'D'
+MSG_END = b'E'
+MSG_ACK = ord('A')
+ACK_COMMITTED = 2
+ACK_FAILED = 3
+SPEC = struct.Struct('<fffHb')
+DATA_MAX = 128
+TIMEOUT = 1.0
+RETRIES = 20
+
+
+def frame(payload):
+    body = b'!J' + bytes([len(payload)]) + payload
+    return body + struct.pack('<H', binascii.crc_hqx(body, 0xFFFF))
+
+
+class Acks:
+    """Pulls '!J' acknowledgement frames out of the bytes from the board"""
+
+    def __init__(self, port):
+        self.port = port
+        self.buf = b''
+
+    def read(self):
+        self.buf += self.port.read(self.port.in_waiting or 1)
+        acks = []
+        while True:
+            start = self.buf.find(b'!J')
+            if start < 0 or len(self.buf) < start + 3:
+                self.buf = self.buf[start:] if start >= 0 else self.buf[-1:]
+                return acks
+            end = start + 5 + self.buf[start + 2]
+            if len(self.buf) < end:
+                self.buf = self.buf[start:]
+                return acks
+            body, crc = self.buf[start:end - 2], self.buf[end - 2:end]
+            if struct.pack('<H', binascii.crc_hqx(body, 0xFFFF)) == crc and body[3] == MSG_ACK:
+                acks.append((body[4], body[5]))
+                self.buf = self.buf[end:]
+            else:
+                self.buf = self.buf[start + 1:]
+
+
+def messages(jobs, per_frame):
+    specs = [SPEC.pack(*job) for job in jobs]
+    payloads = [MSG_BEGIN]
+    for i in range(0, len(specs), per_frame):
+        payloads.append(MSG_JOBS + b''.join(specs[i:i + per_frame]))
+    payloads.append(MSG_END + bytes([len(jobs)]))
+    # Sequence numbers go after the message type
+    return [p[:1] + bytes([seq & 0xFF]) + p[1:] for seq, p in enumerate(payloads)]
+
+
+def upload(port, jobs, window, per_frame):
+    msgs = messages(jobs, per_frame)
+    acks = Acks(port)
+    base = sent = 0
+    back_from = None
+    retries = 0
+    last = time.monotonic()
+    while retries < RETRIES:
+        while sent < len(msgs) and sent - base < (window if base else 1):
+            port.write(frame(msgs[sent]))
+            sent += 1
+        for next_seq, status in acks.read():
+            if status == ACK_FAILED:
+                return False
+            advance = (next_seq - base) & 0xFF
+            if status == ACK_COMMITTED and advance == len(msgs) - base:
+                return True
+            if 0 < advance <= sent - base:
+                base += advance
+                back_from = None
+                retries = 0
+                last = time.monotonic()
+            elif advance == 0 and sent > base and back_from != base:
+                # The board missed base, once per loss is enough
+                back_from = base
+                sent = base
+        if time.monotonic() - last > TIMEOUT:
+            sent = base
+            retries += 1
+            last = time.monotonic()
+    return False
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument('port')
+    parser.add_argument('jobs')
+    parser.add_argument('--baud', type=int, default=9600)
+    parser.add_argument('--window', type=int, default=8)
+    parser.add_argument('--per-frame', type=int, default=(DATA_MAX - 2) // SPEC.size)
+    args = parser.parse_args()
+
+    jobs = []
+    with open(args.jobs, newline='') as f:
+        for row in csv.reader(f):
+            if row and not row[0].startswith('#'):
+                priority = int(row[4]) if len(row) > 4 else 0
+                jobs.append((float(row[0]), float(row[1]), float(row[2]), int(row[3]), priority))
+    if not 0 < len(jobs) < 256:
+        sys.exit('need 1 to 255 jobs')
+
+    with serial.Serial(args.port, args.baud, timeout=0.05) as port:
+        start = time.monotonic()
+        if not upload(port, jobs, args.window, min(args.per_frame, (DATA_MAX - 2) // SPEC.size)):
+            sys.exit('upload failed')
+    print('%d jobs uploaded in %.2f s' % (len(jobs), time.monotonic() - start))
+
+
+if __name__ == '__main__':
+    main()
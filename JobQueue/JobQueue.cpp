@@ -0,0 +1,228 @@
+#include "JobQueue.h"
+
+JobQueue::JobQueue(const char *path):_path(path), _count(0), _nextId(1)
+{
+    snprintf(_tmpPath, sizeof(_tmpPath), "%s.tmp", path);
+}
+
+bool JobQueue::load()
+{
+    FILE *fp = fopen(_path, "r");
+    if (fp == NULL) {
+        fp = fopen(_tmpPath, "r");
+    }
+    if (fp == NULL) {
+        return false;
+    }
+    _lock.lock();
+    _count = 0;
+    Job job;
+    while (_count < JOB_QUEUE_SIZE &&
+           fscanf(fp, "%d %f %f %f %d %d %d", &job.id, &job.length, &job.leftStrip, &job.rightStrip,
+                  &job.quantity, &job.done, &job.priority) == 7) {
+        _jobs[_count++] = job;
+        if (job.id >= _nextId) {
+            _nextId = job.id + 1;
+        }
+    }
+    _lock.unlock();
+    fclose(fp);
+    return true;
+}
+
+// One lock from open to rename, so two saves never share the temporary file
+bool JobQueue::save()
+{
+    _lock.lock();
+    FILE *fp = fopen(_tmpPath, "w");
+    bool ok = fp != NULL;
+    for (int i = 0; ok && i < _count; i++) {
+        Job &job = _jobs[i];
+        ok = fprintf(fp, "%d %.2f %.2f %.2f %d %d %d\n", job.id, job.length, job.leftStrip, job.rightStrip,
+                     job.quantity, job.done, job.priority) > 0;
+    }
+    if (fp != NULL && fclose(fp) != 0) {
+        ok = false;
+    }
+    // FatFs does not rename over an existing file, so the old one goes
+    // first; load() picks up the temporary file if power fails in between
+    if (ok) {
+        ::remove(_path);
+        ok = rename(_tmpPath, _path) == 0;
+    }
+    _lock.unlock();
+    return ok;
+}
+
+int JobQueue::add(float length, float leftStrip, float rightStrip, int quantity, int priority, bool save)
+{
+    _lock.lock();
+    if (_count == JOB_QUEUE_SIZE) {
+        purge();
+    }
+    if (_count == JOB_QUEUE_SIZE || quantity < 1) {
+        _lock.unlock();
+        return -1;
+    }
+    Job &job = _jobs[_count++];
+    job.id = _nextId++;
+    job.length = length;
+    job.leftStrip = leftStrip;
+    job.rightStrip = rightStrip;
+    job.quantity = quantity;
+    job.done = 0;
+    job.priority = priority;
+    int id = job.id;
+    _lock.unlock();
+    if (save) {
+        this->save();
+    }
+    return id;
+}
+
+void JobQueue::remove(int id)
+{
+    _lock.lock();
+    for (int i = 0; i < _count; i++) {
+        if (_jobs[i].id == id) {
+            memmove(&_jobs[i], &_jobs[i + 1], (_count - i - 1) * sizeof(Job));
+            _count--;
+            break;
+        }
+    }
+    _lock.unlock();
+}
+
+bool JobQueue::next(Job &job)
+{
+    int best = -1;
+    _lock.lock();
+    for (int i = 0; i < _count; i++) {
+        if (_jobs[i].done < _jobs[i].quantity &&
+            (best < 0 || _jobs[i].priority > _jobs[best].priority)) {
+            best = i;
+        }
+    }
+    if (best >= 0) {
+        job = _jobs[best];
+    }
+    _lock.unlock();
+    return best >= 0;
+}
+
+bool JobQueue::wireDone(int id, bool save)
+{
+    _lock.lock();
+    for (int i = 0; i < _count; i++) {
+        if (_jobs[i].id == id) {
+            _jobs[i].done++;
+            if (_jobs[i].done >= _jobs[i].quantity) {
+                save = true;
+            }
+            break;
+        }
+    }
+    _lock.unlock();
+    return !save || this->save();
+}
+
+void JobQueue::restoreProgress(int id, int done)
+{
+    _lock.lock();
+    for (int i = 0; i < _count; i++) {
+        if (_jobs[i].id == id) {
+            if (done > _jobs[i].quantity) {
+                done = _jobs[i].quantity;
+            }
+            if (done > _jobs[i].done) {
+                _jobs[i].done = done;
+            }
+            break;
+        }
+    }
+    _lock.unlock();
+}
+
+void JobQueue::purge()
+{
+    _lock.lock();
+    int kept = 0;
+    for (int i = 0; i < _count; i++) {
+        if (_jobs[i].done < _jobs[i].quantity) {
+            _jobs[kept++] = _jobs[i];
+        }
+    }
+    _count = kept;
+    _lock.unlock();
+}
+
+void JobQueue::clear()
+{
+    _lock.lock();
+    _count = 0;
+    _lock.unlock();
+    save();
+}
+
+int JobQueue::pending()
+{
+    int n = 0;
+    _lock.lock();
+    for (int i = 0; i < _count; i++) {
+        if (_jobs[i].done < _jobs[i].quantity) {
+            n++;
+        }
+    }
+    _lock.unlock();
+    return n;
+}
+
+int JobQueue::wiresLeft()
+{
+    int n = 0;
+    _lock.lock();
+    for (int i = 0; i < _count; i++) {
+        n += _jobs[i].quantity - _jobs[i].done;
+    }
+    _lock.unlock();
+    return n;
+}
+
+int JobQueue::pendingJobs(Job *jobs, int max)
+{
+    int n = 0;
+    _lock.lock();
+    for (int i = 0; i < _count && n < max; i++) {
+        if (_jobs[i].done < _jobs[i].quantity) {
+            jobs[n++] = _jobs[i];
+        }
+    }
+    _lock.unlock();
+    return n;
+}
+
+void JobQueue::reorder(const Job *jobs, int count)
+{
+    static Job ordered[JOB_QUEUE_SIZE]; // kept off the caller's stack, guarded by _lock
+    bool taken[JOB_QUEUE_SIZE] = {false};
+    int n = 0;
+    _lock.lock();
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < _count; i++) {
+            if (!taken[i] && _jobs[i].id == jobs[k].id) {
+                ordered[n++] = _jobs[i];
+                taken[i] = true;
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < _count; i++) {
+        if (!taken[i]) {
+            ordered[n++] = _jobs[i];
+        }
+    }
+    memcpy(_jobs, ordered, n * sizeof(Job));
+    _count = n;
+    _lock.unlock();
+    save();
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#ifndef JOB_QUEUE_SIZE
+#define JOB_QUEUE_SIZE 32
+#endif
+
+#ifndef JOB_QUEUE_PATH_MAX
+#define JOB_QUEUE_PATH_MAX 32 // longest file path, temporary suffix included
+#endif
+
+/** One wire spec and how far along it is */
+typedef struct {
+    int id;
+    float length;     // in
+    float leftStrip;  // in, left end to incision
+    float rightStrip; // in, right end to incision
+    int quantity;
+    int done;
+    int priority;     // higher runs first
+} Job;
+
+/** Batch of wire specs, run back to back
+ *
+ * Jobs are kept in a text file on the SD card, one per line, and the file is
+ * rewritten every time a wire is finished so an interrupted batch resumes on
+ * the exact wire it stopped at. When progress is kept in a faster store the
+ * per-wire rewrite can be skipped, and the progress handed back after load()
+ * with restoreProgress(). The highest priority job with wires left runs
+ * next; equal priorities run in the order they were added.
+ *
+ * A save writes the whole queue to a temporary file next to the job file
+ * and renames it over the old one, so a power cut leaves one complete
+ * version or the other.
+ */
+class JobQueue
+{
+public:
+    /** Create a job queue backed by a file
+     *
+     * @param path File the queue is saved to, e.g. "/sd/jobs.txt"
+     */
+    JobQueue(const char *path);
+
+    /** Read the queue back from its file, returns false if there is none
+     *
+     * Falls back to the temporary file when a save was cut off between
+     * removing the old file and renaming the new one.
+     */
+    bool load();
+
+    /** Write the queue to its file
+     *
+     * @returns false if the file could not be written, it then still holds
+     *   the last queue saved
+     */
+    bool save();
+
+    /** Add a job, returns its id or -1 if the queue is full
+     *
+     * @param save Rewrite the file now; adding several jobs at once can
+     *   leave it to one save() after the last
+     */
+    int add(float length, float leftStrip, float rightStrip, int quantity, int priority = 0, bool save = true);
+
+    /** Copy out the job to run next, returns false when everything is done */
+    bool next(Job &job);
+
+    /** Record a finished wire of a job
+     *
+     * @param save Rewrite the file now; when false it is only rewritten
+     *   once the job has all its wires
+     * @returns false if the file was due and could not be written, the
+     *   wire is still counted in memory
+     */
+    bool wireDone(int id, bool save = true);
+
+    /** Take a job out of the queue without saving, e.g. one whose marks can
+     * not be cut
+     */
+    void remove(int id);
+
+    /** Raise the wires done of a job to at least done, e.g. from a progress
+     * record newer than the file
+     */
+    void restoreProgress(int id, int done);
+
+    /** Copy out the jobs with wires left, in queue order
+     *
+     * @returns Number of jobs copied
+     */
+    int pendingJobs(Job *jobs, int max);
+
+    /** Put jobs in the given order, ahead of any not listed
+     *
+     * next() still prefers higher priorities; within a priority the
+     * order given here is kept.
+     */
+    void reorder(const Job *jobs, int count);
+
+    /** Drop finished jobs */
+    void purge();
+
+    /** Remove every job */
+    void clear();
+
+    /** Number of jobs with wires left */
+    int pending();
+
+    /** Number of wires left across all jobs */
+    int wiresLeft();
+
+private:
+    const char *_path;
+    char _tmpPath[JOB_QUEUE_PATH_MAX];
+    Job _jobs[JOB_QUEUE_SIZE];
+    int _count;
+    int _nextId;
+    Mutex _lock;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include "LcdScreen.h"
+#include <stdarg.h>
+
+// From this many characters on, one string command is cheaper than a
+// character command each: a string costs the length plus 17 bytes for the
+// font, cursor and colour commands, a character costs 4 bytes
+#define LCD_STRING_MIN 6
+
+static void lcdWrite(uLCD_4DGL &lcd, int col, int row, int color, const char *s, int n)
+{
+    if (n >= LCD_STRING_MIN) {
+        // text_string() sends its own cursor and colour, so just set them up for puts()
+        char run[LCD_TEXT_MAX + 1];
+        memcpy(run, s, n);
+        run[n] = 0;
+        lcd.current_col = col;
+        lcd.current_row = row;
+        lcd.current_color = color;
+        lcd.puts(run);
+        return;
+    }
+    if (lcd.current_col != col || lcd.current_row != row) {
+        lcd.locate(col, row);
+    }
+    if (lcd.current_color != color) {
+        lcd.color(color);
+    }
+    for (int i = 0; i < n; i++) {
+        lcd.putc(s[i]);
+    }
+}
+
+LcdWidget::LcdWidget():_dirty(true),
+    _next(NULL)
+{
+}
+
+void LcdWidget::invalidate()
+{
+    _dirty = true;
+}
+
+LcdLabel::LcdLabel(int col, int row, const char *text, int color):_col(col),
+    _row(row),
+    _text(text),
+    _color(color)
+{
+}
+
+void LcdLabel::draw(uLCD_4DGL &lcd)
+{
+    lcdWrite(lcd, _col, _row, _color, _text, strlen(_text));
+}
+
+LcdText::LcdText(int col, int row, int width, int color):_col(col),
+    _row(row),
+    _width(width > LCD_TEXT_MAX ? LCD_TEXT_MAX : width),
+    _color(color)
+{
+    memset(_text, ' ', _width);
+    _text[_width] = 0;
+    invalidate();
+}
+
+void LcdText::printf(const char *format, ...)
+{
+    char text[LCD_TEXT_MAX + 1];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (n < 0) {
+        n = 0;
+    }
+    for (int i = n; i < _width; i++) {
+        text[i] = ' ';
+    }
+    text[_width] = 0;
+    if (memcmp(text, _text, _width) != 0) {
+        memcpy(_text, text, _width);
+        _dirty = memcmp(_text, _shown, _width) != 0;
+    }
+}
+
+void LcdText::invalidate()
+{
+    // The area was cleared: what is shown is all blanks
+    memset(_shown, ' ', _width);
+    _shown[_width] = 0;
+    _dirty = memcmp(_text, _shown, _width) != 0;
+}
+
+void LcdText::draw(uLCD_4DGL &lcd)
+{
+    int i = 0;
+    while (i < _width) {
+        if (_text[i] == _shown[i]) {
+            i++;
+            continue;
+        }
+        // Rewriting one unchanged character is cheaper than moving the cursor past it
+        int end = i + 1;
+        while (end < _width && (_text[end] != _shown[end] ||
+                                (end + 1 < _width && _text[end + 1] != _shown[end + 1]))) {
+            end++;
+        }
+        lcdWrite(lcd, _col + i, _row, _color, _text + i, end - i);
+        memcpy(_shown + i, _text + i, end - i);
+        i = end;
+    }
+}
+
+LcdShapes::LcdShapes(const LcdShape *shapes, int count):_shapes(shapes),
+    _count(count)
+{
+}
+
+void LcdShapes::draw(uLCD_4DGL &lcd)
+{
+    for (int i = 0; i < _count; i++) {
+        const LcdShape &s = _shapes[i];
+        if (s.filled) {
+            lcd.filled_rectangle(s.x1, s.y1, s.x2, s.y2, s.color);
+        } else {
+            lcd.rectangle(s.x1, s.y1, s.x2, s.y2, s.color);
+        }
+    }
+}
+
+LcdBar::LcdBar(int x1, int y1, int x2, int y2, int frame, int background):_x1(x1),
+    _y1(y1),
+    _x2(x2),
+    _y2(y2),
+    _frame(frame),
+    _background(background),
+    _end(x1),
+    _color(background),
+    _shownEnd(-1),
+    _shownColor(background),
+    _overlay(NULL)
+{
+}
+
+void LcdBar::set(int percent, int color)
+{
+    if (percent < 0) {
+        percent = 0;
+    }
+    if (percent > 100) {
+        percent = 100;
+    }
+    // The fill runs inside the outline, from x1 + 1 to x2 - 1
+    int end = _x1 + percent * (_x2 - _x1 - 1) / 100;
+    if (end == _x1) {
+        color = _background;
+    }
+    if (end != _end || color != _color) {
+        _end = end;
+        _color = color;
+        _dirty = _end != _shownEnd || _color != _shownColor;
+    }
+}
+
+void LcdBar::overlay(LcdWidget &widget)
+{
+    _overlay = &widget;
+}
+
+void LcdBar::invalidate()
+{
+    _shownEnd = -1;
+    _dirty = true;
+}
+
+void LcdBar::draw(uLCD_4DGL &lcd)
+{
+    if (_shownEnd < 0) {
+        lcd.rectangle(_x1, _y1, _x2, _y2, _frame);
+        _shownEnd = _x1;
+        _shownColor = _background;
+    }
+    if (_color != _shownColor) {
+        // Colour changed: repaint the whole fill, then clear what is left of the old one
+        if (_end > _x1) {
+            lcd.filled_rectangle(_x1 + 1, _y1 + 1, _end, _y2 - 1, _color);
+        }
+        if (_shownEnd > _end) {
+            lcd.filled_rectangle(_end + 1, _y1 + 1, _shownEnd, _y2 - 1, _background);
+        }
+    } else if (_end > _shownEnd) {
+        lcd.filled_rectangle(_shownEnd + 1, _y1 + 1, _end, _y2 - 1, _color);
+    } else if (_end < _shownEnd) {
+        lcd.filled_rectangle(_end + 1, _y1 + 1, _shownEnd, _y2 - 1, _background);
+    }
+    _shownEnd = _end;
+    _shownColor = _color;
+    if (_overlay) {
+        _overlay->invalidate();
+    }
+}
+
+LcdPage::LcdPage(int x1, int y1, int x2, int y2, int background):_x1(x1),
+    _y1(y1),
+    _x2(x2),
+    _y2(y2),
+    _background(background),
+    _first(NULL),
+    _last(NULL)
+{
+}
+
+void LcdPage::add(LcdWidget &widget)
+{
+    widget._next = NULL;
+    if (_last) {
+        _last->_next = &widget;
+    } else {
+        _first = &widget;
+    }
+    _last = &widget;
+}
+
+void LcdPage::invalidate()
+{
+    for (LcdWidget *w = _first; w; w = w->_next) {
+        w->invalidate();
+    }
+}
+
+LcdScreen::LcdScreen(uLCD_4DGL &lcd, Mutex &lock):_lcd(lcd),
+    _lock(lock),
+    _fixed(NULL),
+    _page(NULL),
+    _shown(NULL),
+    _started(false),
+    _frameBytes(0),
+    _maxFrameBytes(0),
+    _frames(0)
+{
+}
+
+void LcdScreen::fixed(LcdPage &page)
+{
+    _fixed = &page;
+}
+
+void LcdScreen::show(LcdPage &page)
+{
+    _page = &page;
+}
+
+void LcdScreen::draw(LcdPage *page)
+{
+    if (!page) {
+        return;
+    }
+    for (LcdWidget *w = page->_first; w; w = w->_next) {
+        if (w->_dirty) {
+            w->_dirty = false;
+            w->draw(_lcd);
+        }
+    }
+}
+
+unsigned int LcdScreen::frame()
+{
+    _lock.lock();
+    unsigned int start = _lcd.bytes_sent();
+    if (!_started) {
+        // Characters are written over old ones without clearing them first
+        _lcd.text_mode(OPAQUE);
+        _started = true;
+    }
+    // Until the first show() only the fixed page is drawn
+    if (_page && _page != _shown) {
+        _lcd.filled_rectangle(_page->_x1, _page->_y1, _page->_x2, _page->_y2, _page->_background);
+        _page->invalidate();
+        _shown = _page;
+    }
+    draw(_fixed);
+    draw(_shown);
+    _frameBytes = _lcd.bytes_sent() - start;
+    _lock.unlock();
+
+    _frames++;
+    if (_frameBytes > _maxFrameBytes) {
+        _maxFrameBytes = _frameBytes;
+    }
+    return _frameBytes;
+}
+
+unsigned int LcdScreen::frameBytes()
+{
+    return _frameBytes;
+}
+
+unsigned int LcdScreen::maxFrameBytes()
+{
+    return _maxFrameBytes;
+}
+
+unsigned int LcdScreen::frames()
+{
+    return _frames;
+}
\ No newline at end of file
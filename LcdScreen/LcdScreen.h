@@ -0,0 +1,217 @@
+#ifndef LCD_SCREEN_H
+#define LCD_SCREEN_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "uLCD_4DGL.h"
+
+#define LCD_TEXT_MAX 18 // columns of the 7x8 font on a 128 pixel screen
+
+/** Something on the screen that remembers what it last drew
+ *
+ * Widgets are only drawn when marked dirty, and then only send the commands
+ * needed to bring the glass from what they drew last to what they show now.
+ */
+class LcdWidget
+{
+    friend class LcdPage;
+    friend class LcdScreen;
+public:
+    LcdWidget();
+    virtual ~LcdWidget() {}
+
+    /** Forget what was drawn, the area under the widget has been cleared */
+    virtual void invalidate();
+
+protected:
+    virtual void draw(uLCD_4DGL &lcd) = 0;
+
+    bool _dirty;
+
+private:
+    LcdWidget *_next;
+};
+
+/** Fixed text, drawn once each time its page is shown */
+class LcdLabel : public LcdWidget
+{
+public:
+    LcdLabel(int col, int row, const char *text, int color = WHITE);
+
+protected:
+    virtual void draw(uLCD_4DGL &lcd);
+
+private:
+    int _col;
+    int _row;
+    const char *_text;
+    int _color;
+};
+
+/** A run of characters rewritten only where they changed
+ *
+ * Text is padded with spaces to the field width, so a shorter value erases
+ * the tail of a longer one. Text is drawn opaque, so changed characters are
+ * simply written over the old ones without clearing anything first.
+ */
+class LcdText : public LcdWidget
+{
+public:
+    LcdText(int col, int row, int width, int color = WHITE);
+
+    /** Set the text, takes effect on the next frame if anything changed */
+    void printf(const char *format, ...);
+
+    virtual void invalidate();
+
+protected:
+    virtual void draw(uLCD_4DGL &lcd);
+
+private:
+    int _col;
+    int _row;
+    int _width;
+    int _color;
+    char _text[LCD_TEXT_MAX + 1];
+    char _shown[LCD_TEXT_MAX + 1];
+};
+
+/** A filled rectangle or outline that does not change */
+typedef struct {
+    int x1, y1, x2, y2;
+    int color;
+    bool filled;
+} LcdShape;
+
+/** A set of fixed shapes, drawn once each time its page is shown */
+class LcdShapes : public LcdWidget
+{
+public:
+    LcdShapes(const LcdShape *shapes, int count);
+
+protected:
+    virtual void draw(uLCD_4DGL &lcd);
+
+private:
+    const LcdShape *_shapes;
+    int _count;
+};
+
+/** A horizontal bar graph inside an outline
+ *
+ * Growing or shrinking only paints the strip between the old and new ends.
+ * Text drawn over the bar can be given as an overlay, it is redrawn after
+ * every change to the bar so the fill does not hide it.
+ */
+class LcdBar : public LcdWidget
+{
+public:
+    LcdBar(int x1, int y1, int x2, int y2, int frame = WHITE, int background = BLACK);
+
+    /** Set the fill, percent is clamped to 0-100 */
+    void set(int percent, int color);
+
+    /** Widget redrawn whenever the bar changes, must be added after the bar */
+    void overlay(LcdWidget &widget);
+
+    virtual void invalidate();
+
+protected:
+    virtual void draw(uLCD_4DGL &lcd);
+
+private:
+    int _x1, _y1, _x2, _y2;
+    int _frame;
+    int _background;
+    int _end;        // right edge of the fill wanted, x1 when empty
+    int _color;
+    int _shownEnd;   // fill end on the glass, -1 before the outline is drawn
+    int _shownColor;
+    LcdWidget *_overlay;
+};
+
+/** A region of the screen and the widgets inside it */
+class LcdPage
+{
+    friend class LcdScreen;
+public:
+    LcdPage(int x1, int y1, int x2, int y2, int background = BLACK);
+
+    /** Add a widget, widgets are drawn in the order they are added */
+    void add(LcdWidget &widget);
+
+private:
+    void invalidate();
+
+    int _x1, _y1, _x2, _y2;
+    int _background;
+    LcdWidget *_first;
+    LcdWidget *_last;
+};
+
+/** Retained-mode model of the screen
+ *
+ * The screen has one fixed page that is always shown and one page that is
+ * swapped with show(). Widgets are updated with their new values at any
+ * time from the drawing thread, and frame() then sends the difference
+ * between what is on the glass and what the widgets hold, all under a
+ * single acquisition of the lcd lock. An unchanged screen costs nothing.
+ *
+ * Example:
+ * @code
+ * LcdScreen screen(lcd, lcdLock);
+ * LcdPage header(0, 0, 127, 15);
+ * LcdText count(0, 1, 10);
+ *
+ * header.add(count);
+ * screen.fixed(header);
+ * while (true) {
+ *     count.printf("%i", n);
+ *     screen.frame();
+ *     Thread::wait(100);
+ * }
+ * @endcode
+ */
+class LcdScreen
+{
+public:
+    LcdScreen(uLCD_4DGL &lcd, Mutex &lock);
+
+    /** Page that is always shown */
+    void fixed(LcdPage &page);
+
+    /** Swap the changing page, its region is cleared on the next frame */
+    void show(LcdPage &page);
+
+    /** Draw everything that changed since the last frame
+     *
+     * Before any page is shown only the fixed page is drawn.
+     *
+     * @returns Bytes sent to the screen for this frame
+     */
+    unsigned int frame();
+
+    /** Bytes sent by the last frame */
+    unsigned int frameBytes();
+
+    /** Most bytes sent by one frame */
+    unsigned int maxFrameBytes();
+
+    /** Frames drawn, including the ones that sent nothing */
+    unsigned int frames();
+
+private:
+    void draw(LcdPage *page);
+
+    uLCD_4DGL &_lcd;
+    Mutex &_lock;
+    LcdPage *_fixed;
+    LcdPage *_page;
+    LcdPage *_shown;
+    bool _started;
+    unsigned int _frameBytes;
+    unsigned int _maxFrameBytes;
+    unsigned int _frames;
+};
+
+#endif
\ No newline at end of file
@@ -25,7 +25,7 @@
 #include "mbed.h"
 
 Motor::Motor(PinName pwm, PinName fwd, PinName rev):
-        _pwm(pwm), _fwd(fwd), _rev(rev) {
+        _pwm(pwm), _fwd(fwd), _rev(rev), _speed(0.0) {
 
     // Set initial condition of PWM
     _pwm.period(0.001);
@@ -37,9 +37,17 @@ Motor::Motor(PinName pwm, PinName fwd, PinName rev):
 }
 
 void Motor::speed(float speed) {
+    // An interrupt stopping the motor must not land between the pins
+    core_util_critical_section_enter();
+    _speed = speed;
     _fwd = (speed > 0.0);
     _rev = (speed < 0.0);
     _pwm = abs(speed);
+    core_util_critical_section_exit();
+}
+
+float Motor::speed() {
+    return _speed;
 }
 
 
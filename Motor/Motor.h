@@ -40,16 +40,23 @@ public:
      */
     Motor(PinName pwm, PinName fwd, PinName rev);
     
-    /** Set the speed of the motor
+    /** Set the speed of the motor, safe from interrupts
      * 
      * @param speed The speed of the motor as a normalised value between -1.0 and 1.0
      */
     void speed(float speed);
 
+    /** Get the speed last set, e.g. to tell from an interrupt which way the motor runs
+     *
+     * @returns The speed as a normalised value between -1.0 and 1.0
+     */
+    float speed();
+
 protected:
     PwmOut _pwm;
     DigitalOut _fwd;
     DigitalOut _rev;
+    volatile float _speed;
 
 };
 
@@ -43,6 +43,9 @@
 #define PINDETECT_HOLD_COUNT    50
 #endif
 
+// Define PINDETECT_COUNT_CYCLES to count the DWT cycles spent in every
+// PinDetect::isr(), per tick of one pin, to compare against PinDetectGroup.
+
 namespace AjK {
 
 /** PinDetect adds mechanical switch debouncing to DigitialIn and interrupt callbacks.
@@ -453,10 +456,25 @@ public:
      */
     operator int() { return _in->read(); }
 
+#ifdef PINDETECT_COUNT_CYCLES
+    /** Cycles spent in isr() across all instances */
+    static uint32_t &cycles() { static uint32_t c = 0; return c; }
+    /** Number of isr() calls across all instances */
+    static uint32_t &ticks() { static uint32_t t = 0; return t; }
+    /** Most cycles spent in one isr() call */
+    static uint32_t &maxCycles() { static uint32_t m = 0; return m; }
+    /** Average cycles spent per isr() call */
+    static uint32_t meanCycles() { return ticks() ? cycles() / ticks() : 0; }
+    static void resetCycles() { cycles() = ticks() = maxCycles() = 0; }
+#endif
+
 protected:    
     /** The Ticker periodic callback function
      */
     void isr(void) {
+#ifdef PINDETECT_COUNT_CYCLES
+        uint32_t start = DWT->CYCCNT;
+#endif
         int currentState = _in->read();
     
         if ( currentState != _prevState ) {
@@ -490,6 +508,12 @@ protected:
                 _samplesTillHeld = 0;
             }
         }
+#ifdef PINDETECT_COUNT_CYCLES
+        uint32_t spent = DWT->CYCCNT - start;
+        cycles() += spent;
+        ticks()++;
+        if ( spent > maxCycles() ) maxCycles() = spent;
+#endif
     }
     
 };
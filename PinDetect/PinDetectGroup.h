@@ -0,0 +1,196 @@
+#ifndef AJK_PIN_DETECT_GROUP_H
+#define AJK_PIN_DETECT_GROUP_H
+
+#ifndef MBED_H
+#include "mbed.h"
+#endif
+
+#ifndef PINDETECT_GROUP_SAMPLE_PERIOD
+#define PINDETECT_GROUP_SAMPLE_PERIOD 100
+#endif
+
+namespace AjK {
+
+class PinDetectGroup;
+
+/** One debounced input of a PinDetectGroup.
+ *
+ * Offers the same callback API as PinDetect, minus the held callbacks.
+ */
+class GroupPin {
+
+    friend class PinDetectGroup;
+
+protected:
+    PinDetectGroup  *_group;
+    uint32_t        _mask;
+    FunctionPointer _callbackAsserted;
+    FunctionPointer _callbackDeasserted;
+
+public:
+    GroupPin(PinDetectGroup &group, PinName p, PinMode m = PullDown);
+
+    /** Call this function when a pin is asserted. */
+    void attach_asserted(void (*function)(void)) { _callbackAsserted.attach( function ); }
+
+    template<typename T>
+    void attach_asserted(T *object, void (T::*member)(void)) { _callbackAsserted.attach( object, member ); }
+
+    /** Call this function when a pin is deasserted. */
+    void attach_deasserted(void (*function)(void)) { _callbackDeasserted.attach( function ); }
+
+    template<typename T>
+    void attach_deasserted(T *object, void (T::*member)(void)) { _callbackDeasserted.attach( object, member ); }
+
+    /** operator int()
+     *
+     * The debounced level of the pin.
+     */
+    operator int();
+};
+
+/** Debounces every pin of one GPIO port from a single Ticker.
+ *
+ * Each tick reads the whole port once and runs a two bit vertical counter
+ * across all pins in parallel, so a pin only changes state after four equal
+ * samples in a row and the cost of a tick barely depends on how many pins
+ * are in the group. Callbacks are only looked up for pins that changed.
+ *
+ * The cycles spent in each tick are counted with the DWT cycle counter, see
+ * maxCycles() and meanCycles().
+ *
+ * Example:
+ * @code
+ * PinDetectGroup inputs( Port0 );
+ * GroupPin upperLimit( inputs, p27, PullUp );
+ * GroupPin lowerLimit( inputs, p28, PullUp );
+ *
+ * int main() {
+ *     upperLimit.attach_asserted( &stopMotor );
+ *     inputs.setSampleFrequency(); // Defaults to 100us.
+ * }
+ * @endcode
+ */
+class PinDetectGroup {
+
+    friend class GroupPin;
+
+protected:
+    PortName    _port;
+    PortIn      *_in;
+    Ticker      *_ticker;
+    uint32_t    _pinMask;
+    uint32_t    _invertMask;
+    uint32_t    _state;
+    uint32_t    _cnt0;
+    uint32_t    _cnt1;
+    GroupPin    *_pins[32];
+    uint32_t    _ticks;
+    uint32_t    _cycles;
+    uint32_t    _maxCycles;
+
+    void add(GroupPin *pin, PinName p, PinMode m) {
+        // LPC1768 pin names count up from P0_0, 32 per port
+        int index = (int)p - (int)P0_0;
+        if ( (index >> 5) != (int)_port ) error("PinDetectGroup: pin is not on this port");
+        gpio_t gpio;
+        gpio_init_in_ex( &gpio, p, m );
+        pin->_mask = 1u << (index & 31);
+        _pins[index & 31] = pin;
+        _pinMask |= pin->_mask;
+        if ( _in ) delete( _in );
+        _in = new PortIn( _port, _pinMask );
+        _state = _sample();
+    }
+
+    inline uint32_t _sample(void) { return ((uint32_t)_in->read() ^ _invertMask) & _pinMask; }
+
+public:
+
+    /** PinDetectGroup constructor
+     *
+     * @param port The GPIO port all the pins of the group are on.
+     */
+    PinDetectGroup(PortName port) : _port(port), _in(NULL), _pinMask(0), _invertMask(0),
+        _state(0), _cnt0(0), _cnt1(0), _ticks(0), _cycles(0), _maxCycles(0) {
+        for (int i = 0; i < 32; i++) _pins[i] = NULL;
+        _ticker = new Ticker;
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+
+    ~PinDetectGroup() {
+        if ( _ticker ) delete( _ticker );
+        if ( _in )     delete( _in );
+    }
+
+    /** Set the sampling time in microseconds and start sampling.
+     *
+     * @param int The time between port samples in microseconds.
+     */
+    void setSampleFrequency(int i = PINDETECT_GROUP_SAMPLE_PERIOD) {
+        _state = _sample();
+        _cnt0 = _cnt1 = 0;
+        _ticker->attach_us( this, &PinDetectGroup::isr, i );
+    }
+
+    /** Set which logic level asserts a pin (1 by default). */
+    void setAssertValue(GroupPin &pin, int i) {
+        if ( i & 1 ) _invertMask &= ~pin._mask;
+        else         _invertMask |= pin._mask;
+        _state = _sample();
+    }
+
+    /** Debounced, assert-adjusted state of every pin in the group */
+    uint32_t state(void) { return _state; }
+
+    /** Most cycles spent in one tick */
+    uint32_t maxCycles(void) { return _maxCycles; }
+
+    /** Average cycles spent per tick */
+    uint32_t meanCycles(void) { return _ticks ? _cycles / _ticks : 0; }
+
+    /** Ticks since the last resetCycles() */
+    uint32_t ticks(void) { return _ticks; }
+
+    void resetCycles(void) { _ticks = _cycles = _maxCycles = 0; }
+
+protected:
+    /** The Ticker periodic callback function
+     */
+    void isr(void) {
+        uint32_t start = DWT->CYCCNT;
+
+        // Vertical counter: a pin toggles after four samples differing from its state
+        uint32_t delta = _sample() ^ _state;
+        _cnt1 = (_cnt1 ^ _cnt0) & delta;
+        _cnt0 = ~_cnt0 & delta;
+        uint32_t toggle = delta & ~(_cnt0 | _cnt1);
+        _state ^= toggle;
+
+        while ( toggle ) {
+            int bit = 31 - __CLZ( toggle );
+            toggle &= ~(1u << bit);
+            GroupPin *pin = _pins[bit];
+            if ( _state & (1u << bit) ) pin->_callbackAsserted.call();
+            else                        pin->_callbackDeasserted.call();
+        }
+
+        uint32_t cycles = DWT->CYCCNT - start;
+        _cycles += cycles;
+        _ticks++;
+        if ( cycles > _maxCycles ) _maxCycles = cycles;
+    }
+};
+
+inline GroupPin::GroupPin(PinDetectGroup &group, PinName p, PinMode m) : _group(&group), _mask(0) {
+    group.add( this, p, m );
+}
+
+inline GroupPin::operator int() { return ((_group->_state ^ _group->_invertMask) & _mask) ? 1 : 0; }
+
+}; // namespace AjK ends.
+
+using namespace AjK;
+
+#endif
\ No newline at end of file
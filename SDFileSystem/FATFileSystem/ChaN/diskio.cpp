@@ -34,6 +34,7 @@ DSTATUS disk_initialize (
 )
 {
     debug_if(FFS_DBG, "disk_initialize on pdrv [%d]\n", pdrv);
+    FATFileSystem::_ffs[pdrv]->_cache.invalidate();
     return (DSTATUS)FATFileSystem::_ffs[pdrv]->disk_initialize();
 }
 
@@ -49,7 +50,7 @@ DRESULT disk_read (
 )
 {
     debug_if(FFS_DBG, "disk_read(sector %d, count %d) on pdrv [%d]\n", sector, count, pdrv);
-    if (FATFileSystem::_ffs[pdrv]->disk_read((uint8_t*)buff, sector, count))
+    if (FATFileSystem::_ffs[pdrv]->_cache.read((uint8_t*)buff, sector, count))
         return RES_PARERR;
     else
         return RES_OK;
@@ -68,7 +69,7 @@ DRESULT disk_write (
 )
 {
     debug_if(FFS_DBG, "disk_write(sector %d, count %d) on pdrv [%d]\n", sector, count, pdrv);
-    if (FATFileSystem::_ffs[pdrv]->disk_write((uint8_t*)buff, sector, count))
+    if (FATFileSystem::_ffs[pdrv]->_cache.write((uint8_t*)buff, sector, count))
         return RES_PARERR;
     else
         return RES_OK;
@@ -91,7 +92,7 @@ DRESULT disk_ioctl (
         case CTRL_SYNC:
             if(FATFileSystem::_ffs[pdrv] == NULL) {
                 return RES_NOTRDY;
-            } else if(FATFileSystem::_ffs[pdrv]->disk_sync()) {
+            } else if(FATFileSystem::_ffs[pdrv]->_cache.sync()) {
                 return RES_ERROR;
             }
             return RES_OK;
@@ -475,7 +475,7 @@ static WCHAR LfnBuf[_MAX_LFN + 1];
 #define	FREE_BUF()
 #elif _USE_LFN == 3 		/* LFN feature with dynamic working buffer on the heap */
 #define	DEFINE_NAMEBUF		BYTE sfn[12]; WCHAR *lfn
-#define INIT_BUF(dobj)		{ lfn = ff_memalloc((_MAX_LFN + 1) * 2); if (!lfn) LEAVE_FF((dobj).fs, FR_NOT_ENOUGH_CORE); (dobj).lfn = lfn; (dobj).fn = sfn; }
+#define INIT_BUF(dobj)		{ lfn = (WCHAR*)ff_memalloc((_MAX_LFN + 1) * 2); if (!lfn) LEAVE_FF((dobj).fs, FR_NOT_ENOUGH_CORE); (dobj).lfn = lfn; (dobj).fn = sfn; }
 #define	FREE_BUF()			ff_memfree(lfn)
 #else
 #error Wrong _USE_LFN setting
@@ -2872,30 +2872,29 @@ FRESULT f_close (
 	FIL *fp		/* Pointer to the file object to be closed */
 )
 {
-	FRESULT res;
+	FRESULT res, sres = FR_OK;
 
 
 #if !_FS_READONLY
-	res = f_sync(fp);					/* Flush cached data */
-	if (res == FR_OK)
+	sres = f_sync(fp);					/* Flush cached data */
 #endif
-	{
-		res = validate(fp);				/* Lock volume */
-		if (res == FR_OK) {
+	/* Release the file even if the flush failed, or its lock would be held
+	   until the volume is remounted and the file could never be opened again */
+	res = validate(fp);					/* Lock volume */
+	if (res == FR_OK) {
 #if _FS_REENTRANT
-			FATFS *fs = fp->fs;
+		FATFS *fs = fp->fs;
 #endif
 #if _FS_LOCK
-			res = dec_lock(fp->lockid);	/* Decrement file open counter */
-			if (res == FR_OK)
+		res = dec_lock(fp->lockid);		/* Decrement file open counter */
+		if (res == FR_OK)
 #endif
-				fp->fs = 0;				/* Invalidate file object */
+			fp->fs = 0;					/* Invalidate file object */
 #if _FS_REENTRANT
-			unlock_fs(fs, FR_OK);		/* Unlock volume */
+		unlock_fs(fs, FR_OK);			/* Unlock volume */
 #endif
-		}
 	}
-	return res;
+	return sres != FR_OK ? sres : res;
 }
 
 
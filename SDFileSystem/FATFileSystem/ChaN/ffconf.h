@@ -6,6 +6,15 @@
 
 #define FFS_DBG			0
 
+namespace rtos { class Mutex; }
+
+#ifndef FFS_CACHE_SETS
+#define FFS_CACHE_SETS	2	/* Sector cache sets, a sector lives in set (sector % sets) */
+#endif
+#ifndef FFS_CACHE_WAYS
+#define FFS_CACHE_WAYS	2	/* Sectors held per set, 0 turns the cache off */
+#endif
+
 /*---------------------------------------------------------------------------/
 / Function Configurations
 /---------------------------------------------------------------------------*/
@@ -45,7 +54,7 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define	_USE_FASTSEEK	0
+#define	_USE_FASTSEEK	1
 /* This option switches fast seek feature. (0:Disable or 1:Enable) */
 
 
@@ -92,7 +101,7 @@
 */
 
 
-#define	_USE_LFN	1
+#define	_USE_LFN	3	/* Heap, the static buffer cannot be shared by threads with _FS_REENTRANT */
 #define	_MAX_LFN	255
 /* The _USE_LFN option switches the LFN feature.
 /
@@ -216,7 +225,7 @@
 /  These options have no effect at read-only configuration (_FS_READONLY == 1). */
 
 
-#define	_FS_LOCK	0
+#define	_FS_LOCK	8
 /* The _FS_LOCK option switches file lock feature to control duplicated file open
 /  and illegal operation to open objects. This option must be 0 when _FS_READONLY
 /  is 1.
@@ -228,9 +237,9 @@
 /      lock feature is independent of re-entrancy. */
 
 
-#define _FS_REENTRANT	0
+#define _FS_REENTRANT	1
 #define _FS_TIMEOUT		1000
-#define	_SYNC_t			HANDLE
+#define	_SYNC_t			rtos::Mutex*	/* The FATFileSystem lock, see FATFileSystem.cpp */
 /* The _FS_REENTRANT option switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
 /  volume is always re-entrant and volume control functions, f_mount(), f_mkfs()
@@ -277,9 +286,12 @@
 */
 
 #define FLUSH_ON_NEW_CLUSTER    0   /* Sync the file on every new cluster */
-#define FLUSH_ON_NEW_SECTOR     1   /* Sync the file on every new sector */
+#define FLUSH_ON_NEW_SECTOR     0   /* Sync the file on every new sector */
 /* Only one of these two defines needs to be set to 1. If both are set to 0
-   the file is only sync when closed.
+   the file is only sync when closed, or by f_sync(). Both are 0 here: the
+   writers sync themselves, the job file by closing it and TelemetryLog every
+   LOG_SYNC_SECTORS sectors, so a log append costs one block write and not a
+   directory and two FAT writes as well.
    Clusters are group of sectors (eg: 8 sectors). Flushing on new cluster means
    it would be less often than flushing on new sector. Sectors are generally
    512 Bytes long. */
@@ -10,6 +10,17 @@
 #include <windows.h>
 #include <tchar.h>
 
+#elif defined(__LP64__)	/* 64 bit host build, long is 64 bit there */
+
+typedef unsigned char	BYTE;
+typedef short			SHORT;
+typedef unsigned short	WORD;
+typedef unsigned short	WCHAR;
+typedef int				INT;
+typedef unsigned int	UINT;
+typedef int				LONG;
+typedef unsigned int	DWORD;
+
 #else			/* Embedded platform */
 
 /* This type MUST be 8-bit */
@@ -25,8 +25,20 @@
 
 #include "FATFileHandle.h"
 
+#include <stdlib.h>
+
 FATFileHandle::FATFileHandle(FIL fh) {
     _fh = fh;
+#if _USE_FASTSEEK
+    _clmt = NULL;
+    _clmt_size = 0;
+#endif
+}
+
+FATFileHandle::~FATFileHandle() {
+#if _USE_FASTSEEK
+    free(_clmt);
+#endif
 }
 
 int FATFileHandle::close() {
@@ -36,6 +48,14 @@ int FATFileHandle::close() {
 }
 
 ssize_t FATFileHandle::write(const void* buffer, size_t length) {
+#if _USE_FASTSEEK
+    if (_fh.cltbl) {
+        // The map cannot grow the cluster chain, writes past the last cluster extend it
+        DWORD mapped = map_clusters() * _fh.fs->csize * _MAX_SS;
+        if (_fh.fptr + length > mapped)
+            return write_past_map((const BYTE*)buffer, length, mapped);
+    }
+#endif
     UINT n;
     FRESULT res = f_write(&_fh, buffer, length, &n);
     if (res) {
@@ -66,6 +86,15 @@ off_t FATFileHandle::lseek(off_t position, int whence) {
     } else if(whence==SEEK_CUR) {
         position += _fh.fptr;
     }
+#if _USE_FASTSEEK
+    // Seeks inside the file use the link map instead of walking the FAT from the start,
+    // seeks past the end stretch the chain and need the normal seek
+    if ((DWORD)position > _fh.fsize) {
+        _fh.cltbl = NULL;
+    } else if (!_fh.cltbl) {
+        build_map();
+    }
+#endif
     FRESULT res = f_lseek(&_fh, position);
     if (res) {
         debug_if(FFS_DBG, "lseek failed: %d\n", res);
@@ -88,3 +117,96 @@ int FATFileHandle::fsync() {
 off_t FATFileHandle::flen() {
     return _fh.fsize;
 }
+
+#if _USE_FASTSEEK
+bool FATFileHandle::build_map() {
+    if (_fh.sclust == 0)
+        return false;   // nothing allocated yet
+    for (int tries = 0; tries < 2; tries++) {
+        if (_clmt == NULL) {
+            if (_clmt_size < FFS_CLMT_SIZE)
+                _clmt_size = FFS_CLMT_SIZE;
+            _clmt = (DWORD*)malloc(_clmt_size * sizeof(DWORD));
+            if (_clmt == NULL)
+                return false;
+        }
+        _clmt[0] = _clmt_size;
+        _fh.cltbl = _clmt;
+        FRESULT res = f_lseek(&_fh, CREATE_LINKMAP);
+        if (res == FR_OK)
+            return true;
+        _fh.cltbl = NULL;
+        if (res != FR_NOT_ENOUGH_CORE)
+            break;
+        // The first try reports the size the file needs
+        debug_if(FFS_DBG, "link map needs %d DWORDs\n", _clmt[0]);
+        _clmt_size = _clmt[0];
+        free(_clmt);
+        _clmt = NULL;
+    }
+    return false;
+}
+
+// Clusters covered by the link map
+DWORD FATFileHandle::map_clusters() {
+    DWORD clusters = 0;
+    for (DWORD *run = _fh.cltbl + 1; *run; run += 2)
+        clusters += run[0];
+    return clusters;
+}
+
+// Add the cluster after the last mapped one, to the last run if it is contiguous
+bool FATFileHandle::map_cluster(DWORD clst) {
+    DWORD end = 1;
+    while (_clmt[end])
+        end += 2;
+    if (end > 1 && _clmt[end - 1] + _clmt[end - 2] == clst) {
+        _clmt[end - 2]++;
+        return true;
+    }
+    if (end + 3 > _clmt_size) {
+        DWORD *clmt = (DWORD*)realloc(_clmt, (_clmt_size + FFS_CLMT_SIZE) * sizeof(DWORD));
+        if (clmt == NULL)
+            return false;
+        _clmt = clmt;
+        _clmt_size += FFS_CLMT_SIZE;
+    }
+    _clmt[end] = 1;
+    _clmt[end + 1] = clst;
+    _clmt[end + 2] = 0;
+    _clmt[0] = end + 3;
+    return true;
+}
+
+// Write up to the end of the map with it, then let FatFs stretch the chain a
+// cluster at a time and map each new cluster, which costs no FAT reads. FatFs
+// writes at most a cluster per disk call anyway.
+ssize_t FATFileHandle::write_past_map(const BYTE* buffer, size_t length, DWORD mapped) {
+    DWORD bcs = (DWORD)_fh.fs->csize * _MAX_SS;
+    size_t done = 0;
+    UINT n;
+    FRESULT res = FR_OK;
+    if (_fh.fptr < mapped) {
+        res = f_write(&_fh, buffer, mapped - _fh.fptr, &n);
+        done = n;
+    }
+    bool map = true;
+    _fh.cltbl = NULL;
+    while (res == FR_OK && _fh.fptr == mapped && done < length) {
+        UINT chunk = length - done < bcs ? length - done : bcs;
+        res = f_write(&_fh, buffer + done, chunk, &n);
+        done += n;
+        if (n == 0)
+            break;      // disk full
+        mapped += bcs;
+        map = map && res == FR_OK && map_cluster(_fh.clust);
+    }
+    // A map that missed a cluster is dropped, the next seek builds it again
+    _fh.cltbl = map && res == FR_OK ? _clmt : NULL;
+    if (res) {
+        debug_if(FFS_DBG, "f_write() failed: %d", res);
+        return -1;
+    }
+    return done;
+}
+#endif
\ No newline at end of file
@@ -26,10 +26,15 @@
 
 using namespace mbed;
 
+#ifndef FFS_CLMT_SIZE
+#define FFS_CLMT_SIZE 16 // DWORDs in a new cluster link map, enough for 7 fragments
+#endif
+
 class FATFileHandle : public FileHandle {
 public:
 
     FATFileHandle(FIL fh);
+    virtual ~FATFileHandle();
     virtual int close();
     virtual ssize_t write(const void* buffer, size_t length);
     virtual ssize_t read(void* buffer, size_t length);
@@ -45,6 +50,16 @@ protected:
     
     FIL _fh;
 
+#if _USE_FASTSEEK
+    bool build_map();
+    DWORD map_clusters();
+    bool map_cluster(DWORD clst);
+    ssize_t write_past_map(const BYTE* buffer, size_t length, DWORD mapped);
+
+    DWORD *_clmt;       // cluster link map for fast seeks, grown as the file fragments
+    DWORD _clmt_size;   // DWORDs allocated for _clmt
+#endif
+
 };
 
 #endif
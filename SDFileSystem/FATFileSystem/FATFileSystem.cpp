@@ -40,9 +40,40 @@ DWORD get_fattime(void) {
          | (DWORD)(ptm->tm_sec/2    );
 }
 
+#if _FS_REENTRANT
+/* Each drive is guarded by the mutex of its FATFileSystem, which lives as long
+ * as the drive does, so FatFs only borrows it */
+int ff_cre_syncobj(BYTE vol, _SYNC_t *sobj) {
+    *sobj = &FATFileSystem::_ffs[vol]->_lock;
+    return 1;
+}
+
+int ff_del_syncobj(_SYNC_t sobj) {
+    return 1;
+}
+
+int ff_req_grant(_SYNC_t sobj) {
+    return sobj->lock(_FS_TIMEOUT) == osOK;
+}
+
+void ff_rel_grant(_SYNC_t sobj) {
+    sobj->unlock();
+}
+#endif
+
+#if _USE_LFN == 3
+void *ff_memalloc(UINT msize) {
+    return malloc(msize);
+}
+
+void ff_memfree(void *mblock) {
+    free(mblock);
+}
+#endif
+
 FATFileSystem *FATFileSystem::_ffs[_VOLUMES] = {0};
 
-FATFileSystem::FATFileSystem(const char* n) : FileSystemLike(n) {
+FATFileSystem::FATFileSystem(const char* n) : FileSystemLike(n), _cache(this) {
     debug_if(FFS_DBG, "FATFileSystem(%s)\n", n);
     for(int i=0; i<_VOLUMES; i++) {
         if(_ffs[i] == 0) {
@@ -167,8 +198,19 @@ int FATFileSystem::mount() {
 }
 
 int FATFileSystem::unmount() {
-    if (disk_sync())
+    lock();
+    int ret = _cache.sync();
+    unlock();
+    if (ret)
         return -1;
     FRESULT res = f_mount(NULL, _fsid, 0);
     return res == 0 ? 0 : -1;
 }
+
+void FATFileSystem::lock() {
+    _lock.lock();
+}
+
+void FATFileSystem::unlock() {
+    _lock.unlock();
+}
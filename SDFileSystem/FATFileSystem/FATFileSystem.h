@@ -25,6 +25,8 @@
 #include "FileSystemLike.h"
 #include "FileHandle.h"
 #include "ff.h"
+#include "SectorCache.h"
+#include "rtos.h"
 #include <stdint.h>
 
 using namespace mbed;
@@ -41,6 +43,8 @@ public:
     static FATFileSystem * _ffs[_VOLUMES];   // FATFileSystem objects, as parallel to FatFs drives array
     FATFS _fs;                               // Work area (file system object) for logical drive
     char _fsid[2];
+    SectorCache _cache;                      // Sectors between FatFs and the disk_* functions
+    rtos::Mutex _lock;                       // Held by FatFs for every call on this drive
 
     /**
      * Opens a file on the filesystem
@@ -84,6 +88,13 @@ public:
      */
     virtual int unmount();
 
+    /**
+     * Holds off FatFs on this drive, for raw sector access alongside it
+     * from several threads. Calls may nest.
+     */
+    void lock();
+    void unlock();
+
     virtual int disk_initialize() { return 0; }
     virtual int disk_status() { return 0; }
     virtual int disk_read(uint8_t *buffer, uint32_t sector, uint32_t count) = 0;
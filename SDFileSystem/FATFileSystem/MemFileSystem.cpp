@@ -0,0 +1,240 @@
+/* mbed Microcontroller Library - MemFileSystem
+ * Copyright (c) 2008, sford
+ */
+#include "mbed.h"
+#include "MemFileSystem.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace mbed
+{
+
+    static bool is_zero(const uint8_t *buffer) {
+        // A word at a time when aligned, stopping at the first non zero word
+        if (((uintptr_t)buffer & 3) == 0) {
+            const uint32_t *words = (const uint32_t *)buffer;
+            for (int i = 0; i < 512 / 4; i++) {
+                if (words[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        for (int i = 0; i < 512; i++) {
+            if (buffer[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    MemFileSystem::MemFileSystem(const char* name, uint32_t sectors) : FATFileSystem(name),
+        _sectors(sectors), _free(NULL), _slabs(NULL), _slab_count(0), _used(0),
+        _fixed_us(0), _sector_us(0), _fail_every(0), _fail_writes_after(-1),
+        _calls(0), _reads(0), _writes(0), _faults(0) {
+        uint32_t chunks = (sectors + MEMFS_CHUNK_SECTORS - 1) / MEMFS_CHUNK_SECTORS;
+        _table = (Block ***)calloc(chunks, sizeof(Block **));
+        if (_table == NULL) {
+            _sectors = 0;
+        }
+    }
+
+    MemFileSystem::~MemFileSystem() {
+        uint32_t chunks = (_sectors + MEMFS_CHUNK_SECTORS - 1) / MEMFS_CHUNK_SECTORS;
+        for (uint32_t i = 0; i < chunks; i++) {
+            free(_table[i]);
+        }
+        free(_table);
+        for (uint32_t i = 0; i < _slab_count; i++) {
+            free(_slabs[i]);
+        }
+        free(_slabs);
+    }
+
+    // read sectors in to the buffer, return 0 if ok
+    int MemFileSystem::disk_read(uint8_t *buffer, uint32_t sector, uint32_t count) {
+        if (fault() || sector + count > _sectors || sector + count < sector) {
+            return 1;
+        }
+        _reads++;
+        delay(count);
+        for (uint32_t i = 0; i < count; i++, buffer += 512) {
+            Block **s = slot(sector + i, false);
+            if (s == NULL || *s == NULL) {
+                // nothing allocated means sector is empty
+                memset(buffer, 0, 512);
+            } else {
+                memcpy(buffer, *s, 512);
+            }
+        }
+        return 0;
+    }
+
+    // write sectors from the buffer, return 0 if ok
+    int MemFileSystem::disk_write(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+        if (_fail_writes_after == 0) {
+            _faults++;
+            return 1;
+        }
+        if (fault() || sector + count > _sectors || sector + count < sector) {
+            return 1;
+        }
+        if (_fail_writes_after > 0) {
+            _fail_writes_after--;
+        }
+        _writes++;
+        delay(count);
+        for (uint32_t i = 0; i < count; i++, buffer += 512) {
+            if (write_sector(buffer, sector + i)) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // return the number of sectors
+    uint32_t MemFileSystem::disk_sectors() {
+        return _sectors;
+    }
+
+    void MemFileSystem::set_latency(int fixed_us, int sector_us) {
+        _fixed_us = fixed_us;
+        _sector_us = sector_us;
+    }
+
+    void MemFileSystem::fail_every(uint32_t n) {
+        _fail_every = n;
+        _calls = 0;
+    }
+
+    void MemFileSystem::fail_writes_after(int n) {
+        _fail_writes_after = n;
+    }
+
+    int MemFileSystem::load(const char *path) {
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL) {
+            return -1;
+        }
+        uint32_t buffer[512 / 4];
+        int res = 0;
+        for (uint32_t sector = 0; sector < _sectors; sector++) {
+            // past the end of a short image the disk reads as empty
+            size_t n = fread(buffer, 1, 512, fp);
+            memset((uint8_t *)buffer + n, 0, 512 - n);
+            if (write_sector((uint8_t *)buffer, sector)) {
+                res = -1;
+                break;
+            }
+        }
+        fclose(fp);
+        return res;
+    }
+
+    int MemFileSystem::save(const char *path) {
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL) {
+            return -1;
+        }
+        static const uint8_t zero[512] = {0};
+        int res = 0;
+        for (uint32_t sector = 0; sector < _sectors && res == 0; sector++) {
+            Block **s = slot(sector, false);
+            // zero sectors are seeked over, which leaves a hole where the host supports them
+            if ((s && *s) || sector == _sectors - 1) {
+                if (fseek(fp, (long)sector * 512, SEEK_SET) ||
+                    fwrite(s && *s ? (const void *)*s : (const void *)zero, 1, 512, fp) != 512) {
+                    res = -1;
+                }
+            }
+        }
+        if (fclose(fp)) {
+            res = -1;
+        }
+        return res;
+    }
+
+    MemFileSystem::Block **MemFileSystem::slot(uint32_t sector, bool create) {
+        Block **&chunk = _table[sector / MEMFS_CHUNK_SECTORS];
+        if (chunk == NULL) {
+            if (!create) {
+                return NULL;
+            }
+            chunk = (Block **)calloc(MEMFS_CHUNK_SECTORS, sizeof(Block *));
+            if (chunk == NULL) {
+                return NULL;
+            }
+        }
+        return &chunk[sector % MEMFS_CHUNK_SECTORS];
+    }
+
+    MemFileSystem::Block *MemFileSystem::alloc_block() {
+        if (_free == NULL) {
+            Block **slabs = (Block **)realloc(_slabs, (_slab_count + 1) * sizeof(Block *));
+            if (slabs == NULL) {
+                return NULL;
+            }
+            _slabs = slabs;
+            Block *slab = (Block *)malloc(MEMFS_SLAB_SECTORS * sizeof(Block));
+            if (slab == NULL) {
+                return NULL;
+            }
+            _slabs[_slab_count++] = slab;
+            for (int i = 0; i < MEMFS_SLAB_SECTORS; i++) {
+                free_block(&slab[i]);
+            }
+        }
+        Block *block = _free;
+        _free = block->next;
+        return block;
+    }
+
+    void MemFileSystem::free_block(Block *block) {
+        block->next = _free;
+        _free = block;
+    }
+
+    int MemFileSystem::write_sector(const uint8_t *buffer, uint32_t sector) {
+        // if buffer is zero give the sector back
+        if (is_zero(buffer)) {
+            Block **s = slot(sector, false);
+            if (s && *s) {
+                free_block(*s);
+                *s = NULL;
+                _used--;
+            }
+            return 0;
+        }
+        // else allocate a sector if needed, and write
+        Block **s = slot(sector, true);
+        if (s == NULL) {
+            return 1; // out of memory
+        }
+        if (*s == NULL) {
+            *s = alloc_block();
+            if (*s == NULL) {
+                return 1; // out of memory
+            }
+            _used++;
+        }
+        memcpy(*s, buffer, 512);
+        return 0;
+    }
+
+    bool MemFileSystem::fault() {
+        if (_fail_every && ++_calls % _fail_every == 0) {
+            _faults++;
+            return true;
+        }
+        return false;
+    }
+
+    void MemFileSystem::delay(uint32_t count) {
+        int us = _fixed_us + _sector_us * (int)count;
+        if (us > 0) {
+            wait_us(us);
+        }
+    }
+
+}
\ No newline at end of file
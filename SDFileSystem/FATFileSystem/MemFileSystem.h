@@ -8,67 +8,99 @@
 
 #include "FATFileSystem.h"
 
+#ifndef MEMFS_CHUNK_SECTORS
+#define MEMFS_CHUNK_SECTORS 64  // sectors per second level table, allocated on first write
+#endif
+
+#ifndef MEMFS_SLAB_SECTORS
+#define MEMFS_SLAB_SECTORS 16   // sectors of storage taken from the heap at a time
+#endif
+
 namespace mbed
 {
 
+    /** FAT file system on a sparse RAM disk, for testing without a card
+     *
+     * Only sectors holding something other than zeros take memory. Sector
+     * pointers live in a two level table whose second level is allocated
+     * per MEMFS_CHUNK_SECTORS on first use, so a large disk costs little
+     * until it is written. Sector storage comes from slabs of
+     * MEMFS_SLAB_SECTORS and is recycled through a free list instead of a
+     * malloc and free per sector.
+     *
+     * For benchmarking the layers above, every access can be slowed by a
+     * fixed and a per sector latency, and faults can be injected. The
+     * image can be saved to and loaded from a file through stdio.
+     */
     class MemFileSystem : public FATFileSystem
     {
     public:
     
-        // 2000 sectors, each 512 bytes (malloced as required)
-        char *sectors[2000];
+        /** Create a RAM disk
+         *
+         * @param name Name of the file system
+         * @param sectors Size of the disk in 512 byte sectors
+         */
+        MemFileSystem(const char* name, uint32_t sectors = 2000);
+        virtual ~MemFileSystem();
+    
+        virtual int disk_read(uint8_t *buffer, uint32_t sector, uint32_t count);
+        virtual int disk_write(const uint8_t *buffer, uint32_t sector, uint32_t count);
+        virtual uint32_t disk_sectors();
+    
+        /** Busy wait on every access, fixed_us per call plus sector_us per sector */
+        void set_latency(int fixed_us, int sector_us);
+    
+        /** Fail every nth read or write call, 0 turns it off */
+        void fail_every(uint32_t n);
+    
+        /** Let n more write calls through, then fail every write as a card
+         * that lost power would; -1 turns it off
+         */
+        void fail_writes_after(int n);
+    
+        /** Load an image written by save(), or any raw disk image */
+        int load(const char *path);
+    
+        /** Save the disk as a raw image, zero sectors are skipped over */
+        int save(const char *path);
+    
+        uint32_t reads() { return _reads; }
+        uint32_t writes() { return _writes; }
+        uint32_t faults() { return _faults; }
+    
+        /** Sectors holding data */
+        uint32_t used_sectors() { return _used; }
     
-        MemFileSystem(const char* name) : FATFileSystem(name) {
-            memset(sectors, 0, sizeof(sectors));
-        }
+    private:
     
-        virtual ~MemFileSystem() {
-            for(int i = 0; i < 2000; i++) {
-                if(sectors[i]) {
-                    free(sectors[i]);
-                }
-            }
-        }
+        typedef union Block {
+            union Block *next;          // while on the free list
+            uint32_t words[512 / 4];
+        } Block;
     
-        // read a sector in to the buffer, return 0 if ok
-        virtual int disk_read(char *buffer, int sector) {
-            if(sectors[sector] == 0) {
-                // nothing allocated means sector is empty
-                memset(buffer, 0, 512);
-            } else {
-                memcpy(buffer, sectors[sector], 512);
-            }
-            return 0;
-        }
+        Block **slot(uint32_t sector, bool create);
+        Block *alloc_block();
+        void free_block(Block *block);
+        int write_sector(const uint8_t *buffer, uint32_t sector);
+        bool fault();
+        void delay(uint32_t count);
     
-        // write a sector from the buffer, return 0 if ok
-        virtual int disk_write(const char *buffer, int sector) {
-            // if buffer is zero deallocate sector
-            char zero[512];
-            memset(zero, 0, 512);
-            if(memcmp(zero, buffer, 512)==0) {
-                if(sectors[sector] != 0) {
-                    free(sectors[sector]);
-                    sectors[sector] = 0;
-                }
-                return 0;
-            }
-            // else allocate a sector if needed, and write
-            if(sectors[sector] == 0) {
-                char *sec = (char*)malloc(512);
-                if(sec==0) {
-                    return 1; // out of memory
-                }
-                sectors[sector] = sec;
-            }
-            memcpy(sectors[sector], buffer, 512);
-            return 0;
-        }
+        uint32_t _sectors;
+        Block ***_table;                // [sectors / chunk][chunk], NULL where never written
+        Block *_free;
+        Block **_slabs;                 // every slab, to give them back
+        uint32_t _slab_count;
+        uint32_t _used;
     
-        // return the number of sectors
-        virtual int disk_sectors() {
-            return sizeof(sectors)/sizeof(sectors[0]);
-        }
+        int _fixed_us;
+        int _sector_us;
+        uint32_t _fail_every;
+        int _fail_writes_after;
+        uint32_t _calls;
+        uint32_t _reads;
+        uint32_t _writes;
+        uint32_t _faults;
     
     };
 
@@ -0,0 +1,183 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2012 ARM Limited
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "SectorCache.h"
+#include "FATFileSystem.h"
+
+#include <string.h>
+
+SectorCache::SectorCache(FATFileSystem *disk) : _disk(disk), _hits(0), _misses(0), _writebacks(0) {
+#if FFS_CACHE_WAYS
+    _clock = 0;
+    invalidate();
+#endif
+}
+
+#if FFS_CACHE_WAYS
+
+int SectorCache::read(uint8_t *buffer, uint32_t sector, uint32_t count) {
+    if (count > 1) {
+        // Bypassed, but sectors written to the cache and not yet to the disk are newer
+        _misses += count;
+        if (_disk->disk_read(buffer, sector, count))
+            return -1;
+        for (int i = 0; i < FFS_CACHE_SETS * FFS_CACHE_WAYS; i++) {
+            Line *line = &_lines[i];
+            if (line->dirty && line->sector - sector < count) {
+                memcpy(buffer + (line->sector - sector) * _MAX_SS, data(line), _MAX_SS);
+            }
+        }
+        return 0;
+    }
+
+    Line *line = find(sector);
+    if (line) {
+        _hits++;
+    } else {
+        _misses++;
+        line = claim(sector);
+        if (line == NULL || _disk->disk_read(data(line), sector, 1))
+            return -1;
+        line->sector = sector;
+        line->valid = true;
+    }
+    line->used = ++_clock;
+    memcpy(buffer, data(line), _MAX_SS);
+    return 0;
+}
+
+int SectorCache::write(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+    if (count > 1) {
+        _misses += count;
+        return write_through(buffer, sector, count);
+    }
+
+    Line *line = find(sector);
+    if (line) {
+        _hits++;
+    } else {
+        // The whole sector is overwritten, no need to read it first
+        _misses++;
+        line = claim(sector);
+        if (line == NULL)
+            return -1;
+        line->sector = sector;
+        line->valid = true;
+    }
+    memcpy(data(line), buffer, _MAX_SS);
+    line->dirty = true;
+    line->used = ++_clock;
+    return 0;
+}
+
+int SectorCache::write_through(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+    if (_disk->disk_write(buffer, sector, count))
+        return -1;
+    // Cached copies of the run now match the disk
+    for (int i = 0; i < FFS_CACHE_SETS * FFS_CACHE_WAYS; i++) {
+        Line *line = &_lines[i];
+        if (line->valid && line->sector - sector < count) {
+            memcpy(data(line), buffer + (line->sector - sector) * _MAX_SS, _MAX_SS);
+            line->dirty = false;
+        }
+    }
+    return 0;
+}
+
+int SectorCache::sync() {
+    int res = 0;
+    for (int i = 0; i < FFS_CACHE_SETS * FFS_CACHE_WAYS; i++) {
+        if (flush(&_lines[i]))
+            res = -1;
+    }
+    if (_disk->disk_sync())
+        res = -1;
+    return res;
+}
+
+void SectorCache::invalidate() {
+    for (int i = 0; i < FFS_CACHE_SETS * FFS_CACHE_WAYS; i++) {
+        _lines[i].valid = false;
+        _lines[i].dirty = false;
+    }
+}
+
+SectorCache::Line *SectorCache::find(uint32_t sector) {
+    Line *set = &_lines[(sector % FFS_CACHE_SETS) * FFS_CACHE_WAYS];
+    for (int i = 0; i < FFS_CACHE_WAYS; i++) {
+        if (set[i].valid && set[i].sector == sector)
+            return &set[i];
+    }
+    return NULL;
+}
+
+SectorCache::Line *SectorCache::claim(uint32_t sector) {
+    // An empty way if there is one, else the least recently used
+    Line *set = &_lines[(sector % FFS_CACHE_SETS) * FFS_CACHE_WAYS];
+    Line *victim = &set[0];
+    for (int i = 0; i < FFS_CACHE_WAYS && victim->valid; i++) {
+        if (!set[i].valid || _clock - set[i].used > _clock - victim->used)
+            victim = &set[i];
+    }
+    if (flush(victim))
+        return NULL;
+    victim->valid = false;
+    return victim;
+}
+
+int SectorCache::flush(Line *line) {
+    if (!line->dirty)
+        return 0;
+    if (_disk->disk_write(data(line), line->sector, 1))
+        return -1;
+    line->dirty = false;
+    _writebacks++;
+    return 0;
+}
+
+uint8_t *SectorCache::data(Line *line) {
+    return _data[line - _lines];
+}
+
+#else
+
+int SectorCache::read(uint8_t *buffer, uint32_t sector, uint32_t count) {
+    _misses += count;
+    return _disk->disk_read(buffer, sector, count);
+}
+
+int SectorCache::write(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+    _misses += count;
+    return _disk->disk_write(buffer, sector, count);
+}
+
+int SectorCache::write_through(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+    return _disk->disk_write(buffer, sector, count);
+}
+
+int SectorCache::sync() {
+    return _disk->disk_sync();
+}
+
+void SectorCache::invalidate() {
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2012 ARM Limited
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef MBED_SECTORCACHE_H
+#define MBED_SECTORCACHE_H
+
+#include "ffconf.h"
+#include <stdint.h>
+
+class FATFileSystem;
+
+/**
+ * Write-back cache of whole sectors between FatFs and a FATFileSystem disk
+ *
+ * The cache is FFS_CACHE_SETS sets of FFS_CACHE_WAYS sectors each. A sector
+ * can only be held in set (sector % FFS_CACHE_SETS), and the least recently
+ * used sector of the set is evicted to make room for a new one. Single sector
+ * accesses, which is how FatFs touches the FAT, directories and partial file
+ * sectors, are served from the cache. Multi sector runs are whole clusters of
+ * file data and go straight to the disk so they keep the speed of multi block
+ * transfers, the cached copies of any sector in the run are kept coherent.
+ *
+ * Writes stay in RAM until the sector is evicted or sync() is called, which
+ * FatFs does through CTRL_SYNC on f_sync() and f_close().
+ */
+class SectorCache {
+public:
+
+    SectorCache(FATFileSystem *disk);
+
+    int read(uint8_t *buffer, uint32_t sector, uint32_t count);
+    int write(const uint8_t *buffer, uint32_t sector, uint32_t count);
+
+    /**
+     * Writes straight to the disk, cached copies of the sectors are updated
+     */
+    int write_through(const uint8_t *buffer, uint32_t sector, uint32_t count);
+
+    /**
+     * Writes back every dirty sector, then syncs the disk
+     */
+    int sync();
+
+    /**
+     * Drops every sector without writing it back, for a new or reinserted disk
+     */
+    void invalidate();
+
+    uint32_t hits() { return _hits; }
+    uint32_t misses() { return _misses; }
+    uint32_t writebacks() { return _writebacks; }
+
+private:
+
+#if FFS_CACHE_WAYS
+    struct Line {
+        uint32_t sector;
+        uint32_t used;      // value of _clock when last touched
+        bool valid;
+        bool dirty;
+    };
+
+    Line *find(uint32_t sector);
+    Line *claim(uint32_t sector);
+    int flush(Line *line);
+    uint8_t *data(Line *line);
+
+    Line _lines[FFS_CACHE_SETS * FFS_CACHE_WAYS];
+    uint8_t _data[FFS_CACHE_SETS * FFS_CACHE_WAYS][_MAX_SS];
+    uint32_t _clock;
+#endif
+
+    FATFileSystem *_disk;
+    uint32_t _hits;
+    uint32_t _misses;
+    uint32_t _writebacks;
+};
+
+#endif
\ No newline at end of file
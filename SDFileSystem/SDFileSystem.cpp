@@ -52,16 +52,17 @@
  * card always responds to commands, data blocks and errors.
  *
  * The protocol supports a CRC, but by default it is off (except for the
- * first reset CMD0, where the CRC can just be pre-calculated, and CMD8)
- * I'll leave the CRC off I think!
+ * first reset CMD0, and CMD8). It can be turned on with set_crc(), and then
+ * every data block is checked with its CRC16 and retried if it fails.
  *
  * Standard capacity cards have variable data block sizes, whereas High
  * Capacity cards fix the size of data block to 512 bytes. I'll therefore
  * just always use the Standard Capacity cards with a block size of 512 bytes.
  * This is set with CMD16.
  *
- * You can read and write single blocks (CMD17, CMD25) or multiple blocks
- * (CMD18, CMD25). For simplicity, I'll just use single block accesses. When
+ * You can read and write single blocks (CMD17, CMD24) or multiple blocks
+ * (CMD18, CMD25). Single blocks are used for one sector and multiple blocks
+ * for longer runs, which saves the command and busy overhead per sector. When
  * the card gets a read command, it responds with a response token, and then
  * a data token or an error.
  *
@@ -73,7 +74,8 @@
  * | 01 | cmd[5:0] | arg[31:24] | arg[23:16] | arg[15:8] | arg[7:0] | crc[6:0] | 1 |
  * +---------------+------------+------------+-----------+----------+--------------+
  *
- * As I'm not using CRC, I can fix that byte to what is needed for CMD0 (0x95)
+ * The CRC7 is always worked out from a table, so the card can be switched to
+ * checking CRCs (CMD59) at any time.
  *
  * All Application Specific commands shall be preceded with APP_CMD (CMD55).
  *
@@ -111,18 +113,47 @@
  * +------+---------+---------+- -  - -+---------+-----------+----------+
  * | 0xFE | data[0] | data[1] |        | data[n] | crc[15:8] | crc[7:0] |
  * +------+---------+---------+- -  - -+---------+-----------+----------+
+ *
+ * Multiple Block Read and Write
+ * -----------------------------
+ *
+ * CMD18 streams blocks, each with the same 0xFE header and CRC, until it is
+ * stopped with CMD12. CMD12 is followed by one stuff byte before its R1b
+ * response.
+ *
+ * CMD25 takes blocks with a 0xFC header instead, each acknowledged by a
+ * data response token and a busy signal, until the 0xFD stop token ends the
+ * transfer. Telling the card the number of blocks beforehand with ACMD23
+ * lets it pre-erase them, which speeds up the write.
  */
 #include "SDFileSystem.h"
 #include "mbed_debug.h"
+#include "TableCRC.h"
 
 #define SD_COMMAND_TIMEOUT 5000
 
+// Data tokens
+#define SD_START_BLOCK          0xFE // single block read/write, multiple block read
+#define SD_START_MULTI_WRITE    0xFC
+#define SD_STOP_MULTI_WRITE     0xFD
+
 #define SD_DBG             0
 
+#define SD_CRC_RETRIES     3 // attempts per block after a CRC failure
+
+// _read_data() and _write_data() results
+#define SD_BLOCK_OK        0
+#define SD_BLOCK_ERROR     1
+#define SD_BLOCK_CRC       2
+
 SDFileSystem::SDFileSystem(PinName mosi, PinName miso, PinName sclk, PinName cs, const char* name) :
-    FATFileSystem(name), _spi(mosi, miso, sclk), _cs(cs), _is_initialized(0) {
+    FATFileSystem(name), _spi(mosi, miso, sclk), _cs(cs), _is_initialized(0),
+    _crc_on(false), _crc_errors(0) {
     _cs = 1;
 
+    // Bytes clocked out while only reading, the card wants 0xFF
+    _spi.set_default_write_value(0xFF);
+
     // Set default to 100kHz for initialisation and 1MHz for data transfer
     _init_sck = 100000;
     _transfer_sck = 1000000;
@@ -218,6 +249,12 @@ int SDFileSystem::disk_initialize() {
         return 1;
     }
 
+    // Check CRCs on commands and data (CMD59)
+    if (_crc_on && _cmd(59, 1) != 0) {
+        debug("Card refused CRC mode\n");
+        _crc_on = false;
+    }
+
     // Set SCK for data transfer
     _spi.frequency(_transfer_sck);
     return 0;
@@ -228,17 +265,27 @@ int SDFileSystem::disk_write(const uint8_t* buffer, uint32_t block_number, uint3
         return -1;
     }
     
-    for (uint32_t b = block_number; b < block_number + count; b++) {
-        // set write address for single block (CMD24)
-        if (_cmd(24, b * cdv) != 0) {
+    // On a CRC failure, carry on from the block that failed
+    int retries = 0;
+    while (count > 0) {
+        uint32_t done = 0;
+        int status = _write_blocks(buffer, block_number, count, &done);
+        if (status == SD_BLOCK_OK) {
+            return 0;
+        }
+        if (status != SD_BLOCK_CRC) {
             return 1;
         }
-        
-        // send the data block
-        _write(buffer, 512);
-        buffer += 512;
+        _crc_errors++;
+        retries = done ? 1 : retries + 1;
+        if (retries > SD_CRC_RETRIES) {
+            return 1;
+        }
+        debug_if(SD_DBG, "CRC error writing block %lu, retrying\n", block_number + done);
+        buffer += done * 512;
+        block_number += done;
+        count -= done;
     }
-    
     return 0;
 }
 
@@ -247,17 +294,27 @@ int SDFileSystem::disk_read(uint8_t* buffer, uint32_t block_number, uint32_t cou
         return -1;
     }
     
-    for (uint32_t b = block_number; b < block_number + count; b++) {
-        // set read address for single block (CMD17)
-        if (_cmd(17, b * cdv) != 0) {
+    // On a CRC failure, carry on from the block that failed
+    int retries = 0;
+    while (count > 0) {
+        uint32_t done = 0;
+        int status = _read_blocks(buffer, block_number, count, &done);
+        if (status == SD_BLOCK_OK) {
+            return 0;
+        }
+        if (status != SD_BLOCK_CRC) {
             return 1;
         }
-        
-        // receive the data
-        _read(buffer, 512);
-        buffer += 512;
+        _crc_errors++;
+        retries = done ? 1 : retries + 1;
+        if (retries > SD_CRC_RETRIES) {
+            return 1;
+        }
+        debug_if(SD_DBG, "CRC error reading block %lu, retrying\n", block_number + done);
+        buffer += done * 512;
+        block_number += done;
+        count -= done;
     }
-
     return 0;
 }
 
@@ -275,16 +332,24 @@ uint32_t SDFileSystem::disk_sectors() { return _sectors; }
 
 
 // PRIVATE FUNCTIONS
+void SDFileSystem::_send_cmd(int cmd, int arg) {
+    uint8_t frame[6];
+    frame[0] = 0x40 | cmd;
+    frame[1] = arg >> 24;
+    frame[2] = arg >> 16;
+    frame[3] = arg >> 8;
+    frame[4] = arg >> 0;
+
+    frame[5] = _crc7(frame, 5) << 1 | 0x01;
+
+    _transfer(frame, NULL, 6);
+}
+
 int SDFileSystem::_cmd(int cmd, int arg) {
     _cs = 0;
 
     // send a command
-    _spi.write(0x40 | cmd);
-    _spi.write(arg >> 24);
-    _spi.write(arg >> 16);
-    _spi.write(arg >> 8);
-    _spi.write(arg >> 0);
-    _spi.write(0x95);
+    _send_cmd(cmd, arg);
 
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
@@ -303,12 +368,7 @@ int SDFileSystem::_cmdx(int cmd, int arg) {
     _cs = 0;
 
     // send a command
-    _spi.write(0x40 | cmd);
-    _spi.write(arg >> 24);
-    _spi.write(arg >> 16);
-    _spi.write(arg >> 8);
-    _spi.write(arg >> 0);
-    _spi.write(0x95);
+    _send_cmd(cmd, arg);
 
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
@@ -328,12 +388,7 @@ int SDFileSystem::_cmd58() {
     int arg = 0;
 
     // send a command
-    _spi.write(0x40 | 58);
-    _spi.write(arg >> 24);
-    _spi.write(arg >> 16);
-    _spi.write(arg >> 8);
-    _spi.write(arg >> 0);
-    _spi.write(0x95);
+    _send_cmd(58, arg);
 
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
@@ -357,12 +412,7 @@ int SDFileSystem::_cmd8() {
     _cs = 0;
 
     // send a command
-    _spi.write(0x40 | 8); // CMD8
-    _spi.write(0x00);     // reserved
-    _spi.write(0x00);     // reserved
-    _spi.write(0x01);     // 3.3v
-    _spi.write(0xAA);     // check pattern
-    _spi.write(0x87);     // crc
+    _send_cmd(8, 0x1AA); // 3.3v, check pattern 0xAA
 
     // wait for the repsonse (response[7] == 0)
     for (int i = 0; i < SD_COMMAND_TIMEOUT * 1000; i++) {
@@ -370,7 +420,7 @@ int SDFileSystem::_cmd8() {
         response[0] = _spi.write(0xFF);
         if (!(response[0] & 0x80)) {
             for (int j = 1; j < 5; j++) {
-                response[i] = _spi.write(0xFF);
+                response[j] = _spi.write(0xFF);
             }
             _cs = 1;
             _spi.write(0xFF);
@@ -382,54 +432,211 @@ int SDFileSystem::_cmd8() {
     return -1; // timeout
 }
 
-int SDFileSystem::_read(uint8_t *buffer, uint32_t length) {
+int SDFileSystem::_write_blocks(const uint8_t* buffer, uint32_t block_number, uint32_t count, uint32_t *done) {
+    if (count == 1) {
+        // set write address for single block (CMD24)
+        if (_cmd(24, block_number * cdv) != 0) {
+            return SD_BLOCK_ERROR;
+        }
+        
+        // send the data block
+        int status = _write(buffer, 512);
+        if (status == SD_BLOCK_OK) {
+            *done = 1;
+        }
+        return status;
+    }
+    
+    // pre-erase the blocks about to be written (ACMD23), only a hint
+    _cmd(55, 0);
+    _cmd(23, count);
+    
+    // set write address for multiple blocks (CMD25)
+    if (_cmdx(25, block_number * cdv) != 0) {
+        return SD_BLOCK_ERROR;
+    }
+    
+    int status = SD_BLOCK_OK;
+    for (uint32_t b = 0; b < count; b++) {
+        status = _write_data(SD_START_MULTI_WRITE, buffer, 512);
+        if (status != SD_BLOCK_OK) {
+            break;
+        }
+        buffer += 512;
+        (*done)++;
+    }
+    
+    // end of the transfer, the card is busy while it programs the last block
+    _spi.write(SD_STOP_MULTI_WRITE);
+    _spi.write(0xFF);
+    while (_spi.write(0xFF) == 0);
+    
+    _cs = 1;
+    _spi.write(0xFF);
+    return status;
+}
+
+int SDFileSystem::_read_blocks(uint8_t* buffer, uint32_t block_number, uint32_t count, uint32_t *done) {
+    if (count == 1) {
+        // set read address for single block (CMD17)
+        if (_cmd(17, block_number * cdv) != 0) {
+            return SD_BLOCK_ERROR;
+        }
+        
+        // receive the data
+        int status = _read(buffer, 512);
+        if (status == SD_BLOCK_OK) {
+            *done = 1;
+        }
+        return status;
+    }
+    
+    // set read address for multiple blocks (CMD18)
+    if (_cmdx(18, block_number * cdv) != 0) {
+        return SD_BLOCK_ERROR;
+    }
+    
+    int status = SD_BLOCK_OK;
+    for (uint32_t b = 0; b < count; b++) {
+        status = _read_data(buffer, 512);
+        if (status != SD_BLOCK_OK) {
+            break;
+        }
+        buffer += 512;
+        (*done)++;
+    }
+    
+    // stop the stream (CMD12)
+    if (_cmd12() != 0 && status == SD_BLOCK_OK) {
+        status = SD_BLOCK_ERROR;
+    }
+    return status;
+}
+
+int SDFileSystem::_cmd12() {
     _cs = 0;
 
-    // read until start byte (0xFF)
-    while (_spi.write(0xFF) != 0xFE);
+    // send a command
+    _send_cmd(12, 0);
+
+    // skip the stuff byte, the card may still be sending data
+    _spi.write(0xFF);
 
-    // read data
-    for (uint32_t i = 0; i < length; i++) {
-        buffer[i] = _spi.write(0xFF);
+    // wait for the repsonse (response[7] == 0)
+    for (int i = 0; i < SD_COMMAND_TIMEOUT; i++) {
+        int response = _spi.write(0xFF);
+        if (!(response & 0x80)) {
+            // R1b: wait while busy
+            while (_spi.write(0xFF) == 0);
+            _cs = 1;
+            _spi.write(0xFF);
+            return response;
+        }
     }
-    _spi.write(0xFF); // checksum
+    _cs = 1;
     _spi.write(0xFF);
+    return -1; // timeout
+}
 
+int SDFileSystem::_read(uint8_t *buffer, uint32_t length) {
+    _cs = 0;
+    int status = _read_data(buffer, length);
     _cs = 1;
     _spi.write(0xFF);
-    return 0;
+    return status;
 }
 
 int SDFileSystem::_write(const uint8_t*buffer, uint32_t length) {
     _cs = 0;
+    int status = _write_data(SD_START_BLOCK, buffer, length);
+    _cs = 1;
+    _spi.write(0xFF);
+    return status;
+}
 
-    // indicate start of block
-    _spi.write(0xFE);
-
-    // write the data
-    for (uint32_t i = 0; i < length; i++) {
-        _spi.write(buffer[i]);
+int SDFileSystem::_read_data(uint8_t *buffer, uint32_t length) {
+    // read until start byte (0xFE), an error token has the top bits clear
+    int token;
+    while ((token = _spi.write(0xFF)) == 0xFF);
+    if (token != SD_START_BLOCK) {
+        return SD_BLOCK_ERROR;
     }
 
-    // write the checksum
-    _spi.write(0xFF);
-    _spi.write(0xFF);
+    // read data and checksum, 0xFF is clocked out as the fill
+    uint8_t crc[2];
+    _transfer(NULL, buffer, length);
+    _transfer(NULL, crc, 2);
 
-    // check the response token
-    if ((_spi.write(0xFF) & 0x1F) != 0x05) {
-        _cs = 1;
-        _spi.write(0xFF);
-        return 1;
+    if (_crc_on && _crc16(buffer, length) != ((crc[0] << 8) | crc[1])) {
+        return SD_BLOCK_CRC;
+    }
+    return SD_BLOCK_OK;
+}
+
+int SDFileSystem::_write_data(int token, const uint8_t *buffer, uint32_t length) {
+    // indicate start of block
+    _spi.write(token);
+
+    // write the data and checksum
+    uint8_t crc[2] = { 0xFF, 0xFF };
+    if (_crc_on) {
+        uint16_t c = _crc16(buffer, length);
+        crc[0] = c >> 8;
+        crc[1] = c;
     }
+    _transfer(buffer, NULL, length);
+    _transfer(crc, NULL, 2);
+
+    // check the response token: 010 accepted, 101 CRC error, 110 write error
+    int response = _spi.write(0xFF) & 0x1F;
 
     // wait for write to finish
     while (_spi.write(0xFF) == 0);
 
-    _cs = 1;
-    _spi.write(0xFF);
-    return 0;
+    if (response == 0x05) {
+        return SD_BLOCK_OK;
+    }
+    return response == 0x0B ? SD_BLOCK_CRC : SD_BLOCK_ERROR;
+}
+
+// CRC7 of a command or register, one table lookup per byte with the table
+// from TableCRC.h, whose entries are shifted up by one
+uint8_t SDFileSystem::_crc7(const uint8_t *data, uint32_t length) {
+    uint8_t crc = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        crc = Table_CRC_7Bit_SD[crc ^ data[i]];
+    }
+    return crc >> 1;
 }
 
+// CRC16 (CCITT polynomial, zero seed) of a data block, one table lookup per byte
+uint16_t SDFileSystem::_crc16(const uint8_t *data, uint32_t length) {
+    uint16_t crc = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        crc = (crc << 8) ^ Table_CRC_16bit_CCITT[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+// Data phase of a block in one call instead of one SPI call per byte: either
+// side may be NULL, missing transmit bytes are the 0xFF fill. With DMA the
+// calling thread blocks until the transfer ends, so other threads run meanwhile.
+void SDFileSystem::_transfer(const uint8_t *tx, uint8_t *rx, uint32_t length) {
+#if DEVICE_SPI_ASYNCH
+    _spi.transfer(tx, tx ? length : 0, rx, rx ? length : 0,
+                  callback(this, &SDFileSystem::_transfer_event), SPI_EVENT_COMPLETE);
+    _transfer_done.wait();
+#else
+    _spi.write((const char *)tx, tx ? length : 0, (char *)rx, rx ? length : 0);
+#endif
+}
+
+#if DEVICE_SPI_ASYNCH
+void SDFileSystem::_transfer_event(int event) {
+    _transfer_done.release();
+}
+#endif
+
 static uint32_t ext_bits(unsigned char *data, int msb, int lsb) {
     uint32_t bits = 0;
     uint32_t size = 1 + msb - lsb;
@@ -449,14 +656,24 @@ uint32_t SDFileSystem::_sd_sectors() {
     uint32_t hc_c_size;
     uint32_t blocks;
 
-    // CMD9, Response R2 (R1 byte + 16-byte block read)
-    if (_cmdx(9, 0) != 0) {
-        debug("Didn't get a response from the disk\n");
-        return 0;
-    }
-
+    // CMD9, Response R2 (R1 byte + 16-byte block read), read again on a CRC
+    // failure of the block or of the CRC7 the CSD carries in its last byte
     uint8_t csd[16];
-    if (_read(csd, 16) != 0) {
+    int status = SD_BLOCK_CRC;
+    for (int i = 0; i <= SD_CRC_RETRIES && status == SD_BLOCK_CRC; i++) {
+        if (_cmdx(9, 0) != 0) {
+            debug("Didn't get a response from the disk\n");
+            return 0;
+        }
+        status = _read(csd, 16);
+        if (status == SD_BLOCK_OK && _crc_on && (_crc7(csd, 15) << 1 | 0x01) != csd[15]) {
+            status = SD_BLOCK_CRC;
+        }
+        if (status == SD_BLOCK_CRC) {
+            _crc_errors++;
+        }
+    }
+    if (status != SD_BLOCK_OK) {
         debug("Couldn't read csd response from disk\n");
         return 0;
     }
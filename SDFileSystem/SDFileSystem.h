@@ -59,11 +59,24 @@ public:
     virtual int disk_sync();
     virtual uint32_t disk_sectors();
 
+    /** Check CRCs on every command and data block
+     *
+     * Read blocks that fail their CRC16 are read again, and so are written
+     * blocks the card reports a CRC error for, up to 3 times each.
+     * Call before the card is initialised, i.e. before the first file access.
+     */
+    void set_crc(bool enable) { _crc_on = enable; }
+
+    /** Blocks, the CSD included, that had to be retried because of a CRC failure */
+    uint32_t crc_errors() { return _crc_errors; }
+
 protected:
 
+    void _send_cmd(int cmd, int arg);
     int _cmd(int cmd, int arg);
     int _cmdx(int cmd, int arg);
     int _cmd8();
+    int _cmd12();
     int _cmd58();
     int initialise_card();
     int initialise_card_v1();
@@ -71,6 +84,17 @@ protected:
 
     int _read(uint8_t * buffer, uint32_t length);
     int _write(const uint8_t *buffer, uint32_t length);
+    int _read_data(uint8_t *buffer, uint32_t length);
+    int _write_data(int token, const uint8_t *buffer, uint32_t length);
+    int _read_blocks(uint8_t* buffer, uint32_t block_number, uint32_t count, uint32_t *done);
+    int _write_blocks(const uint8_t* buffer, uint32_t block_number, uint32_t count, uint32_t *done);
+    uint8_t _crc7(const uint8_t *data, uint32_t length);
+    uint16_t _crc16(const uint8_t *data, uint32_t length);
+    void _transfer(const uint8_t *tx, uint8_t *rx, uint32_t length);
+#if DEVICE_SPI_ASYNCH
+    void _transfer_event(int event);
+    rtos::Semaphore _transfer_done;     // Released by the SPI interrupt when a transfer ends
+#endif
     uint32_t _sd_sectors();
     uint32_t _sectors;
 
@@ -84,6 +108,8 @@ protected:
     DigitalOut _cs;
     int cdv;
     int _is_initialized;
+    bool _crc_on;
+    uint32_t _crc_errors;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "StateMachine.h"
+
+EventQueue::EventQueue():_posted(0),
+    _dropped(0)
+{
+}
+
+bool EventQueue::post(uint8_t type, uint8_t code, uint16_t value)
+{
+    uint32_t message = ((uint32_t)type << 24) | ((uint32_t)code << 16) | value;
+    bool queued = _queue.put((uint32_t *)message) == osOK;
+    core_util_critical_section_enter();
+    if (queued) {
+        _posted++;
+    } else {
+        _dropped++;
+    }
+    core_util_critical_section_exit();
+    return queued;
+}
+
+bool EventQueue::wait(Event &event, uint32_t ms)
+{
+    osEvent e = _queue.get(ms);
+    if (e.status != osEventMessage) {
+        return false;
+    }
+    event.type = e.value.v >> 24;
+    event.code = e.value.v >> 16;
+    event.value = e.value.v;
+    return true;
+}
+
+int EventQueue::posted()
+{
+    return _posted;
+}
+
+int EventQueue::dropped()
+{
+    return _dropped;
+}
+
+StateMachine::StateMachine(const Transition *table, int rows, int initial):_table(table),
+    _rows(rows),
+    _state(initial),
+    _handled(0),
+    _ignored(0),
+    _maxDispatchUs(0)
+{
+    _timer.start();
+}
+
+void StateMachine::attach(Callback<void()> handled)
+{
+    _callback = handled;
+}
+
+bool StateMachine::dispatch(const Event &event)
+{
+    int start = _timer.read_us();
+    for (int i = 0; i < _rows; i++) {
+        const Transition &t = _table[i];
+        if ((t.state != _state && t.state != STATE_ANY) || t.type != event.type) {
+            continue;
+        }
+        if (t.code != EVENT_ANY && t.code != event.code) {
+            continue;
+        }
+        if (t.handler != NULL && !t.handler(event)) {
+            continue;
+        }
+        if (t.next != STATE_SAME) {
+            _state = t.next;
+        }
+        _handled++;
+        int us = _timer.read_us() - start;
+        if (us > _maxDispatchUs) {
+            _maxDispatchUs = us;
+        }
+        if (_callback) {
+            _callback();
+        }
+        return true;
+    }
+    _ignored++;
+    return false;
+}
+
+void StateMachine::run(EventQueue &events)
+{
+    Event event;
+    while (true) {
+        if (events.wait(event)) {
+            dispatch(event);
+        }
+    }
+}
+
+int StateMachine::state()
+{
+    return _state;
+}
+
+int StateMachine::handled()
+{
+    return _handled;
+}
+
+int StateMachine::ignored()
+{
+    return _ignored;
+}
+
+int StateMachine::maxDispatchUs()
+{
+    return _maxDispatchUs;
+}
\ No newline at end of file
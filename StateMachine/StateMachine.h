@@ -0,0 +1,147 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include "mbed.h"
+#include "rtos.h"
+
+#ifndef EVENT_QUEUE_SIZE
+#define EVENT_QUEUE_SIZE 16 // events waiting for the dispatcher before posters drop
+#endif
+
+#define EVENT_ANY  0xFF // matches every code of an event type
+#define STATE_SAME -1   // stay in the current state
+#define STATE_ANY  -2   // a transition row that applies in every state
+
+typedef enum {
+    EVENT_BUTTON  = 1, // code is the control pad ButtonState
+    EVENT_LIMIT   = 2, // code is the switch that closed
+    EVENT_ENCODER = 3, // value is the edge count at the milestone
+    EVENT_TIMER   = 4, // code is the timer that expired
+    EVENT_REDRAW  = 5, // something on the screen is out of date
+    EVENT_FRAME   = 6  // code is a controller data frame type, e.g. 'C'
+} EventType;
+
+/** A typed event, small enough to travel in one queue word */
+typedef struct {
+    uint8_t type;   // EventType
+    uint8_t code;   // what happened, depends on the type
+    uint16_t value; // optional argument
+} Event;
+
+/** Queue of events from interrupts and threads to one waiting thread
+ *
+ * Events are packed into the 32 bit message of an rtos::Queue, so posting
+ * needs no memory pool and never blocks: a post to a full queue is dropped
+ * and counted. Safe to post from interrupts.
+ */
+class EventQueue
+{
+public:
+    EventQueue();
+
+    /** Post an event without waiting, safe from interrupts
+     *
+     * @returns false if the queue was full and the event was dropped
+     */
+    bool post(uint8_t type, uint8_t code = 0, uint16_t value = 0);
+
+    /** Wait for the next event
+     *
+     * @param ms Time to wait, 0 to only take an event already queued
+     * @returns false if no event came within ms
+     */
+    bool wait(Event &event, uint32_t ms = osWaitForever);
+
+    /** Events posted since boot */
+    int posted();
+
+    /** Events dropped because the queue was full */
+    int dropped();
+
+private:
+    Queue<uint32_t, EVENT_QUEUE_SIZE> _queue;
+    volatile int _posted;
+    volatile int _dropped;
+};
+
+/** Handler run for a transition
+ *
+ * @returns false to reject the transition, e.g. when a guard fails; the
+ *   rows after it are then tried
+ */
+typedef bool (*EventHandler)(const Event &event);
+
+/** One row of a transition table */
+typedef struct {
+    int state;            // state the row applies in, or STATE_ANY
+    uint8_t type;         // EventType
+    uint8_t code;         // event code, or EVENT_ANY
+    EventHandler handler; // run first, NULL to just change state
+    int next;             // state after the handler, or STATE_SAME
+} Transition;
+
+/** Table driven state machine run from an EventQueue
+ *
+ * Each event is looked up in the table in order, and the first row for the
+ * current state, event type and code whose handler accepts it is taken.
+ * Events without a row in the current state are ignored. Handlers run on
+ * the dispatching thread as soon as their event is taken from the queue,
+ * so they should not wait on anything but short device operations.
+ *
+ * Example:
+ * @code
+ * enum { OFF, ON };
+ * const Transition table[] = {
+ *     {OFF, EVENT_BUTTON, 0x10, &lightOn,  ON},
+ *     {ON,  EVENT_BUTTON, 0x10, &lightOff, OFF},
+ * };
+ * EventQueue events;
+ * StateMachine machine(table, 2, OFF);
+ *
+ * machine.run(events);
+ * @endcode
+ */
+class StateMachine
+{
+public:
+    /** Create a state machine
+     *
+     * @param table Transition rows, searched in order
+     * @param rows Rows in the table
+     * @param initial State to start in
+     */
+    StateMachine(const Transition *table, int rows, int initial);
+
+    /** Call a function after every event that was handled */
+    void attach(Callback<void()> handled);
+
+    /** Handle one event, returns false if the current state ignores it */
+    bool dispatch(const Event &event);
+
+    /** Dispatch events from a queue forever, on the calling thread */
+    void run(EventQueue &events);
+
+    /** The current state */
+    int state();
+
+    /** Events handled since boot */
+    int handled();
+
+    /** Events with no row in the state they arrived in */
+    int ignored();
+
+    /** Longest dispatch() so far including its handler, in us */
+    int maxDispatchUs();
+
+private:
+    const Transition *_table;
+    int _rows;
+    volatile int _state;
+    Callback<void()> _callback;
+    Timer _timer;
+    int _handled;
+    int _ignored;
+    int _maxDispatchUs;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "StateStore.h"
+#include "TableCRC.h"
+
+#define STATE_STORE_MAGIC 0x57495245 // "WIRE"
+
+StateStore::StateStore(FATFileSystem &fs, const char *name):_fs(fs),
+    _name(name),
+    _first(0),
+    _slot(0),
+    _sequence(1),
+    _changed(false),
+    _commits(0),
+    _maxCommitUs(0)
+{
+    memset(_entries, 0, sizeof(_entries));
+}
+
+bool StateStore::mount()
+{
+    _lock.lock();
+    _fs.lock();
+    _first = 0;
+    if (!locate()) {
+        _fs.unlock();
+        _lock.unlock();
+        return false;
+    }
+    // The newest record that passes its checksum wins
+    Record *record = (Record *)_sector;
+    bool found = false;
+    for (uint32_t i = 0; i < STATE_STORE_SECTORS; i++) {
+        if (_fs._cache.read((uint8_t *)_sector, _first + i, 1)) {
+            continue;
+        }
+        uint32_t crc = record->crc;
+        record->crc = 0;
+        if (record->magic != STATE_STORE_MAGIC || record->count != STATE_STORE_KEYS ||
+            crc32((uint8_t *)_sector, sizeof(_sector)) != crc) {
+            continue;
+        }
+        if (!found || (int32_t)(record->sequence - _sequence) >= 0) {
+            memcpy(_entries, record->entries, sizeof(_entries));
+            _sequence = record->sequence + 1;
+            _slot = (i + 1) % STATE_STORE_SECTORS;
+            found = true;
+        }
+    }
+    _changed = false;
+    _fs.unlock();
+    _lock.unlock();
+    return true;
+}
+
+bool StateStore::locate()
+{
+    char path[32];
+    snprintf(path, sizeof(path), "%s:/%s", _fs._fsid, _name);
+    bool contiguous;
+    if (!place(path, contiguous)) {
+        return false;
+    }
+    if (!contiguous) {
+        // Made when the free space was in pieces, or by someone else. Its
+        // records could never be read, and made again after the clusters it
+        // had it may get a run of them.
+        if (f_unlink(path) != FR_OK || !place(path, contiguous)) {
+            return false;
+        }
+    }
+    return contiguous;
+}
+
+bool StateStore::place(const char *path, bool &contiguous)
+{
+    contiguous = false;
+    FIL file;
+    if (f_open(&file, path, FA_READ | FA_WRITE | FA_OPEN_ALWAYS) != FR_OK) {
+        return false;
+    }
+    const uint32_t size = STATE_STORE_SECTORS * sizeof(_sector);
+    bool ok = true;
+    if (file.fsize != size) {
+        // A new log is zeroed so stale sectors of deleted files cannot pass for records
+        memset(_sector, 0, sizeof(_sector));
+        ok = f_truncate(&file) == FR_OK;
+        for (uint32_t i = 0; ok && i < STATE_STORE_SECTORS; i++) {
+            UINT written;
+            ok = f_write(&file, _sector, sizeof(_sector), &written) == FR_OK && written == sizeof(_sector);
+        }
+    }
+    // Records are written around FatFs, which needs the clusters in one run
+    FATFS *fs = file.fs;
+    uint32_t clusterBytes = fs->csize * sizeof(_sector);
+    contiguous = ok && file.sclust >= 2;
+    for (uint32_t offset = 0; ok && contiguous && offset < size; offset += clusterBytes) {
+        ok = f_lseek(&file, offset + 1) == FR_OK;
+        contiguous = ok && file.clust == file.sclust + offset / clusterBytes;
+    }
+    if (contiguous) {
+        _first = fs->database + (file.sclust - 2) * fs->csize;
+    }
+    // Closing also flushes the zeroed sectors out of the sector cache
+    if (f_close(&file) != FR_OK) {
+        ok = false;
+        contiguous = false;
+        _first = 0;
+    }
+    return ok;
+}
+
+void StateStore::setInt(int key, int32_t value)
+{
+    set(key, (uint32_t)value);
+}
+
+void StateStore::setFloat(int key, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    set(key, bits);
+}
+
+bool StateStore::getInt(int key, int32_t &value)
+{
+    uint32_t bits;
+    if (!get(key, bits)) {
+        return false;
+    }
+    value = (int32_t)bits;
+    return true;
+}
+
+bool StateStore::getFloat(int key, float &value)
+{
+    uint32_t bits;
+    if (!get(key, bits)) {
+        return false;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+bool StateStore::set(int key, uint32_t value)
+{
+    if (key < 0 || key >= STATE_STORE_KEYS) {
+        return false;
+    }
+    _lock.lock();
+    Entry &entry = _entries[key];
+    if (!entry.used || entry.value != value) {
+        entry.key = key;
+        entry.used = 1;
+        entry.value = value;
+        _changed = true;
+    }
+    _lock.unlock();
+    return true;
+}
+
+bool StateStore::get(int key, uint32_t &value)
+{
+    if (key < 0 || key >= STATE_STORE_KEYS) {
+        return false;
+    }
+    _lock.lock();
+    bool used = _entries[key].used;
+    if (used) {
+        value = _entries[key].value;
+    }
+    _lock.unlock();
+    return used;
+}
+
+bool StateStore::commit()
+{
+    _lock.lock();
+    if (!_changed) {
+        _lock.unlock();
+        return true;
+    }
+    if (!_first) {
+        _lock.unlock();
+        return false;
+    }
+    Timer timer;
+    timer.start();
+    memset(_sector, 0, sizeof(_sector));
+    Record *record = (Record *)_sector;
+    record->magic = STATE_STORE_MAGIC;
+    record->sequence = _sequence;
+    record->count = STATE_STORE_KEYS;
+    memcpy(record->entries, _entries, sizeof(_entries));
+    record->crc = crc32((uint8_t *)_sector, sizeof(_sector));
+    // A failed write is retried in the same slot, the older records are untouched
+    _fs.lock();
+    bool ok = _fs._cache.write_through((uint8_t *)_sector, _first + _slot, 1) == 0;
+    _fs.unlock();
+    if (ok) {
+        _sequence++;
+        _slot = (_slot + 1) % STATE_STORE_SECTORS;
+        _changed = false;
+        _commits++;
+    }
+    int us = timer.read_us();
+    if (us > _maxCommitUs) {
+        _maxCommitUs = us;
+    }
+    _lock.unlock();
+    return ok;
+}
+
+int StateStore::commits()
+{
+    return _commits;
+}
+
+int StateStore::maxCommitUs()
+{
+    return _maxCommitUs;
+}
+
+uint32_t StateStore::crc32(const uint8_t *data, int length)
+{
+    // CRC-32 with the MSB first table from TableCRC.h
+    uint32_t crc = 0xFFFFFFFF;
+    for (int i = 0; i < length; i++) {
+        crc = (crc << 8) ^ Table_CRC_32bit_ANSI[(crc >> 24) ^ data[i]];
+    }
+    return ~crc;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "FATFileSystem.h"
+
+#ifndef STATE_STORE_SECTORS
+#define STATE_STORE_SECTORS 64 // records kept in the log, one sector each
+#endif
+
+#ifndef STATE_STORE_KEYS
+#define STATE_STORE_KEYS 16 // distinct keys, must fit one sector with the header
+#endif
+
+/** Power-loss-safe key/value store in a log of raw sectors
+ *
+ * The store owns a contiguous file on a FAT file system, created once and
+ * never touched by FatFs again. Every commit() writes one checksummed record
+ * holding all the values to the next sector of the file, straight to the
+ * disk, so a save costs a single block write with no FAT or directory
+ * updates. Writes rotate through the file, which spreads wear, and the
+ * previous records stay intact: a record torn by a power cut fails its
+ * checksum and mount() falls back to the newest one that did not.
+ *
+ * Keys are small integers and values are 32 bits, int or float.
+ *
+ * Raw sector access holds the file system lock, so the store can be used
+ * from any thread alongside FatFs.
+ */
+class StateStore
+{
+public:
+    /** Create a store backed by a file
+     *
+     * @param fs File system holding the log
+     * @param name File name on that file system, e.g. "state.log"
+     */
+    StateStore(FATFileSystem &fs, const char *name);
+
+    /** Open or create the log and load the newest valid record
+     *
+     * A log that is not one contiguous run of sectors is removed and
+     * created once more.
+     *
+     * @returns true if the log is usable, false if it could not be created
+     *   as one contiguous run of sectors; values are then kept in RAM only
+     */
+    bool mount();
+
+    /** Store a value, written out by the next commit() */
+    void setInt(int key, int32_t value);
+    void setFloat(int key, float value);
+
+    /** Read a value, returns false and leaves value alone if it was never set */
+    bool getInt(int key, int32_t &value);
+    bool getFloat(int key, float &value);
+
+    /** Append a record with every value if any changed since the last one
+     *
+     * @returns false if the record could not be written
+     */
+    bool commit();
+
+    /** Records written since boot */
+    int commits();
+
+    /** Longest commit() so far, in us */
+    int maxCommitUs();
+
+private:
+    typedef struct {
+        uint16_t key;
+        uint16_t used;
+        uint32_t value;
+    } Entry;
+
+    typedef struct {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t count;
+        uint32_t crc;
+        Entry entries[STATE_STORE_KEYS];
+    } Record;
+
+    bool locate();
+    bool place(const char *path, bool &contiguous);
+    bool set(int key, uint32_t value);
+    bool get(int key, uint32_t &value);
+    static uint32_t crc32(const uint8_t *data, int length);
+
+    FATFileSystem &_fs;
+    const char *_name;
+    uint32_t _first;    // first sector of the log, 0 when not mounted
+    uint32_t _slot;     // sector of the log the next record goes to
+    uint32_t _sequence; // sequence number of the next record
+    bool _changed;
+    Entry _entries[STATE_STORE_KEYS];
+    uint32_t _sector[128]; // one record, word aligned for Record
+    int _commits;
+    int _maxCommitUs;
+    Mutex _lock;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "StepProfile.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define US_PER_S_FIXED (1000000.0f * (1 << STEP_PROFILE_FRAC_BITS))
+
+StepProfile::StepProfile():_steps(0), _rampSteps(0), _cruise(0), _ramp(NULL), _capacity(0),
+    _mode(PROFILE_TRAPEZOID), _v0(0), _peak(0), _accel(0), _jerk(0)
+{
+}
+
+StepProfile::~StepProfile()
+{
+    free(_ramp);
+}
+
+// Grow the table to hold a ramp of the given length, it never shrinks
+bool StepProfile::reserve(int steps)
+{
+    if (steps <= _capacity) {
+        return true;
+    }
+    uint32_t *ramp = (uint32_t *)realloc(_ramp, steps * sizeof(uint32_t));
+    if (ramp == NULL) {
+        return false;
+    }
+    _ramp = ramp;
+    _capacity = steps;
+    return true;
+}
+
+// Distance needed to get from _v0 to v
+float StepProfile::rampDistance(float v)
+{
+    float dv = v - _v0;
+    if (dv <= 0) {
+        return 0;
+    }
+    if (_mode == PROFILE_TRAPEZOID) {
+        return (v * v - _v0 * _v0) / (2 * _accel);
+    }
+    // S-curve is symmetric in acceleration, so the mean speed is (v0+v)/2
+    float t;
+    if (dv >= _accel * _accel / _jerk) {
+        t = dv / _accel + _accel / _jerk;
+    } else {
+        t = 2 * sqrtf(dv / _jerk);
+    }
+    return (_v0 + v) / 2 * t;
+}
+
+// Fill _ramp with the interval before each step of the ramp up to _peak
+void StepProfile::fillRamp()
+{
+    float prev = 0;
+    if (_mode == PROFILE_TRAPEZOID) {
+        for (int n = 0; n < _rampSteps; n++) {
+            float t = (sqrtf(_v0 * _v0 + 2 * _accel * (n + 1)) - _v0) / _accel;
+            setRamp(n, t - prev);
+            prev = t;
+        }
+        return;
+    }
+
+    float dv = _peak - _v0;
+    float ap = _accel;
+    if (dv < _accel * _accel / _jerk) {
+        ap = sqrtf(dv * _jerk);
+    }
+    float t1 = ap / _jerk;     // jerk up
+    float t2 = dv / ap - t1;   // constant acceleration
+    float tEnd = 2 * t1 + t2;
+
+    // Integrate along the jerk phases, noting the time each whole step is crossed
+    float dt = tEnd / (8 * _rampSteps + 8);
+    float t = 0, pos = 0, v = _v0;
+    int n = 0;
+    while (n < _rampSteps) {
+        float a;
+        if (t < t1) {
+            a = _jerk * t;
+        } else if (t < t1 + t2) {
+            a = ap;
+        } else if (t < tEnd) {
+            a = ap - _jerk * (t - t1 - t2);
+        } else {
+            a = 0;
+        }
+        float vMid = v + a * dt / 2;
+        float next = pos + vMid * dt;
+        while (n < _rampSteps && next >= n + 1) {
+            float tn = t + (n + 1 - pos) / vMid;
+            setRamp(n++, tn - prev);
+            prev = tn;
+        }
+        pos = next;
+        v += a * dt;
+        t += dt;
+    }
+}
+
+void StepProfile::setRamp(int n, float seconds)
+{
+    uint32_t ticks = (uint32_t)(seconds * US_PER_S_FIXED);
+    _ramp[n] = ticks > _cruise ? ticks : _cruise;
+}
+
+void StepProfile::plan(int steps, float startSpeed, float maxSpeed, float accel, float jerk, ProfileMode mode)
+{
+    _steps = steps > 0 ? steps : 0;
+    _mode = mode;
+    _v0 = startSpeed;
+    _accel = accel;
+    _jerk = jerk;
+    _peak = maxSpeed;
+    if (_mode == PROFILE_SCURVE && _jerk <= 0) {
+        _mode = PROFILE_TRAPEZOID;
+    }
+    if (_v0 < 1) {
+        _v0 = 1;
+    }
+    if (_v0 > _peak) {
+        _v0 = _peak;
+    }
+    if (_accel <= 0) {
+        // Nothing to ramp with, the whole move runs at the start speed
+        _mode = PROFILE_TRAPEZOID;
+        _peak = _v0;
+    }
+
+    // Ramp has to fit in half the move and in the table, otherwise lower the peak
+    int limit = _steps / 2;
+    if (limit > STEP_PROFILE_MAX_RAMP) {
+        limit = STEP_PROFILE_MAX_RAMP;
+    }
+    if (rampDistance(_peak) > limit) {
+        float lo = _v0, hi = _peak;
+        for (int i = 0; i < 16; i++) {
+            float mid = (lo + hi) / 2;
+            if (rampDistance(mid) > limit) {
+                hi = mid;
+            } else {
+                lo = mid;
+            }
+        }
+        _peak = lo;
+    }
+
+    _rampSteps = (int)ceilf(rampDistance(_peak));
+    if (_rampSteps > limit) {
+        _rampSteps = limit;
+    }
+    if (!reserve(_rampSteps)) {
+        // No room for the ramp, the whole move runs at the start speed
+        _peak = _v0;
+        _rampSteps = 0;
+    }
+
+    _cruise = (uint32_t)(US_PER_S_FIXED / _peak);
+    fillRamp();
+}
\ No newline at end of file
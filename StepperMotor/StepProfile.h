@@ -0,0 +1,85 @@
+#ifndef MBED_STEP_PROFILE_H
+#define MBED_STEP_PROFILE_H
+
+#include <stdint.h>
+
+#ifndef STEP_PROFILE_MAX_RAMP
+#define STEP_PROFILE_MAX_RAMP 1024// steps, longest acceleration ramp planned
+#endif
+
+// Intervals are stored in 1/16 us so short intervals keep their fraction
+#define STEP_PROFILE_FRAC_BITS 4
+
+typedef enum {
+    PROFILE_TRAPEZOID,
+    PROFILE_SCURVE
+} ProfileMode;
+
+/** Precomputed velocity profile for a Stepper move
+ *
+ * plan() does all the floating-point work up front and leaves a table of
+ * step intervals for the acceleration ramp. The deceleration ramp is the same
+ * table read backwards, so the move always ends at rest exactly on the last
+ * step. interval() is integer only and safe to call from the step ISR.
+ *
+ * The table is allocated to the longest ramp planned so far and kept, so a
+ * feeder that always plans with the same limits allocates once.
+ */
+class StepProfile
+{
+public:
+    StepProfile();
+    ~StepProfile();
+
+    /** Plan a move
+     *
+     * @param steps Total number of steps
+     * @param startSpeed Speed the motor can start/stop at without ramping, steps/s
+     * @param maxSpeed Cruise speed, steps/s
+     * @param accel Acceleration limit, steps/s^2; with none the move runs at startSpeed
+     * @param jerk Jerk limit, steps/s^3 (PROFILE_SCURVE only)
+     * @param mode Trapezoidal or jerk-limited S-curve
+     */
+    void plan(int steps, float startSpeed, float maxSpeed, float accel, float jerk, ProfileMode mode);
+
+    /** Interval before step n, in 1/16 us */
+    inline uint32_t interval(int n) const {
+        if (n < _rampSteps) {
+            return _ramp[n];
+        }
+        int fromEnd = _steps - 1 - n;
+        if (fromEnd < _rampSteps) {
+            return _ramp[fromEnd];
+        }
+        return _cruise;
+    }
+
+    int steps() const { return _steps; }
+    int rampSteps() const { return _rampSteps; }
+
+    /** Speed actually reached, steps/s (lower than maxSpeed on short moves) */
+    float peakSpeed() const { return _peak; }
+
+private:
+    StepProfile(const StepProfile &);
+    StepProfile &operator=(const StepProfile &);
+
+    float rampDistance(float v);
+    bool reserve(int steps);
+    void fillRamp();
+    void setRamp(int n, float seconds);
+
+    int _steps;
+    int _rampSteps;
+    uint32_t _cruise;
+    uint32_t *_ramp;
+    int _capacity;
+
+    ProfileMode _mode;
+    float _v0;
+    float _peak;
+    float _accel;
+    float _jerk;
+};
+
+#endif
\ No newline at end of file
@@ -4,11 +4,17 @@
 Stepper::Stepper(PinName _en, PinName ms1, PinName ms2, PinName ms3, PinName _stepPin, PinName dir):en(_en),
     microstepping(ms1, ms2, ms3),
     stepPin(_stepPin),
-    direction(dir)
+    direction(dir),
+    _busy(false),
+    _stepsLeft(0),
+    _stepsTaken(0),
+    _edge(1 << STEP_PROFILE_FRAC_BITS),
+    _frac(0),
+    _profile(NULL)
 {
 }
 
-void Stepper::step(int microstep, int dir, float speed)
+void Stepper::configure(int microstep, int dir)
 {
     if (microstep == 1) {
         microstepping = 0;
@@ -22,7 +28,12 @@ void Stepper::step(int microstep, int dir, float speed)
     } else if (dir == 0) {
         direction = 1;
     }
-    
+}
+
+void Stepper::step(int microstep, int dir, float speed)
+{
+    configure(microstep, dir);
+
     //  Step...
     stepPin = 1;
     wait(1/speed);
@@ -30,6 +41,109 @@ void Stepper::step(int microstep, int dir, float speed)
     wait(1/speed);
 }
 
+void Stepper::move(int steps, int microstep, int dir, float speed, Callback<void()> done)
+{
+    if (steps <= 0) {
+        stop();
+        if (done) {
+            done();
+        }
+        return;
+    }
+    start(steps, microstep, dir, speed, NULL, done);
+}
+
+void Stepper::move(const StepProfile &profile, int microstep, int dir, Callback<void()> done)
+{
+    if (profile.steps() <= 0) {
+        stop();
+        if (done) {
+            done();
+        }
+        return;
+    }
+    start(profile.steps(), microstep, dir, 0, &profile, done);
+}
+
+void Stepper::run(int microstep, int dir, float speed)
+{
+    start(-1, microstep, dir, speed, NULL, NULL);
+}
+
+void Stepper::start(int steps, int microstep, int dir, float speed, const StepProfile *profile, Callback<void()> done)
+{
+    stop();
+    configure(microstep, dir);
+
+    _profile = profile;
+    if (_profile) {
+        _edge = _profile->interval(0) >> 1;
+    } else {
+        _edge = (uint32_t)((1000000.0f * (1 << STEP_PROFILE_FRAC_BITS)) / speed);
+    }
+    if (_edge < (1 << STEP_PROFILE_FRAC_BITS)) {
+        _edge = 1 << STEP_PROFILE_FRAC_BITS;
+    }
+    _done = done;
+    _stepsTaken = 0;
+    _stepsLeft = steps;
+    _frac = 0;
+    _busy = true;
+
+    stepPin = 0;
+    insert_absolute(ticker_read_us(_ticker_data) + nextEdge());
+}
+
+void Stepper::stop()
+{
+    remove();
+    _busy = false;
+    _stepsLeft = 0;
+    stepPin = 0;
+}
+
+bool Stepper::busy()
+{
+    return _busy;
+}
+
+int Stepper::stepsTaken()
+{
+    return _stepsTaken;
+}
+
+// Whole microseconds to the next edge, carrying the 1/16 us remainder
+inline us_timestamp_t Stepper::nextEdge()
+{
+    _frac += _edge;
+    us_timestamp_t us = _frac >> STEP_PROFILE_FRAC_BITS;
+    _frac &= (1 << STEP_PROFILE_FRAC_BITS) - 1;
+    return us;
+}
+
+// Timer interrupt: one edge per call, rescheduled off the previous deadline
+// so interrupt latency does not accumulate into the step period.
+void Stepper::handler()
+{
+    if (!stepPin) {
+        stepPin = 1;
+    } else {
+        stepPin = 0;
+        _stepsTaken++;
+        if (_stepsLeft > 0 && --_stepsLeft == 0) {
+            _busy = false;
+            if (_done) {
+                _done();
+            }
+            return;
+        }
+        if (_profile) {
+            _edge = _profile->interval(_stepsTaken) >> 1;
+        }
+    }
+    insert_absolute(event.timestamp + nextEdge());
+}
+
 void Stepper::enable()
 {
     en = 0;
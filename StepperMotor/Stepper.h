@@ -1,19 +1,76 @@
 #ifndef MBED_STEPPER_H
 #define MBED_STEPPER_H
-#endif
 
 #include "mbed.h"
+#include "StepProfile.h"
 
-class Stepper
+/** Step/dir stepper driver (A4988 style)
+ *
+ * step() pulses the driver once and busy-waits, as before. move() and run()
+ * hand the pulse train to the us ticker instead: both edges of every step are
+ * generated from the timer interrupt, so the call returns at once and the
+ * step rate is only limited by the driver, not by the scheduler.
+ *
+ * Passing a StepProfile to move() ramps the rate up and down; the ISR only
+ * looks up the precomputed interval for the next step.
+ */
+class Stepper : private TimerEvent
 {
 public:
     Stepper(PinName _en, PinName ms1, PinName ms2, PinName ms3, PinName _stepPin, PinName dir);
+
+    /** Make a single step, blocking for 2/speed seconds */
     void step(int microstep, int dir, float speed);
+
+    /** Start a non-blocking move
+     *
+     * @param steps Number of steps to make
+     * @param microstep Microstep resolution (see StepperResolution)
+     * @param dir Direction (see StepperDirection)
+     * @param speed Edge rate in Hz, same meaning as in step()
+     * @param done Called from interrupt context once the last step is made
+     */
+    void move(int steps, int microstep, int dir, float speed, Callback<void()> done = NULL);
+
+    /** Start a non-blocking move following a planned velocity profile
+     *
+     * The profile is read from interrupt context and must stay untouched
+     * until the move completes.
+     */
+    void move(const StepProfile &profile, int microstep, int dir, Callback<void()> done = NULL);
+
+    /** Step continuously until stop() is called */
+    void run(int microstep, int dir, float speed);
+
+    /** Abort the current move. The completion callback is not called. */
+    void stop();
+
+    /** True while a move is in progress */
+    bool busy();
+
+    /** Steps made since the last move()/run() was started */
+    int stepsTaken();
+
     void enable();
     void disable();
 private:
+    virtual void handler();
+    void configure(int microstep, int dir);
+    void start(int steps, int microstep, int dir, float speed, const StepProfile *profile, Callback<void()> done);
+    us_timestamp_t nextEdge();
+
     DigitalOut en;
     BusOut microstepping;
     DigitalOut stepPin;
     DigitalOut direction;
-};
\ No newline at end of file
+
+    volatile bool _busy;
+    volatile int _stepsLeft; // -1 when running continuously
+    volatile int _stepsTaken;
+    uint32_t _edge; // time between edges, 1/16 us
+    uint32_t _frac;
+    const StepProfile *_profile;
+    Callback<void()> _done;
+};
+
+#endif
\ No newline at end of file
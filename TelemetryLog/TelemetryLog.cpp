@@ -0,0 +1,179 @@
+#include "TelemetryLog.h"
+
+static const uint8_t zeros[LOG_SECTOR_SIZE] = {0};
+
+TelemetryLog::TelemetryLog(FATFileSystem &fs, const char *name):_fs(fs),
+    _name(name),
+    _thread(osPriorityLow),
+    _file(NULL),
+    _fill(0),
+    _sequence(0),
+    _logged(0),
+    _dropped(0),
+    _sectors(0),
+    _unsynced(0),
+    _unsyncedMs(0),
+    _syncs(0),
+    _writeErrors(0)
+{
+}
+
+void TelemetryLog::start()
+{
+    _clock.start();
+    _thread.start(callback(this, &TelemetryLog::writer));
+}
+
+bool TelemetryLog::log(const LogRecord &record)
+{
+    core_util_critical_section_enter();
+    uint16_t sequence = _sequence++;
+    core_util_critical_section_exit();
+
+    LogRecord *r = _mail.alloc();
+    if (r == NULL) {
+        core_util_critical_section_enter();
+        _dropped++;
+        core_util_critical_section_exit();
+        return false;
+    }
+    *r = record;
+    r->ms = _clock.read_ms();
+    r->sequence = sequence;
+    _mail.put(r);
+    core_util_critical_section_enter();
+    _logged++;
+    core_util_critical_section_exit();
+    return true;
+}
+
+void TelemetryLog::flush()
+{
+    // A pad record in the queue tells the writer to write what it has
+    LogRecord *r = _mail.calloc();
+    if (r != NULL) {
+        r->type = LOG_PAD;
+        _mail.put(r);
+    }
+}
+
+int TelemetryLog::logged()
+{
+    return _logged;
+}
+
+int TelemetryLog::dropped()
+{
+    return _dropped;
+}
+
+int TelemetryLog::sectors()
+{
+    return _sectors;
+}
+
+int TelemetryLog::syncs()
+{
+    return _syncs;
+}
+
+int TelemetryLog::writeErrors()
+{
+    return _writeErrors;
+}
+
+void TelemetryLog::writer()
+{
+    while (true) {
+        // A part filled sector waits for LOG_FLUSH_MS without records, unless a sync is due first
+        uint32_t syncMs = syncWait();
+        bool flushFirst = _fill && LOG_FLUSH_MS <= syncMs;
+        osEvent evt = _mail.get(flushFirst ? LOG_FLUSH_MS : syncMs);
+        if (evt.status == osEventMail) {
+            LogRecord *r = (LogRecord *)evt.value.p;
+            bool flushNow = r->type == LOG_PAD;
+            if (!flushNow) {
+                _sector[_fill++] = *r;
+            }
+            _mail.free(r);
+            if (_fill == (int)LOG_RECORDS_PER_SECTOR || (flushNow && _fill)) {
+                writeSector(flushNow);
+            } else if (flushNow) {
+                sync();
+            }
+        } else if (flushFirst) {
+            writeSector(true);
+        } else {
+            sync();
+        }
+    }
+}
+
+uint32_t TelemetryLog::syncWait()
+{
+    if (_unsynced == 0) {
+        return osWaitForever;
+    }
+    int left = LOG_SYNC_MS - (_clock.read_ms() - _unsyncedMs);
+    return left > 0 ? left : 0;
+}
+
+void TelemetryLog::writeSector(bool syncNow)
+{
+    // Unused slots are zero, which reads back as LOG_PAD
+    memset(&_sector[_fill], 0, sizeof(_sector) - _fill * sizeof(LogRecord));
+    _fill = 0;
+    if ((_file == NULL && !open()) ||
+        _file->write(_sector, sizeof(_sector)) != (ssize_t)sizeof(_sector)) {
+        _writeErrors++;
+        close();
+        return;
+    }
+    _sectors++;
+    if (_unsynced++ == 0) {
+        _unsyncedMs = _clock.read_ms();
+    }
+    if (syncNow || _unsynced >= LOG_SYNC_SECTORS || _clock.read_ms() - _unsyncedMs >= LOG_SYNC_MS) {
+        sync();
+    }
+}
+
+void TelemetryLog::sync()
+{
+    if (_file == NULL || _unsynced == 0) {
+        return;
+    }
+    _unsynced = 0;
+    if (_file->fsync() != 0) {
+        _writeErrors++;
+        close();
+        return;
+    }
+    _syncs++;
+}
+
+void TelemetryLog::close()
+{
+    // Reopen on the next sector, the card may have been swapped
+    if (_file) {
+        _file->close();
+        _file = NULL;
+    }
+    _unsynced = 0;
+}
+
+bool TelemetryLog::open()
+{
+    _file = _fs.open(_name, O_WRONLY | O_CREAT | O_APPEND);
+    if (_file == NULL) {
+        return false;
+    }
+    // A write cut short by a reset leaves part of a sector, pad it so records stay aligned
+    off_t tail = _file->flen() % LOG_SECTOR_SIZE;
+    if (tail && _file->write(zeros, LOG_SECTOR_SIZE - tail) != (ssize_t)(LOG_SECTOR_SIZE - tail)) {
+        _file->close();
+        _file = NULL;
+        return false;
+    }
+    return true;
+}
\ No newline at end of file
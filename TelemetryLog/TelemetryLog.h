@@ -0,0 +1,156 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "FATFileSystem.h"
+
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 32 // records waiting for the writer before producers drop
+#endif
+
+#ifndef LOG_FLUSH_MS
+#define LOG_FLUSH_MS 10000 // ms without records before a part filled sector is written
+#endif
+
+#ifndef LOG_SYNC_SECTORS
+#define LOG_SYNC_SECTORS 8 // sectors appended between syncs of the file's size and FAT
+#endif
+
+#ifndef LOG_SYNC_MS
+#define LOG_SYNC_MS 5000 // ms a sector appended since the last sync waits for one at most
+#endif
+
+#define LOG_MS_MAX 0xFFFF // cycleMs and strokeMs stop here instead of wrapping
+
+#define LOG_SECTOR_SIZE 512
+#define LOG_RECORDS_PER_SECTOR (LOG_SECTOR_SIZE / sizeof(LogRecord))
+
+typedef enum {
+    LOG_PAD = 0, // fills the rest of a sector written early, skipped when decoding
+    LOG_CUT = 1  // one finished wire
+} LogType;
+
+typedef enum {
+    LOG_ERR_LENGTH = 0x01, // fed length off the spec by more than LOG_LENGTH_TOLERANCE
+    LOG_ERR_FEED   = 0x02, // the feed faulted, the measured length is not trusted
+    LOG_ERR_STROKE = 0x04  // the cutter missed a limit, the wire was not cut
+} LogError;
+
+/** One fixed-size binary record, 32 bytes so 16 fill a sector exactly
+ *
+ * Little endian, no padding; TelemetryLog/decode_log.py turns a log of
+ * these into CSV.
+ */
+typedef struct {
+    uint32_t ms;        // since the logger started
+    uint16_t sequence;  // counts every record offered, gaps show drops
+    uint8_t type;       // LogType
+    uint8_t errors;     // LogError bits
+    int16_t job;        // job id
+    int16_t wire;       // wire number within the job, from 1
+    float length;       // in, spec
+    float leftStrip;    // in, spec
+    float rightStrip;   // in, spec
+    float fed;          // in, measured
+    uint16_t cycleMs;   // wall time of the wire's cycle, LOG_MS_MAX or longer
+    uint16_t strokeMs;  // longest cutter down stroke, LOG_MS_MAX or longer
+} LogRecord;
+
+/** A duration for the 16 bit fields of LogRecord, saturated at LOG_MS_MAX */
+static inline uint16_t logMs(int ms)
+{
+    return ms < 0 ? 0 : ms > LOG_MS_MAX ? LOG_MS_MAX : ms;
+}
+
+/** Write-behind binary log on a FAT file system
+ *
+ * Producers hand records to log(), which copies them into an rtos::Mail
+ * queue and returns at once; when the queue is full the record is dropped
+ * and counted rather than blocking. A low priority thread collects records
+ * into a sector buffer and appends it to the file only once all 16 slots
+ * are filled, so each write is one whole, sector aligned block. A part
+ * filled sector is padded and written by flush() or after LOG_FLUSH_MS
+ * without records, so the file always stays a whole number of sectors.
+ *
+ * The file's size and FAT are synced every LOG_SYNC_SECTORS sectors, at
+ * most LOG_SYNC_MS after a sector was appended, and on flush(), not after
+ * every sector. A power cut loses the sectors appended since the last sync.
+ *
+ * Example:
+ * @code
+ * TelemetryLog cutLog(sd, "cuts.bin");
+ *
+ * cutLog.start();
+ * LogRecord r = {0};
+ * r.type = LOG_CUT;
+ * r.fed = 12.0;
+ * cutLog.log(r);
+ * @endcode
+ */
+class TelemetryLog
+{
+public:
+    /** Create a log backed by a file
+     *
+     * @param fs File system holding the log
+     * @param name File name on that file system, e.g. "cuts.bin"
+     */
+    TelemetryLog(FATFileSystem &fs, const char *name);
+
+    /** Start the writer thread, it runs at low priority */
+    void start();
+
+    /** Queue a record without blocking, safe from interrupts
+     *
+     * The time stamp and sequence number are filled in here.
+     *
+     * @returns false if the queue was full and the record was dropped
+     */
+    bool log(const LogRecord &record);
+
+    /** Ask the writer to write out a part filled sector now */
+    void flush();
+
+    /** Records queued since boot */
+    int logged();
+
+    /** Records dropped because the queue was full */
+    int dropped();
+
+    /** Sectors written to the file */
+    int sectors();
+
+    /** Syncs of the file */
+    int syncs();
+
+    /** Sectors the file system refused; their records are lost */
+    int writeErrors();
+
+private:
+    void writer();
+    void writeSector(bool sync);
+    void sync();
+    uint32_t syncWait();
+    void close();
+    bool open();
+
+    FATFileSystem &_fs;
+    const char *_name;
+    Thread _thread;
+    Mail<LogRecord, LOG_QUEUE_SIZE> _mail;
+    Timer _clock;
+    FileHandle *_file;
+    LogRecord _sector[LOG_RECORDS_PER_SECTOR];
+    int _fill;
+    volatile uint16_t _sequence;
+    volatile int _logged;
+    volatile int _dropped;
+    int _sectors;
+    int _unsynced;      // sectors appended since the last sync
+    int _unsyncedMs;    // when the first of them was appended
+    int _syncs;
+    int _writeErrors;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Turn a TelemetryLog binary file into CSV.
+
+Usage: decode_log.py cuts.bin [out.csv]
+
+Records are the 32 byte LogRecord of TelemetryLog.h, little endian. Pad
+records are skipped; gaps in the sequence numbers are reported on stderr
+as records dropped on the board. Durations that reached LOG_MS_MAX are
+written as e.g. ">=65535".
+"""
+import csv
+import struct
+import sys
+
+RECORD = struct.Struct('<IHBBhhffffHH')
+LOG_PAD = 0
+LOG_CUT = 1
+LOG_MS_MAX = 0xFFFF
+ERRORS = {0x01: 'length', 0x02: 'feed', 0x04: 'stroke'}
+FIELDS = ['ms', 'sequence', 'type', 'errors', 'job', 'wire', 'length', 'left_strip',
+          'right_strip', 'fed', 'cycle_ms', 'stroke_ms']
+
+
+def records(data):
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        record = dict(zip(FIELDS, RECORD.unpack_from(data, offset)))
+        if record['type'] != LOG_PAD:
+            yield record
+
+
+def new_boot(last, r):
+    """Time and sequence restart from 0 on every boot. The first record of
+    a boot can be later than the last one of the boot before, so sequence 0
+    starts a boot too, unless it is the sequence wrapping."""
+    return r['ms'] < last['ms'] or (r['sequence'] == 0 and last['sequence'] != 0xFFFF)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    out = open(sys.argv[2], 'w', newline='') if len(sys.argv) > 2 else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(FIELDS)
+    last = None
+    dropped = 0
+    for r in records(data):
+        if last is not None and not new_boot(last, r):
+            dropped += (r['sequence'] - last['sequence'] - 1) & 0xFFFF
+        last = r.copy()
+        r['type'] = 'cut' if r['type'] == LOG_CUT else r['type']
+        r['errors'] = '|'.join(name for bit, name in ERRORS.items() if r['errors'] & bit)
+        for key in ('length', 'left_strip', 'right_strip', 'fed'):
+            r[key] = '%.3f' % r[key]
+        for key in ('cycle_ms', 'stroke_ms'):
+            if r[key] == LOG_MS_MAX:
+                r[key] = '>=%d' % LOG_MS_MAX
+        writer.writerow([r[k] for k in FIELDS])
+    if dropped:
+        sys.stderr.write('%d records dropped on the board\n' % dropped)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,137 @@
+#include "TelemetryStream.h"
+
+TelemetryStream::TelemetryStream(BluefruitPad &pad):_pad(pad),
+    _thread(osPriorityLow),
+    _changed(0),
+    _sequence(0),
+    _sinceFull(TELEMETRY_FULL_EVERY),
+    _idleMs(0),
+    _frames(0),
+    _bytes(0),
+    _coalesced(0),
+    _busy(0)
+{
+    memset(_values, 0, sizeof(_values));
+    memset(_sent, 0, sizeof(_sent));
+}
+
+void TelemetryStream::start()
+{
+    _thread.start(callback(this, &TelemetryStream::publisher));
+}
+
+void TelemetryStream::set(int field, int32_t value)
+{
+    if (field < 0 || field >= TELEMETRY_FIELDS) {
+        return;
+    }
+    uint8_t bit = 1 << field;
+    core_util_critical_section_enter();
+    if (value != _values[field] && (_changed & bit)) {
+        _coalesced++;
+    }
+    _values[field] = value;
+    if (value != _sent[field]) {
+        _changed |= bit;
+    } else {
+        _changed &= ~bit;
+    }
+    core_util_critical_section_exit();
+}
+
+void TelemetryStream::publisher()
+{
+    while (true) {
+        Thread::wait(TELEMETRY_PERIOD_MS);
+        _idleMs += TELEMETRY_PERIOD_MS;
+        if (_changed == 0 && _idleMs < TELEMETRY_IDLE_MS) {
+            continue;
+        }
+        // Leave the values to merge until the link has caught up
+        if (_pad.txPending() > 0) {
+            _busy++;
+            continue;
+        }
+        publish();
+    }
+}
+
+void TelemetryStream::publish()
+{
+    int32_t values[TELEMETRY_FIELDS];
+    core_util_critical_section_enter();
+    memcpy(values, _values, sizeof(values));
+    uint8_t changed = _changed;
+    core_util_critical_section_exit();
+
+    bool full = changed == 0 || _sinceFull >= TELEMETRY_FULL_EVERY - 1;
+    uint8_t mask = full ? (1 << TELEMETRY_FIELDS) - 1 : changed;
+    uint8_t payload[3 + TELEMETRY_FIELDS * 5];
+    payload[0] = full ? TELEMETRY_MSG_FULL : TELEMETRY_MSG_DELTA;
+    payload[1] = _sequence;
+    payload[2] = mask;
+    int length = 3;
+    for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+        if (mask & (1 << i)) {
+            // The difference wraps in 32 bits, as the receiver's sum does
+            int32_t delta = (int32_t)((uint32_t)values[i] - (uint32_t)_sent[i]);
+            length += putVarint(payload + length, full ? values[i] : delta);
+        }
+    }
+
+    // A frame the TX ring turned away goes out next period instead
+    bool sent = _pad.send(payload, length);
+    core_util_critical_section_enter();
+    if (sent) {
+        memcpy(_sent, values, sizeof(_sent));
+    }
+    // Fields set while the frame was built are compared with what went out
+    _changed = 0;
+    for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+        if (_values[i] != _sent[i]) {
+            _changed |= 1 << i;
+        }
+    }
+    core_util_critical_section_exit();
+    if (!sent) {
+        return;
+    }
+    _sequence++;
+    _sinceFull = full ? 0 : _sinceFull + 1;
+    _idleMs = 0;
+    _frames++;
+    _bytes += length;
+}
+
+int TelemetryStream::putVarint(uint8_t *out, int32_t value)
+{
+    // Zigzag puts small negative numbers next to small positive ones
+    uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    int n = 0;
+    while (v >= 0x80) {
+        out[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+int TelemetryStream::frames()
+{
+    return _frames;
+}
+
+int TelemetryStream::bytes()
+{
+    return _bytes;
+}
+
+int TelemetryStream::coalesced()
+{
+    return _coalesced;
+}
+
+int TelemetryStream::busy()
+{
+    return _busy;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef TELEMETRY_STREAM_H
+#define TELEMETRY_STREAM_H
+
+#include "mbed.h"
+#include "rtos.h"
+#include "BluefruitPad.h"
+
+#ifndef TELEMETRY_PERIOD_MS
+#define TELEMETRY_PERIOD_MS 250 // ms between status frames while values change
+#endif
+
+#ifndef TELEMETRY_FULL_EVERY
+#define TELEMETRY_FULL_EVERY 8 // frames between full frames, which resync a receiver
+#endif
+
+#ifndef TELEMETRY_IDLE_MS
+#define TELEMETRY_IDLE_MS 2000 // ms without changes before a full frame is repeated
+#endif
+
+#define TELEMETRY_FIELDS 8 // one bit each in a frame's field mask
+
+typedef enum {
+    TELEMETRY_MSG_FULL  = 'K', // every field, as is
+    TELEMETRY_MSG_DELTA = 'T'  // changed fields, as the difference from the frame before
+} TelemetryMessage;
+
+/** Status published over the BLE data frames at a fixed rate
+ *
+ * Producers set() integer fields from any thread or interrupt; that only
+ * stores the value. A low priority thread sends a frame every
+ * TELEMETRY_PERIOD_MS when anything changed, holding only the fields that
+ * did, each as a zigzag varint of the difference from the last value sent,
+ * so a wire finishing costs a few bytes. Every TELEMETRY_FULL_EVERY frames,
+ * and every TELEMETRY_IDLE_MS while nothing changes, a full frame carries
+ * every value instead.
+ *
+ * A frame is only queued once the last one has left the TX ring, so when
+ * the link is slower than the producers their updates merge into the next
+ * frame instead of piling up; nothing here ever waits on the UART.
+ *
+ * Payload: TelemetryMessage, sequence number, field mask, then one varint
+ * per field in the mask, lowest field first. A receiver applies a delta
+ * frame only if its sequence number follows the last frame it applied,
+ * and otherwise waits for the next full frame.
+ * TelemetryStream/decode_telemetry.py prints the stream on a PC.
+ */
+class TelemetryStream
+{
+public:
+    /** Create a publisher on a link
+     *
+     * @param pad Link frames are sent over
+     */
+    TelemetryStream(BluefruitPad &pad);
+
+    /** Start the publisher thread, it runs at low priority */
+    void start();
+
+    /** Store a field for the next frame, safe from interrupts */
+    void set(int field, int32_t value);
+
+    /** Frames sent since boot */
+    int frames();
+
+    /** Payload bytes sent since boot */
+    int bytes();
+
+    /** Values replaced before a frame carried them */
+    int coalesced();
+
+    /** Periods skipped because the last frame had not left yet */
+    int busy();
+
+private:
+    void publisher();
+    void publish();
+    static int putVarint(uint8_t *out, int32_t value);
+
+    BluefruitPad &_pad;
+    Thread _thread;
+    int32_t _values[TELEMETRY_FIELDS];
+    int32_t _sent[TELEMETRY_FIELDS];
+    volatile uint8_t _changed; // mask of fields that differ from _sent
+    uint8_t _sequence;
+    int _sinceFull;
+    int _idleMs;
+    int _frames;
+    int _bytes;
+    volatile int _coalesced;
+    int _busy;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Print the machine's TelemetryStream status as it arrives.
+
+Usage: decode_telemetry.py PORT [--baud 9600] [--raw]
+       decode_telemetry.py --file CAPTURE [--raw]
+
+PORT is a serial port carrying the BLE UART, e.g. a Bluefruit module or a
+USB UART wired to the board's BLE pins; needs pyserial. CAPTURE is a file
+of bytes the board sent, read to its end. Other '!J' frames, such as
+JobLink acknowledgements, are skipped.
+
+A delta frame is only applied when its sequence number follows the last
+frame applied; after a lost frame the status is held until the next full
+frame, which comes at least every few seconds.
+"""
+import argparse
+import binascii
+import struct
+import sys
+
+MSG_FULL = ord('K')
+MSG_DELTA = ord('T')
+FIELDS = ['state', 'job', 'wires_done', 'wires_left', 'batch_left', 'spool', 'cycle_ms', 'faults']
+STATES = ['HOMING', 'MENU', 'CUTTING_ONE', 'CUTTING_TWO', 'SETTINGS_ONE', 'SETTINGS_RESET',
+          'SETTINGS_FEED', 'SETTINGS_CUTTER', 'SETTINGS_GUIDE']
+FAULTS = {0x01: 'length', 0x02: 'state log', 0x04: 'cut log', 0x08: 'feed', 0x10: 'cutter', 0x20: 'job file'}
+
+
+def frames(chunks):
+    """Yields the payload of every '!J' frame with a good CRC in a stream of byte strings"""
+    buf = b''
+    for chunk in chunks:
+        buf += chunk
+        while True:
+            start = buf.find(b'!J')
+            if start < 0 or len(buf) < start + 3:
+                buf = buf[start:] if start >= 0 else buf[-1:]
+                break
+            end = start + 5 + buf[start + 2]
+            if len(buf) < end:
+                buf = buf[start:]
+                break
+            body, crc = buf[start:end - 2], buf[end - 2:end]
+            if struct.pack('<H', binascii.crc_hqx(body, 0xFFFF)) == crc:
+                yield body[3:]
+                buf = buf[end:]
+            else:
+                buf = buf[start + 1:]
+
+
+def varints(data):
+    """Zigzag varints, as TelemetryStream::putVarint writes them"""
+    value = shift = 0
+    for b in data:
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            yield (value >> 1) ^ -(value & 1)
+            value = shift = 0
+
+
+def int32(value):
+    """Deltas wrap around in 32 bits on the board"""
+    return ((value + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+
+
+class Status:
+    def __init__(self):
+        self.values = None
+        self.seq = None
+        self.skipped = 0
+
+    def apply(self, payload):
+        """Returns True if the frame changed the status"""
+        if len(payload) < 3 or payload[0] not in (MSG_FULL, MSG_DELTA):
+            return False
+        kind, seq, mask = payload[0], payload[1], payload[2]
+        fields = [i for i in range(len(FIELDS)) if mask & (1 << i)]
+        values = list(varints(payload[3:]))
+        if len(values) != len(fields):
+            return False
+        if kind == MSG_FULL:
+            self.values = [0] * len(FIELDS)
+        elif self.values is None or seq != (self.seq + 1) & 0xFF:
+            self.skipped += 1
+            return False
+        for i, v in zip(fields, values):
+            self.values[i] = v if kind == MSG_FULL else int32(self.values[i] + v)
+        self.seq = seq
+        return True
+
+    def __str__(self):
+        v = dict(zip(FIELDS, self.values))
+        state = STATES[v['state']] if 0 <= v['state'] < len(STATES) else str(v['state'])
+        faults = [name for bit, name in FAULTS.items() if v['faults'] & bit]
+        return ('%-15s job %3d  %4d done %4d left  batch %5d  spool %6.1f ft  cycle %5d ms%s' % (
+            state, v['job'], v['wires_done'], v['wires_left'], v['batch_left'],
+            v['spool'] / 10.0, v['cycle_ms'], '  faults: ' + ', '.join(faults) if faults else ''))
+
+
+def show(payloads, raw):
+    status = Status()
+    batch_left = None
+    for payload in payloads:
+        last = str(status) if status.values else None
+        if not status.apply(payload):
+            continue
+        line = str(status)
+        if raw or line != last:
+            print(line)
+        left = status.values[FIELDS.index('batch_left')]
+        if batch_left and left == 0:
+            print('Finished!')
+        batch_left = left
+    return status
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__)
+    parser.add_argument('port', nargs='?')
+    parser.add_argument('--baud', type=int, default=9600)
+    parser.add_argument('--file', help='a capture of the UART instead of a port')
+    parser.add_argument('--raw', action='store_true', help='print every frame, not just changes')
+    args = parser.parse_args()
+    if bool(args.port) == bool(args.file):
+        parser.error('give a PORT or a --file')
+
+    if args.file:
+        with open(args.file, 'rb') as f:
+            status = show(frames(iter(lambda: f.read(4096), b'')), args.raw)
+        if status.skipped:
+            sys.stderr.write('%d delta frames skipped waiting for a full frame\n' % status.skipped)
+        return
+    import serial
+    with serial.Serial(args.port, args.baud, timeout=0.05) as port:
+        show(frames(iter(lambda: port.read(port.in_waiting or 1), None)), args.raw)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,32 @@
+#ifndef MBED_DIRHANDLE_H
+#define MBED_DIRHANDLE_H
+
+#include <dirent.h>
+#include <sys/types.h>
+
+namespace mbed {
+
+/** An open directory of a FileSystemLike */
+class DirHandle
+{
+public:
+    virtual ~DirHandle() {}
+
+    virtual ssize_t read(struct dirent *ent) = 0;
+    virtual int close() = 0;
+    virtual void seek(off_t offset) = 0;
+    virtual off_t tell() = 0;
+    virtual void rewind() = 0;
+
+    virtual int closedir() { return close(); }
+    virtual struct dirent *readdir() { return 0; }
+    virtual void rewinddir() { rewind(); }
+    virtual off_t telldir() { return tell(); }
+    virtual void seekdir(off_t location) { seek(location); }
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif
\ No newline at end of file
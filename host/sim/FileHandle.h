@@ -0,0 +1,37 @@
+#ifndef MBED_FILEHANDLE_H
+#define MBED_FILEHANDLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <sys/types.h>
+
+namespace mbed {
+
+/** An open file of a FileSystemLike, as the retarget layer sees it */
+class FileHandle
+{
+public:
+    virtual ~FileHandle() {}
+
+    virtual ssize_t read(void *buffer, size_t size) = 0;
+    virtual ssize_t write(const void *buffer, size_t size) = 0;
+    virtual off_t seek(off_t offset, int whence = SEEK_SET) = 0;
+    virtual int close() = 0;
+    virtual int sync() { return 0; }
+    virtual int isatty() { return 0; }
+    virtual off_t tell() { return seek(0, SEEK_CUR); }
+    virtual void rewind() { seek(0, SEEK_SET); }
+    virtual off_t size() { return -1; }
+
+    // The mbed 2 names, kept for the drivers that override them
+    virtual off_t lseek(off_t offset, int whence) { return seek(offset, whence); }
+    virtual int fsync() { return sync(); }
+    virtual off_t flen() { return size(); }
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef MBED_FILESYSTEMLIKE_H
+#define MBED_FILESYSTEMLIKE_H
+
+#include "FileHandle.h"
+#include "DirHandle.h"
+#include <sys/stat.h>
+
+namespace mbed {
+
+/** A file system mounted at "/name"
+ *
+ * fopen(), remove() and rename() on "/name/..." paths reach it through the
+ * wrappers in retarget.cpp, the way the mbed retarget layer routes them.
+ */
+class FileSystemLike
+{
+public:
+    FileSystemLike(const char *name = 0);
+    virtual ~FileSystemLike();
+
+    const char *getName() { return _name; }
+
+    virtual FileHandle *open(const char *name, int flags) = 0;
+    virtual int remove(const char *filename) { return -1; }
+    virtual int rename(const char *oldname, const char *newname) { return -1; }
+    virtual DirHandle *opendir(const char *name) { return 0; }
+    virtual int mkdir(const char *name, mode_t mode) { return -1; }
+
+    /** The file system mounted as "/name", or NULL */
+    static FileSystemLike *lookup(const char *name, size_t length);
+
+private:
+    const char *_name;
+    FileSystemLike *_next;
+};
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif
\ No newline at end of file
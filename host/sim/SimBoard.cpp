@@ -0,0 +1,871 @@
+#include "SimBoard.h"
+#include "PinNames.h"
+#include "params.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+
+namespace sim {
+
+// Wiring of main.cpp
+const int CONSOLE_TX = USBTX;
+const int BLE_TX = p13;
+const int DISPLAY_TX = p9;
+const int DISPLAY_RESET = p30;
+const int SD_MOSI = p5;
+const int SD_CS = p8;
+const int FEED_EN = p16;
+const int FEED_MS1 = p17;
+const int FEED_MS2 = p18;
+const int FEED_MS3 = p19;
+const int FEED_STEP = p20;
+const int FEED_DIR = p21;
+const int GUIDE_PWM = p22;
+const int CUTTER_PWM = p23;
+const int CUTTER_FWD = p24;
+const int CUTTER_REV = p25;
+const int ENCODER = p11;
+const int UPPER_SWITCH = p27;
+const int LOWER_SWITCH = p28;
+
+void SerialCapture::send(const uint8_t *data, int length)
+{
+    uart().send(data, length);
+}
+
+Uart &SerialCapture::uart()
+{
+    return io().uart(_tx);
+}
+
+void SerialCapture::received(uint8_t byte)
+{
+    _received += (char)byte;
+    if (_echo) {
+        putchar(byte);
+    }
+}
+
+/*** Display ***/
+
+const int DISPLAY_RX_BUFFER = 32;          // bytes held while a command runs
+const ns_t DISPLAY_BOOT_TIME = 2 * SECOND; // from reset released to the first command taken
+const int DISPLAY_RESET_BAUD = 9600;
+
+Display::Display():_expected(-1),
+    _got(0),
+    _running(false),
+    _buffered(0),
+    _inReset(false),
+    _bootedAt(0),
+    _baud(DISPLAY_RESET_BAUD),
+    _injectNaks(0),
+    _ackDelay(0),
+    _busyTotal(0),
+    _commands(0),
+    _acks(0),
+    _naks(0),
+    _overflows(0),
+    _bytes(0),
+    _done(this, &Display::finished)
+{
+    memset(&_parsing, 0, sizeof(_parsing));
+    memset(&_current, 0, sizeof(_current));
+}
+
+void Display::resetStats()
+{
+    _busyTotal = 0;
+    _commands = 0;
+    _acks = 0;
+    _naks = 0;
+    _overflows = 0;
+    _bytes = 0;
+}
+
+// Argument bytes after the command code, -1 for an unknown command
+int Display::argBytes(uint8_t prefix, uint8_t code)
+{
+    if (prefix == 0x00) {
+        switch (code) {
+            case 0x06: return -2; // text string, NUL terminated
+            case 0x0B: return 2;  // baud rate
+            case 0x08: return 0;  // version
+            case 0x0A: return 8;  // blit header, the pixels follow
+            default: return -1;
+        }
+    }
+    switch (code) {
+        case 0xD7: case 0xB1: case 0xB7: case 0xB6: case 0xB2:
+            return 0;
+        case 0xD8:
+            return 1;
+        case 0x6E: case 0x7E: case 0x68: case 0x76: case 0x66:
+        case 0x7D: case 0x77: case 0x75: case 0x74: case 0x73:
+        case 0x7C: case 0x7B: case 0x7F: case 0xFE:
+        case 0xB5: case 0xB4:
+            return 2;
+        case 0xE4: case 0xCA: case 0xB9: case 0xB8: case 0xB3: case 0xBB:
+            return 4;
+        case 0xCB: case 0xBA:
+            return 6;
+        case 0xCD: case 0xCC:
+            return 8;
+        case 0xD2: case 0xCE: case 0xCF:
+            return 10;
+        case 0xC9:
+            return 14;
+        default:
+            return -1;
+    }
+}
+
+// Processing time of the Goldelox for a command, rough figures for the model
+ns_t Display::runTime(const Command &c)
+{
+    if (c.prefix == 0x00) {
+        if (c.code == 0x0B) {
+            return 15 * MS; // the ACK comes at the new rate, after baudrate() has switched the UART
+        }
+        if (c.code == 0x06) {
+            return 100 * US + (ns_t)c.bytes * 250 * US;
+        }
+        return 1 * MS;
+    }
+    switch (c.code) {
+        case 0xD7: return 10 * MS;  // clear screen
+        case 0xCE: return 1500 * US; // filled rectangle
+        case 0xCC: return 1 * MS;   // filled circle
+        case 0xFE: return 300 * US; // one character
+        case 0xB1: return 20 * MS;  // media init
+        default: return 100 * US;
+    }
+}
+
+void Display::received(uint8_t byte)
+{
+    if (_inReset || now() < _bootedAt) {
+        return;
+    }
+    _bytes++;
+    // Framing errors past a few percent off the display's rate
+    bool garble = abs(io().uart(DISPLAY_TX).baud() - _baud) * 100 > 3 * _baud;
+    if (_running && ++_buffered > DISPLAY_RX_BUFFER) {
+        _overflows++;
+        garble = true;
+    }
+    if (_expected == -1 && _got == 0 && !_parsing.bytes) {
+        // Prefix
+        _parsing.prefix = byte;
+        _parsing.bytes = 1;
+        _parsing.garbled = garble || (byte != 0x00 && byte != 0xFF);
+        return;
+    }
+    _parsing.bytes++;
+    _parsing.garbled = _parsing.garbled || garble;
+    if (_parsing.bytes == 2) {
+        _parsing.code = byte;
+        _expected = argBytes(_parsing.prefix, byte);
+        if (_expected == -1) {
+            _parsing.garbled = true;
+            _expected = 0;
+        }
+    } else if (_expected == -2) {
+        if (byte != 0) {
+            return;
+        }
+        _expected = 0;
+    } else {
+        if (_got < (int)sizeof(_args)) {
+            _args[_got] = byte;
+        }
+        _got++;
+        if (_parsing.prefix == 0x00 && _parsing.code == 0x0A && _got == 8) {
+            // Blit: the header gives the number of pixels still to come
+            int w = (_args[4] << 8) | _args[5];
+            int h = (_args[6] << 8) | _args[7];
+            _expected = 8 + 2 * w * h;
+        }
+    }
+    if (_expected >= 0 && _got >= _expected) {
+        parsed();
+    }
+}
+
+void Display::parsed()
+{
+    Command c = _parsing;
+    c.replyBytes = 0;
+    c.newBaud = 0;
+    if (c.prefix == 0xFF && (c.code == 0xB1 || c.code == 0xB7 || c.code == 0xB6 || c.code == 0xCA)) {
+        c.replyBytes = 2;
+    } else if (c.prefix == 0x00 && c.code == 0x08) {
+        c.replyBytes = 2;
+    } else if (c.prefix == 0x00 && c.code == 0x0B) {
+        int divisor = (_args[0] << 8) | _args[1];
+        c.newBaud = 3000000 / (divisor + 1);
+    }
+    memset(&_parsing, 0, sizeof(_parsing));
+    _expected = -1;
+    _got = 0;
+    _queue.push_back(c);
+    if (!_running) {
+        startNext();
+    }
+}
+
+void Display::startNext()
+{
+    if (_queue.empty()) {
+        _running = false;
+        return;
+    }
+    _current = _queue.front();
+    _queue.pop_front();
+    _buffered -= _current.bytes;
+    if (_buffered < 0) {
+        _buffered = 0;
+    }
+    _running = true;
+    ns_t time = runTime(_current) + _ackDelay;
+    _busyTotal += time;
+    _done.after(time);
+}
+
+void Display::finished()
+{
+    _commands++;
+    uint8_t reply[3] = {0x06, 0x00, 0x00};
+    if (_current.garbled || _injectNaks > 0) {
+        if (!_current.garbled) {
+            _injectNaks--;
+        }
+        reply[0] = 0x15;
+        _naks++;
+        io().uart(DISPLAY_TX).send(reply, 1);
+    } else {
+        if (_current.newBaud) {
+            _baud = _current.newBaud;
+        }
+        _acks++;
+        io().uart(DISPLAY_TX).send(reply, 1 + _current.replyBytes);
+    }
+    startNext();
+}
+
+void Display::pinChanged(int pin, int level)
+{
+    if (!level) {
+        _inReset = true;
+        _done.cancel();
+        _queue.clear();
+        _running = false;
+        _buffered = 0;
+        memset(&_parsing, 0, sizeof(_parsing));
+        _expected = -1;
+        _got = 0;
+    } else if (_inReset) {
+        _inReset = false;
+        _baud = DISPLAY_RESET_BAUD;
+        _bootedAt = now() + DISPLAY_BOOT_TIME;
+    }
+}
+
+/*** SD card ***/
+
+const uint32_t SD_SECTORS = 128 * 1024;     // 64 MB
+const ns_t SD_READ_ACCESS = 250 * US;       // command to data token
+const ns_t SD_PROGRAM_TIME = 1 * MS;        // busy after a single block
+const ns_t SD_MULTI_PROGRAM_TIME = 400 * US; // busy per block of a multiple write
+const int SD_INIT_CALLS = 3;                 // ACMD41 calls before the card leaves idle
+
+SdCard::SdCard():_selected(false),
+    _state(SD_IDLE),
+    _multi(false),
+    _cmdLength(0),
+    _busyUntil(0),
+    _readyAt(0),
+    _reading(false),
+    _streaming(false),
+    _readBlock(0),
+    _writeBlock(0),
+    _idle(true),
+    _initCalls(0),
+    _appCmd(false),
+    _crc(false),
+    _sectors(SD_SECTORS),
+    _corruptReads(0),
+    _rejectWrites(0),
+    _corruptCommands(0),
+    _blocksRead(0),
+    _blocksWritten(0),
+    _crcRejects(0),
+    _commandCrcErrors(0)
+{
+}
+
+uint8_t SdCard::crc7(const uint8_t *data, int length)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        for (int b = 7; b >= 0; b--) {
+            int bit = ((data[i] >> b) & 1) ^ ((crc >> 6) & 1);
+            crc = (crc << 1) & 0x7F;
+            if (bit) {
+                crc ^= 0x09;
+            }
+        }
+    }
+    return crc;
+}
+
+uint16_t SdCard::crc16(const uint8_t *data, int length)
+{
+    uint16_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        for (int b = 7; b >= 0; b--) {
+            int bit = ((data[i] >> b) & 1) ^ ((crc >> 15) & 1);
+            crc <<= 1;
+            if (bit) {
+                crc ^= 0x1021;
+            }
+        }
+    }
+    return crc;
+}
+
+void SdCard::pinChanged(int pin, int level)
+{
+    _selected = !level;
+    if (!_selected) {
+        _cmdLength = 0;
+    }
+}
+
+uint8_t *SdCard::sector(uint32_t n)
+{
+    std::vector<uint8_t> &s = _store[n];
+    if (s.empty()) {
+        s.assign(512, 0);
+    }
+    return &s[0];
+}
+
+uint8_t SdCard::exchange(uint8_t out)
+{
+    if (!_selected) {
+        return 0xFF;
+    }
+    uint8_t in = produce();
+    consume(out);
+    return in;
+}
+
+// What the card shifts out for the byte being clocked
+uint8_t SdCard::produce()
+{
+    if (!_out.empty()) {
+        uint8_t b = _out.front();
+        _out.pop_front();
+        return b;
+    }
+    if (now() < _busyUntil) {
+        return 0x00;
+    }
+    if (_reading && now() >= _readyAt) {
+        if (_readBlock >= _sectors) {
+            _out.push_back(0x08); // out of range error token
+            _reading = false;
+        } else {
+            queueBlock(sector(_readBlock++), 512);
+            _blocksRead++;
+            _reading = _streaming;
+            _readyAt = now() + SD_READ_ACCESS;
+        }
+        uint8_t b = _out.front();
+        _out.pop_front();
+        return b;
+    }
+    return 0xFF;
+}
+
+void SdCard::queueBlock(const uint8_t *data, int length)
+{
+    _out.push_back(0xFE);
+    for (int i = 0; i < length; i++) {
+        _out.push_back(data[i]);
+    }
+    uint16_t crc = crc16(data, length);
+    if (_corruptReads > 0) {
+        _corruptReads--;
+        crc ^= 0x0100;
+    }
+    _out.push_back(crc >> 8);
+    _out.push_back(crc & 0xFF);
+}
+
+void SdCard::consume(uint8_t in)
+{
+    switch (_state) {
+        case SD_WRITE_DATA:
+            _data.push_back(in);
+            if (_data.size() == 514) {
+                blockWritten();
+            }
+            return;
+        case SD_WRITE_TOKEN:
+            if (in == 0xFE) {
+                _data.clear();
+                _state = SD_WRITE_DATA;
+                return;
+            }
+            break;
+        case SD_MULTI_TOKEN:
+            if (in == 0xFC) {
+                _data.clear();
+                _state = SD_WRITE_DATA;
+                return;
+            }
+            if (in == 0xFD) {
+                _state = SD_IDLE;
+                _out.push_back(0xFF);
+                _busyUntil = now() + SD_MULTI_PROGRAM_TIME;
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (_cmdLength == 0 && (in & 0xC0) != 0x40) {
+        return;
+    }
+    _cmd[_cmdLength++] = in;
+    if (_cmdLength == 6) {
+        _cmdLength = 0;
+        command();
+    }
+}
+
+void SdCard::blockWritten()
+{
+    uint16_t crc = (_data[512] << 8) | _data[513];
+    bool bad = _crc && crc != crc16(&_data[0], 512);
+    if (_rejectWrites > 0) {
+        _rejectWrites--;
+        bad = true;
+    }
+    if (bad) {
+        _crcRejects++;
+        _out.push_back(0xEB);
+    } else {
+        memcpy(sector(_writeBlock++), &_data[0], 512);
+        _blocksWritten++;
+        _out.push_back(0xE5);
+    }
+    _busyUntil = now() + (_multi ? SD_MULTI_PROGRAM_TIME : SD_PROGRAM_TIME);
+    if (_multi && !bad) {
+        _state = SD_MULTI_TOKEN;
+    } else {
+        _state = SD_IDLE;
+    }
+}
+
+void SdCard::command()
+{
+    int cmd = _cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)_cmd[1] << 24) | (_cmd[2] << 16) | (_cmd[3] << 8) | _cmd[4];
+    if (_corruptCommands > 0) {
+        _corruptCommands--;
+        _cmd[2] ^= 0x10;
+    }
+    bool checked = _crc || cmd == 0 || cmd == 8;
+    bool crcOk = (crc7(_cmd, 5) << 1 | 1) == _cmd[5];
+
+    // A new command ends a read stream and drops what was still queued
+    _out.clear();
+    _out.push_back(0xFF); // NCR
+    if (checked && !crcOk) {
+        _commandCrcErrors++;
+        _out.push_back(0x08 | (_idle ? 0x01 : 0));
+        _appCmd = false;
+        return;
+    }
+    uint8_t r1 = _idle ? 0x01 : 0x00;
+    bool app = _appCmd;
+    _appCmd = false;
+
+    switch (app ? 100 + cmd : cmd) {
+        case 0:
+            _idle = true;
+            _initCalls = 0;
+            _crc = false;
+            _reading = false;
+            _state = SD_IDLE;
+            _out.push_back(0x01);
+            break;
+        case 8:
+            _out.push_back(r1);
+            _out.push_back(0x00);
+            _out.push_back(0x00);
+            _out.push_back(0x01);
+            _out.push_back(arg & 0xFF);
+            break;
+        case 58:
+            _out.push_back(r1);
+            _out.push_back(_idle ? 0x00 : 0xC0); // powered up, high capacity
+            _out.push_back(0xFF);
+            _out.push_back(0x80);
+            _out.push_back(0x00);
+            break;
+        case 55:
+            _appCmd = true;
+            _out.push_back(r1);
+            break;
+        case 141:
+            if (++_initCalls >= SD_INIT_CALLS) {
+                _idle = false;
+            }
+            _out.push_back(_idle ? 0x01 : 0x00);
+            break;
+        case 123:
+        case 16:
+            _out.push_back(r1);
+            break;
+        case 59:
+            _crc = arg & 1;
+            _out.push_back(r1);
+            break;
+        case 9: {
+            // CSD version 2.0, C_SIZE for SD_SECTORS
+            uint8_t csd[16];
+            memset(csd, 0, sizeof(csd));
+            uint32_t cSize = _sectors / 1024 - 1;
+            csd[0] = 0x40;
+            csd[1] = 0x0E;
+            csd[3] = 0x32;
+            csd[4] = 0x5B;
+            csd[5] = 0x59;
+            csd[7] = (cSize >> 16) & 0x3F;
+            csd[8] = (cSize >> 8) & 0xFF;
+            csd[9] = cSize & 0xFF;
+            csd[10] = 0x7F;
+            csd[11] = 0x80;
+            csd[12] = 0x0A;
+            csd[13] = 0x40;
+            csd[15] = crc7(csd, 15) << 1 | 1;
+            _out.push_back(r1);
+            _out.push_back(0xFF);
+            queueBlock(csd, 16);
+            break;
+        }
+        case 17:
+        case 18:
+            _out.push_back(r1);
+            if (arg >= _sectors) {
+                _out[_out.size() - 1] = 0x40; // parameter error
+                break;
+            }
+            _readBlock = arg;
+            _reading = true;
+            _streaming = cmd == 18;
+            _readyAt = now() + SD_READ_ACCESS;
+            break;
+        case 12:
+            _reading = false;
+            _streaming = false;
+            _out.push_back(0xFF); // stuff byte
+            _out.push_back(r1);
+            _busyUntil = now() + 20 * US;
+            break;
+        case 24:
+        case 25:
+            _out.push_back(r1);
+            if (arg >= _sectors) {
+                _out[_out.size() - 1] = 0x40;
+                break;
+            }
+            _writeBlock = arg;
+            _multi = cmd == 25;
+            _state = _multi ? SD_MULTI_TOKEN : SD_WRITE_TOKEN;
+            break;
+        default:
+            _out.push_back(r1 | 0x04); // illegal command
+            break;
+    }
+}
+
+/*** Machine ***/
+
+const double Machine::UPPER_LIMIT = 0.98;
+const double Machine::LOWER_LIMIT = 0.02;
+const double Machine::WIRE_HEIGHT = 0.2;
+
+const double ENCODER_PHASE = 0.37;   // counts, the idler starts between two magnets
+const double GUIDE_DEG_PER_S = 600;  // servo slew rate
+const double GUIDE_CUT_WINDOW = 5;   // degrees either side of the cut position
+const ns_t ENCODER_EDGE_GAP = 25 * US; // owed edges are spread past the encoder's noise filter
+
+Machine::Machine():_slip(0.97),
+    _wire(0),
+    _steps(0),
+    _divisor(1),
+    _edges(0),
+    _countsMade(0),
+    _togglesOwed(0),
+    _strokeTime(400 * MS),
+    _y(0.5),
+    _yAt(0),
+    _duty(0),
+    _v(0),
+    _stall(0),
+    _target(0),
+    _angle(0),
+    _angleAt(0),
+    _collisions(0),
+    _encoder(this, &Machine::encoderToggle),
+    _limit(this, &Machine::limitReached)
+{
+}
+
+void Machine::blade(double y)
+{
+    _y = y;
+    _yAt = now();
+    io().input(UPPER_SWITCH, _y >= UPPER_LIMIT);
+    io().input(LOWER_SWITCH, _y <= LOWER_LIMIT);
+    scheduleLimit();
+}
+
+void Machine::strokeTime(ns_t time)
+{
+    moveBlade();
+    _strokeTime = time;
+    _v = velocity();
+    scheduleLimit();
+}
+
+double Machine::velocity()
+{
+    Io &pins = io();
+    int fwd = pins.level(CUTTER_FWD);
+    int rev = pins.level(CUTTER_REV);
+    if (fwd == rev) {
+        return 0;
+    }
+    return (fwd ? _duty : -_duty) / _strokeTime;
+}
+
+// Bring the blade up to now at the speed it had since the last change
+void Machine::moveBlade()
+{
+    ns_t t = now();
+    double v = _v;
+    double dt = (double)(t - _yAt);
+    double y = _y + v * dt;
+    if (y > 1) {
+        _stall += (ns_t)(dt - (1 - _y) / v);
+        y = 1;
+    } else if (y < 0) {
+        _stall += (ns_t)(dt - _y / v);
+        y = 0;
+    }
+    _y = y;
+    _yAt = t;
+}
+
+double Machine::blade()
+{
+    moveBlade();
+    return _y;
+}
+
+ns_t Machine::stalled()
+{
+    moveBlade();
+    return _stall;
+}
+
+// Next switch the blade reaches, going the way it moves now
+void Machine::scheduleLimit()
+{
+    _limit.cancel();
+    double v = _v;
+    double target;
+    if (v < 0) {
+        if (_y > UPPER_LIMIT) {
+            target = UPPER_LIMIT;
+        } else if (_y > LOWER_LIMIT) {
+            target = LOWER_LIMIT;
+        } else {
+            return;
+        }
+    } else if (v > 0) {
+        if (_y < LOWER_LIMIT) {
+            target = LOWER_LIMIT;
+        } else if (_y < UPPER_LIMIT) {
+            target = UPPER_LIMIT;
+        } else {
+            return;
+        }
+    } else {
+        return;
+    }
+    _limit.after((ns_t)ceil((target - _y) / v));
+}
+
+void Machine::limitReached()
+{
+    moveBlade();
+    Io &pins = io();
+    bool down = _v < 0;
+    if (fabs(_y - UPPER_LIMIT) < fabs(_y - LOWER_LIMIT)) {
+        _y = down ? UPPER_LIMIT - 1e-9 : UPPER_LIMIT;
+        pins.input(UPPER_SWITCH, !down);
+    } else {
+        _y = down ? LOWER_LIMIT : LOWER_LIMIT + 1e-9;
+        pins.input(LOWER_SWITCH, down);
+        if (down) {
+            Stroke s = {_wire, guide(), now()};
+            _strokes.push_back(s);
+        }
+    }
+    scheduleLimit();
+}
+
+std::vector<double> Machine::pieces(double cutAngle)
+{
+    std::vector<double> lengths;
+    double last = 0;
+    for (size_t i = 0; i < _strokes.size(); i++) {
+        if (fabs(_strokes[i].angle - cutAngle) > GUIDE_CUT_WINDOW) {
+            continue; // strip incision
+        }
+        lengths.push_back(_strokes[i].position - last);
+        last = _strokes[i].position;
+    }
+    return lengths;
+}
+
+double Machine::guide()
+{
+    ns_t t = now();
+    double travel = GUIDE_DEG_PER_S * (t - _angleAt) / SECOND;
+    if (fabs(_target - _angle) <= travel) {
+        _angle = _target;
+    } else {
+        _angle += _target > _angle ? travel : -travel;
+    }
+    _angleAt = t;
+    return _angle;
+}
+
+void Machine::step()
+{
+    if (io().level(FEED_EN)) {
+        return; // driver disabled
+    }
+    int dir = io().level(FEED_DIR) ? 1 : -1;
+    _steps += dir;
+    if (blade() < WIRE_HEIGHT) {
+        _collisions++;
+        return; // the blade holds the wire
+    }
+    _wire += dir * _slip / (FEEDER_STEP_PER_INCH * _divisor);
+    uint32_t counts = (uint32_t)floor(_wire / FEEDER_INCH_PER_COUNT + ENCODER_PHASE);
+    if (counts != _countsMade) {
+        _togglesOwed += counts > _countsMade ? counts - _countsMade : _countsMade - counts;
+        _countsMade = counts;
+        if (!_encoder.pending()) {
+            _encoder.after(0);
+        }
+    }
+}
+
+// From an event of its own, so the encoder interrupt never nests in the step one
+void Machine::encoderToggle()
+{
+    io().input(ENCODER, !io().level(ENCODER));
+    _edges++;
+    if (--_togglesOwed > 0) {
+        _encoder.after(ENCODER_EDGE_GAP);
+    }
+}
+
+void Machine::pinChanged(int pin, int level)
+{
+    switch (pin) {
+        case FEED_STEP:
+            if (level) {
+                step();
+            }
+            break;
+        case FEED_MS1:
+        case FEED_MS2:
+        case FEED_MS3: {
+            static const int divisors[8] = {1, 2, 4, 8, 8, 8, 8, 16};
+            Io &pins = io();
+            _divisor = divisors[pins.level(FEED_MS1) | pins.level(FEED_MS2) << 1 | pins.level(FEED_MS3) << 2];
+            break;
+        }
+        case CUTTER_FWD:
+        case CUTTER_REV:
+            // The pin already changed, the blade moved at the old speed until now
+            moveBlade();
+            _v = velocity();
+            scheduleLimit();
+            break;
+        default:
+            break;
+    }
+}
+
+void Machine::pwmChanged(int pin, ns_t period, ns_t pulse)
+{
+    if (pin == CUTTER_PWM) {
+        moveBlade();
+        _duty = period ? (double)pulse / period : 0;
+        _v = velocity();
+        scheduleLimit();
+    } else if (pin == GUIDE_PWM && pulse >= 500 * US) {
+        guide();
+        _target = ((double)pulse - 1500 * US) / (900 * US) * 180;
+    }
+}
+
+/*** Board ***/
+
+static Board theBoard;
+
+void attachDevices(Io &io)
+{
+    theBoard.console = new SerialCapture(CONSOLE_TX);
+    io.uart(CONSOLE_TX).connect(theBoard.console);
+
+    theBoard.ble = new SerialCapture(BLE_TX);
+    io.uart(BLE_TX).connect(theBoard.ble);
+
+    theBoard.display = new Display;
+    io.uart(DISPLAY_TX).connect(theBoard.display);
+    io.watch(DISPLAY_RESET, theBoard.display);
+
+    theBoard.sd = new SdCard;
+    io.spi(SD_MOSI).connect(theBoard.sd);
+    io.watch(SD_CS, theBoard.sd);
+
+    theBoard.machine = new Machine;
+    static const int machinePins[] = {FEED_EN, FEED_MS1, FEED_MS2, FEED_MS3, FEED_STEP, FEED_DIR,
+                                      GUIDE_PWM, CUTTER_PWM, CUTTER_FWD, CUTTER_REV};
+    for (size_t i = 0; i < sizeof(machinePins) / sizeof(machinePins[0]); i++) {
+        io.watch(machinePins[i], theBoard.machine);
+    }
+}
+
+Board &board()
+{
+    io();
+    return theBoard;
+}
+
+} // namespace sim
\ No newline at end of file
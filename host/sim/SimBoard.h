@@ -0,0 +1,289 @@
+#ifndef SIM_BOARD_H
+#define SIM_BOARD_H
+
+#include "SimIo.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+/** The machine around the firmware, wired as in main.cpp
+ *
+ * Every model only sees the pins, serial links and SPI bus the firmware
+ * drives, and answers with the timing of the real part, so a test checks
+ * the firmware as the board would run it.
+ */
+namespace sim {
+
+/** Far end of a serial link that keeps what the board sent */
+class SerialCapture : public UartDevice
+{
+public:
+    SerialCapture(int tx):_tx(tx),
+        _echo(false)
+    {
+    }
+
+    /** Bytes towards the board, at the link's rate */
+    void send(const uint8_t *data, int length);
+    void send(const std::string &text) { send((const uint8_t *)text.data(), text.size()); }
+
+    /** Copy what arrives to stdout as well */
+    void echo(bool on) { _echo = on; }
+
+    std::string &received() { return _received; }
+    Uart &uart();
+
+    virtual void received(uint8_t byte);
+
+private:
+    int _tx;
+    bool _echo;
+    std::string _received;
+};
+
+/** 4D Systems uLCD-144-G2 serial protocol
+ *
+ * Commands are parsed as they arrive and run one at a time, each taking
+ * its processing time before the ACK. Bytes arriving while a command runs
+ * wait in a small receive buffer; once that overflows the command being
+ * received is garbled and answered with a NAK.
+ */
+class Display : public UartDevice, public PinListener
+{
+public:
+    Display();
+
+    /** Answer the next commands with a NAK, as a garbled one would be */
+    void injectNaks(int count) { _injectNaks += count; }
+
+    /** Hold every answer this much longer, as a slower display would */
+    void ackDelay(ns_t delay) { _ackDelay = delay; }
+
+    uint32_t commands() { return _commands; }
+    uint32_t acks() { return _acks; }
+    uint32_t naks() { return _naks; }
+    uint32_t overflows() { return _overflows; }
+    uint32_t bytes() { return _bytes; }
+    int baud() { return _baud; }
+
+    /** Busy time of the display since the last resetStats() */
+    ns_t busy() { return _busyTotal; }
+    void resetStats();
+
+    virtual void received(uint8_t byte);
+    virtual void pinChanged(int pin, int level);
+
+private:
+    typedef struct {
+        uint8_t prefix;
+        uint8_t code;
+        int bytes;
+        bool garbled;
+        int replyBytes; // after the ACK
+        int newBaud;
+    } Command;
+
+    int argBytes(uint8_t prefix, uint8_t code);
+    ns_t runTime(const Command &c);
+    void parsed();
+    void startNext();
+    void finished();
+
+    Command _parsing;
+    int _expected; // -1 while unknown, -2 for a NUL terminated string
+    int _got;
+    uint8_t _args[16];
+    std::deque<Command> _queue;
+    bool _running;
+    Command _current;
+    int _buffered;
+    bool _inReset;
+    ns_t _bootedAt;
+    int _baud;
+    int _injectNaks;
+    ns_t _ackDelay;
+    ns_t _busyTotal;
+    uint32_t _commands;
+    uint32_t _acks;
+    uint32_t _naks;
+    uint32_t _overflows;
+    uint32_t _bytes;
+    MemberEvent<Display> _done;
+};
+
+/** SD card in SPI mode, SDHC with a sparse sector store
+ *
+ * CRCs are checked on CMD0 and CMD8, and on every command and written
+ * block once CMD59 turns them on. Errors can be injected on the CRC of
+ * read blocks, on written blocks and on commands.
+ */
+class SdCard : public SpiDevice, public PinListener
+{
+public:
+    SdCard();
+
+    /** Corrupt the CRC16 of the next count read blocks, CSD included; 0 stops */
+    void corruptReads(int count) { _corruptReads = count; }
+
+    /** Answer the next count written blocks with a CRC error token; 0 stops */
+    void rejectWrites(int count) { _rejectWrites = count; }
+
+    /** Flip a bit of the next count commands on the way in; 0 stops */
+    void corruptCommands(int count) { _corruptCommands = count; }
+
+    bool crcMode() { return _crc; }
+    uint32_t sectors() { return _sectors; }
+    uint32_t blocksRead() { return _blocksRead; }
+    uint32_t blocksWritten() { return _blocksWritten; }
+    uint32_t crcRejects() { return _crcRejects; }
+    uint32_t commandCrcErrors() { return _commandCrcErrors; }
+
+    /** Reference CRCs of the SD spec, computed bit by bit */
+    static uint8_t crc7(const uint8_t *data, int length);
+    static uint16_t crc16(const uint8_t *data, int length);
+
+    virtual uint8_t exchange(uint8_t out);
+    virtual void pinChanged(int pin, int level);
+
+private:
+    typedef enum {
+        SD_IDLE,
+        SD_WRITE_TOKEN,   // after CMD24, waiting for 0xFE
+        SD_MULTI_TOKEN,   // after CMD25, waiting for 0xFC or 0xFD
+        SD_WRITE_DATA
+    } SdState;
+
+    uint8_t produce();
+    void consume(uint8_t in);
+    void command();
+    void queueBlock(const uint8_t *data, int length);
+    void blockWritten();
+    uint8_t *sector(uint32_t n);
+
+    bool _selected;
+    SdState _state;
+    bool _multi;
+    uint8_t _cmd[6];
+    int _cmdLength;
+    std::deque<uint8_t> _out;
+    ns_t _busyUntil;
+    ns_t _readyAt;
+    bool _reading;
+    bool _streaming;
+    uint32_t _readBlock;
+    uint32_t _writeBlock;
+    std::vector<uint8_t> _data;
+    bool _idle;
+    int _initCalls;
+    bool _appCmd;
+    bool _crc;
+    uint32_t _sectors;
+    std::map<uint32_t, std::vector<uint8_t> > _store;
+    int _corruptReads;
+    int _rejectWrites;
+    int _corruptCommands;
+    uint32_t _blocksRead;
+    uint32_t _blocksWritten;
+    uint32_t _crcRejects;
+    uint32_t _commandCrcErrors;
+};
+
+/** Feeder, cutter and wire guide
+ *
+ * The stepper drives the feed wheel; the wire moves a little less than the
+ * wheel by the slip ratio and turns the hall encoder idler. The cutter is
+ * a DC motor moving the blade between two limit switches, and the blade
+ * blocks the wire below WIRE_HEIGHT. Every time the blade bottoms out the
+ * wire position and guide angle are recorded, so a test can check the
+ * pieces that came out.
+ */
+class Machine : public PinListener
+{
+public:
+    /** Blade positions, 0 at the bottom to 1 at the top */
+    static const double UPPER_LIMIT;
+    static const double LOWER_LIMIT;
+    static const double WIRE_HEIGHT;
+
+    typedef struct {
+        double position; // in of wire fed when the blade bottomed out
+        double angle;    // guide angle then
+        ns_t at;
+    } Stroke;
+
+    Machine();
+
+    /** Wire travel over wheel travel */
+    void slip(double slip) { _slip = slip; }
+
+    /** Time for the blade to cross its whole travel at full speed, takes effect at once */
+    void strokeTime(ns_t time);
+
+    /** Blade start position, before the firmware boots */
+    void blade(double y);
+
+    double wire() { return _wire; }
+    double blade();
+    double guide();
+    int32_t steps() { return _steps; }
+    uint32_t encoderEdges() { return _edges; }
+    const std::vector<Stroke> &strokes() { return _strokes; }
+
+    /** Lengths of the pieces cut off at the cut angle, the wire starting at the blade */
+    std::vector<double> pieces(double cutAngle);
+
+    /** Steps made while the blade was down in the wire */
+    uint32_t collisions() { return _collisions; }
+
+    /** Time the motor pushed the blade against either end stop */
+    ns_t stalled();
+
+    virtual void pinChanged(int pin, int level);
+    virtual void pwmChanged(int pin, ns_t period, ns_t pulse);
+
+private:
+    void step();
+    void encoderToggle();
+    void moveBlade();
+    void scheduleLimit();
+    void limitReached();
+    double velocity();
+
+    double _slip;
+    double _wire;
+    int32_t _steps;
+    int _divisor;
+    uint32_t _edges;
+    uint32_t _countsMade;
+    int _togglesOwed;
+    ns_t _strokeTime;
+    double _y;
+    ns_t _yAt;
+    double _duty;
+    double _v; // blade travel per ns
+    ns_t _stall;
+    double _target;
+    double _angle;
+    ns_t _angleAt;
+    uint32_t _collisions;
+    std::vector<Stroke> _strokes;
+    MemberEvent<Machine> _encoder;
+    MemberEvent<Machine> _limit;
+};
+
+/** Every model of the board */
+typedef struct {
+    SerialCapture *console;
+    SerialCapture *ble;
+    Display *display;
+    SdCard *sd;
+    Machine *machine;
+} Board;
+
+Board &board();
+
+} // namespace sim
+
+#endif
\ No newline at end of file
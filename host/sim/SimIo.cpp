@@ -0,0 +1,206 @@
+#include "SimIo.h"
+#include <string.h>
+
+namespace sim {
+
+const size_t UART_RX_FIFO = 16;
+
+Uart::Uart():_baud(9600),
+    _irq(0),
+    _device(0),
+    _rxIrq(false),
+    _txIrq(false),
+    _holdingFull(false),
+    _holding(0),
+    _shifting(false),
+    _shifter(0),
+    _overruns(0),
+    _sentBytes(0),
+    _shiftDone(this, &Uart::shifted),
+    _arrival(this, &Uart::arrived),
+    _txPending(this, &Uart::raiseTx),
+    _rxPending(this, &Uart::raiseRx)
+{
+}
+
+void Uart::baud(int rate)
+{
+    _baud = rate > 0 ? rate : 9600;
+}
+
+void Uart::putc(uint8_t byte)
+{
+    _holding = byte;
+    _holdingFull = true;
+    if (!_shifting) {
+        shifted();
+    }
+}
+
+int Uart::getc()
+{
+    if (_rx.empty()) {
+        return -1;
+    }
+    uint8_t byte = _rx.front();
+    _rx.pop_front();
+    return byte;
+}
+
+void Uart::enableTxIrq(bool on)
+{
+    _txIrq = on;
+}
+
+// The shifter finished a byte, or was idle: deliver it and load the next
+void Uart::shifted()
+{
+    if (_shifting) {
+        _shifting = false;
+        _sentBytes++;
+        if (_device) {
+            _device->received(_shifter);
+        }
+    }
+    if (_holdingFull) {
+        _shifter = _holding;
+        _holdingFull = false;
+        _shifting = true;
+        _shiftDone.after(byteTime());
+        if (!_txPending.pending()) {
+            _txPending.after(0); // THRE
+        }
+    }
+}
+
+void Uart::send(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++) {
+        _toBoard.push_back(data[i]);
+    }
+    if (!_arrival.pending() && !_toBoard.empty()) {
+        _arrival.after(byteTime());
+    }
+}
+
+void Uart::arrived()
+{
+    uint8_t byte = _toBoard.front();
+    _toBoard.pop_front();
+    if (_rx.size() < UART_RX_FIFO) {
+        _rx.push_back(byte);
+    } else {
+        _overruns++;
+    }
+    if (!_toBoard.empty()) {
+        _arrival.after(byteTime());
+    }
+    raiseRx();
+}
+
+void Uart::raiseTx()
+{
+    if (_txIrq && _irq) {
+        _irq->txIrq();
+    }
+}
+
+void Uart::raiseRx()
+{
+    if (_rxIrq && _irq && !_rx.empty()) {
+        _irq->rxIrq();
+    }
+}
+
+uint8_t SpiBus::write(uint8_t out)
+{
+    spin(8 * SECOND / _hz);
+    return _device ? _device->exchange(out) : 0xFF;
+}
+
+void SpiBus::block(const uint8_t *tx, int txLength, uint8_t *rx, int rxLength, uint8_t fill)
+{
+    int length = txLength > rxLength ? txLength : rxLength;
+    spin((ns_t)length * 8 * SECOND / _hz);
+    for (int i = 0; i < length; i++) {
+        uint8_t in = _device ? _device->exchange(i < txLength ? tx[i] : fill) : 0xFF;
+        if (i < rxLength) {
+            rx[i] = in;
+        }
+    }
+}
+
+Io::Io()
+{
+    for (int i = 0; i < PIN_TABLE; i++) {
+        _level[i] = 0;
+        _edges[i] = 0;
+        _uarts[i] = 0;
+        _buses[i] = 0;
+    }
+}
+
+void Io::drive(int pin, int level)
+{
+    if (pin < 0 || pin >= PIN_TABLE) {
+        return;
+    }
+    level = level ? 1 : 0;
+    bool changed = _level[pin] != level;
+    _level[pin] = level;
+    if (changed) {
+        for (size_t i = 0; i < _listeners[pin].size(); i++) {
+            _listeners[pin][i]->pinChanged(pin, level);
+        }
+    }
+}
+
+void Io::pwm(int pin, ns_t period, ns_t pulse)
+{
+    if (pin < 0 || pin >= PIN_TABLE) {
+        return;
+    }
+    for (size_t i = 0; i < _listeners[pin].size(); i++) {
+        _listeners[pin][i]->pwmChanged(pin, period, pulse);
+    }
+}
+
+void Io::input(int pin, int level)
+{
+    level = level ? 1 : 0;
+    if (_level[pin] == level) {
+        return;
+    }
+    _level[pin] = level;
+    if (_edges[pin]) {
+        _edges[pin]->edge(pin, level);
+    }
+}
+
+Uart &Io::uart(int tx)
+{
+    if (!_uarts[tx]) {
+        _uarts[tx] = new Uart;
+    }
+    return *_uarts[tx];
+}
+
+SpiBus &Io::spi(int mosi)
+{
+    if (!_buses[mosi]) {
+        _buses[mosi] = new SpiBus;
+    }
+    return *_buses[mosi];
+}
+
+Io &io()
+{
+    static Io *board = 0;
+    if (!board) {
+        board = new Io;
+        attachDevices(*board);
+    }
+    return *board;
+}
+
+} // namespace sim
\ No newline at end of file
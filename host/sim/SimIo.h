@@ -0,0 +1,187 @@
+#ifndef SIM_IO_H
+#define SIM_IO_H
+
+#include "SimKernel.h"
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+/** Pins, serial links and SPI buses between the firmware and the models
+ *
+ * The mbed shadow drives this side; the device models in SimBoard.cpp sit
+ * on the other. Inputs change only from events, so a pin interrupt never
+ * runs inside another handler.
+ */
+namespace sim {
+
+const int PIN_TABLE = 5 * 32;
+
+/** Told when the firmware writes an output pin */
+class PinListener
+{
+public:
+    virtual ~PinListener() {}
+    virtual void pinChanged(int pin, int level) {}
+    virtual void pwmChanged(int pin, ns_t period, ns_t pulse) {}
+};
+
+/** An interrupt on a pin edge, as InterruptIn takes */
+class EdgeListener
+{
+public:
+    virtual ~EdgeListener() {}
+    virtual void edge(int pin, int level) = 0;
+};
+
+/** The far end of a serial link */
+class UartDevice
+{
+public:
+    virtual ~UartDevice() {}
+
+    /** A byte finished arriving from the board */
+    virtual void received(uint8_t byte) = 0;
+};
+
+/** The interrupts of the board's UART */
+class UartIrq
+{
+public:
+    virtual ~UartIrq() {}
+    virtual void rxIrq() = 0;
+    virtual void txIrq() = 0;
+};
+
+/** An LPC1768 UART: a holding register ahead of the shifter for TX, a 16
+ *  byte FIFO for RX. Both directions take 10 bit times per byte.
+ */
+class Uart
+{
+public:
+    Uart();
+
+    // Board side
+    void baud(int rate);
+    int baud() { return _baud; }
+    bool writeable() { return !_holdingFull; }
+    void putc(uint8_t byte); // the holding register must be empty
+    bool readable() { return !_rx.empty(); }
+    int getc();
+    void attach(UartIrq *irq) { _irq = irq; }
+    void enableRxIrq(bool on) { _rxIrq = on; }
+    void enableTxIrq(bool on);
+
+    // Device side
+    void connect(UartDevice *device) { _device = device; }
+
+    /** Queue bytes towards the board, sent back to back at the link rate */
+    void send(const uint8_t *data, int length);
+    void send(uint8_t byte) { send(&byte, 1); }
+
+    /** Bytes still on their way to the board */
+    int sending() { return _toBoard.size(); }
+
+    ns_t byteTime() { return 10 * SECOND / _baud; }
+    uint32_t overruns() { return _overruns; }
+    uint32_t sent() { return _sentBytes; }
+
+private:
+    void shifted();
+    void arrived();
+    void raiseTx();
+    void raiseRx();
+
+    int _baud;
+    UartIrq *_irq;
+    UartDevice *_device;
+    bool _rxIrq;
+    bool _txIrq;
+    bool _holdingFull;
+    uint8_t _holding;
+    bool _shifting;
+    uint8_t _shifter;
+    std::deque<uint8_t> _rx;
+    std::deque<uint8_t> _toBoard;
+    uint32_t _overruns;
+    uint32_t _sentBytes;
+    MemberEvent<Uart> _shiftDone;
+    MemberEvent<Uart> _arrival;
+    MemberEvent<Uart> _txPending;
+    MemberEvent<Uart> _rxPending;
+};
+
+/** A device on an SPI bus, selected by its own chip select */
+class SpiDevice
+{
+public:
+    virtual ~SpiDevice() {}
+
+    /** Full duplex exchange of one byte while selected */
+    virtual uint8_t exchange(uint8_t out) = 0;
+};
+
+class SpiBus
+{
+public:
+    SpiBus():_hz(1000000),
+        _device(0)
+    {
+    }
+
+    void frequency(int hz) { _hz = hz; }
+    int frequency() { return _hz; }
+    void connect(SpiDevice *device) { _device = device; }
+
+    /** Exchange a byte at once, for transfers timed by the caller */
+    uint8_t exchange(uint8_t out) { return _device ? _device->exchange(out) : 0xFF; }
+
+    ns_t byteTime() { return 8 * SECOND / _hz; }
+
+    /** Exchange a byte, taking 8 clocks */
+    uint8_t write(uint8_t out);
+
+    /** Exchange a block, time taken once for the whole run */
+    void block(const uint8_t *tx, int txLength, uint8_t *rx, int rxLength, uint8_t fill);
+
+private:
+    int _hz;
+    SpiDevice *_device;
+};
+
+class Io
+{
+public:
+    Io();
+
+    int level(int pin) { return _level[pin]; }
+
+    /** Written by the firmware */
+    void drive(int pin, int level);
+    void pwm(int pin, ns_t period, ns_t pulse);
+
+    /** Driven by a device model, from an event */
+    void input(int pin, int level);
+
+    void watch(int pin, PinListener *listener) { _listeners[pin].push_back(listener); }
+    void listenEdges(int pin, EdgeListener *listener) { _edges[pin] = listener; }
+
+    Uart &uart(int tx);
+    SpiBus &spi(int mosi);
+
+private:
+    int _level[PIN_TABLE];
+    std::vector<PinListener *> _listeners[PIN_TABLE];
+    EdgeListener *_edges[PIN_TABLE];
+    Uart *_uarts[PIN_TABLE];
+    SpiBus *_buses[PIN_TABLE];
+};
+
+/** The board, with every device of SimBoard.cpp attached on first use */
+Io &io();
+
+/** Attach the device models, called once by io() */
+void attachDevices(Io &io);
+
+} // namespace sim
+
+#endif
\ No newline at end of file
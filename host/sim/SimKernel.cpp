@@ -0,0 +1,460 @@
+#include "SimKernel.h"
+#include <ucontext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <deque>
+
+namespace sim {
+
+const size_t THREAD_STACK_SIZE = 256 * 1024; // host frames are far bigger than on the board
+const int PRIORITIES = 7;                    // osPriorityIdle (-3) to osPriorityRealtime (+3)
+
+enum ThreadState {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,
+    THREAD_DONE
+};
+
+class TimeoutEvent : public Event
+{
+public:
+    SimThread *thread;
+
+protected:
+    virtual void fire();
+};
+
+class SimThread
+{
+public:
+    ucontext_t context;
+    char *stack;
+    int priority;
+    ThreadState state;
+    void (*entry)(void *);
+    void *arg;
+    const char *name;
+    bool timedOut;
+    int32_t signals;
+    int32_t waitSignals;
+    void *waitObject;
+    TimeoutEvent timeout;
+};
+
+class Kernel
+{
+public:
+    Kernel():_now(0),
+        _seq(0),
+        _isr(0),
+        _events(0),
+        _switches(0)
+    {
+        _main.stack = NULL;
+        _main.priority = 0;
+        _main.state = THREAD_RUNNING;
+        _main.entry = NULL;
+        _main.arg = NULL;
+        _main.name = "main";
+        _main.timedOut = false;
+        _main.signals = 0;
+        _main.waitSignals = 0;
+        _main.waitObject = NULL;
+        _main.timeout.thread = &_main;
+        _current = &_main;
+    }
+
+    void schedule(Event *e, ns_t when)
+    {
+        if (e->_slot >= 0) {
+            unlink(e);
+        }
+        e->_when = when < _now ? _now : when;
+        e->_seq = _seq++;
+        e->_slot = _heap.size();
+        _heap.push_back(e);
+        up(e->_slot);
+    }
+
+    void unlink(Event *e)
+    {
+        int slot = e->_slot;
+        Event *last = _heap.back();
+        _heap.pop_back();
+        e->_slot = -1;
+        if (last != e) {
+            _heap[slot] = last;
+            last->_slot = slot;
+            up(slot);
+            down(last->_slot);
+        }
+    }
+
+    // Fires the earliest event, whatever thread's stack we are on
+    void fireNext()
+    {
+        Event *e = _heap.front();
+        unlink(e);
+        if (e->_when > _now) {
+            _now = e->_when;
+        }
+        _isr++;
+        _events++;
+        e->fire();
+        _isr--;
+    }
+
+    SimThread *highest()
+    {
+        for (int p = PRIORITIES - 1; p >= 0; p--) {
+            if (!_ready[p].empty()) {
+                return _ready[p].front();
+            }
+        }
+        return NULL;
+    }
+
+    void makeReady(SimThread *t, bool front)
+    {
+        t->state = THREAD_READY;
+        if (front) {
+            _ready[t->priority + 3].push_front(t);
+        } else {
+            _ready[t->priority + 3].push_back(t);
+        }
+    }
+
+    void switchTo(SimThread *t)
+    {
+        _ready[t->priority + 3].pop_front();
+        t->state = THREAD_RUNNING;
+        if (t == _current) {
+            return;
+        }
+        SimThread *from = _current;
+        _current = t;
+        _switches++;
+        swapcontext(&from->context, &t->context);
+    }
+
+    // The current thread gave up the CPU: run whatever is ready, or let
+    // time pass until an event readies something
+    void reschedule()
+    {
+        while (true) {
+            SimThread *t = highest();
+            if (t) {
+                switchTo(t);
+                return;
+            }
+            if (_heap.empty()) {
+                fprintf(stderr, "sim: deadlock at %.6f s, every thread is blocked and nothing is scheduled\n", _now / 1e9);
+                exit(2);
+            }
+            fireNext();
+        }
+    }
+
+    void preemptIfOutranked()
+    {
+        SimThread *t = highest();
+        if (t && t->priority > _current->priority && !_isr) {
+            makeReady(_current, true);
+            switchTo(t);
+        }
+    }
+
+    void spin(ns_t time)
+    {
+        ns_t target = _now + time;
+        // Inside an interrupt the events due still fire, as nested interrupts
+        while (!_heap.empty() && _heap.front()->_when <= target) {
+            fireNext();
+            preemptIfOutranked();
+        }
+        if (_now < target) {
+            _now = target;
+        }
+    }
+
+    void idle()
+    {
+        if (_isr) {
+            return;
+        }
+        if (_heap.empty()) {
+            fprintf(stderr, "sim: sleep() at %.6f s with nothing scheduled to wake it\n", _now / 1e9);
+            exit(2);
+        }
+        fireNext();
+        preemptIfOutranked();
+    }
+
+    bool block(ns_t timeout)
+    {
+        if (_isr) {
+            fprintf(stderr, "sim: blocking wait from interrupt context\n");
+            exit(2);
+        }
+        SimThread *t = _current;
+        t->state = THREAD_BLOCKED;
+        t->timedOut = false;
+        if (timeout != FOREVER) {
+            schedule(&t->timeout, _now + timeout);
+        }
+        reschedule();
+        return !t->timedOut;
+    }
+
+    void wake(SimThread *t)
+    {
+        if (t->state != THREAD_BLOCKED) {
+            return;
+        }
+        if (t->timeout.pending()) {
+            unlink(&t->timeout);
+        }
+        makeReady(t, false);
+        preemptIfOutranked();
+    }
+
+    static void trampoline();
+
+    ns_t _now;
+    uint64_t _seq;
+    int _isr;
+    uint64_t _events;
+    uint64_t _switches;
+    std::vector<Event *> _heap; // binary heap on (when, seq), each event knows its slot
+    std::deque<SimThread *> _ready[PRIORITIES];
+    SimThread _main;
+    SimThread *_current;
+
+private:
+    static bool before(const Event *a, const Event *b)
+    {
+        return a->_when < b->_when || (a->_when == b->_when && a->_seq < b->_seq);
+    }
+
+    void place(int slot, Event *e)
+    {
+        _heap[slot] = e;
+        e->_slot = slot;
+    }
+
+    void up(int slot)
+    {
+        Event *e = _heap[slot];
+        while (slot > 0) {
+            int parent = (slot - 1) / 2;
+            if (!before(e, _heap[parent])) {
+                break;
+            }
+            place(slot, _heap[parent]);
+            slot = parent;
+        }
+        place(slot, e);
+    }
+
+    void down(int slot)
+    {
+        Event *e = _heap[slot];
+        int n = _heap.size();
+        while (true) {
+            int child = 2 * slot + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n && before(_heap[child + 1], _heap[child])) {
+                child++;
+            }
+            if (!before(_heap[child], e)) {
+                break;
+            }
+            place(slot, _heap[child]);
+            slot = child;
+        }
+        place(slot, e);
+    }
+};
+
+// Constructed on first use, so drivers built by static constructors can
+// schedule, and never destroyed, so events in static objects can outlive it
+static Kernel &kernel()
+{
+    static Kernel *k = new Kernel;
+    return *k;
+}
+
+void TimeoutEvent::fire()
+{
+    thread->timedOut = true;
+    kernel().wake(thread);
+}
+
+void Kernel::trampoline()
+{
+    SimThread *t = kernel()._current;
+    t->entry(t->arg);
+    t->state = THREAD_DONE;
+    kernel().reschedule();
+}
+
+Event::Event():_when(0),
+    _seq(0),
+    _slot(-1)
+{
+}
+
+Event::~Event()
+{
+    cancel();
+}
+
+void Event::at(ns_t when)
+{
+    kernel().schedule(this, when);
+}
+
+void Event::after(ns_t delay)
+{
+    kernel().schedule(this, kernel()._now + delay);
+}
+
+void Event::cancel()
+{
+    if (_slot >= 0) {
+        kernel().unlink(this);
+    }
+}
+
+ns_t now()
+{
+    return kernel()._now;
+}
+
+void spin(ns_t time)
+{
+    kernel().spin(time);
+}
+
+void idle()
+{
+    kernel().idle();
+}
+
+bool inIsr()
+{
+    return kernel()._isr > 0;
+}
+
+uint64_t events()
+{
+    return kernel()._events;
+}
+
+uint64_t switches()
+{
+    return kernel()._switches;
+}
+
+void exit(int status)
+{
+    fflush(stdout);
+    fflush(stderr);
+    _exit(status);
+}
+
+SimThread *current()
+{
+    return kernel()._current;
+}
+
+SimThread *createThread(void (*entry)(void *), void *arg, int priority, const char *name)
+{
+    SimThread *t = new SimThread;
+    t->stack = new char[THREAD_STACK_SIZE];
+    t->priority = priority;
+    t->entry = entry;
+    t->arg = arg;
+    t->name = name;
+    t->timedOut = false;
+    t->signals = 0;
+    t->waitSignals = 0;
+    t->waitObject = NULL;
+    t->timeout.thread = t;
+    getcontext(&t->context);
+    t->context.uc_stack.ss_sp = t->stack;
+    t->context.uc_stack.ss_size = THREAD_STACK_SIZE;
+    t->context.uc_link = NULL;
+    makecontext(&t->context, &Kernel::trampoline, 0);
+    kernel().makeReady(t, false);
+    kernel().preemptIfOutranked();
+    return t;
+}
+
+void setPriority(SimThread *t, int priority)
+{
+    Kernel &k = kernel();
+    if (t->state == THREAD_READY) {
+        std::deque<SimThread *> &level = k._ready[t->priority + 3];
+        for (size_t i = 0; i < level.size(); i++) {
+            if (level[i] == t) {
+                level.erase(level.begin() + i);
+                break;
+            }
+        }
+        t->priority = priority;
+        k.makeReady(t, false);
+    } else {
+        t->priority = priority;
+    }
+    k.preemptIfOutranked();
+}
+
+int priority(SimThread *t)
+{
+    return t->priority;
+}
+
+bool finished(SimThread *t)
+{
+    return t->state == THREAD_DONE;
+}
+
+bool block(ns_t timeout)
+{
+    return kernel().block(timeout);
+}
+
+void wake(SimThread *t)
+{
+    kernel().wake(t);
+}
+
+void yield()
+{
+    Kernel &k = kernel();
+    k.makeReady(k._current, false);
+    k.reschedule();
+}
+
+int32_t &threadSignals(SimThread *t)
+{
+    return t->signals;
+}
+
+int32_t &threadWaitSignals(SimThread *t)
+{
+    return t->waitSignals;
+}
+
+void *&threadWaitObject(SimThread *t)
+{
+    return t->waitObject;
+}
+
+} // namespace sim
\ No newline at end of file
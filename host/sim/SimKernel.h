@@ -0,0 +1,127 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Virtual time kernel of the host build
+ *
+ * The firmware runs on one host thread. Its rtos threads are ucontext
+ * coroutines switched by priority, and everything the hardware would do on
+ * its own (timers, UART shifters, SPI, the machine) is an event on a single
+ * virtual clock. Time only moves when every thread is blocked or a thread
+ * busy-waits, so an hour of cutting runs in seconds and every run of a test
+ * is the same.
+ *
+ * Events fire in interrupt context: they may wake threads but never block.
+ */
+namespace sim {
+
+typedef uint64_t ns_t;
+
+const ns_t FOREVER = ~(ns_t)0;
+const ns_t US = 1000;
+const ns_t MS = 1000000;
+const ns_t SECOND = 1000000000;
+
+/** Something that happens at a point of virtual time */
+class Event
+{
+public:
+    Event();
+    virtual ~Event();
+
+    /** Fire at an absolute time, moving the event if it was already pending */
+    void at(ns_t when);
+
+    /** Fire after a delay from now */
+    void after(ns_t delay);
+
+    void cancel();
+
+    bool pending() const { return _slot >= 0; }
+    ns_t when() const { return _when; }
+
+protected:
+    /** Called in interrupt context once the time comes */
+    virtual void fire() = 0;
+
+private:
+    friend class Kernel;
+    ns_t _when;
+    uint64_t _seq;
+    int _slot;
+};
+
+/** An event calling a member function */
+template<typename T>
+class MemberEvent : public Event
+{
+public:
+    MemberEvent(T *obj, void (T::*method)()):_obj(obj),
+        _method(method)
+    {
+    }
+
+protected:
+    virtual void fire() { (_obj->*_method)(); }
+
+private:
+    T *_obj;
+    void (T::*_method)();
+};
+
+class SimThread;
+
+/** Virtual now */
+ns_t now();
+
+/** Busy-wait: time passes and events fire, the calling thread keeps the CPU
+ *  unless an event readies a higher priority thread
+ */
+void spin(ns_t time);
+
+/** Let time pass until the next event, as the idle thread would */
+void idle();
+
+/** True while an event is firing */
+bool inIsr();
+
+/** Events fired since boot */
+uint64_t events();
+
+/** Context switches since boot */
+uint64_t switches();
+
+/** Flush stdout and end the process, from any thread */
+__attribute__((noreturn)) void exit(int status);
+
+/** Thread plumbing for the rtos shadow */
+SimThread *current();
+SimThread *createThread(void (*entry)(void *), void *arg, int priority, const char *name);
+void setPriority(SimThread *t, int priority);
+int priority(SimThread *t);
+bool finished(SimThread *t);
+
+/** Block the current thread until woken or the timeout passes
+ *
+ * @returns false on timeout
+ */
+bool block(ns_t timeout);
+
+/** Make a blocked thread ready, switching to it at once from thread context
+ *  if it outranks the caller
+ */
+void wake(SimThread *t);
+
+/** Put the current thread behind the others of its priority */
+void yield();
+
+/** Per-thread words the rtos shadow keeps its wait state in */
+int32_t &threadSignals(SimThread *t);
+int32_t &threadWaitSignals(SimThread *t);
+void *&threadWaitObject(SimThread *t);
+
+} // namespace sim
+
+#endif
\ No newline at end of file
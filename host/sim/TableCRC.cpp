@@ -0,0 +1,63 @@
+#include "TableCRC.h"
+
+namespace mbed {
+
+namespace {
+
+// CRC7 of the SD card, poly 0x09, kept shifted up by one as mbed stores it
+struct Crc7
+{
+    uint8_t v[MBED_CRC_TABLE_SIZE];
+    constexpr Crc7():v()
+    {
+        for (int i = 0; i < MBED_CRC_TABLE_SIZE; i++) {
+            uint8_t crc = i;
+            for (int b = 0; b < 8; b++) {
+                crc = (crc & 0x80) ? (crc << 1) ^ (0x09 << 1) : crc << 1;
+            }
+            v[i] = crc;
+        }
+    }
+};
+
+struct Crc16
+{
+    uint16_t v[MBED_CRC_TABLE_SIZE];
+    constexpr Crc16():v()
+    {
+        for (int i = 0; i < MBED_CRC_TABLE_SIZE; i++) {
+            uint16_t crc = i << 8;
+            for (int b = 0; b < 8; b++) {
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+            v[i] = crc;
+        }
+    }
+};
+
+struct Crc32
+{
+    uint32_t v[MBED_CRC_TABLE_SIZE];
+    constexpr Crc32():v()
+    {
+        for (int i = 0; i < MBED_CRC_TABLE_SIZE; i++) {
+            uint32_t crc = (uint32_t)i << 24;
+            for (int b = 0; b < 8; b++) {
+                crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04C11DB7u : crc << 1;
+            }
+            v[i] = crc;
+        }
+    }
+};
+
+constexpr Crc7 crc7;
+constexpr Crc16 crc16;
+constexpr Crc32 crc32;
+
+}
+
+const uint8_t (&Table_CRC_7Bit_SD)[MBED_CRC_TABLE_SIZE] = crc7.v;
+const uint16_t (&Table_CRC_16bit_CCITT)[MBED_CRC_TABLE_SIZE] = crc16.v;
+const uint32_t (&Table_CRC_32bit_ANSI)[MBED_CRC_TABLE_SIZE] = crc32.v;
+
+} // namespace mbed
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef TABLE_CRC_H
+#define TABLE_CRC_H
+
+#include <stdint.h>
+
+/** The MSB first CRC tables of mbed's TableCRC.h, filled in by TableCRC.cpp
+ *  from their polynomials
+ */
+namespace mbed {
+
+#define MBED_CRC_TABLE_SIZE 256
+
+extern const uint8_t (&Table_CRC_7Bit_SD)[MBED_CRC_TABLE_SIZE];
+extern const uint16_t (&Table_CRC_16bit_CCITT)[MBED_CRC_TABLE_SIZE];
+extern const uint32_t (&Table_CRC_32bit_ANSI)[MBED_CRC_TABLE_SIZE];
+
+} // namespace mbed
+
+using namespace mbed;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,563 @@
+#include "mbed.h"
+
+static SimDwt dwt;
+static SimCoreDebug coreDebug;
+SimDwt *const DWT = &dwt;
+SimCoreDebug *const CoreDebug = &coreDebug;
+uint32_t SystemCoreClock = 96000000;
+
+extern "C" void error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\nsim: error() at %.6f s\n", sim::now() / 1e9);
+    sim::exit(1);
+}
+
+extern "C" void wait(float s)
+{
+    sim::spin((sim::ns_t)(s * 1e9f));
+}
+
+// wait_ms(0) still takes a moment, so polling loops on it make progress
+extern "C" void wait_ms(int ms)
+{
+    sim::spin(ms > 0 ? ms * sim::MS : sim::US);
+}
+
+extern "C" void wait_us(int us)
+{
+    sim::spin(us > 0 ? us * sim::US : sim::US);
+}
+
+extern "C" void sleep(void)
+{
+    sim::idle();
+}
+
+extern "C" uint32_t us_ticker_read(void)
+{
+    return (uint32_t)(sim::now() / sim::US);
+}
+
+// Nothing preempts code that does not wait, so there is nothing to mask
+extern "C" void core_util_critical_section_enter(void)
+{
+}
+
+extern "C" void core_util_critical_section_exit(void)
+{
+}
+
+void gpio_init_in_ex(gpio_t *gpio, PinName pin, PinMode mode)
+{
+    gpio->pin = pin;
+}
+
+namespace mbed {
+
+static const ticker_data_t usTicker = {0};
+
+const ticker_data_t *get_us_ticker_data(void)
+{
+    return &usTicker;
+}
+
+us_timestamp_t ticker_read_us(const ticker_data_t *const ticker)
+{
+    return sim::now() / sim::US;
+}
+
+DigitalOut::DigitalOut(PinName pin, int value):_pin(pin)
+{
+    write(value);
+}
+
+void DigitalOut::write(int value)
+{
+    if (_pin != NC) {
+        sim::io().drive(_pin, value);
+    }
+}
+
+int DigitalOut::read()
+{
+    return _pin != NC ? sim::io().level(_pin) : 0;
+}
+
+DigitalIn::DigitalIn(PinName pin, PinMode mode):_pin(pin)
+{
+}
+
+int DigitalIn::read()
+{
+    return _pin != NC ? sim::io().level(_pin) : 0;
+}
+
+void DigitalIn::mode(PinMode pull)
+{
+}
+
+BusOut::BusOut(PinName p0, PinName p1, PinName p2, PinName p3,
+               PinName p4, PinName p5, PinName p6, PinName p7,
+               PinName p8, PinName p9, PinName p10, PinName p11,
+               PinName p12, PinName p13, PinName p14, PinName p15):_value(0)
+{
+    PinName pins[16] = {p0, p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15};
+    for (int i = 0; i < 16; i++) {
+        _pins[i] = pins[i];
+    }
+}
+
+void BusOut::write(int value)
+{
+    _value = value;
+    for (int i = 0; i < 16; i++) {
+        if (_pins[i] != NC) {
+            sim::io().drive(_pins[i], (value >> i) & 1);
+        }
+    }
+}
+
+int BusOut::read()
+{
+    return _value;
+}
+
+PortIn::PortIn(PortName port, int mask):_port(port),
+    _mask(mask)
+{
+}
+
+int PortIn::read()
+{
+    sim::Io &io = sim::io();
+    uint32_t value = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        if ((_mask >> bit) & 1) {
+            value |= (uint32_t)io.level(_port * 32 + bit) << bit;
+        }
+    }
+    return value;
+}
+
+PwmOut::PwmOut(PinName pin):_pin(pin),
+    _period(20 * sim::MS),
+    _pulse(0)
+{
+    update();
+}
+
+void PwmOut::write(float value)
+{
+    if (value < 0) {
+        value = 0;
+    } else if (value > 1) {
+        value = 1;
+    }
+    _pulse = (sim::ns_t)(_period * value);
+    update();
+}
+
+float PwmOut::read()
+{
+    return _period ? (float)_pulse / _period : 0;
+}
+
+// The duty cycle is kept, as on the LPC1768
+void PwmOut::period(float seconds)
+{
+    float duty = read();
+    _period = (sim::ns_t)(seconds * 1e9);
+    write(duty);
+}
+
+void PwmOut::period_ms(int ms)
+{
+    period(ms / 1000.0f);
+}
+
+void PwmOut::period_us(int us)
+{
+    period(us / 1000000.0f);
+}
+
+void PwmOut::pulsewidth(float seconds)
+{
+    _pulse = (sim::ns_t)(seconds * 1e9);
+    if (_pulse > _period) {
+        _pulse = _period;
+    }
+    update();
+}
+
+void PwmOut::pulsewidth_ms(int ms)
+{
+    pulsewidth(ms / 1000.0f);
+}
+
+void PwmOut::pulsewidth_us(int us)
+{
+    pulsewidth(us / 1000000.0f);
+}
+
+void PwmOut::update()
+{
+    sim::io().pwm(_pin, _period, _pulse);
+}
+
+InterruptIn::InterruptIn(PinName pin, PinMode mode):_pin(pin),
+    _enabled(true)
+{
+    sim::io().listenEdges(_pin, this);
+}
+
+InterruptIn::~InterruptIn()
+{
+    sim::io().listenEdges(_pin, 0);
+}
+
+int InterruptIn::read()
+{
+    return sim::io().level(_pin);
+}
+
+void InterruptIn::rise(Callback<void()> func)
+{
+    _rise = func;
+}
+
+void InterruptIn::fall(Callback<void()> func)
+{
+    _fall = func;
+}
+
+void InterruptIn::edge(int pin, int level)
+{
+    if (!_enabled) {
+        return;
+    }
+    if (level && _rise) {
+        _rise.call();
+    } else if (!level && _fall) {
+        _fall.call();
+    }
+}
+
+TimerEvent::TimerEvent():_ticker_data(get_us_ticker_data())
+{
+    memset(&event, 0, sizeof(event));
+    _fire.owner = this;
+}
+
+TimerEvent::~TimerEvent()
+{
+    remove();
+}
+
+// A 32 bit timestamp is taken as the nearest time with those low bits
+void TimerEvent::insert(timestamp_t timestamp)
+{
+    us_timestamp_t now = ticker_read_us(_ticker_data);
+    us_timestamp_t absolute = (now & ~(us_timestamp_t)0xFFFFFFFF) | timestamp;
+    if (absolute + 0x80000000ULL < now) {
+        absolute += 0x100000000ULL;
+    }
+    insert_absolute(absolute);
+}
+
+// A time already past fires at once, the timestamp is kept for rescheduling
+void TimerEvent::insert_absolute(us_timestamp_t timestamp)
+{
+    event.timestamp = timestamp;
+    _fire.at(timestamp * sim::US);
+}
+
+void TimerEvent::remove()
+{
+    _fire.cancel();
+}
+
+void Ticker::attach_us(Callback<void()> func, us_timestamp_t t)
+{
+    _function = func;
+    _delay = t;
+    insert_absolute(ticker_read_us(_ticker_data) + t);
+}
+
+void Ticker::detach()
+{
+    remove();
+    _function = Callback<void()>();
+}
+
+void Ticker::handler()
+{
+    insert_absolute(event.timestamp + _delay);
+    if (_function) {
+        _function.call();
+    }
+}
+
+void Timeout::handler()
+{
+    Callback<void()> local = _function;
+    detach();
+    if (local) {
+        local.call();
+    }
+}
+
+Timer::Timer():_running(false),
+    _start(0),
+    _time(0)
+{
+}
+
+void Timer::start()
+{
+    if (!_running) {
+        _start = ticker_read_us(get_us_ticker_data());
+        _running = true;
+    }
+}
+
+void Timer::stop()
+{
+    _time = elapsed();
+    _running = false;
+}
+
+void Timer::reset()
+{
+    _start = ticker_read_us(get_us_ticker_data());
+    _time = 0;
+}
+
+us_timestamp_t Timer::elapsed()
+{
+    if (!_running) {
+        return _time;
+    }
+    return _time + ticker_read_us(get_us_ticker_data()) - _start;
+}
+
+float Timer::read()
+{
+    return elapsed() / 1000000.0f;
+}
+
+int Timer::read_ms()
+{
+    return elapsed() / 1000;
+}
+
+int Timer::read_us()
+{
+    return elapsed();
+}
+
+us_timestamp_t Timer::read_high_resolution_us()
+{
+    return elapsed();
+}
+
+int Stream::puts(const char *s)
+{
+    int n = 0;
+    while (s[n]) {
+        _putc(s[n++]);
+    }
+    return n;
+}
+
+int Stream::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+int Stream::vprintf(const char *format, va_list args)
+{
+    char buffer[512];
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    for (int i = 0; i < n && i < (int)sizeof(buffer) - 1; i++) {
+        _putc(buffer[i]);
+    }
+    return n;
+}
+
+SerialBase::SerialBase(PinName tx, PinName rx, int baud):_uart(sim::io().uart(tx))
+{
+    _uart.baud(baud);
+    _uart.attach(this);
+}
+
+void SerialBase::baud(int baudrate)
+{
+    _uart.baud(baudrate);
+}
+
+int SerialBase::readable()
+{
+    return _uart.readable();
+}
+
+int SerialBase::writeable()
+{
+    return _uart.writeable();
+}
+
+void SerialBase::attach(Callback<void()> func, IrqType type)
+{
+    _irq[type] = func;
+    if (type == RxIrq) {
+        _uart.enableRxIrq(func);
+    } else {
+        _uart.enableTxIrq(func);
+    }
+}
+
+void SerialBase::rxIrq()
+{
+    if (_irq[RxIrq]) {
+        _irq[RxIrq].call();
+    }
+}
+
+void SerialBase::txIrq()
+{
+    if (_irq[TxIrq]) {
+        _irq[TxIrq].call();
+    }
+}
+
+// Polls like the board does, the UART keeps shifting meanwhile
+int SerialBase::_base_getc()
+{
+    while (!_uart.readable()) {
+        sim::spin(_uart.byteTime());
+    }
+    return _uart.getc();
+}
+
+int SerialBase::_base_putc(int c)
+{
+    while (!_uart.writeable()) {
+        sim::spin(_uart.byteTime() / 10);
+    }
+    _uart.putc(c);
+    return c;
+}
+
+RawSerial::RawSerial(PinName tx, PinName rx, int baud):SerialBase(tx, rx, baud)
+{
+}
+
+int RawSerial::getc()
+{
+    return _base_getc();
+}
+
+int RawSerial::putc(int c)
+{
+    return _base_putc(c);
+}
+
+int RawSerial::puts(const char *str)
+{
+    while (*str) {
+        putc(*str++);
+    }
+    return 0;
+}
+
+int RawSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+int RawSerial::vprintf(const char *format, va_list arg)
+{
+    char buffer[512];
+    int n = vsnprintf(buffer, sizeof(buffer), format, arg);
+    for (int i = 0; i < n && i < (int)sizeof(buffer) - 1; i++) {
+        putc(buffer[i]);
+    }
+    return n;
+}
+
+SPI::SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel):_bus(sim::io().spi(mosi)),
+    _fill(0xFF),
+    _tx(0),
+    _txLength(0),
+    _rx(0),
+    _rxLength(0),
+    _event(0),
+    _done(this, &SPI::transferDone)
+{
+}
+
+void SPI::frequency(int hz)
+{
+    _bus.frequency(hz);
+}
+
+int SPI::write(int value)
+{
+    return _bus.write(value);
+}
+
+int SPI::write(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length)
+{
+    _bus.block((const uint8_t *)tx_buffer, tx_length, (uint8_t *)rx_buffer, rx_length, _fill);
+    return tx_length > rx_length ? tx_length : rx_length;
+}
+
+int SPI::start_transfer(const uint8_t *tx, int txLength, uint8_t *rx, int rxLength,
+                        const event_callback_t &callback, int event)
+{
+    if (_done.pending()) {
+        return -1;
+    }
+    _tx = tx;
+    _txLength = txLength;
+    _rx = rx;
+    _rxLength = rxLength;
+    _callback = callback;
+    _event = event;
+    int length = txLength > rxLength ? txLength : rxLength;
+    _done.after(length * _bus.byteTime());
+    return 0;
+}
+
+// The DMA finished: the bytes are exchanged now, then the event is raised
+void SPI::transferDone()
+{
+    int length = _txLength > _rxLength ? _txLength : _rxLength;
+    for (int i = 0; i < length; i++) {
+        uint8_t in = _bus.exchange(i < _txLength ? _tx[i] : _fill);
+        if (i < _rxLength) {
+            _rx[i] = in;
+        }
+    }
+    if (_callback && (_event & SPI_EVENT_COMPLETE)) {
+        _callback.call(SPI_EVENT_COMPLETE);
+    }
+}
+
+void SPI::abort_transfer()
+{
+    _done.cancel();
+}
+
+} // namespace mbed
\ No newline at end of file
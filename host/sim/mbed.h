@@ -0,0 +1,505 @@
+#ifndef MBED_H
+#define MBED_H
+
+/** mbed 2 shadow of the host build
+ *
+ * Only the API the firmware uses, with the same names and signatures, over
+ * the virtual clock and pin table of SimKernel.h and SimIo.h.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <functional>
+
+#include "PinNames.h"
+#include "SimKernel.h"
+#include "SimIo.h"
+
+#define MBED_LIBRARY_VERSION 165
+#define DEVICE_SERIAL 1
+#define DEVICE_SPI 1
+#define DEVICE_INTERRUPTIN 1
+#define DEVICE_PWMOUT 1
+#define DEVICE_PORTIN 1
+#define DEVICE_SPI_ASYNCH 1 // so the host build runs the DMA path of the drivers
+
+#define MBED_UNUSED __attribute__((unused))
+#define MBED_FORCEINLINE static inline __attribute__((always_inline))
+#define MBED_PRINTF_METHOD(format_index, first_param_index) \
+    __attribute__((format(printf, format_index + 1, first_param_index == 0 ? 0 : first_param_index + 1)))
+
+extern "C" {
+void error(const char *format, ...) __attribute__((noreturn, format(printf, 1, 2)));
+void wait(float s);
+void wait_ms(int ms);
+void wait_us(int us);
+void sleep(void);
+uint32_t us_ticker_read(void);
+void core_util_critical_section_enter(void);
+void core_util_critical_section_exit(void);
+}
+
+inline void __disable_irq() {}
+inline void __enable_irq() {}
+inline void __DMB() {}
+inline void __DSB() {}
+inline void __ISB() {}
+inline uint32_t __CLZ(uint32_t value) { return value ? __builtin_clz(value) : 32; }
+
+// One core, no interrupt between the two: the store always succeeds
+inline uint32_t __LDREXW(volatile uint32_t *addr) { return *addr; }
+inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) { *addr = value; return 0; }
+
+/** Cycle counter at the board's 96 MHz, read from the virtual clock */
+struct SimDwt {
+    uint32_t CTRL;
+    struct Cycles {
+        operator uint32_t() const { return (uint32_t)(sim::now() * 96 / 1000); }
+    } CYCCNT;
+};
+struct SimCoreDebug {
+    uint32_t DEMCR;
+};
+extern SimDwt *const DWT;
+extern SimCoreDebug *const CoreDebug;
+#define DWT_CTRL_CYCCNTENA_Msk (1UL)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+extern uint32_t SystemCoreClock;
+
+typedef struct {
+    PinName pin;
+} gpio_t;
+void gpio_init_in_ex(gpio_t *gpio, PinName pin, PinMode mode);
+
+namespace mbed {
+
+/** Callback to a function or a member function, copied by value */
+template<typename F>
+class Callback;
+
+template<typename R, typename... Args>
+class Callback<R(Args...)>
+{
+public:
+    Callback(R (*func)(Args...) = 0)
+    {
+        if (func) {
+            _f = func;
+        }
+    }
+
+    template<typename T, typename U>
+    Callback(U *obj, R (T::*method)(Args...))
+    {
+        _f = [obj, method](Args... args) { return (obj->*method)(args...); };
+    }
+
+    template<typename T, typename U>
+    Callback(const U *obj, R (T::*method)(Args...) const)
+    {
+        _f = [obj, method](Args... args) { return (obj->*method)(args...); };
+    }
+
+    template<typename T, typename U>
+    Callback(U *obj, R (*func)(T *, Args...))
+    {
+        _f = [obj, func](Args... args) { return func(obj, args...); };
+    }
+
+    void attach(const Callback &func) { _f = func._f; }
+
+    R call(Args... args) const { return _f(args...); }
+    R operator()(Args... args) const { return _f(args...); }
+    operator bool() const { return (bool)_f; }
+
+private:
+    std::function<R(Args...)> _f;
+};
+
+template<typename R, typename... Args>
+Callback<R(Args...)> callback(R (*func)(Args...) = 0)
+{
+    return Callback<R(Args...)>(func);
+}
+
+template<typename R, typename... Args>
+Callback<R(Args...)> callback(const Callback<R(Args...)> &func)
+{
+    return func;
+}
+
+template<typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U *obj, R (T::*method)(Args...))
+{
+    return Callback<R(Args...)>(obj, method);
+}
+
+template<typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(const U *obj, R (T::*method)(Args...) const)
+{
+    return Callback<R(Args...)>(obj, method);
+}
+
+template<typename T, typename U, typename R, typename... Args>
+Callback<R(Args...)> callback(U *obj, R (*func)(T *, Args...))
+{
+    return Callback<R(Args...)>(obj, func);
+}
+
+/** The old attach/call interface */
+class FunctionPointer : public Callback<void()>
+{
+public:
+    FunctionPointer(void (*function)() = 0):Callback<void()>(function)
+    {
+    }
+
+    void attach(void (*function)()) { Callback<void()>::attach(Callback<void()>(function)); }
+
+    template<typename T>
+    void attach(T *object, void (T::*member)()) { Callback<void()>::attach(Callback<void()>(object, member)); }
+
+    void call() const
+    {
+        if (*this) {
+            Callback<void()>::call();
+        }
+    }
+};
+
+typedef Callback<void(int)> event_callback_t;
+#define SPI_EVENT_ERROR (1 << 1)
+#define SPI_EVENT_COMPLETE (1 << 2)
+#define SPI_EVENT_RX_OVERFLOW (1 << 3)
+#define SPI_EVENT_ALL (SPI_EVENT_ERROR | SPI_EVENT_COMPLETE | SPI_EVENT_RX_OVERFLOW)
+
+typedef uint32_t timestamp_t;
+typedef uint64_t us_timestamp_t;
+
+typedef struct ticker_event_s {
+    us_timestamp_t timestamp;
+    uint32_t id;
+    struct ticker_event_s *next;
+} ticker_event_t;
+
+typedef struct {
+    int unused;
+} ticker_data_t;
+
+const ticker_data_t *get_us_ticker_data(void);
+us_timestamp_t ticker_read_us(const ticker_data_t *const ticker);
+
+class DigitalOut
+{
+public:
+    DigitalOut(PinName pin, int value = 0);
+    void write(int value);
+    int read();
+    int is_connected() { return _pin != NC; }
+    DigitalOut &operator=(int value)
+    {
+        write(value);
+        return *this;
+    }
+    DigitalOut &operator=(DigitalOut &rhs)
+    {
+        write(rhs.read());
+        return *this;
+    }
+    operator int() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+class DigitalIn
+{
+public:
+    DigitalIn(PinName pin, PinMode mode = PullDefault);
+    int read();
+    void mode(PinMode pull);
+    int is_connected() { return _pin != NC; }
+    operator int() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+class BusOut
+{
+public:
+    BusOut(PinName p0, PinName p1 = NC, PinName p2 = NC, PinName p3 = NC,
+           PinName p4 = NC, PinName p5 = NC, PinName p6 = NC, PinName p7 = NC,
+           PinName p8 = NC, PinName p9 = NC, PinName p10 = NC, PinName p11 = NC,
+           PinName p12 = NC, PinName p13 = NC, PinName p14 = NC, PinName p15 = NC);
+    void write(int value);
+    int read();
+    BusOut &operator=(int v)
+    {
+        write(v);
+        return *this;
+    }
+    operator int() { return read(); }
+
+private:
+    PinName _pins[16];
+    int _value;
+};
+
+class PortIn
+{
+public:
+    PortIn(PortName port, int mask = 0xFFFFFFFF);
+    int read();
+    void mode(PinMode mode) {}
+    operator int() { return read(); }
+
+private:
+    PortName _port;
+    uint32_t _mask;
+};
+
+class PwmOut
+{
+public:
+    PwmOut(PinName pin);
+    void write(float value);
+    float read();
+    void period(float seconds);
+    void period_ms(int ms);
+    void period_us(int us);
+    void pulsewidth(float seconds);
+    void pulsewidth_ms(int ms);
+    void pulsewidth_us(int us);
+    PwmOut &operator=(float value)
+    {
+        write(value);
+        return *this;
+    }
+    operator float() { return read(); }
+
+private:
+    void update();
+
+    PinName _pin;
+    sim::ns_t _period;
+    sim::ns_t _pulse;
+};
+
+class InterruptIn : private sim::EdgeListener
+{
+public:
+    InterruptIn(PinName pin, PinMode mode = PullDefault);
+    virtual ~InterruptIn();
+    int read();
+    operator int() { return read(); }
+    void rise(Callback<void()> func);
+    void fall(Callback<void()> func);
+    void mode(PinMode pull) {}
+    void enable_irq() { _enabled = true; }
+    void disable_irq() { _enabled = false; }
+
+private:
+    virtual void edge(int pin, int level);
+
+    PinName _pin;
+    bool _enabled;
+    Callback<void()> _rise;
+    Callback<void()> _fall;
+};
+
+/** Base of everything run from the us ticker interrupt */
+class TimerEvent
+{
+public:
+    TimerEvent();
+    virtual ~TimerEvent();
+
+protected:
+    virtual void handler() = 0;
+    void insert(timestamp_t timestamp);
+    void insert_absolute(us_timestamp_t timestamp);
+    void remove();
+
+    ticker_event_t event;
+    const ticker_data_t *_ticker_data;
+
+private:
+    class Fire : public sim::Event
+    {
+    public:
+        TimerEvent *owner;
+
+    protected:
+        virtual void fire() { owner->handler(); }
+    };
+    Fire _fire;
+};
+
+class Ticker : public TimerEvent
+{
+public:
+    Ticker() {}
+    virtual ~Ticker() { detach(); }
+
+    void attach(Callback<void()> func, float t) { attach_us(func, (us_timestamp_t)(t * 1000000.0f)); }
+
+    template<typename T, typename M>
+    void attach(T *obj, M method, float t) { attach(callback(obj, method), t); }
+
+    void attach_us(Callback<void()> func, us_timestamp_t t);
+
+    template<typename T, typename M>
+    void attach_us(T *obj, M method, us_timestamp_t t) { attach_us(Callback<void()>(obj, method), t); }
+
+    void detach();
+
+protected:
+    virtual void handler();
+
+    us_timestamp_t _delay;
+    Callback<void()> _function;
+};
+
+class Timeout : public Ticker
+{
+protected:
+    virtual void handler();
+};
+
+class Timer
+{
+public:
+    Timer();
+    void start();
+    void stop();
+    void reset();
+    float read();
+    int read_ms();
+    int read_us();
+    us_timestamp_t read_high_resolution_us();
+    operator float() { return read(); }
+
+private:
+    us_timestamp_t elapsed();
+
+    bool _running;
+    us_timestamp_t _start;
+    us_timestamp_t _time;
+};
+
+/** printf and friends over the _putc/_getc of a subclass */
+class Stream
+{
+public:
+    Stream(const char *name = NULL) {}
+    virtual ~Stream() {}
+    int putc(int c) { return _putc(c); }
+    int puts(const char *s);
+    int getc() { return _getc(); }
+    int printf(const char *format, ...) MBED_PRINTF_METHOD(1, 2);
+    int vprintf(const char *format, va_list args);
+
+protected:
+    virtual int _putc(int c) = 0;
+    virtual int _getc() = 0;
+};
+
+class SerialBase : private sim::UartIrq
+{
+public:
+    enum IrqType {
+        RxIrq = 0,
+        TxIrq
+    };
+
+    void baud(int baudrate);
+    int readable();
+    int writeable();
+    void attach(Callback<void()> func, IrqType type = RxIrq);
+
+    template<typename T>
+    void attach(T *obj, void (T::*method)(), IrqType type = RxIrq) { attach(callback(obj, method), type); }
+
+protected:
+    SerialBase(PinName tx, PinName rx, int baud);
+    virtual ~SerialBase() {}
+    int _base_getc();
+    int _base_putc(int c);
+
+    sim::Uart &_uart;
+
+private:
+    virtual void rxIrq();
+    virtual void txIrq();
+
+    Callback<void()> _irq[2];
+};
+
+class RawSerial : public SerialBase
+{
+public:
+    RawSerial(PinName tx, PinName rx, int baud = 9600);
+    int getc();
+    int putc(int c);
+    int puts(const char *str);
+    int printf(const char *format, ...) MBED_PRINTF_METHOD(1, 2);
+    int vprintf(const char *format, va_list arg);
+};
+
+class SPI
+{
+public:
+    SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel = NC);
+    void format(int bits, int mode = 0) {}
+    void frequency(int hz = 1000000);
+    int write(int value);
+    int write(const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length);
+    void set_default_write_value(char data) { _fill = data; }
+    void lock() {}
+    void unlock() {}
+
+    /** Asynchronous block transfer, the callback runs from the transfer
+     *  complete interrupt once every byte is exchanged
+     */
+    template<typename Type>
+    int transfer(const Type *tx_buffer, int tx_length, Type *rx_buffer, int rx_length,
+                 const event_callback_t &callback, int event = SPI_EVENT_COMPLETE)
+    {
+        return start_transfer((const uint8_t *)tx_buffer, tx_length * sizeof(Type),
+                              (uint8_t *)rx_buffer, rx_length * sizeof(Type), callback, event);
+    }
+
+    void abort_transfer();
+
+private:
+    int start_transfer(const uint8_t *tx, int txLength, uint8_t *rx, int rxLength,
+                       const event_callback_t &callback, int event);
+    void transferDone();
+
+    sim::SpiBus &_bus;
+    char _fill;
+    const uint8_t *_tx;
+    int _txLength;
+    uint8_t *_rx;
+    int _rxLength;
+    int _event;
+    event_callback_t _callback;
+    sim::MemberEvent<SPI> _done;
+};
+
+} // namespace mbed
+
+using namespace mbed;
+using namespace std;
+
+#include "mbed_debug.h"
+#include "rtos.h"
+
+#endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef MBED_DEBUG_H
+#define MBED_DEBUG_H
+
+#include <stdio.h>
+#include <stdarg.h>
+
+/** Driver debug messages go to stderr, as on the board's console */
+static inline void debug(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+static inline void debug_if(int condition, const char *format, ...)
+{
+    if (condition) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+    }
+}
+
+#endif
\ No newline at end of file
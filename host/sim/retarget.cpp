@@ -0,0 +1,144 @@
+#include "FileSystemLike.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/* Paths starting with the name of a FileSystemLike go to it, anything else
+ * to the host. The build links with --wrap=fopen,--wrap=remove,--wrap=rename
+ * so the firmware's calls land here.
+ */
+
+extern "C" FILE *__real_fopen(const char *path, const char *mode);
+extern "C" int __real_remove(const char *path);
+extern "C" int __real_rename(const char *oldpath, const char *newpath);
+
+namespace mbed {
+
+static FileSystemLike *mounts = 0;
+
+FileSystemLike::FileSystemLike(const char *name):_name(name),
+    _next(mounts)
+{
+    mounts = this;
+}
+
+FileSystemLike::~FileSystemLike()
+{
+    for (FileSystemLike **p = &mounts; *p; p = &(*p)->_next) {
+        if (*p == this) {
+            *p = _next;
+            break;
+        }
+    }
+}
+
+FileSystemLike *FileSystemLike::lookup(const char *name, size_t length)
+{
+    for (FileSystemLike *fs = mounts; fs; fs = fs->_next) {
+        if (fs->_name && strlen(fs->_name) == length && strncmp(fs->_name, name, length) == 0) {
+            return fs;
+        }
+    }
+    return 0;
+}
+
+} // namespace mbed
+
+// "/sd/jobs.txt" gives the "sd" file system and "jobs.txt"
+static FileSystemLike *route(const char *path, const char **rest)
+{
+    if (!path || path[0] != '/') {
+        return 0;
+    }
+    const char *slash = strchr(path + 1, '/');
+    if (!slash) {
+        return 0;
+    }
+    *rest = slash + 1;
+    return FileSystemLike::lookup(path + 1, slash - path - 1);
+}
+
+static ssize_t cookieRead(void *cookie, char *buffer, size_t size)
+{
+    ssize_t n = ((FileHandle *)cookie)->read(buffer, size);
+    return n < 0 ? -1 : n;
+}
+
+static ssize_t cookieWrite(void *cookie, const char *buffer, size_t size)
+{
+    ssize_t n = ((FileHandle *)cookie)->write(buffer, size);
+    return n < 0 ? 0 : n;
+}
+
+static int cookieSeek(void *cookie, off64_t *offset, int whence)
+{
+    off_t at = ((FileHandle *)cookie)->seek(*offset, whence);
+    if (at < 0) {
+        return -1;
+    }
+    *offset = at;
+    return 0;
+}
+
+static int cookieClose(void *cookie)
+{
+    return ((FileHandle *)cookie)->close();
+}
+
+extern "C" FILE *__wrap_fopen(const char *path, const char *mode)
+{
+    const char *rest;
+    FileSystemLike *fs = route(path, &rest);
+    if (!fs) {
+        return __real_fopen(path, mode);
+    }
+    int flags;
+    bool plus = strchr(mode, '+') != NULL;
+    switch (mode[0]) {
+        case 'r':
+            flags = plus ? O_RDWR : O_RDONLY;
+            break;
+        case 'w':
+            flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+            break;
+        case 'a':
+            flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+            break;
+        default:
+            errno = EINVAL;
+            return NULL;
+    }
+    FileHandle *file = fs->open(rest, flags);
+    if (!file) {
+        errno = ENOENT;
+        return NULL;
+    }
+    cookie_io_functions_t io = {cookieRead, cookieWrite, cookieSeek, cookieClose};
+    FILE *stream = fopencookie(file, mode, io);
+    if (!stream) {
+        file->close();
+    }
+    return stream;
+}
+
+extern "C" int __wrap_remove(const char *path)
+{
+    const char *rest;
+    FileSystemLike *fs = route(path, &rest);
+    return fs ? fs->remove(rest) : __real_remove(path);
+}
+
+extern "C" int __wrap_rename(const char *oldpath, const char *newpath)
+{
+    const char *oldRest;
+    const char *newRest;
+    FileSystemLike *fs = route(oldpath, &oldRest);
+    if (!fs) {
+        return __real_rename(oldpath, newpath);
+    }
+    if (route(newpath, &newRest) != fs) {
+        errno = EXDEV;
+        return -1;
+    }
+    return fs->rename(oldRest, newRest);
+}
\ No newline at end of file
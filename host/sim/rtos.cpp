@@ -0,0 +1,247 @@
+#include "rtos.h"
+
+namespace rtos {
+
+static sim::ns_t timeout(uint32_t millisec)
+{
+    return millisec == osWaitForever ? sim::FOREVER : millisec * sim::MS;
+}
+
+void WaitList::remove(sim::SimThread *t)
+{
+    for (size_t i = 0; i < _threads.size(); i++) {
+        if (_threads[i] == t) {
+            _threads.erase(_threads.begin() + i);
+            return;
+        }
+    }
+}
+
+sim::SimThread *WaitList::take()
+{
+    size_t best = 0;
+    for (size_t i = 1; i < _threads.size(); i++) {
+        if (sim::priority(_threads[i]) > sim::priority(_threads[best])) {
+            best = i;
+        }
+    }
+    sim::SimThread *t = _threads[best];
+    _threads.erase(_threads.begin() + best);
+    return t;
+}
+
+// A thread taken off the list by a waker just as its timeout fired still
+// got what it waited for
+bool WaitList::wait(uint32_t millisec)
+{
+    sim::SimThread *t = sim::current();
+    add(t);
+    if (sim::block(timeout(millisec))) {
+        return true;
+    }
+    for (size_t i = 0; i < _threads.size(); i++) {
+        if (_threads[i] == t) {
+            _threads.erase(_threads.begin() + i);
+            return false;
+        }
+    }
+    return true;
+}
+
+Semaphore::Semaphore(int32_t count):_count(count)
+{
+}
+
+// A release hands its token straight to the waiter it wakes
+int32_t Semaphore::wait(uint32_t millisec)
+{
+    if (_count > 0) {
+        return _count--;
+    }
+    if (millisec == 0) {
+        return 0;
+    }
+    return _waiters.wait(millisec) ? 1 : 0;
+}
+
+osStatus Semaphore::release(void)
+{
+    if (!_waiters.empty()) {
+        sim::wake(_waiters.take());
+    } else {
+        _count++;
+    }
+    return osOK;
+}
+
+Mutex::Mutex():_owner(0),
+    _depth(0)
+{
+}
+
+// Recursive like RTX; unlock hands the mutex to the waiter it wakes
+osStatus Mutex::lock(uint32_t millisec)
+{
+    sim::SimThread *t = sim::current();
+    if (!_owner) {
+        _owner = t;
+        _depth = 1;
+        return osOK;
+    }
+    if (_owner == t) {
+        _depth++;
+        return osOK;
+    }
+    if (millisec == 0) {
+        return osErrorResource;
+    }
+    return _waiters.wait(millisec) ? osOK : osErrorTimeoutResource;
+}
+
+bool Mutex::trylock()
+{
+    return lock(0) == osOK;
+}
+
+osStatus Mutex::unlock()
+{
+    if (_owner != sim::current()) {
+        return osErrorResource;
+    }
+    if (--_depth > 0) {
+        return osOK;
+    }
+    if (_waiters.empty()) {
+        _owner = 0;
+        return osOK;
+    }
+    _owner = _waiters.take();
+    _depth = 1;
+    sim::wake(_owner);
+    return osOK;
+}
+
+Thread::Thread(osPriority priority, uint32_t stack_size, unsigned char *stack_pointer):_priority(priority),
+    _stack_size(stack_size),
+    _tid(0)
+{
+}
+
+osStatus Thread::start(mbed::Callback<void()> task)
+{
+    if (_tid) {
+        return osErrorParameter;
+    }
+    _task = task;
+    _tid = sim::createThread(&Thread::_thunk, this, _priority, "thread");
+    return osOK;
+}
+
+void Thread::_thunk(void *thread)
+{
+    Thread *t = (Thread *)thread;
+    t->_task.call();
+    t->_join_sem.release();
+}
+
+osStatus Thread::join()
+{
+    if (_tid && !sim::finished(_tid)) {
+        _join_sem.wait();
+        _join_sem.release();
+    }
+    return osOK;
+}
+
+osStatus Thread::set_priority(osPriority priority)
+{
+    _priority = priority;
+    if (_tid) {
+        sim::setPriority(_tid, priority);
+    }
+    return osOK;
+}
+
+osPriority Thread::get_priority()
+{
+    return _priority;
+}
+
+static int signalWait; // wait object of a thread in signal_wait()
+
+static bool signalled(int32_t flags, int32_t wanted)
+{
+    return wanted ? (flags & wanted) == wanted : flags != 0;
+}
+
+int32_t Thread::signal_set(int32_t signals)
+{
+    if (!_tid) {
+        return 0x80000000;
+    }
+    int32_t &flags = sim::threadSignals(_tid);
+    int32_t previous = flags;
+    flags |= signals;
+    if (sim::threadWaitObject(_tid) == &signalWait && signalled(flags, sim::threadWaitSignals(_tid))) {
+        sim::wake(_tid);
+    }
+    return previous;
+}
+
+int32_t Thread::signal_clr(int32_t signals)
+{
+    if (!_tid) {
+        return 0x80000000;
+    }
+    int32_t &flags = sim::threadSignals(_tid);
+    flags &= ~signals;
+    return flags;
+}
+
+osEvent Thread::signal_wait(int32_t signals, uint32_t millisec)
+{
+    sim::SimThread *t = sim::current();
+    int32_t &flags = sim::threadSignals(t);
+    osEvent event;
+    while (!signalled(flags, signals)) {
+        if (millisec == 0) {
+            event.status = osOK;
+            return event;
+        }
+        sim::threadWaitSignals(t) = signals;
+        sim::threadWaitObject(t) = &signalWait;
+        bool woken = sim::block(timeout(millisec));
+        sim::threadWaitObject(t) = 0;
+        if (!woken) {
+            event.status = osEventTimeout;
+            return event;
+        }
+    }
+    event.status = osEventSignal;
+    event.value.signals = flags;
+    flags &= signals ? ~signals : 0;
+    return event;
+}
+
+osStatus Thread::wait(uint32_t millisec)
+{
+    if (millisec == 0) {
+        sim::yield();
+        return osOK;
+    }
+    sim::block(millisec * sim::MS);
+    return osEventTimeout;
+}
+
+osStatus Thread::yield()
+{
+    sim::yield();
+    return osOK;
+}
+
+osThreadId Thread::gettid()
+{
+    return sim::current();
+}
+
+} // namespace rtos
\ No newline at end of file
@@ -0,0 +1,268 @@
+#ifndef RTOS_H
+#define RTOS_H
+
+/** mbed-rtos shadow of the host build
+ *
+ * The classes of the old RTX mbed-rtos API over the coroutine threads of
+ * SimKernel.h. Waiters are served highest priority first, as in RTX.
+ */
+
+#include "mbed.h"
+#include <deque>
+#include <new>
+
+typedef enum {
+    osOK = 0,
+    osEventSignal = 0x08,
+    osEventMessage = 0x10,
+    osEventMail = 0x20,
+    osEventTimeout = 0x40,
+    osErrorParameter = 0x80,
+    osErrorResource = 0x81,
+    osErrorTimeoutResource = 0xC1,
+    osErrorISR = 0x82,
+    osErrorISRRecursive = 0x83,
+    osErrorPriority = 0x84,
+    osErrorNoMemory = 0x85,
+    osErrorValue = 0x86,
+    osErrorOS = 0xFF
+} osStatus;
+
+typedef enum {
+    osPriorityIdle = -3,
+    osPriorityLow = -2,
+    osPriorityBelowNormal = -1,
+    osPriorityNormal = 0,
+    osPriorityAboveNormal = +1,
+    osPriorityHigh = +2,
+    osPriorityRealtime = +3,
+    osPriorityError = 0x84
+} osPriority;
+
+#define osWaitForever 0xFFFFFFFF
+#define DEFAULT_STACK_SIZE 2048
+
+typedef sim::SimThread *osThreadId;
+
+typedef struct {
+    osStatus status;
+    union {
+        uint32_t v;
+        void *p;
+        int32_t signals;
+    } value;
+    union {
+        void *mail_id;
+        void *message_id;
+    } def;
+} osEvent;
+
+namespace rtos {
+
+/** Threads blocked on one object, woken highest priority first */
+class WaitList
+{
+public:
+    void add(sim::SimThread *t) { _threads.push_back(t); }
+    void remove(sim::SimThread *t);
+    bool empty() { return _threads.empty(); }
+    sim::SimThread *take();
+
+    /** Block the current thread on the list
+     *
+     * @returns false if the timeout passed first
+     */
+    bool wait(uint32_t millisec);
+
+private:
+    std::deque<sim::SimThread *> _threads;
+};
+
+class Semaphore
+{
+public:
+    Semaphore(int32_t count = 0);
+    int32_t wait(uint32_t millisec = osWaitForever);
+    osStatus release(void);
+
+private:
+    int32_t _count;
+    WaitList _waiters;
+};
+
+class Mutex
+{
+public:
+    Mutex();
+    osStatus lock(uint32_t millisec = osWaitForever);
+    bool trylock();
+    osStatus unlock();
+
+private:
+    sim::SimThread *_owner;
+    int _depth;
+    WaitList _waiters;
+};
+
+class Thread
+{
+public:
+    Thread(osPriority priority = osPriorityNormal,
+           uint32_t stack_size = DEFAULT_STACK_SIZE,
+           unsigned char *stack_pointer = NULL);
+    virtual ~Thread() {}
+
+    osStatus start(mbed::Callback<void()> task);
+    osStatus join();
+    osStatus set_priority(osPriority priority);
+    osPriority get_priority();
+    int32_t signal_set(int32_t signals);
+    int32_t signal_clr(int32_t signals);
+    uint32_t stack_size() { return _stack_size; }
+
+    static osEvent signal_wait(int32_t signals, uint32_t millisec = osWaitForever);
+    static osStatus wait(uint32_t millisec);
+    static osStatus yield();
+    static osThreadId gettid();
+
+private:
+    static void _thunk(void *thread);
+
+    mbed::Callback<void()> _task;
+    osPriority _priority;
+    uint32_t _stack_size;
+    sim::SimThread *_tid;
+    Semaphore _join_sem;
+};
+
+template<typename T, uint32_t queue_sz>
+class Queue
+{
+public:
+    Queue() {}
+
+    osStatus put(T *data, uint32_t millisec = 0)
+    {
+        while (_items.size() >= queue_sz) {
+            if (millisec == 0 || sim::inIsr()) {
+                return osErrorResource;
+            }
+            if (!_putters.wait(millisec)) {
+                return osErrorTimeoutResource;
+            }
+        }
+        _items.push_back(data);
+        if (!_getters.empty()) {
+            sim::wake(_getters.take());
+        }
+        return osOK;
+    }
+
+    osEvent get(uint32_t millisec = osWaitForever)
+    {
+        osEvent event;
+        event.def.message_id = this;
+        while (_items.empty()) {
+            if (millisec == 0) {
+                event.status = osOK;
+                return event;
+            }
+            if (!_getters.wait(millisec)) {
+                event.status = osEventTimeout;
+                return event;
+            }
+        }
+        event.status = osEventMessage;
+        event.value.p = _items.front();
+        _items.pop_front();
+        if (!_putters.empty()) {
+            sim::wake(_putters.take());
+        }
+        return event;
+    }
+
+private:
+    std::deque<T *> _items;
+    WaitList _getters;
+    WaitList _putters;
+};
+
+template<typename T, uint32_t pool_sz>
+class MemoryPool
+{
+public:
+    MemoryPool():_free(0)
+    {
+        for (uint32_t i = 0; i < pool_sz; i++) {
+            _next[i] = _free;
+            _free = &_blocks[i];
+        }
+    }
+
+    T *alloc(void)
+    {
+        Block *b = _free;
+        if (!b) {
+            return NULL;
+        }
+        _free = _next[b - _blocks];
+        return (T *)b->data;
+    }
+
+    T *calloc(void)
+    {
+        T *item = alloc();
+        if (item) {
+            memset(item, 0, sizeof(T));
+        }
+        return item;
+    }
+
+    osStatus free(T *block)
+    {
+        Block *b = (Block *)block;
+        _next[b - _blocks] = _free;
+        _free = b;
+        return osOK;
+    }
+
+private:
+    struct Block {
+        alignas(T) unsigned char data[sizeof(T)];
+    };
+    Block _blocks[pool_sz];
+    Block *_next[pool_sz];
+    Block *_free;
+};
+
+template<typename T, uint32_t queue_sz>
+class Mail
+{
+public:
+    Mail() {}
+
+    T *alloc(uint32_t millisec = 0) { return _pool.alloc(); }
+    T *calloc(uint32_t millisec = 0) { return _pool.calloc(); }
+    osStatus put(T *mptr) { return _queue.put(mptr); }
+
+    osEvent get(uint32_t millisec = osWaitForever)
+    {
+        osEvent event = _queue.get(millisec);
+        if (event.status == osEventMessage) {
+            event.status = osEventMail;
+        }
+        return event;
+    }
+
+    osStatus free(T *mptr) { return _pool.free(mptr); }
+
+private:
+    Queue<T, queue_sz> _queue;
+    MemoryPool<T, queue_sz> _pool;
+};
+
+} // namespace rtos
+
+using namespace rtos;
+
+#endif
\ No newline at end of file
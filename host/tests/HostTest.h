@@ -0,0 +1,92 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include "SimKernel.h"
+#include "FileHandle.h"
+#include "rtos.h"
+#include <stdio.h>
+
+/** Checks of the host tests, a failed one is printed and the test goes on */
+static int hostFailures = 0;
+
+#define CHECK(cond) hostCheck((cond), #cond, __FILE__, __LINE__)
+
+static inline bool hostCheck(bool ok, const char *what, const char *file, int line)
+{
+    if (!ok) {
+        printf("%s:%i: FAIL: %s\n", file, line, what);
+        hostFailures++;
+    }
+    return ok;
+}
+
+/** An SD card on the 1 MHz bus: 300 us per command, 4.1 ms per sector */
+static const int SD_COMMAND_US = 300;
+static const int SD_SECTOR_US = 4100;
+
+/** Slow a MemFileSystem down to the SD card of the machine */
+template <class Disk>
+static inline void sdCardLatency(Disk &disk)
+{
+    disk.set_latency(SD_COMMAND_US, SD_SECTOR_US);
+}
+
+/** The byte at offset at of a test file, each seed gives its own pattern */
+static inline char fileByte(int seed, int at)
+{
+    return (char)('A' + (unsigned)(seed + at) % 26);
+}
+
+/** Write bytes of the seed's pattern in writes of chunk, waiting pauseMs after each */
+template <class Disk>
+static inline bool writeFile(Disk &fs, const char *name, int seed, int bytes, int chunk = 512, int pauseMs = 0)
+{
+    mbed::FileHandle *file = fs.open(name, O_WRONLY | O_CREAT | O_TRUNC);
+    if (file == NULL) {
+        return false;
+    }
+    char buffer[512];
+    bool ok = chunk <= (int)sizeof(buffer);
+    for (int at = 0; at < bytes && ok; at += chunk) {
+        int n = bytes - at < chunk ? bytes - at : chunk;
+        for (int i = 0; i < n; i++) {
+            buffer[i] = fileByte(seed, at + i);
+        }
+        ok = file->write(buffer, n) == n;
+        if (pauseMs > 0) {
+            Thread::wait(pauseMs);
+        }
+    }
+    return file->close() == 0 && ok;
+}
+
+/** The file holds exactly bytes of the seed's pattern */
+template <class Disk>
+static inline bool checkFile(Disk &fs, const char *name, int seed, int bytes)
+{
+    mbed::FileHandle *file = fs.open(name, O_RDONLY);
+    if (file == NULL) {
+        return false;
+    }
+    char buffer[512];
+    int at = 0;
+    bool ok = true;
+    ssize_t n;
+    while (ok && (n = file->read(buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            ok = ok && buffer[i] == fileByte(seed, at + i);
+        }
+        at += n;
+    }
+    file->close();
+    return ok && at == bytes;
+}
+
+/** Print the result and end the process, from any thread */
+static inline void hostDone(const char *name)
+{
+    printf("%s: %s\n", name, hostFailures ? "FAILED" : "passed");
+    sim::exit(hostFailures ? 1 : 0);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,74 @@
+// A batch of 1000 wires through the whole firmware, on virtual time
+#include "mbed.h"
+#include "rtos.h"
+#include "params.h"
+#include "JobQueue.h"
+#include "StateMachine.h"
+#include "SDFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <time.h>
+
+extern JobQueue jobQueue;
+extern volatile bool cutting;
+extern EventQueue uiEvents;
+extern StateMachine machine;
+extern SDFileSystem sd;
+
+int firmware_main();
+
+static const int WIRES = 1000;
+static const int JOBS = 4;
+static const float LENGTH = 2.0;
+static const float STRIP = 0.25;
+static const sim::ns_t TIMEOUT = 3600 * sim::SECOND;
+
+static void harness()
+{
+    sim::Board &b = sim::board();
+    while (machine.state() != MENU) {
+        Thread::wait(100);
+    }
+    for (int i = 0; i < JOBS; i++) {
+        jobQueue.add(LENGTH, STRIP, STRIP, WIRES / JOBS, 0, i == JOBS - 1);
+    }
+    sim::ns_t start = sim::now();
+    clock_t wall = clock();
+    uiEvents.post(EVENT_BUTTON, FOUR_RELEASED);
+    while (!cutting) {
+        Thread::wait(10);
+    }
+    while (cutting || jobQueue.wiresLeft() > 0) {
+        if (!CHECK(sim::now() - start < TIMEOUT)) {
+            break;
+        }
+        Thread::wait(100);
+    }
+    double virtualSeconds = (sim::now() - start) / 1e9;
+    double wallSeconds = (double)(clock() - wall) / CLOCKS_PER_SEC;
+
+    std::vector<double> pieces = b.machine->pieces(POS_CUT);
+    int wrong = 0;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (fabs(pieces[i] - LENGTH) > 0.25) {
+            wrong++;
+        }
+    }
+    CHECK(pieces.size() == WIRES);
+    CHECK(wrong == 0);
+    CHECK(b.machine->collisions() == 0);
+    CHECK(b.display->naks() == 0);
+
+    printf("%i wires, %i pieces (%i off length), %u collisions\n", WIRES, (int)pieces.size(), wrong, b.machine->collisions());
+    printf("virtual %.1f s (%.0f ms per wire), wall %.2f s, %llu events, %llu switches\n", virtualSeconds,
+           virtualSeconds * 1000 / WIRES, wallSeconds, (unsigned long long)sim::events(), (unsigned long long)sim::switches());
+    hostDone("test_batch");
+}
+
+int main()
+{
+    sd.format();
+    Thread harnessThread(osPriorityBelowNormal);
+    harnessThread.start(&harness);
+    return firmware_main();
+}
\ No newline at end of file
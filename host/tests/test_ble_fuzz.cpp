@@ -0,0 +1,310 @@
+// BluefruitPad against a reference scanner on random streams: valid frames
+// of every type mixed with truncated, corrupted and overlong ones and noise,
+// parsed in random pieces and then through the UART and the parser thread.
+// Events, data payloads, sensor values and counters must all match.
+#include "mbed.h"
+#include "rtos.h"
+#include "BluefruitPad.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+static const int ITEMS = 20000;
+static const int THREAD_ITEMS = 1500;
+static const char SENSOR_TYPES[] = "QAGML";
+
+RawSerial ble(p13, p14);
+EventQueue events;
+BluefruitPad pad(ble, events);
+
+/** What a stream should decode to */
+struct Decoded {
+    std::vector<uint32_t> events;
+    std::vector<std::string> data;
+    int frames;
+    int badChecksums;
+    int skipped;
+    std::string sensors[5];
+
+    Decoded():frames(0), badChecksums(0), skipped(0) {}
+};
+
+static Decoded got;
+static osThreadId dataThread;
+
+static uint32_t packEvent(uint8_t type, uint8_t code, uint16_t value)
+{
+    return type | code << 8 | (uint32_t)value << 16;
+}
+
+static void onData(const uint8_t *payload, int length)
+{
+    got.data.push_back(std::string((const char *)payload, length));
+    dataThread = Thread::gettid();
+}
+
+static void drainEvents()
+{
+    Event e;
+    while (events.wait(e, 0)) {
+        got.events.push_back(packEvent(e.type, e.code, e.value));
+    }
+}
+
+// CRC-16/CCITT-FALSE bit by bit, independent of the table in the driver
+static uint16_t crcBits(const std::string &s, size_t from, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = from; i < from + length; i++) {
+        crc ^= (uint8_t)s[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static int refLength(uint8_t type)
+{
+    switch (type) {
+        case 'B': return 5;
+        case 'C': return 6;
+        case 'Q': return 19;
+        case 'A': case 'G': case 'M': case 'L': return 15;
+        case 'J': return 5;
+        default: return 0;
+    }
+}
+
+// The protocol as written down: a frame starts at every '!', and one that
+// is unknown, too long or fails its check gives way to the next byte
+static void reference(const std::string &s, Decoded &r)
+{
+    size_t pos = 0;
+    while (pos < s.size()) {
+        if (s[pos] != '!') {
+            r.skipped++;
+            pos++;
+            continue;
+        }
+        if (pos + 1 >= s.size()) {
+            break;
+        }
+        uint8_t type = s[pos + 1];
+        size_t length = refLength(type);
+        if (length == 0) {
+            r.skipped++;
+            pos++;
+            continue;
+        }
+        if (type == 'J') {
+            if (pos + 2 >= s.size()) {
+                break;
+            }
+            if ((uint8_t)s[pos + 2] > BLE_DATA_MAX) {
+                r.skipped++;
+                pos++;
+                continue;
+            }
+            length = (uint8_t)s[pos + 2] + 5;
+        }
+        if (pos + length > s.size()) {
+            break;
+        }
+        const uint8_t *f = (const uint8_t *)s.data() + pos;
+        bool valid;
+        if (type == 'J') {
+            uint16_t crc = crcBits(s, pos, length - 2);
+            valid = f[length - 2] == (crc & 0xFF) && f[length - 1] == (crc >> 8);
+        } else {
+            uint8_t sum = 0;
+            for (size_t i = 0; i < length - 1; i++) {
+                sum += f[i];
+            }
+            valid = (uint8_t)~sum == f[length - 1];
+        }
+        if (!valid) {
+            r.badChecksums++;
+            pos++;
+            continue;
+        }
+        r.frames++;
+        if (type == 'J') {
+            r.data.push_back(s.substr(pos + 3, f[2]));
+        } else if (type == 'B') {
+            int button = f[2] - '0', pressed = f[3] - '0';
+            if (button >= 1 && button <= 8 && (pressed == 0 || pressed == 1)) {
+                r.events.push_back(packEvent(EVENT_BUTTON, button << 4 | pressed, 0));
+            }
+        } else if (type == 'C') {
+            uint16_t rgb = (f[2] >> 3) << 11 | (f[3] >> 2) << 5 | f[4] >> 3;
+            r.events.push_back(packEvent(EVENT_FRAME, 'C', rgb));
+        } else {
+            r.sensors[strchr(SENSOR_TYPES, type) - SENSOR_TYPES] = s.substr(pos + 2, length - 3);
+            r.events.push_back(packEvent(EVENT_FRAME, type, 0));
+        }
+        pos += length;
+    }
+}
+
+static std::string validFrame()
+{
+    static const char types[] = "BBBBCQAGMLJJJ";
+    char type = types[rand() % (sizeof(types) - 1)];
+    std::string f = "!";
+    f += type;
+    if (type == 'J') {
+        int length = rand() % (BLE_DATA_MAX + 1);
+        f += (char)length;
+        for (int i = 0; i < length; i++) {
+            f += (char)rand();
+        }
+        uint16_t crc = crcBits(f, 0, f.size());
+        f += (char)(crc & 0xFF);
+        f += (char)(crc >> 8);
+        return f;
+    }
+    for (int i = 2; i < refLength(type) - 1; i++) {
+        // Buttons mostly in range, so most of them post
+        f += type == 'B' ? (char)('0' + rand() % (i == 2 ? 10 : 3)) : (char)rand();
+    }
+    uint8_t sum = 0;
+    for (size_t i = 0; i < f.size(); i++) {
+        sum += f[i];
+    }
+    f += (char)~sum;
+    return f;
+}
+
+// One item of a stream: mostly valid frames, the rest damaged or noise
+static std::string item()
+{
+    std::string f = validFrame();
+    switch (rand() % 16) {
+        case 0: // cut short
+            return f.substr(0, 1 + rand() % (f.size() - 1));
+        case 1: // a byte flipped
+            f[rand() % f.size()] ^= 1 << rand() % 8;
+            return f;
+        case 2: // a byte lost
+            return f.erase(rand() % f.size(), 1);
+        case 3: { // noise, a '!' now and then
+            std::string noise;
+            for (int n = 1 + rand() % 20; n > 0; n--) {
+                noise += rand() % 8 ? (char)rand() : '!';
+            }
+            return noise;
+        }
+        case 4: { // a data frame longer than BLE_DATA_MAX
+            std::string j = "!J";
+            j += (char)(BLE_DATA_MAX + 1 + rand() % (255 - BLE_DATA_MAX));
+            return j + f;
+        }
+        default:
+            return f;
+    }
+}
+
+static std::string stream(int items)
+{
+    std::string s;
+    for (int i = 0; i < items; i++) {
+        s += item();
+    }
+    // Longer than any frame without a '!', so nothing is left half parsed
+    s += std::string(BLE_FRAME_MAX + 1, '.');
+    return s;
+}
+
+static bool sameSensors(const Decoded &want)
+{
+    bool same = true;
+    for (int i = 0; SENSOR_TYPES[i]; i++) {
+        float values[4];
+        if (want.sensors[i].empty()) {
+            continue;
+        }
+        same = same && pad.read(SENSOR_TYPES[i], values) &&
+               memcmp(values, want.sensors[i].data(), want.sensors[i].size()) == 0;
+    }
+    return same;
+}
+
+// Everything the pad produced since the counts in base matches want
+static void compare(const char *how, const Decoded &want, const Decoded &base, int bytes)
+{
+    int frames = pad.frames() - base.frames;
+    int bad = pad.badChecksums() - base.badChecksums;
+    int skipped = pad.skipped() - base.skipped;
+    printf("%s: %i bytes, %i frames (%i data), %i bad checksums, %i bytes skipped\n", how, bytes, frames,
+           (int)got.data.size(), bad, skipped);
+    CHECK(got.events == want.events);
+    CHECK(got.data == want.data);
+    CHECK(frames == want.frames);
+    CHECK(bad == want.badChecksums);
+    CHECK(skipped == want.skipped);
+    CHECK(sameSensors(want));
+    CHECK(events.dropped() == 0);
+}
+
+static Decoded counts()
+{
+    Decoded c;
+    c.frames = pad.frames();
+    c.badChecksums = pad.badChecksums();
+    c.skipped = pad.skipped();
+    return c;
+}
+
+// Fed in pieces of random length, so frames split anywhere
+static void pieces()
+{
+    srand(22);
+    std::string s = stream(ITEMS);
+    Decoded want, base = counts();
+    reference(s, want);
+    got = Decoded();
+    for (size_t at = 0; at < s.size();) {
+        size_t n = std::min(s.size() - at, (size_t)(1 + rand() % 40));
+        pad.parse((const uint8_t *)s.data() + at, n);
+        at += n;
+        drainEvents();
+    }
+    compare("pieces", want, base, s.size());
+    // Nearly all of the frames sent whole came through
+    CHECK(want.frames > ITEMS * 3 / 4);
+}
+
+// The same through the RX interrupt, the ring and the parser thread
+static void thread()
+{
+    srand(2200);
+    std::string s = stream(THREAD_ITEMS);
+    Decoded want, base = counts();
+    reference(s, want);
+    got = Decoded();
+    pad.start();
+    sim::Uart &uart = sim::board().ble->uart();
+    uart.send((const uint8_t *)s.data(), s.size());
+    while (uart.sending() > 0) {
+        Thread::wait(10);
+        drainEvents();
+    }
+    Thread::wait(10);
+    drainEvents();
+    compare("thread", want, base, s.size());
+    CHECK(dataThread != Thread::gettid());
+    CHECK(pad.overruns() == 0);
+}
+
+int main()
+{
+    pad.attach(&onData);
+    CHECK(BluefruitPad::crc16((const uint8_t *)"123456789", 9) == 0x29B1);
+    pieces();
+    thread();
+    hostDone("test_ble_fuzz");
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+// Cycles on the simulated machine: blade clear timing, stroke timeouts, feed hand-off
+#include "mbed.h"
+#include "rtos.h"
+#include "params.h"
+#include "Stepper.h"
+#include "Servo.h"
+#include "Motor.h"
+#include "PinDetectGroup.h"
+#include "HallEncoder.h"
+#include "FeedController.h"
+#include "CycleExecutor.h"
+#include "CutPlanner.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <math.h>
+
+// Wired as in main.cpp
+Stepper feeder(p16, p17, p18, p19, p20, p21);
+Motor cutter(p23, p24, p25);
+Servo guide(p22);
+HallEncoder encoder(p11, PullUp);
+PinDetectGroup inputs(Port0);
+FeedController controller(feeder, FEEDER_STEP_PER_INCH, FEEDER_INCH_PER_COUNT);
+GroupPin upperLimit(inputs, p27, PullUp);
+GroupPin lowerLimit(inputs, p28, PullUp);
+CycleExecutor executor(controller, guide, cutter, upperLimit, lowerLimit, CUTTER_MOTOR_SPEED);
+const CutCostModel model = {FEEDER_MAX_SPEED / FEEDER_STEP_PER_INCH, PLAN_FEED_OVERHEAD_MS, CYCLE_GUIDE_SETTLE_MS, 1000};
+CutPlanner planner(POS_STRIP, POS_CUT, model);
+
+static const Job WIRE = {1, 2.0, 0.25, 0.25, 1, 0, 0};
+
+static void edge()
+{
+    controller.encoderEdge();
+}
+
+// Neither direction of the H-bridge driven
+static bool cutterStopped()
+{
+    return !sim::io().level(p24) && !sim::io().level(p25);
+}
+
+// Wires of one spec back to back, as cutWires() runs them
+static int runWires(int count, float &guidePos, float &fed, int &strokeMs)
+{
+    CycleGraph graph;
+    int faults = 0;
+    fed = 0;
+    strokeMs = 0;
+    for (int i = 0; i < count && !(faults & CYCLE_FAULT_STROKE); i++) {
+        planner.buildWire(WIRE, guidePos, graph);
+        CycleReport report = executor.run(graph);
+        faults |= report.faults;
+        fed += report.fed;
+        strokeMs = report.strokeMs > strokeMs ? report.strokeMs : strokeMs;
+    }
+    return faults;
+}
+
+// The clear time follows the cutter's speed, so neither a slow nor a fast
+// cutter lets a feed start with the blade in the wire
+static void clearTiming(sim::ns_t strokeTime)
+{
+    sim::Machine &m = *sim::board().machine;
+    m.strokeTime(strokeTime);
+    uint32_t collisions = m.collisions();
+    double wire = m.wire();
+    float guidePos = GUIDE_UNKNOWN;
+    float fed;
+    int strokeMs;
+    int faults = runWires(5, guidePos, fed, strokeMs);
+    CHECK(executor.finish());
+    printf("stroke time %i ms: down stroke %i ms, fed %.3f in, %u collisions\n", (int)(strokeTime / sim::MS),
+           strokeMs, fed, m.collisions() - collisions);
+    CHECK(faults == 0);
+    CHECK(m.collisions() == collisions);
+    // From the top, where the blade coasts a little past the upper limit
+    CHECK(fabs(strokeMs - strokeTime / sim::MS * (sim::Machine::UPPER_LIMIT - sim::Machine::LOWER_LIMIT)) < strokeTime / sim::MS * 0.05);
+    // The feed results came back through the hand-off, one per wire
+    CHECK(fabs(fed - (m.wire() - wire)) < 0.05);
+    CHECK(fabs(fed - 5 * WIRE.length) < 5 * FEED_TOLERANCE);
+}
+
+// A cutter that never reaches the lower limit is stopped and the cycle gives up
+static void jammed()
+{
+    sim::Machine &m = *sim::board().machine;
+    m.strokeTime(1000 * sim::SECOND);
+    uint32_t strokes = m.strokes().size();
+    float guidePos = GUIDE_UNKNOWN;
+    float fed;
+    int strokeMs;
+    sim::ns_t start = sim::now();
+    int faults = runWires(3, guidePos, fed, strokeMs);
+    sim::ns_t took = sim::now() - start;
+    printf("jammed: faults %x after %i ms\n", faults, (int)(took / sim::MS));
+    CHECK(faults & CYCLE_FAULT_STROKE);
+    CHECK(took < (CYCLE_STROKE_TIMEOUT_MS + 1000) * sim::MS);
+    CHECK(cutterStopped());
+    CHECK(m.strokes().size() == strokes);
+    double blade = m.blade();
+    Thread::wait(1000);
+    CHECK(m.blade() == blade);
+    CHECK(executor.finish());
+}
+
+// A return stroke that never reaches the upper limit fails finish()
+static void jammedUp()
+{
+    sim::Machine &m = *sim::board().machine;
+    m.strokeTime(400 * sim::MS);
+    float guidePos = GUIDE_UNKNOWN;
+    float fed;
+    int strokeMs;
+    CHECK(runWires(1, guidePos, fed, strokeMs) == 0);
+    m.strokeTime(1000 * sim::SECOND);
+    CHECK(!executor.finish());
+    CHECK(cutterStopped());
+}
+
+int main()
+{
+    encoder.attach(&edge);
+    inputs.setSampleFrequency(DEBOUNCE_SAMPLE_PERIOD);
+    controller.setProfile(FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, FEEDER_PROFILE);
+    controller.setStepping(FULL_STEP, STEPPER_REV);
+    controller.setTolerance(FEED_TOLERANCE, FEED_APPROACH);
+    guide.calibrate(0.0015, 0.0009, 180);
+
+    // Home the cutter
+    cutter.speed(CUTTER_MOTOR_SPEED);
+    while (!upperLimit) {
+        Thread::wait(10);
+    }
+    cutter.speed(0);
+
+    clearTiming(400 * sim::MS);
+    clearTiming(1500 * sim::MS);
+    clearTiming(150 * sim::MS);
+    jammed();
+    jammedUp();
+    hostDone("test_cycle");
+}
\ No newline at end of file
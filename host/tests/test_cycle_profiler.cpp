@@ -0,0 +1,142 @@
+// CycleProfiler on virtual time: exact durations and statistics, markers
+// from an interrupt, a ring that wrapped, and phases around and past the
+// 44 s wrap of the cycle counter
+#include "mbed.h"
+#include "rtos.h"
+#include "CycleProfiler.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <string>
+
+RawSerial pc(USBTX, USBRX);
+CycleProfiler profiler;
+
+static PhaseStats stats[PROFILE_PHASES];
+
+// One phase of us microseconds, the CPU held as a busy loop would
+static void phase(ProfilePhase p, int us)
+{
+    profiler.begin(p);
+    wait_us(us);
+    profiler.end(p);
+}
+
+// Markers take no virtual time, so the calibration is exact
+static void calibrate()
+{
+    CHECK(profiler.calibrate() == 0);
+    CHECK(profiler.markers() == 0);
+}
+
+// 100 guide swings of 1 to 100 ms, a cycle around them all
+static void statistics()
+{
+    profiler.begin(PHASE_CYCLE);
+    for (int i = 1; i <= 100; i++) {
+        phase(PHASE_GUIDE, i * 1000);
+    }
+    profiler.end(PHASE_CYCLE);
+    profiler.report(stats);
+    PhaseStats &g = stats[PHASE_GUIDE];
+    CHECK(g.count == 100);
+    CHECK(g.min == 1000 && g.max == 100000);
+    CHECK(g.mean == 50500);
+    CHECK(g.p99 == 99000);
+    CHECK(g.excluded == 0);
+    // 1 ms falls in the 512 us octave, 100 ms in the 65 ms one
+    int total = 0;
+    for (int i = 0; i < PROFILE_HIST_BINS; i++) {
+        total += g.hist[i];
+    }
+    CHECK(total == 100 && g.hist[9] == 1 && g.hist[16] == 35);
+    CHECK(stats[PHASE_CYCLE].count == 1 && stats[PHASE_CYCLE].min == 5050000);
+    CHECK(stats[PHASE_FEED].count == 0);
+}
+
+static volatile int interruptMarks;
+
+static void guideIrq()
+{
+    profiler.begin(PHASE_GUIDE);
+    profiler.end(PHASE_GUIDE);
+    interruptMarks++;
+}
+
+// Markers from an interrupt land between a thread's, and every pair holds
+static void interrupts()
+{
+    profiler.calibrate();
+    Ticker ticker;
+    ticker.attach_us(&guideIrq, 700);
+    for (int i = 0; i < 20; i++) {
+        phase(PHASE_FEED, 2000);
+    }
+    ticker.detach();
+    profiler.report(stats);
+    CHECK(profiler.markers() < PROFILE_RING_SIZE);
+    CHECK(stats[PHASE_FEED].count == 20);
+    CHECK(stats[PHASE_FEED].min == 2000 && stats[PHASE_FEED].max == 2000);
+    CHECK(stats[PHASE_GUIDE].count == interruptMarks && stats[PHASE_GUIDE].max == 0);
+    CHECK(interruptMarks > 50);
+}
+
+// Only the newest PROFILE_RING_SIZE markers count, an end whose begin was
+// overwritten is skipped
+static void ringWrap()
+{
+    profiler.calibrate();
+    profiler.begin(PHASE_CUT_DOWN);
+    for (int i = 0; i < PROFILE_RING_SIZE; i++) {
+        phase(PHASE_FEED_MAIN, 10 + i);
+    }
+    profiler.end(PHASE_CUT_DOWN);
+    profiler.report(stats);
+    CHECK(profiler.markers() == 2 * PROFILE_RING_SIZE + 2);
+    CHECK(stats[PHASE_CUT_DOWN].count == 0);
+    CHECK(stats[PHASE_FEED_MAIN].count == PROFILE_RING_SIZE / 2 - 1);
+    CHECK(stats[PHASE_FEED_MAIN].max == 10 + PROFILE_RING_SIZE - 1);
+}
+
+// Phases past half the counter wrap are followed across it, those past a
+// whole wrap are excluded, and a busy ring gets no wrap markers
+static void wrap()
+{
+    profiler.calibrate();
+    const int seconds[] = {1, 30, 40, 50, 100};
+    for (unsigned i = 0; i < sizeof(seconds) / sizeof(seconds[0]); i++) {
+        profiler.begin(PHASE_HOME);
+        Thread::wait(seconds[i] * 1000);
+        profiler.end(PHASE_HOME);
+    }
+    uint32_t markers = profiler.markers();
+    profiler.report(stats);
+    PhaseStats &h = stats[PHASE_HOME];
+    printf("home: %i measured, %lu to %lu us, %i excluded, %lu wrap markers\n", h.count, (unsigned long)h.min,
+           (unsigned long)h.max, h.excluded, (unsigned long)(markers - 10));
+    CHECK(h.count == 3 && h.excluded == 2);
+    CHECK(h.min == 1000000 && h.max == 40000000);
+    CHECK(h.mean == 71000000 / 3);
+    // 210 s with nothing else marking, a wrap marker every 10 to 20 s
+    CHECK(markers > 10 + 5 && markers <= 10 + 210 / 10);
+    profiler.print(pc);
+    Thread::wait(100);
+    std::string &out = sim::board().console->received();
+    CHECK(out.find("2 over the counter wrap") != std::string::npos);
+    printf("%s", out.c_str());
+
+    markers = profiler.markers();
+    for (int i = 0; i < 2000; i++) {
+        phase(PHASE_FEED, 10000);
+    }
+    CHECK(profiler.markers() == markers + 4000);
+}
+
+int main()
+{
+    calibrate();
+    statistics();
+    interrupts();
+    ringWrap();
+    wrap();
+    hostDone("test_cycle_profiler");
+}
\ No newline at end of file
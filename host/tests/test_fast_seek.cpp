@@ -0,0 +1,158 @@
+// Random seeks into growing files on a RAM disk: through FATFileHandle with
+// the cluster link map, and through plain f_lseek() walking the FAT chain,
+// then between appends that fragment a file and extend its map
+#include "mbed.h"
+#include "MemFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <stdlib.h>
+#include <string.h>
+
+MemFileSystem mem("mem", 64 * 1024);
+
+static const int SEEKS = 200;
+static const int APPENDS = 50;
+
+// The 4 bytes at every word offset hold the offset, so any read can be checked
+static bool makeFile(const char *name, uint32_t bytes)
+{
+    FileHandle *file = mem.open(name, O_WRONLY | O_CREAT | O_TRUNC);
+    if (file == NULL) {
+        return false;
+    }
+    uint32_t chunk[1024];
+    for (uint32_t at = 0; at < bytes; at += sizeof(chunk)) {
+        for (int i = 0; i < 1024; i++) {
+            chunk[i] = at + 4 * i;
+        }
+        if (file->write(chunk, sizeof(chunk)) != (ssize_t)sizeof(chunk)) {
+            file->close();
+            return false;
+        }
+    }
+    return file->close() == 0;
+}
+
+typedef struct {
+    float readsPerSeek;
+    float msPerSeek;
+} SeekCost;
+
+// Seek and read a word at random offsets, through the file handle or FatFs directly
+static SeekCost seeks(const char *name, uint32_t bytes, bool linkMap)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "%s:/%s", mem._fsid, name);
+    FileHandle *file = NULL;
+    FIL fil;
+    if (linkMap) {
+        file = mem.open(name, O_RDONLY);
+        CHECK(file != NULL);
+    } else {
+        CHECK(f_open(&fil, path, FA_READ) == FR_OK);
+    }
+    srand(bytes);
+    uint32_t reads = mem.reads();
+    sim::ns_t start = sim::now();
+    int bad = 0;
+    for (int i = 0; i < SEEKS; i++) {
+        uint32_t at = (uint32_t)(((uint64_t)rand() * (bytes / 4)) / ((uint64_t)RAND_MAX + 1)) * 4;
+        uint32_t word = 0;
+        if (linkMap) {
+            file->lseek(at, SEEK_SET);
+            file->read(&word, 4);
+        } else {
+            UINT n;
+            f_lseek(&fil, at);
+            f_read(&fil, &word, 4, &n);
+        }
+        bad += word != at;
+    }
+    SeekCost cost;
+    cost.readsPerSeek = (float)(mem.reads() - reads) / SEEKS;
+    cost.msPerSeek = (float)((sim::now() - start) / sim::US) / 1000 / SEEKS;
+    CHECK(bad == 0);
+    if (linkMap) {
+        file->close();
+    } else {
+        f_close(&fil);
+    }
+    return cost;
+}
+
+// Append two clusters at a time while another file takes the cluster after
+// them, and seek and read a random word after each append. A map dropped on
+// the append would be built again by the seek, walking the whole chain.
+static uint32_t appendAndSeek(const char *name, uint32_t bytes)
+{
+    FileHandle *file = mem.open(name, O_RDWR);
+    FileHandle *other = mem.open("other.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    CHECK(file != NULL && other != NULL);
+    if (file == NULL || other == NULL) {
+        return bytes;
+    }
+    srand(APPENDS);
+    uint32_t reads = mem.reads();
+    sim::ns_t start = sim::now();
+    int bad = 0;
+    uint32_t chunk[256];
+    for (int i = 0; i < APPENDS; i++) {
+        for (int j = 0; j < 256; j++) {
+            chunk[j] = bytes + 4 * j;
+        }
+        CHECK(file->lseek(bytes, SEEK_SET) == (off_t)bytes);
+        CHECK(file->write(chunk, sizeof(chunk)) == (ssize_t)sizeof(chunk));
+        bytes += sizeof(chunk);
+        CHECK(other->write(chunk, 512) == 512);
+        uint32_t at = (uint32_t)(((uint64_t)rand() * (bytes / 4)) / ((uint64_t)RAND_MAX + 1)) * 4;
+        uint32_t word = 0;
+        file->lseek(at, SEEK_SET);
+        file->read(&word, 4);
+        bad += word != at;
+    }
+    float readsPerRound = (float)(mem.reads() - reads) / APPENDS;
+    float msPerRound = (float)((sim::now() - start) / sim::US) / 1000 / APPENDS;
+    printf("%i appends to a fragmenting file, each followed by a seek: %4.1f disk reads %5.1f ms per round\n",
+           APPENDS, readsPerRound, msPerRound);
+    CHECK(bad == 0);
+    // The random read and the FAT sectors both files allocate from, where
+    // building the map again on every seek costs some 95
+    CHECK(readsPerRound < 6.0f);
+    CHECK(file->close() == 0);
+    CHECK(other->close() == 0);
+    return bytes;
+}
+
+int main()
+{
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    const uint32_t sizes[] = {64 * 1024, 1024 * 1024, 6 * 1024 * 1024};
+    const char *names[] = {"small.bin", "medium.bin", "large.bin"};
+    for (int i = 0; i < 3; i++) {
+        CHECK(makeFile(names[i], sizes[i]));
+    }
+    sdCardLatency(mem);
+    float mapReads[3];
+    for (int i = 0; i < 3; i++) {
+        SeekCost walk = seeks(names[i], sizes[i], false);
+        SeekCost map = seeks(names[i], sizes[i], true);
+        mapReads[i] = map.readsPerSeek;
+        printf("%5u KB file: FAT walk %6.1f disk reads %8.1f ms per seek, link map %4.1f disk reads %5.1f ms per seek\n",
+               sizes[i] / 1024, walk.readsPerSeek, walk.msPerSeek, map.readsPerSeek, map.msPerSeek);
+        CHECK(map.readsPerSeek <= walk.readsPerSeek);
+    }
+    // Constant in the file size: the data sector, now and then a directory or FAT sector
+    CHECK(mapReads[2] < 1.5f);
+    CHECK(mapReads[2] < mapReads[0] + 0.5f);
+
+    uint32_t grown = appendAndSeek(names[2], sizes[2]);
+    SeekCost walk = seeks(names[2], grown, false);
+    SeekCost map = seeks(names[2], grown, true);
+    printf("after the appends: FAT walk %6.1f disk reads, link map %4.1f disk reads per seek\n",
+           walk.readsPerSeek, map.readsPerSeek);
+    // Building the map for the new handle walks the chain once: half a read per seek here
+    CHECK(map.readsPerSeek < 2.0f);
+    CHECK(map.readsPerSeek < walk.readsPerSeek);
+    hostDone("test_fast_seek");
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+// Feed to length on the simulated feeder, with good and bad encoder readings
+#include "mbed.h"
+#include "rtos.h"
+#include "params.h"
+#include "Stepper.h"
+#include "HallEncoder.h"
+#include "FeedController.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <math.h>
+
+// Wired as in main.cpp, where the machine model sits
+Stepper feeder(p16, p17, p18, p19, p20, p21);
+HallEncoder encoder(p11, PullUp);
+FeedController controller(feeder, FEEDER_STEP_PER_INCH, FEEDER_INCH_PER_COUNT);
+
+static void edge()
+{
+    controller.encoderEdge();
+}
+
+static FeedResult feed(float length, double &actual)
+{
+    double before = sim::board().machine->wire();
+    FeedResult r = controller.feed(length);
+    actual = sim::board().machine->wire() - before;
+    printf("feed %.3f: wire %.3f, measured %.3f, slip %.3f, %i counts%s\n", length, actual, r.measured,
+           r.slip, r.counts, r.fault ? ", fault" : "");
+    return r;
+}
+
+// The wire lands within the tolerance and the measurement within a fraction of a count
+static void goodEncoder()
+{
+    const float lengths[] = {2.0, 6.0, 0.5, 12.0, 2.0, 2.0};
+    double actual;
+    for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        FeedResult r = feed(lengths[i], actual);
+        CHECK(!r.fault);
+        CHECK(fabs(actual - lengths[i]) <= FEED_TOLERANCE + 1 / FEEDER_STEP_PER_INCH);
+        CHECK(fabs(r.measured - actual) <= FEEDER_INCH_PER_COUNT / 4);
+    }
+    CHECK(fabs(controller.slip() - 0.97f) < 0.02f);
+}
+
+// A slipping wheel reads far under FEED_MIN_SLIP: flagged, not chased, not learned
+static void slipping()
+{
+    float before = controller.slip();
+    sim::board().machine->slip(0.3);
+    double actual;
+    FeedResult r = feed(6.0, actual);
+    CHECK(r.fault);
+    CHECK(r.slip < FEED_MIN_SLIP);
+    CHECK(fabs(r.measured - actual) <= FEEDER_INCH_PER_COUNT);
+    CHECK(controller.slip() == before);
+}
+
+// A jammed wire makes no edges at all
+static void jammed()
+{
+    float before = controller.slip();
+    sim::board().machine->slip(0);
+    double actual;
+    FeedResult r = feed(6.0, actual);
+    CHECK(r.fault);
+    CHECK(r.counts == 0);
+    CHECK(r.measured == 0);
+    CHECK(controller.slip() == before);
+}
+
+int main()
+{
+    sim::board().machine->slip(0.97);
+    encoder.attach(&edge);
+    controller.setProfile(FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, FEEDER_PROFILE);
+    controller.setStepping(FULL_STEP, STEPPER_REV);
+    controller.setTolerance(FEED_TOLERANCE, FEED_APPROACH);
+
+    goodEncoder();
+    slipping();
+    jammed();
+    sim::board().machine->slip(0.97);
+    goodEncoder();
+    hostDone("test_feed");
+}
\ No newline at end of file
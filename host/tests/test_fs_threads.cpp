@@ -0,0 +1,149 @@
+// FatFs from many threads at once on a RAM disk slowed to SD card speed:
+// writers on their own files, readers on a shared one and the state store,
+// all checked for consistency while running and after a remount
+#include "mbed.h"
+#include "rtos.h"
+#include "MemFileSystem.h"
+#include "StateStore.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+
+MemFileSystem mem("mem", 16 * 1024);
+StateStore state(mem, "state.log");
+
+static const int WRITERS = 4;
+static const int READERS = 3;
+static const int ROUNDS = 20;
+static const int FILE_BYTES = 3000;
+static const int SHARED_BYTES = 4000;
+
+// Writers holding a file open, and reads that finished while one did
+static volatile int writersOpen;
+static volatile int overlapped;
+static int writerRounds[WRITERS];
+static int readerRounds[READERS];
+static int stateCommits;
+
+// Each round of each file its own pattern
+static int seed(int file, int round)
+{
+    return file * 7 + round * 3;
+}
+
+// Rewrite a file of its own and read it back, over and over
+static void writer(int *id)
+{
+    char name[16];
+    snprintf(name, sizeof(name), "w%i.txt", *id);
+    for (int round = 0; round < ROUNDS; round++) {
+        // Give the others a chance in the middle of the file
+        writersOpen++;
+        CHECK(writeFile(mem, name, seed(*id, round), FILE_BYTES, 100, 1));
+        writersOpen--;
+        CHECK(checkFile(mem, name, seed(*id, round), FILE_BYTES));
+        writerRounds[*id]++;
+    }
+}
+
+// Read the shared file end to end, over and over
+static void reader(int *id)
+{
+    for (int round = 0; round < ROUNDS; round++) {
+        CHECK(checkFile(mem, "shared.txt", seed(WRITERS, 0), SHARED_BYTES));
+        if (writersOpen > 0) {
+            overlapped++;
+        }
+        readerRounds[*id]++;
+        Thread::wait(2 + *id);
+    }
+}
+
+// Commit a counter to the store, holding the drive lock for its raw sectors
+static void committer()
+{
+    for (int i = 1; i <= ROUNDS; i++) {
+        state.setInt(1, i);
+        CHECK(state.commit());
+        int32_t value = 0;
+        CHECK(state.getInt(1, value) && value == i);
+        stateCommits++;
+        Thread::wait(5);
+    }
+}
+
+// An open file refuses a second writer, and removal
+static void fileLocks()
+{
+    FileHandle *fh = mem.open("w0.txt", O_WRONLY | O_CREAT);
+    CHECK(fh != NULL);
+    CHECK(mem.open("w0.txt", O_WRONLY) == NULL);
+    CHECK(mem.remove("w0.txt") != 0);
+    CHECK(fh && fh->close() == 0);
+    fh = mem.open("w0.txt", O_WRONLY);
+    CHECK(fh != NULL);
+    CHECK(fh && fh->close() == 0);
+}
+
+int main()
+{
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    CHECK(writeFile(mem, "shared.txt", seed(WRITERS, 0), SHARED_BYTES));
+    CHECK(state.mount());
+    fileLocks();
+    sdCardLatency(mem);
+
+    // Mixed priorities, so threads woken during a disk access preempt the one holding the drive
+    static const osPriority priorities[] = {osPriorityBelowNormal, osPriorityNormal, osPriorityAboveNormal};
+    Thread *threads[WRITERS + READERS + 1];
+    int ids[WRITERS + READERS];
+    sim::ns_t start = sim::now();
+    for (int i = 0; i < WRITERS; i++) {
+        ids[i] = i;
+        threads[i] = new Thread(priorities[i % 3]);
+        threads[i]->start(callback(&ids[i], &writer));
+    }
+    for (int i = 0; i < READERS; i++) {
+        ids[WRITERS + i] = i;
+        threads[WRITERS + i] = new Thread(priorities[(i + 1) % 3]);
+        threads[WRITERS + i]->start(callback(&ids[WRITERS + i], &reader));
+    }
+    threads[WRITERS + READERS] = new Thread(osPriorityHigh);
+    threads[WRITERS + READERS]->start(&committer);
+    for (int i = 0; i < WRITERS + READERS + 1; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    int ms = (int)((sim::now() - start) / sim::MS);
+
+    int rounds = stateCommits;
+    for (int i = 0; i < WRITERS; i++) {
+        CHECK(writerRounds[i] == ROUNDS);
+        rounds += writerRounds[i];
+    }
+    for (int i = 0; i < READERS; i++) {
+        CHECK(readerRounds[i] == ROUNDS);
+        rounds += readerRounds[i];
+    }
+    printf("%i threads, %i rounds in %i ms, %i shared reads while a writer held its file open\n",
+           WRITERS + READERS + 1, rounds, ms, overlapped);
+    CHECK(stateCommits == ROUNDS);
+    // Readers are not held off from fopen to fclose of another file
+    CHECK(overlapped > 0);
+
+    // Everything reached the disk
+    mem.set_latency(0, 0);
+    CHECK(mem.unmount() == 0);
+    CHECK(mem.mount() == 0);
+    for (int i = 0; i < WRITERS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "w%i.txt", i);
+        CHECK(checkFile(mem, name, seed(i, ROUNDS - 1), FILE_BYTES));
+    }
+    CHECK(checkFile(mem, "shared.txt", seed(WRITERS, 0), SHARED_BYTES));
+    StateStore reloaded(mem, "state.log");
+    int32_t value = 0;
+    CHECK(reloaded.mount());
+    CHECK(reloaded.getInt(1, value) && value == ROUNDS);
+    hostDone("test_fs_threads");
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+// HallEncoder on the feeder encoder pin: edge count and timestamps, the
+// glitch filter, velocity and its decay after the wheel stops, long stops,
+// acceleration and ring overruns
+#include "mbed.h"
+#include "rtos.h"
+#include "HallEncoder.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <math.h>
+
+static const PinName PIN = p11;
+
+HallEncoder encoder(PIN, PullUp);
+
+static int callbacks;
+
+static void edgeCallback()
+{
+    callbacks++;
+}
+
+static void toggle()
+{
+    sim::io().input(PIN, !sim::io().level(PIN));
+}
+
+// Drain the ring, returns the edges read
+static int drain()
+{
+    uint32_t t;
+    int n = 0;
+    while (encoder.read(t)) {
+        n++;
+    }
+    return n;
+}
+
+static bool near(float value, float expected, float tolerance)
+{
+    return fabsf(value - expected) <= fabsf(expected) * tolerance;
+}
+
+// Edges 1 ms apart: counted once each, stamped 1 ms apart, 1000 edges/s
+static void steady()
+{
+    encoder.reset();
+    callbacks = 0;
+    for (int i = 0; i < 40; i++) {
+        toggle();
+        wait_us(1000);
+    }
+    CHECK(encoder.count() == 40);
+    CHECK(callbacks == 40);
+    uint32_t last = 0, t;
+    int n = 0;
+    bool even = true;
+    while (encoder.read(t)) {
+        if (n++ > 0) {
+            even = even && t - last == 1000;
+        }
+        last = t;
+    }
+    CHECK(n == 40 && even);
+    // The last edge was 1 ms ago, a full interval, so no decay yet
+    float v = encoder.velocity();
+    printf("steady: %.1f edges/s, %.1f edges/s^2\n", v, encoder.acceleration());
+    CHECK(near(v, 1000, 0.01f));
+    CHECK(fabsf(encoder.acceleration()) < 1);
+}
+
+// Pairs of edges closer than HALL_ENCODER_MIN_EDGE_US leave nothing behind,
+// pairs just far enough apart count twice
+static void glitches()
+{
+    encoder.reset();
+    callbacks = 0;
+    int before = encoder.glitches();
+    for (int i = 0; i < 10; i++) {
+        toggle();
+        wait_us(HALL_ENCODER_MIN_EDGE_US / 2);
+        toggle();
+        wait_us(500);
+    }
+    CHECK(encoder.count() == 0 && callbacks == 0);
+    CHECK(encoder.glitches() == before + 10);
+    CHECK(drain() == 0);
+    for (int i = 0; i < 10; i++) {
+        toggle();
+        wait_us(HALL_ENCODER_MIN_EDGE_US + 1);
+        toggle();
+        wait_us(500);
+    }
+    CHECK(encoder.count() == 20 && callbacks == 20);
+    CHECK(encoder.glitches() == before + 10);
+    CHECK(drain() == 20);
+}
+
+// After the last edge the velocity falls as 1/time once a whole interval
+// has gone by without one, and a stop longer than 2^32 / HALL_ENCODER_WINDOW
+// us still reads as stopped
+static void stopped()
+{
+    for (int i = 0; i < 10; i++) {
+        toggle();
+        wait_us(2000);
+    }
+    CHECK(near(encoder.velocity(), 500, 0.01f));
+    wait_us(8000);
+    CHECK(near(encoder.velocity(), 100, 0.01f));
+    Thread::wait(100);
+    CHECK(encoder.velocity() < 10);
+    Thread::wait(1200 * 1000);
+    float v = encoder.velocity();
+    printf("after 1200 s stopped: %g edges/s\n", v);
+    CHECK(v < 0.001f);
+    drain();
+}
+
+// Edges of a wheel accelerating from v0 at a constant rate
+static void accelerate(double v0, double a, int edges)
+{
+    sim::ns_t start = sim::now();
+    for (int k = 1; k <= edges; k++) {
+        double t = (-v0 + sqrt(v0 * v0 + 2 * a * k)) / a;
+        sim::ns_t at = start + (sim::ns_t)(t * 1e9);
+        wait_us((int)((at - sim::now()) / sim::US));
+        toggle();
+    }
+    wait_us(HALL_ENCODER_MIN_EDGE_US);
+}
+
+static void acceleration()
+{
+    encoder.reset();
+    accelerate(200, 2000, 100);
+    float v = encoder.velocity();
+    float a = encoder.acceleration();
+    // 100 edges in: v = sqrt(v0^2 + 2 a x), about 663 edges/s
+    printf("accelerating: %.1f edges/s, %.0f edges/s^2\n", v, a);
+    CHECK(near(v, sqrtf(200.0f * 200 + 2 * 2000.0f * 100), 0.02f));
+    CHECK(near(a, 2000, 0.05f));
+    CHECK(encoder.count() == 100);
+}
+
+// Unread edges past HALL_ENCODER_RING_SIZE are counted as overruns
+static void overruns()
+{
+    drain();
+    int before = encoder.overruns();
+    for (int i = 0; i < HALL_ENCODER_RING_SIZE + 10; i++) {
+        toggle();
+        wait_us(100);
+    }
+    CHECK(drain() == HALL_ENCODER_RING_SIZE);
+    CHECK(encoder.overruns() == before + 10);
+}
+
+int main()
+{
+    encoder.attach(&edgeCallback);
+    steady();
+    glitches();
+    stopped();
+    acceleration();
+    overruns();
+    hostDone("test_hall_encoder");
+}
\ No newline at end of file
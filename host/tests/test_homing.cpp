@@ -0,0 +1,77 @@
+// The upper limit switch stops the cutter from its interrupt: homing at
+// boot, and a jog held past the top, with the time the motor kept running
+// after the switch
+#include "mbed.h"
+#include "rtos.h"
+#include "params.h"
+#include "StateMachine.h"
+#include "SDFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+
+extern EventQueue uiEvents;
+extern StateMachine machine;
+extern SDFileSystem sd;
+
+int firmware_main();
+
+static const sim::ns_t STROKE = 400 * sim::MS;
+// Four debounce samples and the interrupt, with room to spare
+static const sim::ns_t MAX_OVERRUN = 2 * sim::MS;
+
+// Time the motor ran past the switch at full speed, into the end stop or not
+static sim::ns_t overrun(sim::Machine &m)
+{
+    return (sim::ns_t)((m.blade() - sim::Machine::UPPER_LIMIT) * STROKE) + m.stalled();
+}
+
+static void waitFor(int state)
+{
+    sim::ns_t start = sim::now();
+    while (machine.state() != state && CHECK(sim::now() - start < 10 * sim::SECOND)) {
+        Thread::wait(10);
+    }
+}
+
+static void harness()
+{
+    sim::Machine &m = *sim::board().machine;
+    waitFor(MENU);
+    CHECK(m.blade() >= sim::Machine::UPPER_LIMIT);
+    sim::ns_t homing = overrun(m);
+
+    // Jog down a little, then hold UP well past the top
+    uiEvents.post(EVENT_BUTTON, TWO_RELEASED);
+    uiEvents.post(EVENT_BUTTON, THREE_RELEASED);
+    waitFor(SETTINGS_CUTTER);
+    uiEvents.post(EVENT_BUTTON, DOWN_PRESSED);
+    Thread::wait(100);
+    uiEvents.post(EVENT_BUTTON, DOWN_RELEASED);
+    Thread::wait(10);
+    CHECK(m.blade() < sim::Machine::UPPER_LIMIT);
+    sim::ns_t stalled = m.stalled();
+    uiEvents.post(EVENT_BUTTON, UP_PRESSED);
+    Thread::wait(2000);
+    CHECK(m.blade() >= sim::Machine::UPPER_LIMIT);
+    sim::ns_t jog = overrun(m) - stalled;
+    uiEvents.post(EVENT_BUTTON, UP_RELEASED);
+    uiEvents.post(EVENT_BUTTON, LEFT_RELEASED);
+    waitFor(SETTINGS_ONE);
+
+    printf("motor ran on past the upper limit: %i us homing, %i us with UP held 2 s, %i us against the end stop\n",
+           (int)(homing / sim::US), (int)(jog / sim::US), (int)(m.stalled() / sim::US));
+    CHECK(homing < MAX_OVERRUN);
+    CHECK(jog < MAX_OVERRUN);
+    CHECK(m.stalled() == 0);
+    hostDone("test_homing");
+}
+
+int main()
+{
+    sd.format();
+    sim::board().machine->strokeTime(STROKE);
+    sim::board().machine->blade(0.3);
+    Thread harnessThread(osPriorityBelowNormal);
+    harnessThread.start(&harness);
+    return firmware_main();
+}
\ No newline at end of file
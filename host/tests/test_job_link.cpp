@@ -0,0 +1,319 @@
+// JobLink in a loopback with a go-back-N sender like upload_jobs.py, over
+// the simulated BLE UART at 9600 baud and a RAM disk slowed to SD card
+// speed: throughput on a clean link, recovery from corrupted messages and
+// lost acknowledgements, and batches refused for a job out of range
+#include "mbed.h"
+#include "rtos.h"
+#include "BluefruitPad.h"
+#include "JobLink.h"
+#include "JobQueue.h"
+#include "MemFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+MemFileSystem mem("mem", 4096);
+JobQueue jobQueue("/mem/jobs.txt");
+RawSerial ble(p13, p14);
+EventQueue events;
+BluefruitPad pad(ble, events);
+JobLink jobLink(pad, jobQueue, events);
+
+static const int WINDOW = 8;
+static const sim::ns_t TIMEOUT = 1 * sim::SECOND;
+static const int RETRIES = 20;
+
+/** A batch upload as seen from the sender */
+struct Upload {
+    int status;     // last JobAckStatus, -1 if the sender gave up
+    int ms;
+    int frames;     // frames sent, resends included
+    int resends;
+};
+
+// Damage done to the link by the test, in percent
+static int corruptPercent;
+static int lostAckPercent;
+
+static void committer()
+{
+    Event e;
+    while (events.wait(e)) {
+        if (e.type == EVENT_FRAME && e.code == 'J') {
+            jobLink.commit();
+        }
+    }
+}
+
+static std::string frame(const std::string &payload)
+{
+    std::string f = "!J";
+    f += (char)payload.size();
+    f += payload;
+    uint16_t crc = BluefruitPad::crc16((const uint8_t *)f.data(), f.size());
+    f += (char)(crc & 0xFF);
+    f += (char)(crc >> 8);
+    return f;
+}
+
+static void sendFrame(const std::string &payload)
+{
+    std::string f = frame(payload);
+    if (rand() % 100 < corruptPercent) {
+        f[rand() % f.size()] ^= 1 << rand() % 8;
+    }
+    sim::board().ble->send((const uint8_t *)f.data(), f.size());
+}
+
+// Acknowledgements the board sent since the last call, as (next << 8) | status
+static std::vector<int> readAcks()
+{
+    static size_t at = 0;
+    std::string &rx = sim::board().ble->received();
+    std::vector<int> acks;
+    while (at + 8 <= rx.size()) {
+        if (rx.compare(at, 3, std::string("!J\x03", 3)) != 0) {
+            at++;
+            continue;
+        }
+        uint16_t crc = BluefruitPad::crc16((const uint8_t *)rx.data() + at, 6);
+        if ((uint8_t)rx[at + 6] == (crc & 0xFF) && (uint8_t)rx[at + 7] == (crc >> 8) && rx[at + 3] == JOB_MSG_ACK) {
+            if (rand() % 100 >= lostAckPercent) {
+                acks.push_back((uint8_t)rx[at + 4] << 8 | (uint8_t)rx[at + 5]);
+            }
+            at += 8;
+        } else {
+            at++;
+        }
+    }
+    return acks;
+}
+
+static std::vector<std::string> uploadMessages(const std::vector<Job> &jobs, int perFrame)
+{
+    std::vector<std::string> msgs;
+    msgs.push_back(std::string(1, JOB_MSG_BEGIN));
+    for (size_t i = 0; i < jobs.size(); i += perFrame) {
+        std::string m(1, JOB_MSG_JOBS);
+        for (size_t j = i; j < jobs.size() && j < i + perFrame; j++) {
+            char spec[JOB_LINK_SPEC_SIZE];
+            uint16_t quantity = jobs[j].quantity;
+            memcpy(spec, &jobs[j].length, 4);
+            memcpy(spec + 4, &jobs[j].leftStrip, 4);
+            memcpy(spec + 8, &jobs[j].rightStrip, 4);
+            memcpy(spec + 12, &quantity, 2);
+            spec[14] = (char)jobs[j].priority;
+            m.append(spec, sizeof(spec));
+        }
+        msgs.push_back(m);
+    }
+    msgs.push_back(std::string(1, JOB_MSG_END) + (char)jobs.size());
+    for (size_t seq = 0; seq < msgs.size(); seq++) {
+        msgs[seq].insert(1, 1, (char)seq);
+    }
+    return msgs;
+}
+
+// upload() of upload_jobs.py: resent from the last acknowledged message on
+// a repeated acknowledgement or a timeout, the window opened by the begin
+static Upload upload(const std::vector<Job> &jobs, int perFrame)
+{
+    std::vector<std::string> msgs = uploadMessages(jobs, perFrame);
+    Upload u = {-1, 0, 0, 0};
+    int base = 0, sent = 0, backFrom = -1, retries = 0;
+    sim::ns_t start = sim::now(), last = start;
+    readAcks();
+    while (retries < RETRIES && u.status < 0) {
+        while (sent < (int)msgs.size() && sent - base < (base ? WINDOW : 1)) {
+            sendFrame(msgs[sent++]);
+            u.frames++;
+        }
+        Thread::wait(5);
+        std::vector<int> acks = readAcks();
+        for (size_t i = 0; i < acks.size() && u.status < 0; i++) {
+            int next = acks[i] >> 8, status = acks[i] & 0xFF;
+            int advance = (next - base) & 0xFF;
+            if (status == JOB_ACK_FAILED) {
+                u.status = status;
+            } else if (status == JOB_ACK_COMMITTED && advance == (int)msgs.size() - base) {
+                u.status = status;
+            } else if (advance > 0 && advance <= sent - base) {
+                base += advance;
+                backFrom = -1;
+                retries = 0;
+                last = sim::now();
+            } else if (advance == 0 && sent > base && backFrom != base) {
+                // The board missed base, once per loss is enough
+                backFrom = base;
+                u.resends += sent - base;
+                sent = base;
+            }
+        }
+        if (u.status < 0 && sim::now() - last > TIMEOUT) {
+            u.resends += sent - base;
+            sent = base;
+            retries++;
+            last = sim::now();
+        }
+    }
+    u.ms = (int)((sim::now() - start) / sim::MS);
+    // Let anything still queued on the link drain before the next batch
+    while (sim::board().ble->uart().sending() > 0) {
+        Thread::wait(10);
+    }
+    Thread::wait(50);
+    readAcks();
+    return u;
+}
+
+static std::vector<Job> batch(int count)
+{
+    std::vector<Job> jobs;
+    for (int i = 0; i < count; i++) {
+        Job job;
+        memset(&job, 0, sizeof(job));
+        job.length = 2.0f + i * 0.5f;
+        job.leftStrip = 0.25f;
+        job.rightStrip = 0.5f;
+        job.quantity = 1 + i;
+        job.priority = i % 3;
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// The queue and the file it was saved to hold exactly jobs
+static bool queued(const std::vector<Job> &jobs)
+{
+    Job got[JOB_QUEUE_SIZE];
+    JobQueue loaded("/mem/jobs.txt");
+    if (!loaded.load() || loaded.pending() != (int)jobs.size() ||
+        jobQueue.pendingJobs(got, JOB_QUEUE_SIZE) != (int)jobs.size()) {
+        return false;
+    }
+    int wires = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        wires += jobs[i].quantity;
+        if (got[i].length != jobs[i].length || got[i].leftStrip != jobs[i].leftStrip ||
+            got[i].rightStrip != jobs[i].rightStrip || got[i].quantity != jobs[i].quantity ||
+            got[i].priority != jobs[i].priority) {
+            return false;
+        }
+    }
+    return loaded.wiresLeft() == wires;
+}
+
+static void report(const char *how, const Upload &u, int jobs)
+{
+    printf("%s: %i jobs in %i ms (%.1f jobs/s), %i frames, %i resent\n", how, jobs, u.ms,
+           jobs * 1000.0f / u.ms, u.frames, u.resends);
+}
+
+// A clean link: every message once, the batch in one save
+static void clean()
+{
+    std::vector<Job> jobs = batch(JOB_QUEUE_SIZE);
+    int before = jobLink.batches();
+    Upload u = upload(jobs, JOB_LINK_SPECS_MAX);
+    report("clean", u, jobs.size());
+    CHECK(u.status == JOB_ACK_COMMITTED);
+    CHECK(u.resends == 0);
+    CHECK(jobLink.outOfOrder() == 0);
+    CHECK(jobLink.batches() == before + 1);
+    CHECK(queued(jobs));
+    jobQueue.clear();
+    CHECK(jobQueue.save());
+}
+
+// Messages damaged on the way in and acknowledgements lost on the way out
+// are made up by resends, and every batch still lands once
+static void lossy()
+{
+    srand(23);
+    corruptPercent = 10;
+    lostAckPercent = 10;
+    int batches = 0, ms = 0, frames = 0, resends = 0, jobsSent = 0;
+    for (int i = 0; i < 8; i++) {
+        std::vector<Job> jobs = batch(8 + i * 3);
+        Upload u = upload(jobs, 4);
+        CHECK(u.status == JOB_ACK_COMMITTED);
+        CHECK(queued(jobs));
+        batches += u.status == JOB_ACK_COMMITTED;
+        ms += u.ms;
+        frames += u.frames;
+        resends += u.resends;
+        jobsSent += jobs.size();
+        jobQueue.clear();
+        CHECK(jobQueue.save());
+    }
+    corruptPercent = 0;
+    lostAckPercent = 0;
+    Upload total = {JOB_ACK_COMMITTED, ms, frames, resends};
+    report("10% corrupted, 10% acks lost", total, jobsSent);
+    printf("  %i of 8 batches committed, %i messages out of order, %i bad CRCs\n", batches,
+           jobLink.outOfOrder(), pad.badChecksums());
+    CHECK(resends > 0);
+    CHECK(pad.badChecksums() > 0);
+}
+
+// One job the machine can not cut refuses the whole batch, nothing is
+// queued, and the corrected batch goes through after it
+static void outOfRange()
+{
+    std::vector<Job> kept = batch(1);
+    jobQueue.add(kept[0].length, kept[0].leftStrip, kept[0].rightStrip, kept[0].quantity, kept[0].priority);
+
+    const float nan = NAN, inf = INFINITY;
+    const float bad[][3] = {
+        {nan, 0, 0}, {inf, 0, 0}, {2.0f, nan, 0}, {2.0f, 0, inf}, {0, 0, 0}, {-1.0f, 0, 0},
+        {JOB_LINK_LENGTH_MAX + 1.0f, 0, 0}, {2.0f, -0.1f, 0}, {2.0f, 0, -0.1f}, {2.0f, 1.0f, 1.0f},
+        {2.0f, 1.5f, 0.6f},
+    };
+    int refused = 0;
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        std::vector<Job> jobs = batch(6);
+        jobs[3].length = bad[i][0];
+        jobs[3].leftStrip = bad[i][1];
+        jobs[3].rightStrip = bad[i][2];
+        Upload u = upload(jobs, JOB_LINK_SPECS_MAX);
+        refused += u.status == JOB_ACK_FAILED;
+        CHECK(u.status == JOB_ACK_FAILED);
+        CHECK(queued(kept));
+    }
+    std::vector<Job> zero = batch(3);
+    zero[1].quantity = 0;
+    refused += upload(zero, JOB_LINK_SPECS_MAX).status == JOB_ACK_FAILED;
+    CHECK(queued(kept));
+    printf("out of range: %i of %i batches refused\n", refused, (int)(sizeof(bad) / sizeof(bad[0])) + 1);
+
+    // The longest wire allowed and strips leaving a hair of wire are fine
+    std::vector<Job> edge = batch(2);
+    edge[0].length = JOB_LINK_LENGTH_MAX;
+    edge[1].leftStrip = 1.0f;
+    edge[1].rightStrip = edge[1].length - 1.001f;
+    CHECK(upload(edge, JOB_LINK_SPECS_MAX).status == JOB_ACK_COMMITTED);
+    kept.insert(kept.end(), edge.begin(), edge.end());
+    CHECK(queued(kept));
+    jobQueue.clear();
+    CHECK(jobQueue.save());
+}
+
+int main()
+{
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    sdCardLatency(mem);
+    pad.attach(callback(&jobLink, &JobLink::receive));
+    pad.start();
+    Thread commitThread(osPriorityNormal);
+    commitThread.start(&committer);
+
+    clean();
+    lossy();
+    outOfRange();
+    hostDone("test_job_link");
+}
\ No newline at end of file
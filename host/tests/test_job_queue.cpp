@@ -0,0 +1,114 @@
+// JobQueue saves on the simulated SD card: round trip, failed writes, cut off saves
+#include "mbed.h"
+#include "rtos.h"
+#include "SDFileSystem.h"
+#include "JobQueue.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+
+SDFileSystem sd(p5, p6, p7, p8, "sd");
+
+static const char *PATH = "/sd/jobs.txt";
+static const char *TMP_PATH = "/sd/jobs.txt.tmp";
+
+// Wires left of the queue a fresh JobQueue loads from the card, -1 if none
+static int loadedWires()
+{
+    JobQueue loaded(PATH);
+    return loaded.load() ? loaded.wiresLeft() : -1;
+}
+
+static bool exists(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    return fp != NULL;
+}
+
+static void roundTrip(JobQueue &queue)
+{
+    queue.add(2.0, 0.25, 0.25, 10, 0, false);
+    queue.add(6.5, 0.5, 0.0, 4, 1, false);
+    queue.add(12.0, 0.0, 0.0, 1, 0, false);
+    CHECK(queue.save());
+    CHECK(loadedWires() == 15);
+    CHECK(!exists(TMP_PATH));
+
+    JobQueue loaded(PATH);
+    CHECK(loaded.load());
+    Job job;
+    CHECK(loaded.next(job));
+    CHECK(job.length == 6.5f && job.leftStrip == 0.5f && job.quantity == 4 && job.priority == 1);
+}
+
+// A save the card refuses reports it, and the file keeps the last queue saved
+static void failedWrite(JobQueue &queue)
+{
+    Job job;
+    queue.next(job);
+    sim::board().sd->rejectWrites(1000);
+    CHECK(!queue.wireDone(job.id));
+    CHECK(queue.wiresLeft() == 14);
+    sim::board().sd->rejectWrites(0);
+    CHECK(loadedWires() == 15);
+    CHECK(queue.save());
+    CHECK(loadedWires() == 14);
+
+    // Only saves that are due can fail
+    sim::board().sd->rejectWrites(1000);
+    CHECK(queue.wireDone(job.id, false));
+    sim::board().sd->rejectWrites(0);
+}
+
+// Power lost after the old file was removed: the complete temporary file is loaded
+static void cutOff(JobQueue &queue)
+{
+    CHECK(queue.save());
+    int wires = queue.wiresLeft();
+    CHECK(rename(PATH, TMP_PATH) == 0);
+    CHECK(!exists(PATH));
+    CHECK(loadedWires() == wires);
+    // The next save replaces both
+    CHECK(queue.save());
+    CHECK(loadedWires() == wires);
+    CHECK(!exists(TMP_PATH));
+}
+
+// Two threads saving at once never share the temporary file
+static JobQueue *shared;
+static int sharedFailures;
+
+static void saver()
+{
+    for (int i = 0; i < 20; i++) {
+        if (!shared->save()) {
+            sharedFailures++;
+        }
+    }
+}
+
+static void concurrent(JobQueue &queue)
+{
+    shared = &queue;
+    sharedFailures = 0;
+    Thread other;
+    other.start(&saver);
+    saver();
+    other.join();
+    CHECK(sharedFailures == 0);
+    CHECK(loadedWires() == queue.wiresLeft());
+}
+
+int main()
+{
+    CHECK(sd.format() == 0);
+    JobQueue queue(PATH);
+    CHECK(!queue.load());
+    roundTrip(queue);
+    failedWrite(queue);
+    cutOff(queue);
+    concurrent(queue);
+    hostDone("test_job_queue");
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+// uLCD command transport on the simulated display: throughput, NAKs, threads left to run
+#include "mbed.h"
+#include "rtos.h"
+#include "uLCD_4DGL.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+
+/** The driver with its transport open to the test */
+class TestLcd : public uLCD_4DGL
+{
+public:
+    TestLcd():uLCD_4DGL(p9, p10, p30)
+    {
+    }
+
+    int queued(char *command, int number)
+    {
+        return writeCOMMAND(command, number);
+    }
+
+    // The transport before commands were queued: one at a time, each answer waited for
+    int synchronous(char *command, int number)
+    {
+        return sendCOMMAND('\xFF', command, number);
+    }
+};
+
+static const int RECTS = 100;
+
+// Work done by a thread below the display's priority, e.g. the logger
+static volatile uint32_t background;
+
+static void backgroundTask()
+{
+    while (true) {
+        wait_us(100);
+        background++;
+    }
+}
+
+static int rect(char *command, int i)
+{
+    int x = i % 100;
+    command[0] = FRECTANGLE;
+    command[1] = 0;
+    command[2] = x;
+    command[3] = 0;
+    command[4] = 10;
+    command[5] = 0;
+    command[6] = x + 20;
+    command[7] = 0;
+    command[8] = 30;
+    command[9] = i;
+    command[10] = 0x1F;
+    return 11;
+}
+
+// Virtual ms to draw RECTS rectangles, and the share of it the background thread got
+static int draw(TestLcd &lcd, bool queued, int &backgroundPercent)
+{
+    char command[11];
+    sim::ns_t start = sim::now();
+    uint32_t before = background;
+    for (int i = 0; i < RECTS; i++) {
+        int n = rect(command, i);
+        CHECK((queued ? lcd.queued(command, n) : lcd.synchronous(command, n)) == 1);
+    }
+    CHECK(lcd.flush() == 1);
+    sim::ns_t took = sim::now() - start;
+    backgroundPercent = (int)((background - before) * 100 * sim::US * 100 / took);
+    return (int)(took / sim::MS);
+}
+
+static void throughput(TestLcd &lcd, int baud, sim::ns_t ackDelay)
+{
+    sim::Display &display = *sim::board().display;
+    lcd.baudrate(baud);
+    display.ackDelay(ackDelay);
+    display.resetStats();
+    int syncBackground, queuedBackground;
+    int syncMs = draw(lcd, false, syncBackground);
+    int queuedMs = draw(lcd, true, queuedBackground);
+    printf("%7i baud, %4i us ack delay: %i rectangles in %4i ms one at a time, %4i ms queued (%.2fx); "
+           "background thread got %i%% / %i%%\n", baud, (int)(ackDelay / sim::US), RECTS, syncMs, queuedMs,
+           (float)syncMs / queuedMs, syncBackground, queuedBackground);
+    CHECK(queuedMs < syncMs);
+    CHECK(display.naks() == 0);
+    CHECK(display.overflows() == 0);
+    CHECK(display.commands() == 2 * RECTS);
+    // Waiting on the screen sleeps instead of spinning
+    CHECK(queuedBackground > 50);
+    display.ackDelay(0);
+}
+
+// A NAK shows up on the queued commands after it, and once on flush()
+static void naks(TestLcd &lcd)
+{
+    char command[11];
+    int n = rect(command, 0);
+    CHECK(lcd.flush() == 1);
+    sim::board().display->injectNaks(1);
+    int first = lcd.queued(command, n);
+    int ok = first == 1 ? 1 : 0;
+    int failed = 0;
+    for (int i = 0; i < 10; i++) {
+        int r = lcd.queued(command, n);
+        if (r == 1) {
+            // Answers come in order, so nothing after a NAK is reported as ACKed
+            CHECK(failed == 0);
+            ok++;
+        } else {
+            CHECK(r == -1);
+            failed++;
+        }
+    }
+    printf("NAK: %i queued commands returned 1 before it arrived, %i returned -1\n", ok, failed);
+    CHECK(failed > 0);
+    CHECK(lcd.flush() == -1);
+    CHECK(lcd.flush() == 1);
+    CHECK(lcd.queued(command, n) == 1);
+    CHECK(lcd.flush() == 1);
+    CHECK(lcd.nak_count() == 1);
+}
+
+// Commands that answer with data wait for it, and leave the queue in step
+static void replies(TestLcd &lcd)
+{
+    char command[11];
+    int n = rect(command, 0);
+    lcd.queued(command, n);
+    CHECK(lcd.media_init() == 0); // the simulated display has no card
+    CHECK(lcd.read_word() == 0);
+    CHECK(lcd.queued(command, n) == 1);
+    CHECK(lcd.flush() == 1);
+    CHECK(lcd.nak_count() == 1);
+}
+
+int main()
+{
+    TestLcd lcd;
+    Thread logger(osPriorityLow);
+    logger.start(&backgroundTask);
+    throughput(lcd, 115200, 0);
+    throughput(lcd, 3000000, 0);
+    throughput(lcd, 3000000, 2 * sim::MS);
+    naks(lcd);
+    replies(lcd);
+    hostDone("test_lcd");
+}
\ No newline at end of file
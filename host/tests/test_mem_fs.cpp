@@ -0,0 +1,152 @@
+// The sparse RAM disk itself: memory taken by a large disk, zero sectors,
+// image save and load, fault injection and latency
+#include "mbed.h"
+#include "MemFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <string.h>
+
+static const char *IMAGE = "/tmp/test_mem_fs.img";
+
+// A 2 GB disk only takes memory for the sectors written
+static void sparse()
+{
+    MemFileSystem big("big", 4 * 1024 * 1024);
+    CHECK(big.disk_sectors() == 4 * 1024 * 1024);
+    CHECK(big.format() == 0);
+    uint32_t formatted = big.used_sectors();
+    CHECK(big.mount() == 0);
+    char name[16];
+    for (int i = 0; i < 10; i++) {
+        snprintf(name, sizeof(name), "f%i.bin", i);
+        CHECK(writeFile(big, name, i, 16 * 1024));
+    }
+    for (int i = 0; i < 10; i++) {
+        snprintf(name, sizeof(name), "f%i.bin", i);
+        CHECK(checkFile(big, name, i, 16 * 1024));
+    }
+    CHECK(big.unmount() == 0);
+    printf("2 GB disk: %u sectors used after format, %u after 160 KB of files\n", formatted, big.used_sectors());
+    CHECK(formatted < 64);
+    // The files' 320 sectors, and their FAT and directory sectors
+    CHECK(big.used_sectors() >= formatted + 320 && big.used_sectors() < formatted + 340);
+}
+
+// Sectors of zeros hold no storage, whatever the buffer alignment
+static void zeros()
+{
+    MemFileSystem raw("raw", 64);
+    static uint32_t words[513 / 4 + 1];
+    uint8_t *buffer = (uint8_t *)words;
+    uint8_t back[512];
+    for (int offset = 0; offset < 2; offset++) {
+        memset(buffer, 0, sizeof(words));
+        buffer[offset + 511] = 1;
+        CHECK(raw.disk_write(buffer + offset, 5, 1) == 0);
+        CHECK(raw.used_sectors() == 1);
+        CHECK(raw.disk_read(back, 5, 1) == 0 && memcmp(back, buffer + offset, 512) == 0);
+        buffer[offset + 511] = 0;
+        CHECK(raw.disk_write(buffer + offset, 5, 1) == 0);
+        CHECK(raw.used_sectors() == 0);
+        CHECK(raw.disk_read(back, 5, 1) == 0 && memcmp(back, buffer + offset, 512) == 0);
+    }
+    // Out of range
+    CHECK(raw.disk_read(back, 64, 1) != 0);
+    CHECK(raw.disk_write(back, 63, 2) != 0);
+}
+
+// A saved image loads into a new disk and mounts with every file intact
+static void image()
+{
+    // FatFs is built for one volume, so the disks take turns
+    uint32_t used;
+    {
+        MemFileSystem mem("mem", 64 * 1024);
+        CHECK(mem.format() == 0);
+        CHECK(mem.mount() == 0);
+        CHECK(writeFile(mem, "a.bin", 1, 40 * 1024));
+        CHECK(writeFile(mem, "b.bin", 2, 3 * 512));
+        CHECK(mem.unmount() == 0);
+        CHECK(mem.save(IMAGE) == 0);
+        used = mem.used_sectors();
+    }
+
+    MemFileSystem copy("copy", 64 * 1024);
+    CHECK(copy.load(IMAGE) == 0);
+    CHECK(copy.used_sectors() == used);
+    CHECK(copy.mount() == 0);
+    CHECK(checkFile(copy, "a.bin", 1, 40 * 1024));
+    CHECK(checkFile(copy, "b.bin", 2, 3 * 512));
+    CHECK(copy.unmount() == 0);
+    CHECK(copy.load("/tmp/no/such/image") != 0);
+    remove(IMAGE);
+}
+
+// Injected faults fail calls without corrupting what was already on the disk
+static void faults()
+{
+    MemFileSystem mem("mem", 4096);
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    CHECK(writeFile(mem, "keep.bin", 3, 8 * 1024));
+    CHECK(mem.unmount() == 0);
+
+    // Every 13th access fails, and with it some of the rewrites; FatFs ignores
+    // failed writes to the second FAT, so not every fault fails a call
+    CHECK(mem.mount() == 0);
+    mem.fail_every(13);
+    int failed = 0;
+    for (int i = 0; i < 20; i++) {
+        failed += !writeFile(mem, "scratch.bin", i, 4 * 1024);
+    }
+    mem.fail_every(0);
+    CHECK(failed > 0);
+    CHECK(mem.faults() > 0);
+    mem.unmount();
+
+    // Power lost in the middle of a file
+    uint32_t before = mem.faults();
+    CHECK(mem.mount() == 0);
+    mem.fail_writes_after(3);
+    CHECK(!writeFile(mem, "lost.bin", 4, 16 * 1024));
+    mem.fail_writes_after(-1);
+    CHECK(mem.faults() > before);
+    mem.unmount();
+    printf("faults: %i of 20 rewrites failed, %u faults injected\n", failed, mem.faults());
+
+    CHECK(mem.mount() == 0);
+    CHECK(checkFile(mem, "keep.bin", 3, 8 * 1024));
+    CHECK(writeFile(mem, "after.bin", 5, 4 * 1024));
+    CHECK(checkFile(mem, "after.bin", 5, 4 * 1024));
+    CHECK(mem.unmount() == 0);
+}
+
+// Every call costs the fixed latency plus the per sector one, in virtual time
+static void latency()
+{
+    MemFileSystem mem("mem", 64);
+    uint8_t buffer[8 * 512];
+    sdCardLatency(mem);
+    uint32_t reads = mem.reads(), writes = mem.writes();
+    sim::ns_t start = sim::now();
+    CHECK(mem.disk_read(buffer, 0, 8) == 0);
+    CHECK(sim::now() - start == (SD_COMMAND_US + 8 * SD_SECTOR_US) * sim::US);
+    start = sim::now();
+    CHECK(mem.disk_write(buffer, 8, 1) == 0);
+    CHECK(sim::now() - start == (SD_COMMAND_US + SD_SECTOR_US) * sim::US);
+    CHECK(mem.reads() == reads + 1 && mem.writes() == writes + 1);
+    mem.set_latency(0, 0);
+    start = sim::now();
+    CHECK(mem.disk_read(buffer, 0, 8) == 0);
+    CHECK(sim::now() == start);
+}
+
+int main()
+{
+    sparse();
+    zeros();
+    image();
+    faults();
+    latency();
+    hostDone("test_mem_fs");
+}
\ No newline at end of file
@@ -0,0 +1,129 @@
+// PinDetectGroup on the limit switch pins: a pin changes after four equal
+// samples and not before, glitches and bounces shorter than that are
+// filtered, and the attach callbacks fire once per change
+#include "mbed.h"
+#include "rtos.h"
+#include "PinDetectGroup.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <stdlib.h>
+
+static const int PERIOD = 100; // us
+
+PinDetectGroup inputs(Port0);
+GroupPin upper(inputs, p27, PullUp);
+GroupPin lower(inputs, p28, PullUp);
+
+static int upperAsserted, upperDeasserted, lowerAsserted, lowerDeasserted;
+
+static void upperOn() { upperAsserted++; }
+static void upperOff() { upperDeasserted++; }
+static void lowerOn() { lowerAsserted++; }
+static void lowerOff() { lowerDeasserted++; }
+
+static int calls()
+{
+    return upperAsserted + upperDeasserted + lowerAsserted + lowerDeasserted;
+}
+
+// Whole sample periods; main() starts half way between two samples, so
+// every sample sees a settled level
+static void settle(int samples)
+{
+    wait_us(samples * PERIOD);
+}
+
+// The fourth equal sample changes the pin, the third does not
+static void fourSamples()
+{
+    sim::io().input(p27, 1);
+    settle(3);
+    CHECK(upper == 0 && upperAsserted == 0);
+    settle(1);
+    CHECK(upper == 1 && upperAsserted == 1);
+    settle(20);
+    CHECK(upperAsserted == 1 && upperDeasserted == 0);
+
+    sim::io().input(p27, 0);
+    settle(3);
+    CHECK(upper == 1 && upperDeasserted == 0);
+    settle(1);
+    CHECK(upper == 0 && upperDeasserted == 1);
+    CHECK(lower == 0 && lowerAsserted == 0 && lowerDeasserted == 0);
+}
+
+// Three samples of a new level, then back: the counter starts over
+static void glitches()
+{
+    int before = calls();
+    for (int i = 0; i < 50; i++) {
+        sim::io().input(p28, 1);
+        settle(1 + i % 3);
+        sim::io().input(p28, 0);
+        settle(1);
+    }
+    CHECK(calls() == before);
+    CHECK(lower == 0);
+}
+
+// A switch bouncing faster than the sample period on every change
+static void bounces()
+{
+    srand(7);
+    int before = calls();
+    for (int change = 0; change < 20; change++) {
+        int level = change % 2 == 0;
+        for (int i = 0; i < 12; i++) {
+            sim::io().input(p28, rand() % 2);
+            wait_us(10 + rand() % 40);
+        }
+        sim::io().input(p28, level);
+        settle(8);
+        CHECK(lower == level);
+    }
+    CHECK(lowerAsserted == 10 && lowerDeasserted == 10);
+    CHECK(calls() == before + 20);
+}
+
+// Both switches change on the same sample, each is told once
+static void together()
+{
+    int before = calls();
+    sim::io().input(p27, 1);
+    sim::io().input(p28, 1);
+    settle(4);
+    CHECK(upper == 1 && lower == 1);
+    CHECK(calls() == before + 2);
+    sim::io().input(p27, 0);
+    sim::io().input(p28, 0);
+    settle(4);
+    CHECK(upper == 0 && lower == 0);
+    CHECK(calls() == before + 4);
+}
+
+// One tick per sample period, whatever the pins do
+static void ticks()
+{
+    inputs.resetCycles();
+    settle(1000);
+    printf("%u ticks in 100 ms\n", (unsigned)inputs.ticks());
+    CHECK(inputs.ticks() == 1000);
+}
+
+int main()
+{
+    sim::io().input(p27, 0);
+    sim::io().input(p28, 0);
+    upper.attach_asserted(&upperOn);
+    upper.attach_deasserted(&upperOff);
+    lower.attach_asserted(&lowerOn);
+    lower.attach_deasserted(&lowerOff);
+    inputs.setSampleFrequency(PERIOD);
+    wait_us(PERIOD / 2);
+    fourSamples();
+    glitches();
+    bounces();
+    together();
+    ticks();
+    hostDone("test_pin_detect");
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+// CutPlanner operations and estimates against a round figure cost model
+#include "mbed.h"
+#include "CutPlanner.h"
+#include "HostTest.h"
+#include <math.h>
+
+static const float STRIP = 155;
+static const float CUT = 142;
+// 100 in/s, 50 ms per feed, 150 ms per swing, 1 s per stroke
+static const CutCostModel MODEL = {100, 50, 150, 1000};
+static CutPlanner planner(STRIP, CUT, MODEL);
+
+static Job wire(float length, float leftStrip, float rightStrip, int quantity = 1, int priority = 0)
+{
+    Job job = {0, length, leftStrip, rightStrip, quantity, 0, priority};
+    return job;
+}
+
+// Operations spelled out as F (feed), S/C (swing to strip/cut) and | (stroke)
+static bool plans(const Job &job, float &guide, const char *expected)
+{
+    CutOp ops[CUT_PLANNER_MAX_OPS];
+    int n = planner.wireOps(job, guide, ops);
+    char got[CUT_PLANNER_MAX_OPS + 1];
+    for (int i = 0; i < n; i++) {
+        got[i] = ops[i].type == OP_FEED ? 'F' : ops[i].type == OP_STROKE ? '|' : ops[i].arg == STRIP ? 'S' : 'C';
+    }
+    got[n > 0 ? n : 0] = 0;
+    if (strcmp(got, expected) != 0) {
+        printf("%.2f/%.2f/%.2f: planned %s, expected %s\n", job.length, job.leftStrip, job.rightStrip, got, expected);
+        return false;
+    }
+    return true;
+}
+
+static void singleWires()
+{
+    float guide = CUT;
+    CHECK(plans(wire(2.0, 0.25, 0.25), guide, "FS|F|FC|"));
+    CHECK(guide == CUT);
+    CHECK(plans(wire(2.0, 0, 0), guide, "F|"));
+    // The strip on an end without an incision lands on a cut and is dropped
+    CHECK(plans(wire(2.0, 0.25, 0), guide, "FS|FC|"));
+    CHECK(plans(wire(2.0, 0, 0.25), guide, "FS|FC|"));
+    CHECK(plans(wire(2.0, 0.005, 0.25), guide, "FS|FC|"));
+    // Incisions meeting in the middle are one stroke
+    CHECK(plans(wire(2.0, 1.0, 1.0), guide, "FS|FC|"));
+    // From an unknown guide position the first stroke still swings
+    guide = GUIDE_UNKNOWN;
+    CHECK(plans(wire(2.0, 0, 0), guide, "FC|"));
+
+    // Feeds add up to the wire
+    CutOp ops[CUT_PLANNER_MAX_OPS];
+    Job job = wire(6.5, 0.5, 0.75);
+    int n = planner.wireOps(job, guide, ops);
+    float fed = 0;
+    for (int i = 0; i < n; i++) {
+        fed += ops[i].type == OP_FEED ? ops[i].arg : 0;
+    }
+    CHECK(fabsf(fed - job.length) < 1e-5f);
+}
+
+// Marks out of order would feed backwards; they are refused and leave the guide alone
+static void badMarks()
+{
+    const Job bad[] = {
+        wire(2.0, 1.5, 1.0), wire(2.0, -0.25, 0), wire(2.0, 0, -0.25), wire(0, 0, 0),
+        wire(-2.0, 0, 0), wire(NAN, 0.25, 0.25), wire(2.0, NAN, 0), wire(2.0, 0, NAN), wire(INFINITY, 0, 0)
+    };
+    for (unsigned i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        float guide = STRIP;
+        CutOp ops[CUT_PLANNER_MAX_OPS];
+        CHECK(planner.wireOps(bad[i], guide, ops) == -1);
+        CHECK(guide == STRIP);
+        CycleGraph graph;
+        graph.add(ACTION_CUT, 0);
+        CHECK(!planner.buildWire(bad[i], guide, graph));
+        CHECK(graph.size() == 0);
+    }
+    Job jobs[] = {wire(2.0, 1.5, 1.0, 10), wire(2.0, 0, 0)};
+    CHECK(planner.estimate(jobs, 2, CUT, true) == 50 + 20 + 1000);
+}
+
+// Consecutive wires share the cut between them and the guide where it was left
+static void acrossWires()
+{
+    float guide = CUT;
+    CHECK(plans(wire(2.0, 0, 0), guide, "F|"));
+    CHECK(plans(wire(2.0, 0, 0), guide, "F|"));
+    // Trailing strip of the first and leading strip of the second both on the cut between them
+    CHECK(plans(wire(2.0, 0.25, 0), guide, "FS|FC|"));
+    CHECK(plans(wire(2.0, 0, 0.25), guide, "FS|FC|"));
+    CHECK(guide == CUT);
+}
+
+// Estimates are the model's cost of exactly the operations planned
+static void estimates()
+{
+    Job both = wire(2.0, 0.25, 0.25, 10);
+    Job plain = wire(2.0, 0, 0, 10);
+    Job oneEnd = wire(2.0, 0.25, 0, 10);
+    // Fixed: 3 feeds, 2 swings, 3 strokes
+    int fixed = 3 * 50 + 20 + 2 * 150 + 3 * 1000;
+    CHECK(planner.estimate(&both, 1, CUT, false) == 10 * fixed);
+    CHECK(planner.estimate(&plain, 1, CUT, false) == 10 * fixed);
+    // Feeds of 0.25, 1.5 and 0.25 in, each rounded down to the ms
+    CHECK(planner.estimate(&both, 1, CUT, true) == 10 * (3 * 50 + 2 + 15 + 2 + 2 * 150 + 3 * 1000));
+    CHECK(planner.estimate(&plain, 1, CUT, true) == 10 * (50 + 20 + 1000));
+    CHECK(planner.estimate(&oneEnd, 1, CUT, true) == 10 * (2 * 50 + 2 + 17 + 2 * 150 + 2 * 1000));
+    // The first wire swings in from an unknown guide position
+    CHECK(planner.estimate(&plain, 1, GUIDE_UNKNOWN, true) == 10 * (50 + 20 + 1000) + 150);
+    // Only the wires left count
+    plain.done = 7;
+    CHECK(planner.estimate(&plain, 1, CUT, true) == 3 * (50 + 20 + 1000));
+}
+
+// Priority first, then jobs that start without a swing, and never costlier than queue order
+static void ordering()
+{
+    Job jobs[] = {
+        wire(2.0, 0.25, 0.25, 5), wire(3.0, 0, 0, 5), wire(4.0, 0.5, 0, 5, 1), wire(1.0, 0, 0, 5)
+    };
+    for (int i = 0; i < 4; i++) {
+        jobs[i].id = i + 1;
+    }
+    int before = planner.estimate(jobs, 4, STRIP, true);
+    planner.order(jobs, 4, STRIP);
+    int after = planner.estimate(jobs, 4, STRIP, true);
+    printf("order: %i, %i, %i, %i; %i ms planned in queue order, %i ms ordered, %i ms fixed cycle\n",
+           jobs[0].id, jobs[1].id, jobs[2].id, jobs[3].id, before, after, planner.estimate(jobs, 4, STRIP, false));
+    CHECK(jobs[0].id == 3);
+    // The job with strips is left for last, after the plain ones that need no swing from the cut
+    CHECK(jobs[3].id == 1);
+    CHECK(after <= before);
+}
+
+int main()
+{
+    singleWires();
+    badMarks();
+    acrossWires();
+    estimates();
+    ordering();
+    hostDone("test_planner");
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+// SDFileSystem CRCs: the table driven CRC7 and CRC16 against the vectors of
+// the SD spec and the bit by bit reference of the simulated card, and blocks
+// and the CSD read again after a CRC failure
+#include "mbed.h"
+#include "SDFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** The driver with its CRCs open to the test */
+class TestSd : public SDFileSystem
+{
+public:
+    TestSd():SDFileSystem(p5, p6, p7, p8, "sd")
+    {
+    }
+
+    uint8_t crc7(const uint8_t *data, uint32_t length) { return _crc7(data, length); }
+    uint16_t crc16(const uint8_t *data, uint32_t length) { return _crc16(data, length); }
+};
+
+TestSd sd;
+
+static const uint32_t FIRST = 2048;
+static uint8_t out[8 * 512];
+static uint8_t in[8 * 512];
+
+// Examples from the SD physical layer spec, and the usual CRC16 check value
+static void vectors()
+{
+    const uint8_t cmd0[] = {0x40, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t cmd8[] = {0x48, 0x00, 0x00, 0x01, 0xAA};
+    const uint8_t cmd17[] = {0x51, 0x00, 0x00, 0x00, 0x00};
+    const uint8_t r17[] = {0x11, 0x00, 0x00, 0x09, 0x00};
+    CHECK(sd.crc7(cmd0, 5) == 0x4A);
+    CHECK(sd.crc7(cmd8, 5) == 0x43);
+    CHECK(sd.crc7(cmd17, 5) == 0x2A);
+    CHECK(sd.crc7(r17, 5) == 0x33);
+
+    uint8_t ones[512];
+    memset(ones, 0xFF, sizeof(ones));
+    CHECK(sd.crc16(ones, 512) == 0x7FA1);
+    CHECK(sd.crc16((const uint8_t *)"123456789", 9) == 0x31C3);
+    CHECK(sd.crc16(ones, 0) == 0);
+}
+
+// The tables agree with the card's bit by bit CRCs on any data
+static void reference()
+{
+    srand(13);
+    int bad = 0;
+    for (int n = 0; n < 500; n++) {
+        int length = 1 + rand() % 512;
+        for (int i = 0; i < length; i++) {
+            out[i] = (uint8_t)rand();
+        }
+        bad += sd.crc7(out, length) != sim::SdCard::crc7(out, length);
+        bad += sd.crc16(out, length) != sim::SdCard::crc16(out, length);
+    }
+    CHECK(bad == 0);
+}
+
+// A CSD read failing its CRC is read again, and the size comes out right
+static void csd()
+{
+    sim::SdCard &card = *sim::board().sd;
+    sd.set_crc(true);
+    card.corruptReads(1);
+    CHECK(sd.disk_initialize() == 0);
+    CHECK(card.crcMode());
+    CHECK(sd.crc_errors() == 1);
+    CHECK(sd.disk_sectors() == card.sectors());
+}
+
+// Corrupt blocks are read again and rejected ones written again, up to the limit
+static void blocks()
+{
+    sim::SdCard &card = *sim::board().sd;
+    for (unsigned i = 0; i < sizeof(out); i++) {
+        out[i] = (uint8_t)(i * 31 + 7);
+    }
+    uint32_t errors = sd.crc_errors();
+    card.rejectWrites(2);
+    CHECK(sd.disk_write(out, FIRST, 8) == 0);
+    CHECK(sd.crc_errors() == errors + 2);
+
+    errors = sd.crc_errors();
+    card.corruptReads(2);
+    memset(in, 0, sizeof(in));
+    CHECK(sd.disk_read(in, FIRST, 8) == 0);
+    CHECK(memcmp(in, out, sizeof(out)) == 0);
+    // The card may have queued the block after a bad one before the stop
+    CHECK(sd.crc_errors() > errors);
+
+    // A block that never reads clean fails the call, the card stays usable
+    card.corruptReads(100);
+    CHECK(sd.disk_read(in, FIRST, 1) != 0);
+    card.corruptReads(0);
+    memset(in, 0, sizeof(in));
+    CHECK(sd.disk_read(in, FIRST, 8) == 0);
+    CHECK(memcmp(in, out, sizeof(out)) == 0);
+    CHECK(card.commandCrcErrors() == 0);
+    printf("%u CRC errors retried\n", sd.crc_errors());
+}
+
+int main()
+{
+    vectors();
+    reference();
+    csd();
+    blocks();
+    hostDone("test_sd_crc");
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+// Sector cache on a RAM disk slowed to SD card speed: a log appended sector
+// by sector and a small file rewritten over and over. Built twice, with the
+// cache and with it compiled out (test_sector_cache_off), to compare.
+#include "mbed.h"
+#include "MemFileSystem.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <string.h>
+
+MemFileSystem mem("mem", 64 * 1024);
+
+static const int RECORDS = 512;
+static const int RECORD_BYTES = 64;
+static const int REWRITES = 50;
+
+typedef struct {
+    int ms;
+    uint32_t reads;
+    uint32_t writes;
+} Cost;
+
+static void begin(Cost &cost)
+{
+    cost.ms = (int)(sim::now() / sim::MS);
+    cost.reads = mem.reads();
+    cost.writes = mem.writes();
+}
+
+static void end(Cost &cost, const char *what)
+{
+    cost.ms = (int)(sim::now() / sim::MS) - cost.ms;
+    cost.reads = mem.reads() - cost.reads;
+    cost.writes = mem.writes() - cost.writes;
+    printf("%-28s %6i ms, %5u disk reads, %5u disk writes\n", what, cost.ms, cost.reads, cost.writes);
+}
+
+static void record(char *line, int i)
+{
+    snprintf(line, RECORD_BYTES + 1, "%06i %-56s\n", i, "cut 2.00 in, strips 0.25/0.25, 1480 ms");
+}
+
+// Whole sectors of records appended and synced, as TelemetryLog writes them
+static void appendLog()
+{
+    Cost cost;
+    begin(cost);
+    FileHandle *file = mem.open("cuts.log", O_WRONLY | O_CREAT | O_APPEND);
+    CHECK(file != NULL);
+    char sector[512 + 1];
+    for (int i = 0; file && i < RECORDS; i += 512 / RECORD_BYTES) {
+        for (int j = 0; j < 512 / RECORD_BYTES; j++) {
+            record(sector + j * RECORD_BYTES, i + j);
+        }
+        CHECK(file->write(sector, 512) == 512);
+        CHECK(file->fsync() == 0);
+    }
+    CHECK(file && file->close() == 0);
+    end(cost, "log, 64 sectors appended");
+}
+
+// A job file rewritten whole after every wire
+static void rewriteFile()
+{
+    Cost cost;
+    begin(cost);
+    for (int i = 0; i < REWRITES; i++) {
+        FILE *fp = fopen("/mem/jobs.txt", "w");
+        CHECK(fp != NULL);
+        fprintf(fp, "1 2.00 0.25 0.25 100 %d 0\n2 6.50 0.50 0.00 20 0 1\n", i);
+        CHECK(fclose(fp) == 0);
+    }
+    end(cost, "job file, 50 rewrites");
+}
+
+// Everything reaches the disk: remounted, both files read back as written
+static void verify()
+{
+    CHECK(mem.unmount() == 0);
+    CHECK(mem.mount() == 0);
+    FILE *fp = fopen("/mem/cuts.log", "r");
+    CHECK(fp != NULL);
+    char line[RECORD_BYTES + 1], expected[RECORD_BYTES + 1];
+    int ok = 0;
+    for (int i = 0; i < RECORDS && fp; i++) {
+        record(expected, i);
+        if (fread(line, 1, RECORD_BYTES, fp) == RECORD_BYTES && memcmp(line, expected, RECORD_BYTES) == 0) {
+            ok++;
+        }
+    }
+    CHECK(ok == RECORDS);
+    if (fp) {
+        fclose(fp);
+    }
+    fp = fopen("/mem/jobs.txt", "r");
+    CHECK(fp != NULL);
+    int id, quantity, done = -1;
+    float length, left, right;
+    if (fp) {
+        CHECK(fscanf(fp, "%d %f %f %f %d %d", &id, &length, &left, &right, &quantity, &done) == 6);
+        fclose(fp);
+    }
+    CHECK(done == REWRITES - 1);
+}
+
+int main()
+{
+    sdCardLatency(mem);
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    appendLog();
+    rewriteFile();
+    verify();
+    SectorCache &cache = mem._cache;
+    printf("cache %ix%i: %u hits, %u misses, %u write backs\n", FFS_CACHE_SETS, FFS_CACHE_WAYS,
+           cache.hits(), cache.misses(), cache.writebacks());
+#if FFS_CACHE_WAYS
+    CHECK(cache.hits() > 0);
+    // Every hit is a disk access saved
+    CHECK(mem.reads() + mem.writes() < cache.hits() + cache.misses());
+    hostDone("test_sector_cache");
+#else
+    CHECK(cache.hits() == 0);
+    hostDone("test_sector_cache_off");
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+// StateMachine on a table of its own: the first row whose handler accepts
+// is taken and a rejecting guard falls through to the rows after it,
+// STATE_ANY rows, ignored events, a full EventQueue, and the time from an
+// input interrupt to the redraw it causes
+#include "mbed.h"
+#include "rtos.h"
+#include "StateMachine.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <stdlib.h>
+
+enum { IDLE, ARMED, RUNNING };
+enum { ARM = 1, GO = 2, STOP = 3 };
+
+static bool allowed;
+static int guards, refusals, pings, redraws;
+
+static bool guard(const Event &event)
+{
+    guards++;
+    return allowed;
+}
+
+static bool refuse(const Event &event)
+{
+    refusals++;
+    return true;
+}
+
+static bool ping(const Event &event)
+{
+    pings++;
+    return true;
+}
+
+static const Transition table[] = {
+    {STATE_ANY, EVENT_FRAME,  'P',       &ping,   STATE_SAME},
+
+    {IDLE,      EVENT_BUTTON, ARM,       NULL,    ARMED},
+    {IDLE,      EVENT_BUTTON, GO,        &guard,  RUNNING},
+
+    {ARMED,     EVENT_BUTTON, GO,        &guard,  RUNNING},
+    {ARMED,     EVENT_BUTTON, GO,        &refuse, STATE_SAME},
+    {ARMED,     EVENT_BUTTON, EVENT_ANY, NULL,    IDLE},
+
+    {RUNNING,   EVENT_BUTTON, STOP,      NULL,    IDLE},
+    {STATE_ANY, EVENT_BUTTON, STOP,      &ping,   IDLE},
+};
+
+StateMachine machine(table, sizeof(table) / sizeof(table[0]), IDLE);
+
+static void redraw()
+{
+    redraws++;
+}
+
+static bool button(int code)
+{
+    Event e = {EVENT_BUTTON, (uint8_t)code, 0};
+    return machine.dispatch(e);
+}
+
+// A guard that rejects hands the event to the next row, one that accepts
+// takes its row and the rows after it are never tried
+static void fallThrough()
+{
+    int handled = machine.handled();
+    CHECK(button(ARM) && machine.state() == ARMED);
+    allowed = false;
+    CHECK(button(GO));
+    CHECK(machine.state() == ARMED && guards == 1 && refusals == 1);
+    allowed = true;
+    CHECK(button(GO));
+    CHECK(machine.state() == RUNNING && guards == 2 && refusals == 1);
+    // EVENT_ANY after the GO rows catches every other button
+    CHECK(button(STOP) && machine.state() == IDLE);
+    CHECK(button(ARM) && button(ARM + 10) && machine.state() == IDLE);
+    CHECK(machine.handled() == handled + 6 && redraws == 6);
+}
+
+// STATE_ANY rows apply in every state, in their place in the table: the
+// last one only gets STOP where no row of the state took it first
+static void anyState()
+{
+    int handled = machine.handled();
+    Event frame = {EVENT_FRAME, 'P', 0};
+    allowed = true;
+    for (int state = IDLE; state <= RUNNING; state++) {
+        if (state >= ARMED) {
+            button(ARM);
+        }
+        if (state == RUNNING) {
+            button(GO);
+        }
+        pings = 0;
+        CHECK(machine.dispatch(frame) && machine.state() == state && pings == 1);
+        CHECK(button(STOP) && machine.state() == IDLE);
+        CHECK(pings == 1 + (state == IDLE));
+    }
+    CHECK(machine.handled() == handled + 0 + 1 + 2 + 3 * 2);
+}
+
+// No row, a row for another code, and a guard with nothing after it are all
+// ignored: no state change, no redraw
+static void ignored()
+{
+    int ignoredBefore = machine.ignored(), handled = machine.handled(), before = redraws;
+    Event timer = {EVENT_TIMER, 1, 0};
+    Event frame = {EVENT_FRAME, 'Q', 0};
+    CHECK(!machine.dispatch(timer));
+    CHECK(!machine.dispatch(frame));
+    allowed = false;
+    CHECK(!button(GO));
+    CHECK(machine.state() == IDLE);
+    CHECK(machine.ignored() == ignoredBefore + 3);
+    CHECK(machine.handled() == handled && redraws == before);
+}
+
+// A post to a full queue is dropped and counted, the queued events come
+// out in order with their fields intact
+static void dropped()
+{
+    EventQueue queue;
+    for (int i = 0; i < EVENT_QUEUE_SIZE + 5; i++) {
+        CHECK(queue.post(EVENT_ENCODER, i, 1000 + i) == (i < EVENT_QUEUE_SIZE));
+    }
+    CHECK(queue.posted() == EVENT_QUEUE_SIZE && queue.dropped() == 5);
+    Event e;
+    int n = 0;
+    bool same = true;
+    while (queue.wait(e, 0)) {
+        same = same && e.type == EVENT_ENCODER && e.code == n && e.value == 1000 + n;
+        n++;
+    }
+    CHECK(n == EVENT_QUEUE_SIZE && same);
+    CHECK(queue.post(EVENT_ENCODER) && queue.dropped() == 5);
+}
+
+// The firmware's threads: a dispatcher running the machine on the input
+// queue, and a display thread woken by the redraws it posts
+static const Transition echo[] = {
+    {STATE_ANY, EVENT_BUTTON, EVENT_ANY, NULL, STATE_SAME},
+};
+StateMachine runner(echo, 1, IDLE);
+EventQueue inputs;
+EventQueue screen;
+
+static volatile sim::ns_t postedAt;
+static sim::ns_t worstLatency, totalLatency;
+static int frames;
+
+static void postRedraw()
+{
+    screen.post(EVENT_REDRAW);
+}
+
+static void dispatcher()
+{
+    runner.run(inputs);
+}
+
+static void display()
+{
+    Event e;
+    while (screen.wait(e)) {
+        sim::ns_t latency = sim::now() - postedAt;
+        totalLatency += latency;
+        worstLatency = latency > worstLatency ? latency : worstLatency;
+        frames++;
+    }
+}
+
+static void buttonIrq()
+{
+    postedAt = sim::now();
+    inputs.post(EVENT_BUTTON, GO);
+}
+
+// Buttons from an interrupt at random times, each one redrawn before the next
+static void latency()
+{
+    runner.attach(&postRedraw);
+    Thread dispatchThread(osPriorityAboveNormal);
+    Thread displayThread(osPriorityNormal);
+    dispatchThread.start(&dispatcher);
+    displayThread.start(&display);
+    srand(21);
+    Timeout press;
+    const int presses = 200;
+    for (int i = 0; i < presses; i++) {
+        press.attach_us(&buttonIrq, 1000 + rand() % 50000);
+        Thread::wait(60);
+    }
+    printf("input to redraw: %i frames, %.1f us mean, %.1f us worst\n", frames,
+           (double)totalLatency / presses / sim::US, (double)worstLatency / sim::US);
+    CHECK(frames == presses);
+    CHECK(runner.handled() == presses && inputs.dropped() == 0);
+    // Straight through, no polling period on the way
+    CHECK(worstLatency < 1 * sim::MS);
+}
+
+int main()
+{
+    machine.attach(&redraw);
+    fallThrough();
+    anyState();
+    ignored();
+    dropped();
+    latency();
+    hostDone("test_state_machine");
+}
\ No newline at end of file
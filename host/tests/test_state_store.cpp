@@ -0,0 +1,196 @@
+// StateStore on a RAM disk, its records read back raw: the log wraps past
+// STATE_STORE_SECTORS, a torn newest record falls back to the one before,
+// a failed write is retried in its slot, and a log left in pieces is made
+// again in one run
+#include "mbed.h"
+#include "rtos.h"
+#include "MemFileSystem.h"
+#include "StateStore.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <string.h>
+
+static const uint32_t MAGIC = 0x57495245;
+static const char *LOG = "state.log";
+
+MemFileSystem mem("mem", 4096);
+
+/** The records found on the disk */
+struct Log {
+    uint32_t first;  // lowest sector holding a record
+    int records;
+    uint32_t newest; // sector of the record with the highest sequence
+    uint32_t sequence;
+};
+
+// Every sector that looks like a record, the checksum is left to the store
+static Log scan()
+{
+    Log log = {0xFFFFFFFF, 0, 0, 0};
+    uint32_t sector[128];
+    for (uint32_t s = 0; s < mem.disk_sectors(); s++) {
+        if (mem.disk_read((uint8_t *)sector, s, 1) != 0 || sector[0] != MAGIC || sector[2] != STATE_STORE_KEYS) {
+            continue;
+        }
+        log.records++;
+        log.first = s < log.first ? s : log.first;
+        if (sector[1] > log.sequence) {
+            log.newest = s;
+            log.sequence = sector[1];
+        }
+    }
+    return log;
+}
+
+// The sector after s in a log that starts at first
+static uint32_t after(const Log &log, uint32_t s)
+{
+    return log.first + (s - log.first + 1) % STATE_STORE_SECTORS;
+}
+
+// The file system mounted again and a new store on it, as after a reset
+static void reboot()
+{
+    CHECK(mem.unmount() == 0);
+    CHECK(mem.mount() == 0);
+}
+
+static int32_t intValue(StateStore &store, int key)
+{
+    int32_t value = -1;
+    store.getInt(key, value);
+    return value;
+}
+
+// Two and a bit times round the log: every slot holds a record, the newest
+// STATE_STORE_SECTORS, and the next one after a reset replaces the oldest
+static void wrap()
+{
+    const int n = 2 * STATE_STORE_SECTORS + 5;
+    {
+        StateStore store(mem, LOG);
+        CHECK(store.mount());
+        for (int i = 1; i <= n; i++) {
+            store.setInt(0, i);
+            store.setFloat(1, i * 0.5f);
+            CHECK(store.commit());
+        }
+        CHECK(store.commits() == n);
+    }
+    Log log = scan();
+    printf("wrap: %i commits, %i records, newest %u in sector %u\n", n, log.records, log.sequence, log.newest);
+    CHECK(log.records == STATE_STORE_SECTORS);
+    CHECK(log.sequence == (uint32_t)n);
+    CHECK(log.newest == log.first + (n - 1) % STATE_STORE_SECTORS);
+
+    reboot();
+    StateStore store(mem, LOG);
+    CHECK(store.mount());
+    float f = 0;
+    CHECK(intValue(store, 0) == n);
+    CHECK(store.getFloat(1, f) && f == n * 0.5f);
+    store.setInt(0, n + 1);
+    CHECK(store.commit());
+    Log next = scan();
+    CHECK(next.records == STATE_STORE_SECTORS);
+    CHECK(next.sequence == (uint32_t)n + 1 && next.newest == after(log, log.newest));
+}
+
+// A newest record torn by a power cut fails its checksum, the one before
+// it is loaded and the next commit goes to the torn slot
+static void torn()
+{
+    {
+        StateStore store(mem, LOG);
+        CHECK(store.mount());
+        store.setInt(0, 1000);
+        CHECK(store.commit());
+        store.setInt(0, 1001);
+        CHECK(store.commit());
+    }
+    Log log = scan();
+    CHECK(mem.unmount() == 0);
+    uint32_t sector[128];
+    CHECK(mem.disk_read((uint8_t *)sector, log.newest, 1) == 0);
+    sector[100] ^= 0x10;
+    CHECK(mem.disk_write((uint8_t *)sector, log.newest, 1) == 0);
+    CHECK(mem.mount() == 0);
+
+    StateStore store(mem, LOG);
+    CHECK(store.mount());
+    CHECK(intValue(store, 0) == 1000);
+    store.setInt(0, 1002);
+    CHECK(store.commit());
+    Log next = scan();
+    CHECK(next.newest == log.newest && next.sequence == log.sequence);
+    reboot();
+    StateStore again(mem, LOG);
+    CHECK(again.mount() && intValue(again, 0) == 1002);
+}
+
+// A write the card refused leaves the value in RAM and every record on the
+// disk as it was, and the retry goes to the same slot
+static void failedWrite()
+{
+    StateStore store(mem, LOG);
+    CHECK(store.mount());
+    Log log = scan();
+    mem.fail_writes_after(0);
+    store.setInt(0, 2000);
+    CHECK(!store.commit());
+    mem.fail_writes_after(-1);
+    CHECK(intValue(store, 0) == 2000);
+    Log failed = scan();
+    CHECK(failed.newest == log.newest && failed.sequence == log.sequence);
+
+    CHECK(store.commit());
+    Log next = scan();
+    CHECK(next.sequence == log.sequence + 1 && next.newest == after(log, log.newest));
+    reboot();
+    StateStore again(mem, LOG);
+    CHECK(again.mount() && intValue(again, 0) == 2000);
+}
+
+// A log written a sector at a time alongside another file is in pieces:
+// mount() makes it again in one run and the other file is untouched
+static void fragmented()
+{
+    CHECK(mem.remove(LOG) == 0);
+    const int bytes = STATE_STORE_SECTORS * 512;
+    FileHandle *log = mem.open(LOG, O_WRONLY | O_CREAT | O_TRUNC);
+    FileHandle *other = mem.open("other.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    CHECK(log != NULL && other != NULL);
+    char buffer[512];
+    for (int at = 0; log && other && at < bytes; at += sizeof(buffer)) {
+        memset(buffer, 0, sizeof(buffer));
+        CHECK(log->write(buffer, sizeof(buffer)) == (ssize_t)sizeof(buffer));
+        for (unsigned i = 0; i < sizeof(buffer); i++) {
+            buffer[i] = fileByte(9, at + i);
+        }
+        CHECK(other->write(buffer, sizeof(buffer)) == (ssize_t)sizeof(buffer));
+    }
+    CHECK(log && log->close() == 0);
+    CHECK(other && other->close() == 0);
+
+    {
+        StateStore store(mem, LOG);
+        CHECK(store.mount());
+        store.setInt(0, 3000);
+        CHECK(store.commit());
+    }
+    reboot();
+    StateStore store(mem, LOG);
+    CHECK(store.mount() && intValue(store, 0) == 3000);
+    CHECK(checkFile(mem, "other.bin", 9, bytes));
+}
+
+int main()
+{
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    wrap();
+    torn();
+    failedWrite();
+    fragmented();
+    hostDone("test_state_store");
+}
\ No newline at end of file
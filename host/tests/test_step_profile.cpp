@@ -0,0 +1,175 @@
+// Motion limits and step counts of StepProfile, and the Stepper running it
+#include "mbed.h"
+#include "Stepper.h"
+#include "StepProfile.h"
+#include "SimIo.h"
+#include "HostTest.h"
+#include "params.h"
+#include <math.h>
+
+static const PinName STEP = p26;
+static const PinName DIR = p12;
+
+/** Rising edges of the step pin */
+class Pulses : public sim::PinListener
+{
+public:
+    Pulses():count(0)
+    {
+    }
+
+    virtual void pinChanged(int pin, int level)
+    {
+        count += level;
+    }
+
+    int count;
+};
+
+/** Speed, acceleration and jerk seen along a planned move */
+typedef struct {
+    float startSpeed;
+    float peakSpeed;
+    float maxAccel;
+    float maxJerk;
+    float seconds;
+    bool symmetric;
+} Motion;
+
+// Speeds are taken over windows of steps: single intervals are rounded to
+// 1/16 us, which alone would look like huge accelerations at full speed
+static Motion measure(const StepProfile &profile)
+{
+    Motion m = {0, 0, 0, 0, 0, true};
+    int steps = profile.steps();
+    int window = steps / 16;
+    if (window < 1) {
+        window = 1;
+    } else if (window > 32) {
+        window = 32;
+    }
+    float t = 0, windowStart = 0, lastT = 0, lastV = 0, lastA = 0, lastAT = 0;
+    int windows = 0;
+    for (int n = 0; n < steps; n++) {
+        float dt = profile.interval(n) / (1000000.0f * (1 << STEP_PROFILE_FRAC_BITS));
+        if (n == 0) {
+            m.startSpeed = 1 / dt;
+        }
+        m.peakSpeed = fmaxf(m.peakSpeed, 1 / dt);
+        if (profile.interval(n) != profile.interval(steps - 1 - n)) {
+            m.symmetric = false;
+        }
+        t += dt;
+        if ((n + 1) % window != 0) {
+            continue;
+        }
+        float v = window / (t - windowStart);
+        float mid = (t + windowStart) / 2;
+        if (windows > 0) {
+            float a = (v - lastV) / (mid - lastT);
+            float at = (mid + lastT) / 2;
+            m.maxAccel = fmaxf(m.maxAccel, fabsf(a));
+            if (windows > 1) {
+                m.maxJerk = fmaxf(m.maxJerk, fabsf(a - lastA) / (at - lastAT));
+            }
+            lastA = a;
+            lastAT = at;
+        }
+        windows++;
+        lastV = v;
+        lastT = mid;
+        windowStart = t;
+    }
+    m.seconds = t;
+    return m;
+}
+
+// The feeder's own limits, on long moves and on moves too short to reach cruise
+static void limits(ProfileMode mode, float accelMargin, float jerkMargin)
+{
+    const int lengths[] = {4, 50, 400, 1500, 5000, 20000};
+    for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        StepProfile profile;
+        profile.plan(lengths[i], FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, mode);
+        Motion m = measure(profile);
+        printf("%s %5i steps: ramp %4i, start %6.0f, peak %6.0f steps/s, accel %6.0f steps/s^2, jerk %8.0f steps/s^3, %.3f s\n",
+               mode == PROFILE_SCURVE ? "S-curve  " : "trapezoid", lengths[i], profile.rampSteps(),
+               m.startSpeed, m.peakSpeed, m.maxAccel, m.maxJerk, m.seconds);
+        CHECK(profile.steps() == lengths[i]);
+        CHECK(m.symmetric);
+        CHECK(m.peakSpeed <= FEEDER_MAX_SPEED * 1.001f);
+        // The mean speed over a step of a short ramp stays under the speed it ends at
+        CHECK(m.peakSpeed <= profile.peakSpeed() * 1.01f && m.peakSpeed >= profile.peakSpeed() * 0.9f);
+        CHECK(m.startSpeed >= FEEDER_START_SPEED * 0.9f);
+        CHECK(m.maxAccel <= FEEDER_ACCEL * accelMargin);
+        if (mode == PROFILE_SCURVE) {
+            CHECK(m.maxJerk <= FEEDER_JERK * jerkMargin);
+        }
+    }
+    // A long move spends its middle at cruise
+    StepProfile profile;
+    profile.plan(20000, FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, mode);
+    CHECK(fabsf(profile.peakSpeed() - FEEDER_MAX_SPEED) < 1);
+}
+
+// The table is reused after a long plan and grown after a short one
+static void replan()
+{
+    StepProfile profile;
+    profile.plan(40, FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, PROFILE_TRAPEZOID);
+    int shortRamp = profile.rampSteps();
+    profile.plan(20000, FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, PROFILE_TRAPEZOID);
+    Motion longMove = measure(profile);
+    profile.plan(40, FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, PROFILE_TRAPEZOID);
+    CHECK(profile.rampSteps() == shortRamp);
+    CHECK(longMove.maxAccel <= FEEDER_ACCEL * 1.05f);
+    CHECK(measure(profile).symmetric);
+}
+
+// No acceleration limit gives no ramp, the move runs at the start speed
+static void noAccel()
+{
+    const float accels[] = {0, -FEEDER_ACCEL};
+    for (int mode = PROFILE_TRAPEZOID; mode <= PROFILE_SCURVE; mode++) {
+        for (unsigned i = 0; i < sizeof(accels) / sizeof(accels[0]); i++) {
+            StepProfile profile;
+            profile.plan(400, FEEDER_START_SPEED, FEEDER_MAX_SPEED, accels[i], FEEDER_JERK, (ProfileMode)mode);
+            Motion m = measure(profile);
+            CHECK(profile.rampSteps() == 0);
+            CHECK(profile.peakSpeed() == FEEDER_START_SPEED);
+            CHECK(fabsf(m.startSpeed - FEEDER_START_SPEED) < 1 && fabsf(m.peakSpeed - FEEDER_START_SPEED) < 1);
+        }
+    }
+}
+
+// The ISR makes exactly the planned number of steps, whatever the ramp
+static void stepCount(Stepper &stepper, Pulses &pulses)
+{
+    const int lengths[] = {1, 2, 3, 7, 100, 1873, 5000};
+    for (int mode = PROFILE_TRAPEZOID; mode <= PROFILE_SCURVE; mode++) {
+        for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+            StepProfile profile;
+            profile.plan(lengths[i], FEEDER_START_SPEED, FEEDER_MAX_SPEED, FEEDER_ACCEL, FEEDER_JERK, (ProfileMode)mode);
+            Motion m = measure(profile);
+            pulses.count = 0;
+            stepper.move(profile, 1, 1);
+            Thread::wait((int)(m.seconds * 1000) + 10);
+            CHECK(!stepper.busy());
+            CHECK(pulses.count == lengths[i]);
+            CHECK(stepper.stepsTaken() == lengths[i]);
+        }
+    }
+}
+
+int main()
+{
+    Stepper stepper(NC, NC, NC, NC, STEP, DIR);
+    Pulses pulses;
+    sim::io().watch(STEP, &pulses);
+    limits(PROFILE_TRAPEZOID, 1.05f, 0);
+    limits(PROFILE_SCURVE, 1.05f, 1.25f);
+    replan();
+    noAccel();
+    stepCount(stepper, pulses);
+    hostDone("test_step_profile");
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+// Step pulse timing of the ticker driven Stepper, on the virtual clock
+#include "mbed.h"
+#include "Stepper.h"
+#include "SimIo.h"
+#include "HostTest.h"
+#include <vector>
+
+// Pins no model of the board listens to
+static const PinName STEP = p26;
+static const PinName DIR = p12;
+
+/** Every edge of the step pin, in us */
+class Edges : public sim::PinListener
+{
+public:
+    virtual void pinChanged(int pin, int level)
+    {
+        times.push_back(sim::now() / sim::US);
+        levels.push_back(level);
+    }
+
+    void clear()
+    {
+        times.clear();
+        levels.clear();
+    }
+
+    std::vector<uint64_t> times;
+    std::vector<int> levels;
+};
+
+static Edges edges;
+static int doneCalls;
+static uint64_t doneAt;
+
+static void moveDone()
+{
+    doneCalls++;
+    doneAt = sim::now() / sim::US;
+}
+
+// Starts on the rising edge, alternates, ends low
+static bool wellFormed()
+{
+    for (size_t i = 0; i < edges.levels.size(); i++) {
+        if (edges.levels[i] != (int)((i + 1) & 1)) {
+            return false;
+        }
+    }
+    return edges.levels.size() % 2 == 0;
+}
+
+static void startMove(Stepper &stepper, int steps, float speed)
+{
+    edges.clear();
+    doneCalls = 0;
+    stepper.move(steps, 1, 1, speed, &moveDone);
+}
+
+// Whole microsecond rate: every edge exactly 1/speed after the last
+static void exactRate(Stepper &stepper)
+{
+    uint64_t start = sim::now() / sim::US;
+    startMove(stepper, 100, 4000);
+    CHECK(stepper.busy());
+    Thread::wait(100);
+    CHECK(!stepper.busy());
+    CHECK(stepper.stepsTaken() == 100);
+    CHECK(edges.times.size() == 200);
+    CHECK(wellFormed());
+    CHECK(edges.times[0] == start + 250);
+    for (size_t i = 1; i < edges.times.size(); i++) {
+        CHECK(edges.times[i] - edges.times[i - 1] == 250);
+    }
+    CHECK(doneCalls == 1);
+    CHECK(doneAt == edges.times.back());
+    CHECK(sim::io().level(DIR) == 0);
+}
+
+// Fractional rate: the 1/16 us remainder is carried, so the train does not drift
+static void fractionalRate(Stepper &stepper)
+{
+    uint64_t start = sim::now() / sim::US;
+    const int steps = 3000;
+    startMove(stepper, steps, 3000);
+    Thread::wait(3000);
+    CHECK(edges.times.size() == 2 * steps);
+    CHECK(wellFormed());
+    for (size_t i = 1; i < edges.times.size(); i++) {
+        uint64_t gap = edges.times[i] - edges.times[i - 1];
+        CHECK(gap == 333 || gap == 334);
+    }
+    // 6000 edges of 333.3125 us, the nearest 1/16 us under 1e6/3000
+    uint64_t exact = start + (uint64_t)(2 * steps * 5333 / 16);
+    CHECK(edges.times.back() >= exact - 1 && edges.times.back() <= exact + 1);
+    CHECK(doneCalls == 1);
+}
+
+// stop() ends the train low and never calls the completion callback
+static void stopped(Stepper &stepper)
+{
+    startMove(stepper, 1000, 2000);
+    Thread::wait(10);
+    stepper.stop();
+    size_t count = edges.times.size();
+    CHECK(count > 0 && count < 2000);
+    CHECK(sim::io().level(STEP) == 0);
+    Thread::wait(1000);
+    CHECK(edges.times.size() == count);
+    CHECK(!stepper.busy());
+    CHECK(doneCalls == 0);
+}
+
+// run() keeps stepping in the other direction until stopped
+static void running(Stepper &stepper)
+{
+    edges.clear();
+    stepper.run(1, 0, 1000);
+    Thread::wait(1000);
+    CHECK(stepper.busy());
+    CHECK(stepper.stepsTaken() >= 499 && stepper.stepsTaken() <= 500); // the last edge may fall with the wakeup
+    CHECK(sim::io().level(DIR) == 1);
+    stepper.stop();
+    CHECK(!stepper.busy());
+}
+
+int main()
+{
+    Stepper stepper(NC, NC, NC, NC, STEP, DIR);
+    sim::io().watch(STEP, &edges);
+    exactRate(stepper);
+    fractionalRate(stepper);
+    stopped(stepper);
+    running(stepper);
+    hostDone("test_stepper");
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+// TelemetryLog on a RAM disk slowed to SD card speed: syncs per sector in
+// a burst, the sync deadline while records trickle in, records dropped by a
+// full queue, and the records read back in order and through decode_log.py
+#include "mbed.h"
+#include "rtos.h"
+#include "MemFileSystem.h"
+#include "TelemetryLog.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+MemFileSystem mem("mem", 16 * 1024);
+TelemetryLog cutLog(mem, "cuts.bin");
+
+static const int BURST_SECTORS = 40;
+
+static int records;
+
+static bool logCut(int ms)
+{
+    LogRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = LOG_CUT;
+    r.job = 1;
+    r.wire = ++records;
+    r.length = 2.0f;
+    r.fed = 2.0f;
+    r.cycleMs = logMs(ms);
+    r.strokeMs = logMs(ms / 4);
+    return cutLog.log(r);
+}
+
+// Whole sectors as fast as the queue takes them
+static void burst()
+{
+    int sectors = cutLog.sectors(), syncs = cutLog.syncs();
+    uint32_t writes = mem.writes();
+    sim::ns_t start = sim::now();
+    for (int i = 0; i < BURST_SECTORS; i++) {
+        for (int j = 0; j < (int)LOG_RECORDS_PER_SECTOR; j++) {
+            CHECK(logCut(1500));
+        }
+        while (cutLog.sectors() < sectors + i + 1) {
+            Thread::wait(1);
+        }
+    }
+    sectors = cutLog.sectors() - sectors;
+    syncs = cutLog.syncs() - syncs;
+    float writesPerSector = (float)(mem.writes() - writes) / sectors;
+    printf("burst: %i sectors in %i ms, %i syncs, %.2f disk writes per sector\n", sectors,
+           (int)((sim::now() - start) / sim::MS), syncs, writesPerSector);
+    CHECK(syncs <= sectors / LOG_SYNC_SECTORS + 1);
+    // The sector itself, and now and then the FAT and the directory entry
+    CHECK(writesPerSector < 1.5f);
+    CHECK(cutLog.dropped() == 0);
+}
+
+// A sector appended while records trickle in is synced within LOG_SYNC_MS
+static void trickle()
+{
+    cutLog.flush();
+    Thread::wait(100);
+    int syncs = cutLog.syncs();
+    int sectors = cutLog.sectors();
+    for (int i = 0; i < (int)LOG_RECORDS_PER_SECTOR; i++) {
+        CHECK(logCut(1500));
+    }
+    Thread::wait(100);
+    CHECK(cutLog.sectors() == sectors + 1);
+    CHECK(cutLog.syncs() == syncs);
+    sim::ns_t start = sim::now();
+    while (cutLog.syncs() == syncs && sim::now() - start < 2 * LOG_SYNC_MS * sim::MS) {
+        CHECK(logCut(1500));
+        Thread::wait(1000);
+    }
+    int ms = (int)((sim::now() - start) / sim::MS);
+    printf("trickle: sector synced after %i ms with a record every second\n", ms);
+    CHECK(cutLog.syncs() == syncs + 1);
+    CHECK(ms <= LOG_SYNC_MS + 1000);
+}
+
+// Durations past 16 bits stop at LOG_MS_MAX
+static void saturate()
+{
+    CHECK(logMs(0) == 0);
+    CHECK(logMs(1234) == 1234);
+    CHECK(logMs(LOG_MS_MAX) == LOG_MS_MAX);
+    CHECK(logMs(70000) == LOG_MS_MAX);
+    CHECK(logMs(-5) == 0);
+    CHECK(logCut(100000));
+}
+
+// Records offered faster than the writer runs fill the queue, the rest are
+// dropped and still take a sequence number
+static void overflow()
+{
+    Thread::wait(100);
+    int dropped = cutLog.dropped();
+    int taken = 0;
+    for (int i = 0; i < LOG_QUEUE_SIZE + 10; i++) {
+        taken += logCut(1500);
+    }
+    printf("overflow: %i of %i records queued, %i dropped\n", taken, LOG_QUEUE_SIZE + 10,
+           cutLog.dropped() - dropped);
+    CHECK(taken == LOG_QUEUE_SIZE);
+    CHECK(cutLog.dropped() == dropped + 10);
+    // The queue empties and takes records again
+    Thread::wait(100);
+    CHECK(logCut(1500));
+}
+
+#ifdef DECODE_LOG
+static const char *COPY = "/tmp/test_telemetry_log.bin";
+
+// The log copied out, its first sector again as a second boot that started
+// after the first one's last record, decoded to CSV
+static void decode(const std::string &log, int found, uint32_t lastMs)
+{
+    std::string data = log;
+    int rebooted = 0;
+    for (size_t at = 0; at < LOG_SECTOR_SIZE; at += sizeof(LogRecord)) {
+        LogRecord r;
+        memcpy(&r, log.data() + at, sizeof(r));
+        rebooted += r.type != LOG_PAD;
+        r.ms += lastMs + 1000;
+        data.append((const char *)&r, sizeof(r));
+    }
+    FILE *fp = fopen(COPY, "wb");
+    CHECK(fp != NULL);
+    if (fp == NULL) {
+        return;
+    }
+    fwrite(data.data(), 1, data.size(), fp);
+    fclose(fp);
+    std::string command = std::string(DECODE_LOG " ") + COPY + " " + COPY + ".csv 2> " + COPY + ".err";
+    CHECK(system(command.c_str()) == 0);
+
+    int lines = 0, dropped = -1;
+    char line[256];
+    fp = fopen((std::string(COPY) + ".csv").c_str(), "r");
+    while (fp && fgets(line, sizeof(line), fp)) {
+        lines++;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    fp = fopen((std::string(COPY) + ".err").c_str(), "r");
+    if (fp && fgets(line, sizeof(line), fp)) {
+        sscanf(line, "%i records dropped", &dropped);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    printf("decode_log.py: %i rows, %i records dropped\n", lines - 1, dropped);
+    CHECK(lines == 1 + found + rebooted);
+    CHECK(dropped == cutLog.dropped());
+    remove(COPY);
+    remove((std::string(COPY) + ".csv").c_str());
+    remove((std::string(COPY) + ".err").c_str());
+}
+#endif
+
+// Every record that was not dropped is in the file, in order, whole
+// sectors only, with a gap in the sequence for each one dropped. The log
+// keeps its file open, so the volume is remounted under it as a power cut
+// would.
+static void readBack()
+{
+    cutLog.flush();
+    Thread::wait(1000);
+    mem.unmount();
+    CHECK(mem.mount() == 0);
+    FileHandle *file = mem.open("cuts.bin", O_RDONLY);
+    CHECK(file != NULL);
+    if (file == NULL) {
+        return;
+    }
+    CHECK(file->flen() % LOG_SECTOR_SIZE == 0);
+    std::string log;
+    LogRecord r;
+    int found = 0, ordered = 0, gaps = 0, saturated = 0, last = -1;
+    uint32_t lastMs = 0;
+    while (file->read(&r, sizeof(r)) == (ssize_t)sizeof(r)) {
+        log.append((const char *)&r, sizeof(r));
+        if (r.type == LOG_PAD) {
+            continue;
+        }
+        found++;
+        ordered += r.wire == r.sequence + 1 && r.sequence > last;
+        gaps += r.sequence - last - 1;
+        last = r.sequence;
+        lastMs = r.ms;
+        saturated += r.cycleMs == LOG_MS_MAX && r.strokeMs == 25000;
+    }
+    file->close();
+    printf("read back %i of %i records, %i dropped\n", found, records, cutLog.dropped());
+    CHECK(found == records - cutLog.dropped());
+    CHECK(ordered == found);
+    CHECK(gaps == cutLog.dropped());
+    CHECK(saturated == 1);
+#ifdef DECODE_LOG
+    decode(log, found, lastMs);
+#endif
+}
+
+int main()
+{
+    CHECK(mem.format() == 0);
+    CHECK(mem.mount() == 0);
+    sdCardLatency(mem);
+    cutLog.start();
+    burst();
+    trickle();
+    saturate();
+    overflow();
+    readBack();
+    CHECK(cutLog.writeErrors() == 0);
+    hostDone("test_telemetry_log");
+}
\ No newline at end of file
@@ -0,0 +1,444 @@
+// TelemetryStream over the simulated BLE UART at 9600 baud, read back by a
+// receiver written from the protocol description: zigzag varints at their
+// edges, delta and full frames, sequence numbers and resync after a lost
+// frame, values merging while the link is busy, the full frame repeated
+// while idle, bytes per wire, and the capture through decode_telemetry.py
+#include "mbed.h"
+#include "rtos.h"
+#include "BluefruitPad.h"
+#include "TelemetryStream.h"
+#include "SimBoard.h"
+#include "HostTest.h"
+#include "params.h"
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+RawSerial ble(p13, p14);
+EventQueue events;
+BluefruitPad pad(ble, events);
+TelemetryStream telemetry(pad);
+
+/** The status as a receiver following the protocol rebuilds it */
+struct Receiver {
+    int32_t values[TELEMETRY_FIELDS];
+    bool synced;
+    int sequence;
+    int skipped;
+    int others;          // '!J' frames that are not telemetry
+    std::string kinds;   // TelemetryMessage of every frame applied
+    int lastLength;      // payload bytes of the last frame applied
+
+    Receiver():synced(false), sequence(0), skipped(0), others(0), lastLength(0)
+    {
+        memset(values, 0, sizeof(values));
+    }
+
+    void apply(const std::string &payload);
+};
+
+// CRC-16/CCITT-FALSE bit by bit, independent of the table in the driver
+static uint16_t crcBits(const std::string &s, size_t from, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = from; i < from + length; i++) {
+        crc ^= (uint8_t)s[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Seven bits at a time, low group first, then the sign from bit 0
+static bool readVarint(const std::string &p, size_t &at, int32_t &value)
+{
+    uint32_t v = 0;
+    for (int shift = 0; at < p.size() && shift < 35; shift += 7) {
+        uint8_t b = p[at++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            value = v & 1 ? -(int32_t)(v >> 1) - 1 : (int32_t)(v >> 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Receiver::apply(const std::string &payload)
+{
+    if (payload.size() < 3 || (payload[0] != TELEMETRY_MSG_FULL && payload[0] != TELEMETRY_MSG_DELTA)) {
+        others++;
+        return;
+    }
+    bool full = payload[0] == TELEMETRY_MSG_FULL;
+    int seq = (uint8_t)payload[1];
+    uint8_t mask = payload[2];
+    int32_t read[TELEMETRY_FIELDS];
+    size_t at = 3;
+    for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+        if ((mask & (1 << i)) && !readVarint(payload, at, read[i])) {
+            others++;
+            return;
+        }
+    }
+    if (at != payload.size()) {
+        others++;
+        return;
+    }
+    if (!full && (!synced || seq != ((sequence + 1) & 0xFF))) {
+        skipped++;
+        return;
+    }
+    for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+        if (mask & (1 << i)) {
+            values[i] = full ? read[i] : (int32_t)((uint32_t)values[i] + (uint32_t)read[i]);
+        }
+    }
+    synced = true;
+    sequence = seq;
+    kinds += payload[0];
+    lastLength = payload.size();
+}
+
+// Whole '!J' frames with a good CRC in bytes the board sent
+static std::vector<std::string> splitFrames(const std::string &s)
+{
+    std::vector<std::string> frames;
+    size_t at = 0;
+    while (at + 5 <= s.size()) {
+        size_t length = (uint8_t)s[at + 2] + 5;
+        if (s[at] != '!' || s[at + 1] != 'J' || at + length > s.size()) {
+            at++;
+            continue;
+        }
+        uint16_t crc = crcBits(s, at, length - 2);
+        if ((uint8_t)s[at + length - 2] != (crc & 0xFF) || (uint8_t)s[at + length - 1] != (crc >> 8)) {
+            at++;
+            continue;
+        }
+        frames.push_back(s.substr(at, length));
+        at += length;
+    }
+    return frames;
+}
+
+static Receiver rx;
+static size_t fed;
+static int32_t expected[TELEMETRY_FIELDS];
+
+// Hand the receiver everything the board sent since the last call, once
+// the link has gone quiet
+static void feed()
+{
+    sim::Uart &uart = sim::board().ble->uart();
+    while (pad.txPending() > 0 || uart.sending() > 0) {
+        Thread::wait(10);
+    }
+    std::string &sent = sim::board().ble->received();
+    std::vector<std::string> frames = splitFrames(sent.substr(fed));
+    for (size_t i = 0; i < frames.size(); i++) {
+        rx.apply(frames[i].substr(3, frames[i].size() - 5));
+    }
+    fed = sent.size();
+}
+
+static void set(int field, int32_t value)
+{
+    telemetry.set(field, value);
+    expected[field] = value;
+}
+
+static bool same()
+{
+    return memcmp(rx.values, expected, sizeof(expected)) == 0;
+}
+
+static int varintSize(int32_t value)
+{
+    uint32_t z = value >= 0 ? (uint32_t)value * 2 : (uint32_t)(-(value + 1)) * 2 + 1;
+    return 1 + (z >= 1u << 7) + (z >= 1u << 14) + (z >= 1u << 21) + (z >= 1u << 28);
+}
+
+// One publisher period; the test runs half a period off the publisher's
+// ticks, so exactly one tick passes
+static void period()
+{
+    Thread::wait(TELEMETRY_PERIOD_MS);
+    feed();
+}
+
+// The first frame is full, the ones after it carry only what changed
+static void first()
+{
+    set(TELEMETRY_STATE, MENU);
+    set(TELEMETRY_SPOOL, 5000);
+    period();
+    CHECK(rx.kinds == "K" && same());
+    set(TELEMETRY_JOB, 3);
+    period();
+    CHECK(rx.kinds == "KT" && same());
+    CHECK(rx.lastLength == 3 + 1);
+}
+
+// Every field through the edges of the varint groups and of int32, each
+// frame as long as the varints of its values or differences
+static void zigzag()
+{
+    const int32_t edges[] = {0, 1, -1, 63, -64, 64, -65, 8191, -8192, 8192, -8193, 1048575, -1048576,
+                             134217727, -134217728, 134217728, INT32_MAX, INT32_MIN, 123456789, -987654321};
+    const int n = sizeof(edges) / sizeof(edges[0]);
+    int wrong = 0, lengths = 0;
+    for (int round = 0; round < 2 * n; round++) {
+        int32_t before[TELEMETRY_FIELDS];
+        memcpy(before, expected, sizeof(before));
+        for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+            set(i, edges[(round + i * 3) % n]);
+        }
+        size_t frames = rx.kinds.size();
+        period();
+        CHECK(rx.kinds.size() == frames + 1);
+        bool full = rx.kinds[rx.kinds.size() - 1] == TELEMETRY_MSG_FULL;
+        int length = 3;
+        for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+            length += varintSize(full ? expected[i] : (int32_t)((uint32_t)expected[i] - (uint32_t)before[i]));
+        }
+        wrong += !same();
+        lengths += rx.lastLength == length;
+    }
+    printf("zigzag: %i frames, %i decoded wrong, %i of the expected length\n", 2 * n, wrong, lengths);
+    CHECK(wrong == 0);
+    CHECK(lengths == 2 * n);
+}
+
+// Full frames every TELEMETRY_FULL_EVERY frames, sequence numbers without
+// a gap, none skipped
+static void fullEvery()
+{
+    bool pattern = true;
+    for (size_t i = 0; i < rx.kinds.size(); i++) {
+        pattern = pattern && rx.kinds[i] == (i % TELEMETRY_FULL_EVERY == 0 ? 'K' : 'T');
+    }
+    CHECK(pattern);
+    CHECK(rx.skipped == 0 && rx.others == 0);
+    CHECK(rx.sequence == (int)((rx.kinds.size() - 1) & 0xFF));
+    CHECK(telemetry.frames() == (int)rx.kinds.size());
+}
+
+// A wire finishing as main.cpp reports it, the bytes it costs on the wire
+static void wires()
+{
+    set(TELEMETRY_STATE, CUTTING_TWO);
+    set(TELEMETRY_JOB, 7);
+    set(TELEMETRY_WIRES_DONE, 0);
+    set(TELEMETRY_WIRES_LEFT, 40);
+    set(TELEMETRY_BATCH_LEFT, 90);
+    set(TELEMETRY_SPOOL, 4800);
+    set(TELEMETRY_CYCLE_MS, 0);
+    set(TELEMETRY_FAULTS, 0);
+    period();
+    int bytes = telemetry.bytes(), frames = telemetry.frames();
+    size_t wire = sim::board().ble->received().size();
+    for (int i = 1; i <= 40; i++) {
+        set(TELEMETRY_WIRES_DONE, i);
+        set(TELEMETRY_WIRES_LEFT, 40 - i);
+        set(TELEMETRY_BATCH_LEFT, 90 - i);
+        set(TELEMETRY_SPOOL, 4800 - i * 2);
+        set(TELEMETRY_CYCLE_MS, 1400 + (i * 37) % 200);
+        period();
+    }
+    frames = telemetry.frames() - frames;
+    bytes = telemetry.bytes() - bytes;
+    int onWire = sim::board().ble->received().size() - wire;
+    printf("wires: 40 wires in %i frames, %.1f payload bytes and %.1f bytes on the wire per wire\n", frames,
+           bytes / 40.0f, onWire / 40.0f);
+    CHECK(frames == 40 && same());
+    CHECK(onWire == bytes + 5 * frames);
+    // Five small deltas, and a full frame now and then
+    CHECK(onWire / 40.0f < 16);
+}
+
+// The bytes the board sent with one frame left out
+static std::string dropFrame(size_t lost)
+{
+    std::vector<std::string> frames = splitFrames(sim::board().ble->received());
+    std::string lossy;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (i != lost) {
+            lossy += frames[i];
+        }
+    }
+    return lossy;
+}
+
+static const size_t LOST = 2;
+static int deltasSkipped;
+
+// A lost delta frame stops the receiver until the next full frame, after
+// which it has every value again
+static void resync()
+{
+    size_t lost = LOST;
+    std::string lossy = dropFrame(lost);
+    size_t next = lost + 1;
+    while (next < rx.kinds.size() && rx.kinds[next] != 'K') {
+        next++;
+    }
+    Receiver lossyRx;
+    std::vector<std::string> kept = splitFrames(lossy);
+    for (size_t i = 0; i < kept.size(); i++) {
+        lossyRx.apply(kept[i].substr(3, kept[i].size() - 5));
+    }
+    printf("resync: frame %i lost, %i deltas skipped until the full frame %i\n", (int)lost, lossyRx.skipped,
+           (int)next);
+    CHECK(rx.kinds[lost] == 'T');
+    CHECK(lossyRx.skipped == (int)(next - lost - 1));
+    CHECK(memcmp(lossyRx.values, rx.values, sizeof(rx.values)) == 0);
+    deltasSkipped = lossyRx.skipped;
+}
+
+static volatile bool hogging;
+
+// Other traffic keeping the TX ring from ever running empty
+static void hog()
+{
+    uint8_t filler[100];
+    memset(filler, 'X', sizeof(filler));
+    while (hogging) {
+        pad.send(filler, sizeof(filler));
+        Thread::wait(10);
+    }
+}
+
+// While the link is busy nothing is queued: every period counts as busy,
+// values merge, and one frame with the newest ones follows once it clears
+static void coalescing()
+{
+    int frames = telemetry.frames(), busy = telemetry.busy(), coalesced = telemetry.coalesced();
+    int turnedAway = pad.txDropped();
+    hogging = true;
+    Thread hogThread(osPriorityNormal);
+    hogThread.start(&hog);
+    Thread::wait(20);
+    for (int i = 1; i <= 40; i++) {
+        set(TELEMETRY_CYCLE_MS, 2000 + i);
+        Thread::wait(50);
+    }
+    hogging = false;
+    hogThread.join();
+    int busyPeriods = telemetry.busy() - busy;
+    CHECK(telemetry.frames() == frames);
+    // The ring was full the whole time
+    CHECK(pad.txDropped() > turnedAway);
+    period();
+    period();
+    printf("coalescing: %i busy periods, %i values merged, %i frame after\n", busyPeriods,
+           telemetry.coalesced() - coalesced, telemetry.frames() - frames);
+    CHECK(busyPeriods >= 40 * 50 / TELEMETRY_PERIOD_MS - 1);
+    CHECK(telemetry.coalesced() == coalesced + 39);
+    CHECK(telemetry.frames() == frames + 1);
+    CHECK(same() && rx.others > 0);
+}
+
+// Nothing changing: a full frame every TELEMETRY_IDLE_MS, values unchanged
+static void idle()
+{
+    set(TELEMETRY_STATE, MENU);
+    set(TELEMETRY_JOB, 0);
+    set(TELEMETRY_WIRES_LEFT, 0);
+    set(TELEMETRY_BATCH_LEFT, 12);
+    set(TELEMETRY_CYCLE_MS, 1500);
+    period();
+    size_t frames = rx.kinds.size();
+    Thread::wait(3 * TELEMETRY_IDLE_MS);
+    feed();
+    std::string repeated = rx.kinds.substr(frames);
+    printf("idle: %i frames in %i ms\n", (int)repeated.size(), 3 * TELEMETRY_IDLE_MS);
+    CHECK(repeated == "KKK");
+    CHECK(same());
+}
+
+#ifdef DECODE_TELEMETRY
+static bool writeCapture(const char *path, const std::string &bytes)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    fwrite(bytes.data(), 1, bytes.size(), fp);
+    return fclose(fp) == 0;
+}
+
+// The last line decode_telemetry.py printed for a capture, and what it said on stderr
+static std::string decode(const char *capture, std::string &err)
+{
+    std::string out = std::string(capture) + ".out";
+    std::string command = std::string(DECODE_TELEMETRY " --raw --file ") + capture + " > " + out + " 2> " +
+                          capture + ".err";
+    CHECK(system(command.c_str()) == 0);
+    char line[256];
+    std::string last;
+    FILE *fp = fopen(out.c_str(), "r");
+    while (fp && fgets(line, sizeof(line), fp)) {
+        last = line;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    fp = fopen((std::string(capture) + ".err").c_str(), "r");
+    err = fp && fgets(line, sizeof(line), fp) ? line : "";
+    if (fp) {
+        fclose(fp);
+    }
+    remove(out.c_str());
+    remove((std::string(capture) + ".err").c_str());
+    return last;
+}
+
+// decode_telemetry.py on the capture and on the one with a frame lost
+static void decoder()
+{
+    const char *capture = "/tmp/test_telemetry_stream.bin";
+    const char *lossy = "/tmp/test_telemetry_stream.lossy";
+    CHECK(writeCapture(capture, sim::board().ble->received()));
+    CHECK(writeCapture(lossy, dropFrame(LOST)));
+
+    char want[128];
+    snprintf(want, sizeof(want), "%-15s job %3d  %4d done %4d left  batch %5d  spool %6.1f ft  cycle %5d ms\n",
+             "MENU", (int)expected[TELEMETRY_JOB], (int)expected[TELEMETRY_WIRES_DONE],
+             (int)expected[TELEMETRY_WIRES_LEFT], (int)expected[TELEMETRY_BATCH_LEFT],
+             expected[TELEMETRY_SPOOL] / 10.0, (int)expected[TELEMETRY_CYCLE_MS]);
+    std::string err;
+    std::string last = decode(capture, err);
+    printf("decode_telemetry.py: %s", last.c_str());
+    CHECK(last == want);
+    CHECK(err.empty());
+
+    last = decode(lossy, err);
+    int skipped = -1;
+    sscanf(err.c_str(), "%i delta frames skipped", &skipped);
+    printf("decode_telemetry.py, a frame lost: %i deltas skipped\n", skipped);
+    CHECK(last == want);
+    CHECK(skipped == deltasSkipped);
+    remove(capture);
+    remove(lossy);
+}
+#endif
+
+int main()
+{
+    telemetry.start();
+    Thread::wait(TELEMETRY_PERIOD_MS / 2);
+    first();
+    zigzag();
+    fullEvery();
+    wires();
+    resync();
+    coalescing();
+    idle();
+#ifdef DECODE_TELEMETRY
+    decoder();
+#endif
+    hostDone("test_telemetry_stream");
+}
\ No newline at end of file
@@ -1,7 +1,6 @@
 /* TODO
  * Fix SD card issues
  * Add Settings Page with options (reset spool, );
- * Add "Finished!" on BLE control pad when done
  * Add PWD protection on BLE
  * Add pause/emergency button
  */
@@ -10,11 +9,28 @@
 #include "rtos.h"
 #include "SDFileSystem.h"
 #include "uLCD_4DGL.h"
+#include "LcdScreen.h"
 #include "params.h"
 #include "Stepper.h"
 #include "Servo.h"
+#include "PinDetectGroup.h"
+#if DEBOUNCE_BENCHMARK
+#define PINDETECT_COUNT_CYCLES
 #include "PinDetect.h"
+#endif
+#include "HallEncoder.h"
 #include "Motor.h"
+#include "FeedController.h"
+#include "CycleExecutor.h"
+#include "CycleProfiler.h"
+#include "JobQueue.h"
+#include "CutPlanner.h"
+#include "StateStore.h"
+#include "TelemetryLog.h"
+#include "StateMachine.h"
+#include "BluefruitPad.h"
+#include "JobLink.h"
+#include "TelemetryStream.h"
 
 /*** Devices and Pins ***/
 // Debugging : LEDs, PC
@@ -36,46 +52,133 @@ Stepper wireFeeder(p16, p17, p18, p19, p20, p21);
 Motor wireCutter(p23, p24, p25);
 Servo wireGuide(p22);
 
-PinDetect feederHallSensor(p11, PullUp);
-PinDetect cutterUpperLimitSwitch(p27, PullUp);
-PinDetect cutterLowerLimitSwitch(p28, PullUp);
+HallEncoder feederEncoder(p11, PullUp);
+// Limit switches are both on port 0 and share one debounce ticker
+PinDetectGroup port0Inputs(Port0);
+CycleProfiler profiler;
+FeedController feedController(wireFeeder, FEEDER_STEP_PER_INCH, FEEDER_INCH_PER_COUNT);
+GroupPin cutterUpperLimitSwitch(port0Inputs, p27, PullUp);
+GroupPin cutterLowerLimitSwitch(port0Inputs, p28, PullUp);
+#if DEBOUNCE_BENCHMARK
+// The same switches through per-pin PinDetect, only to count its cycles against the group
+PinDetect upperLimitBench(p27, PullUp);
+PinDetect lowerLimitBench(p28, PullUp);
+#endif
+CycleExecutor cycleExecutor(feedController, wireGuide, wireCutter, cutterUpperLimitSwitch, cutterLowerLimitSwitch, CUTTER_MOTOR_SPEED);
+CycleGraph wireCycle;
+JobQueue jobQueue(JOB_FILE);
+StateStore stateStore(sd, STATE_FILE);
+TelemetryLog cutLog(sd, LOG_FILE);
+const CutCostModel cutCostModel = {FEEDER_MAX_SPEED/FEEDER_STEP_PER_INCH, PLAN_FEED_OVERHEAD_MS, CYCLE_GUIDE_SETTLE_MS, (int)(CUTTER_TIME*1000)};
+CutPlanner cutPlanner(POS_STRIP, POS_CUT, cutCostModel);
 
 // Global Variables
 volatile double wireLeft = 1000.0; //ft, current wire on spool
+bool stateMounted = false; // progress goes to the state log instead of the job file
+bool jobFileOk = true; // the last job file save went through
+const char *queueError = ""; // why the job on the wire setup page was not queued
 volatile double wireLength = 0.0; // Length of Wire, in
 volatile double leftIncisionDist=0.0; // Distance from left end to incision, in
 volatile double rightIncisionDist=0.0; // Distance from right end to incision, in
 volatile int optionSelected = 1;
-volatile bool refreshScreen = true;
 volatile int guideAngle = POS_CUT;
-
-volatile int feederEncoderCount = 0;
+float guidePos = GUIDE_UNKNOWN; // last position the guide was sent to
 
 volatile int numWires = 1;
 volatile int numWiresLeft = 1;
+volatile bool cutting = false; // a batch is running on the cut thread
+volatile int jogCounts = 0; // feeder encoder edges since the last jog started
 
-volatile ButtonState currentButton=INVALID;
-volatile State currentState = MENU;
-volatile bool stateChange = 1;
-
-volatile BleState currentBleState = IDLE;
-volatile char bhit;
-volatile char bnum;
-volatile bool buttonReady = true;
-
-volatile float startTime = 0.0;
+// Inputs for the control state machine, and redraws for the display thread
+EventQueue uiEvents;
+EventQueue screenEvents;
+const int32_t CUT_SIGNAL = 0x1; // tells the cut thread a batch is queued
+BluefruitPad blePad(ble, uiEvents);
+JobLink jobLink(blePad, jobQueue, uiEvents);
+TelemetryStream telemetry(blePad);
 
 Thread heartbeatThread;
-Thread updateWireLeftThread;
-Thread saveWireLeftThread;
-Thread waitForButtonThread;
-Thread updateBottomScreenThread;
+Thread updateScreenThread;
+Thread cutThread;
 Timeout bleTimeout;
 
-Timer cutterTimer;
-
 Mutex lcdLock;
 
+// Screen model: the header is always shown, one page below it per state
+LcdScreen screen(lcd, lcdLock);
+LcdPage header(0,0,127,15);
+LcdLabel wireLeftLabel(0,0,"Wire Left:");
+LcdText wireLeftText(0,1,10);
+LcdBar wireLeftBar(127-52,0,127,12);
+LcdText wireLeftPercent(14,1,4);
+
+LcdPage menuPage(0,16,127,127);
+LcdLabel menuTitle(0,3,"Select Option");
+LcdLabel menuNew(0,4,"[1]New Operation");
+LcdLabel menuSettings(0,5,"[2]Settings");
+LcdLabel menuAbout(0,6,"[3]About");
+LcdText batchText(0,7,LCD_TEXT_MAX);
+
+const LcdShape wireShapeList[] = {
+    {0,32,127,32+4, RED, true}, // Wire
+    {16,32,18,32+4, BLACK, true}, // Incision Left
+    {16,33,18,35, 0xB87333, true},
+    {127-16,32,127-18,32+4, BLACK, true}, // Incision Right
+    {127-16,33,127-18,35, 0xB87333, true},
+    {0,40,1,48, RED, true}, // Length visual
+    {126,40,127,48, RED, true},
+    {0,43,127,44, RED, true},
+    {0,48,1,56, RED, true}, // Left Incision Visual
+    {17,48,18,56, RED, true},
+    {0,52,18,53, RED, true},
+    {127,48,126,56, RED, true}, // Right Incision Visual
+    {127-17,48,127-18,56, RED, true},
+    {127,52,127-18,53, RED, true}
+};
+LcdPage cutSetupPage(0,16,127,127);
+LcdShapes wireShapes(wireShapeList, sizeof(wireShapeList)/sizeof(wireShapeList[0]));
+LcdLabel lengthLabel(3,5,"Length (in.)");
+LcdLabel leftLabel(1,6,"L");
+LcdLabel rightLabel(17,6,"R");
+LcdText lengthText(0,10,LCD_TEXT_MAX);
+LcdText leftCutText(0,11,LCD_TEXT_MAX);
+LcdText rightCutText(0,12,LCD_TEXT_MAX);
+LcdText numWiresText(0,13,LCD_TEXT_MAX);
+LcdText queueErrorText(0,14,LCD_TEXT_MAX);
+LcdLabel cutSetupKeys(0,15,"[L]Back    [R]Next");
+
+LcdPage cutRunPage(0,16,127,127);
+LcdLabel progressLabel(0,4,"Progress:");
+LcdText wiresMadeText(0,7,LCD_TEXT_MAX);
+LcdBar progressBar(14,40,127-14,52);
+LcdText progressPercent(12,6,4);
+LcdText finishText(9,15,9);
+
+LcdPage settingsPage(0,16,127,127);
+LcdLabel settingsTitle(0,3,"Select Setting");
+LcdLabel settingsSpool(0,4,"[1]Reset Spool");
+LcdLabel settingsFeed(0,5,"[2]Feed Wire");
+LcdLabel settingsCutter(0,6,"[3]Move Cutter");
+LcdLabel settingsGuide(0,7,"[4]Move GuideMotor");
+LcdLabel settingsBack(0,15,"[L]Back");
+
+LcdPage feedPage(0,16,127,127);
+LcdLabel feedFwd(0,3,"[U]Feed FWD");
+LcdLabel feedRev(0,4,"[D]Feed REV");
+LcdText fedText(0,6,LCD_TEXT_MAX);
+LcdLabel feedBack(0,15,"[L]Back");
+
+LcdPage cutterPage(0,16,127,127);
+LcdLabel cutterCw(0,3,"[U]Cutter CW");
+LcdLabel cutterCcw(0,4,"[D]Cutter CCW");
+LcdLabel cutterBack(0,15,"[L]Back");
+
+LcdPage guidePage(0,16,127,127);
+LcdLabel guideInc(0,3,"[U]Inc. Angle");
+LcdLabel guideDec(0,4,"[D]Dec. Angle");
+LcdText angleText(0,6,LCD_TEXT_MAX);
+LcdLabel guideBack(0,15,"[L]Back");
+
 void validateWireParams() {
     
     // If incision distance past midpoint, round down to nearest increment
@@ -94,46 +197,217 @@ void validateWireParams() {
     if (numWires*wireLength > wireLeft*12.0) {numWires=wireLeft*12.0/wireLength;}
 }
 
-void updateWireLeft() {
-    int percentLeft = 100;
-    while(1) {
-        percentLeft = 100*wireLeft/MAX_SPOOL_LENGTH;
-        lcdLock.lock();
-        
-        lcd.filled_rectangle(0,0,127,16, BLACK);
-        
-        lcd.locate(0,0);
-        lcd.printf("Wire Left: \n\r");
-        lcd.printf("%3.1f ft", wireLeft);
-        
-        lcd.rectangle(127-52,0,127,12, WHITE);
-        if(percentLeft >= WIRE_LEVEL_MED) {
-            lcd.filled_rectangle(127-51,1,127-51+percentLeft/2,11, GREEN);
-        } else if(percentLeft >= WIRE_LEVEL_LOW) {
-            lcd.filled_rectangle(127-51,1,127-51+percentLeft/2,11, RED+GREEN);
-        } else {
-            lcd.filled_rectangle(127-51,1,127-51+percentLeft/2,11, RED);
-        }
-        
-        lcd.locate(14,1);
-        lcd.printf("%3i%%", percentLeft);
-        lcdLock.unlock();
-        Thread::wait(1000);
+// One sector write to the state log, cheap enough to do after every wire
+void saveWireLeft() {
+    telemetry.set(TELEMETRY_SPOOL, (int32_t)(wireLeft*10));
+    stateStore.setFloat(STATE_WIRE_LEFT, wireLeft);
+    stateStore.commit();
+}
+
+/*** Control state machine ***/
+// Handlers run on the main thread as soon as their event is dispatched
+
+// UP_PRESSED and DOWN_PRESSED step the selected wire parameter by one increment
+bool stepOption(const Event &event) {
+    int step = event.code==UP_PRESSED ? 1 : -1;
+    if(optionSelected==1)
+        wireLength+=step*WIRE_INCREMENT;
+    if(optionSelected==2)
+        leftIncisionDist+=step*WIRE_INCREMENT;
+    if(optionSelected==3)
+        rightIncisionDist+=step*WIRE_INCREMENT;
+    if(optionSelected==4)
+        numWires+=step;
+    validateWireParams();
+    return true;
+}
+
+// ONE_RELEASED to FOUR_RELEASED select options 1 to 4
+bool selectOption(const Event &event) {
+    optionSelected = event.code>>4;
+    return true;
+}
+
+// Hand the queued jobs to the cut thread, rejected when there are none
+bool startBatch(const Event &event) {
+    if(jobQueue.pending()==0) { return false; }
+    cutting = true;
+    cutThread.signal_set(CUT_SIGNAL);
+    return true;
+}
+
+bool openSetup(const Event &event) {
+    queueError = "";
+    return true;
+}
+
+// Rejected when the job can not be queued and saved, the setup page then says why
+bool queueJob(const Event &event) {
+    validateWireParams();
+    int id = jobQueue.add(wireLength, leftIncisionDist, rightIncisionDist, numWires, 0, false);
+    if(id < 0) {
+        queueError = "Job queue full";
+        return false;
+    }
+    if(!jobQueue.save()) {
+        jobQueue.remove(id);
+        queueError = "Job file error";
+        return false;
     }
+    queueError = "";
+    numWiresLeft = numWires;
+    return startBatch(event);
+}
 
+bool finishBatch(const Event &event) {
+    return !cutting && numWiresLeft==0;
 }
 
-void saveWireLeft() {
-    char * str;
-    while(1) {
-        FILE * fp = fopen("sd/params.txt", "W");
-        if(fp == NULL) {
-            error ("Unable to open file");
-        }
-        sprintf(str, "%f", wireLeft);
-        fprintf(fp, str);
-        fclose(fp);
-        Thread::wait(60*1000);
+// A batch uploaded over BLE is complete, it goes to the job file from here
+bool commitJobs(const Event &event) {
+    // A batch that could not be saved is not queued; the sender got JOB_ACK_FAILED and resends it
+    if(!jobLink.commit()) {
+        pc.printf("Batch from BLE not committed\n\r");
+    }
+    telemetry.set(TELEMETRY_BATCH_LEFT, jobQueue.wiresLeft());
+    return true;
+}
+
+bool resetSpool(const Event &event) {
+    wireLeft = MAX_SPOOL_LENGTH;
+    saveWireLeft();
+    return true;
+}
+
+bool enableFeeder(const Event &event) {
+    jogCounts = 0;
+    wireFeeder.enable();
+    return true;
+}
+
+bool disableFeeder(const Event &event) {
+    wireFeeder.stop();
+    wireFeeder.disable();
+    return true;
+}
+
+// A jog starts and stops without a ramp, so it runs at the speed the feeder can start from
+bool jogFeederUp(const Event &event) {
+    jogCounts = 0;
+    wireFeeder.run(FEEDER_MOTOR_STEPS,STEPPER_REV,FEEDER_START_SPEED);
+    return true;
+}
+
+bool jogFeederDown(const Event &event) {
+    jogCounts = 0;
+    wireFeeder.run(FEEDER_MOTOR_STEPS,STEPPER_FWD,FEEDER_START_SPEED);
+    return true;
+}
+
+bool stopFeeder(const Event &event) {
+    wireFeeder.stop();
+    return true;
+}
+
+bool jogCutterUp(const Event &event) {
+    wireCutter.speed(CUTTER_MOTOR_SPEED);
+    return true;
+}
+
+bool jogCutterDown(const Event &event) {
+    wireCutter.speed(-CUTTER_MOTOR_SPEED);
+    return true;
+}
+
+bool stopCutter(const Event &event) {
+    wireCutter.speed(0.0);
+    return true;
+}
+
+// The limit interrupt has already stopped the cutter
+bool finishHoming(const Event &event) {
+    profiler.end(PHASE_HOME);
+    return true;
+}
+
+bool guideUp(const Event &event) {
+    wireGuide.position(++guideAngle);
+    guidePos = guideAngle;
+    return true;
+}
+
+bool guideDown(const Event &event) {
+    wireGuide.position(--guideAngle);
+    guidePos = guideAngle;
+    return true;
+}
+
+// Searched in order, the first row for the state and event whose handler accepts it is taken
+const Transition transitions[] = {
+    {STATE_ANY,       EVENT_FRAME,   'J',              &commitJobs,    STATE_SAME},
+
+    {HOMING,          EVENT_LIMIT,   LIMIT_UPPER,      &finishHoming,  MENU},
+
+    {MENU,            EVENT_BUTTON,  ONE_RELEASED,     &openSetup,     CUTTING_ONE},
+    {MENU,            EVENT_BUTTON,  TWO_RELEASED,     NULL,           SETTINGS_ONE},
+    {MENU,            EVENT_BUTTON,  FOUR_RELEASED,    &startBatch,    CUTTING_TWO},
+
+    {CUTTING_ONE,     EVENT_BUTTON,  UP_PRESSED,       &stepOption,    STATE_SAME},
+    {CUTTING_ONE,     EVENT_BUTTON,  DOWN_PRESSED,     &stepOption,    STATE_SAME},
+    {CUTTING_ONE,     EVENT_BUTTON,  ONE_RELEASED,     &selectOption,  STATE_SAME},
+    {CUTTING_ONE,     EVENT_BUTTON,  TWO_RELEASED,     &selectOption,  STATE_SAME},
+    {CUTTING_ONE,     EVENT_BUTTON,  THREE_RELEASED,   &selectOption,  STATE_SAME},
+    {CUTTING_ONE,     EVENT_BUTTON,  FOUR_RELEASED,    &selectOption,  STATE_SAME},
+    {CUTTING_ONE,     EVENT_BUTTON,  LEFT_RELEASED,    NULL,           MENU},
+    {CUTTING_ONE,     EVENT_BUTTON,  RIGHT_RELEASED,   &queueJob,      CUTTING_TWO},
+    {CUTTING_ONE,     EVENT_BUTTON,  RIGHT_RELEASED,   NULL,           STATE_SAME},
+
+    {CUTTING_TWO,     EVENT_BUTTON,  RIGHT_RELEASED,   &finishBatch,   MENU},
+
+    {SETTINGS_ONE,    EVENT_BUTTON,  ONE_RELEASED,     &resetSpool,    STATE_SAME},
+    {SETTINGS_ONE,    EVENT_BUTTON,  TWO_RELEASED,     &enableFeeder,  SETTINGS_FEED},
+    {SETTINGS_ONE,    EVENT_BUTTON,  THREE_RELEASED,   NULL,           SETTINGS_CUTTER},
+    {SETTINGS_ONE,    EVENT_BUTTON,  FOUR_RELEASED,    NULL,           SETTINGS_GUIDE},
+    {SETTINGS_ONE,    EVENT_BUTTON,  LEFT_RELEASED,    NULL,           MENU},
+
+    {SETTINGS_FEED,   EVENT_BUTTON,  UP_PRESSED,       &jogFeederUp,   STATE_SAME},
+    {SETTINGS_FEED,   EVENT_BUTTON,  DOWN_PRESSED,     &jogFeederDown, STATE_SAME},
+    {SETTINGS_FEED,   EVENT_BUTTON,  UP_RELEASED,      &stopFeeder,    STATE_SAME},
+    {SETTINGS_FEED,   EVENT_BUTTON,  DOWN_RELEASED,    &stopFeeder,    STATE_SAME},
+    {SETTINGS_FEED,   EVENT_ENCODER, EVENT_ANY,        NULL,           STATE_SAME},
+    {SETTINGS_FEED,   EVENT_BUTTON,  LEFT_RELEASED,    &disableFeeder, SETTINGS_ONE},
+
+    {SETTINGS_CUTTER, EVENT_BUTTON,  UP_PRESSED,       &jogCutterUp,   STATE_SAME},
+    {SETTINGS_CUTTER, EVENT_BUTTON,  DOWN_PRESSED,     &jogCutterDown, STATE_SAME},
+    {SETTINGS_CUTTER, EVENT_BUTTON,  UP_RELEASED,      &stopCutter,    STATE_SAME},
+    {SETTINGS_CUTTER, EVENT_BUTTON,  DOWN_RELEASED,    &stopCutter,    STATE_SAME},
+    {SETTINGS_CUTTER, EVENT_BUTTON,  LEFT_RELEASED,    &stopCutter,    SETTINGS_ONE},
+
+    {SETTINGS_GUIDE,  EVENT_BUTTON,  UP_RELEASED,      &guideUp,       STATE_SAME},
+    {SETTINGS_GUIDE,  EVENT_BUTTON,  DOWN_RELEASED,    &guideDown,     STATE_SAME},
+    {SETTINGS_GUIDE,  EVENT_BUTTON,  LEFT_RELEASED,    NULL,           SETTINGS_ONE},
+};
+StateMachine machine(transitions, sizeof(transitions)/sizeof(transitions[0]), HOMING);
+
+// Anything the machine handled may have changed the screen or the state
+void eventHandled() {
+    screenEvents.post(EVENT_REDRAW);
+    telemetry.set(TELEMETRY_STATE, machine.state());
+}
+
+// The upper limit stops a rising cutter in interrupt context, not after the
+// event queue, and posts its event only when HOMING waits for it. The cycle
+// executor polls both switches itself.
+void upperLimitHit() {
+    if(wireCutter.speed() > 0) { wireCutter.speed(0.0); }
+    if(machine.state() == HOMING) { uiEvents.post(EVENT_LIMIT, LIMIT_UPPER); }
+}
+
+void encoderEdge() {
+    feedController.encoderEdge();
+    int counts = ++jogCounts;
+    if(counts % ENCODER_MILESTONE_COUNTS == 0) {
+        uiEvents.post(EVENT_ENCODER, 0, counts);
     }
 }
 
@@ -141,272 +415,285 @@ void saveWireLeft() {
 void heartbeat() {
     while(1){
         led4 = !led4;
+#if DEBOUNCE_BENCHMARK
+        // A group tick samples both switches, PinDetect takes a tick per switch
+        pc.printf("Debounce cycles/tick: group %u mean, %u max, %u ticks; PinDetect %u mean, %u max, %u ticks of 2 pins\n\r", port0Inputs.meanCycles(), port0Inputs.maxCycles(), port0Inputs.ticks(), PinDetect::meanCycles(), PinDetect::maxCycles(), PinDetect::ticks());
+#endif
+#if DISPLAY_BENCHMARK
+        pc.printf("Display: %u bytes last frame, %u max, %u frames\n\r", screen.frameBytes(), screen.maxFrameBytes(), screen.frames());
+#endif
+#if STATE_BENCHMARK
+        pc.printf("State: %i saves, %i us max\n\r", stateStore.commits(), stateStore.maxCommitUs());
+#endif
+#if LOG_BENCHMARK
+        pc.printf("Log: %i records, %i dropped, %i sectors, %i syncs, %i errors\n\r", cutLog.logged(), cutLog.dropped(), cutLog.sectors(), cutLog.syncs(), cutLog.writeErrors());
+#endif
+#if BLE_BENCHMARK
+        pc.printf("BLE: %i frames, %i bad checksums, %i bytes skipped, %i overruns\n\r", blePad.frames(), blePad.badChecksums(), blePad.skipped(), blePad.overruns());
+#endif
+#if JOB_LINK_BENCHMARK
+        pc.printf("Upload: %i batches, %i jobs, %i out of order\n\r", jobLink.batches(), jobLink.jobsReceived(), jobLink.outOfOrder());
+#endif
+#if TELEMETRY_BENCHMARK
+        pc.printf("Telemetry: %i frames, %i bytes, %i coalesced, %i busy, %i TX dropped\n\r", telemetry.frames(), telemetry.bytes(), telemetry.coalesced(), telemetry.busy(), blePad.txDropped());
+#endif
+#if EVENT_BENCHMARK
+        pc.printf("Events: %i handled, %i ignored, %i dropped, %i us max dispatch\n\r", machine.handled(), machine.ignored(), uiEvents.dropped(), machine.maxDispatchUs());
+#endif
         Thread::wait(1000);
     }
 }
 
-void bleIRQ(){
-    switch(currentBleState) {
-        case IDLE: {
-            if(ble.getc()=='!') { currentBleState = GOT_EXCLAM; }
-            else { currentBleState = IDLE; }
-            break;
-        }
-        case GOT_EXCLAM: {
-            if(ble.getc()=='B') { currentBleState = GOT_B; }
-            else { currentBleState = IDLE; }
-            break;
-        }
-        case GOT_B: {
-            bnum = ble.getc();
-            currentBleState = GOT_BTN;
-            break;
-        }
-        case GOT_BTN: {
-            bhit = ble.getc();
-            currentBleState = GOT_HIT;
-            break;
-        }
-        case GOT_HIT: {
-            int btn = 0xFF;
-            if (ble.getc()==char(~('!' + 'B' + bnum + bhit))) { //checksum OK?
-                buttonReady = 1;
-                btn=(((bnum-'0')<<4) | (bhit-'0'));
-                currentButton = (ButtonState)btn;
-            }
-            currentBleState = IDLE;
-            break;
-        }
-        default: {
-            ble.getc();
-            currentBleState=IDLE;
-            break;
-        }
+// Display thread, draws a frame whenever a redraw is posted
+void updateScreen() {
+    Event event;
+    while(screenEvents.wait(event)) {
+        // One frame covers every redraw posted while the last one was sent
+        while(screenEvents.wait(event, 0)) {}
         
-    }
-    
-}
-
-void updateBottomScreen(){
-    while(true){
-        if(currentState==MENU&&stateChange){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            lcd.locate(0,3);
-            lcd.printf("Select Option\n\r");
-            lcd.printf("[1]New Operation \n\r");
-            lcd.printf("[2]Settings \n\r");
-            lcd.printf("[3]About \n\r");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState==CUTTING_ONE&&stateChange){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            
-            lcd.filled_rectangle(0,32,127,32+4, RED); // Wire
-            lcd.filled_rectangle(16,32,18,32+4, BLACK); // Incision Left
-            lcd.filled_rectangle(16,33,18,35, 0xB87333);
-            
-            lcd.filled_rectangle(127-16,32,127-18,32+4, BLACK); // Incision Right
-            lcd.filled_rectangle(127-16,33,127-18,35, 0xB87333);
-            
-            lcd.filled_rectangle(0,40,1,48, RED); // Length visual
-            lcd.filled_rectangle(126,40,127,48, RED);
-            lcd.filled_rectangle(0,43,127,44, RED);
-            lcd.locate(3,5);
-            lcd.printf("Length (in.)");
-            
-            lcd.filled_rectangle(0,48,1,56, RED); // Left Incision Visual
-            lcd.filled_rectangle(17,48,18,56, RED);
-            lcd.filled_rectangle(0,52,18,53, RED);
-            lcd.locate(1,6);
-            lcd.printf("L");
-            
-            lcd.filled_rectangle(127,48,126,56, RED); // Right Incision Visual
-            lcd.filled_rectangle(127-17,48,127-18,56, RED);
-            lcd.filled_rectangle(127,52,127-18,53, RED);
-            lcd.locate(17,6);
-            lcd.printf("R");
-            
-            lcd.locate(0,15);
-            lcd.printf("[L]Back    [R]Next");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState == CUTTING_TWO && stateChange) {
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            lcd.locate(0,15);
-            lcd.printf("[L]Abort");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState == CUTTING_ONE && refreshScreen) {
-            lcdLock.lock();
-            lcd.filled_rectangle(0,80,127,112, BLACK);
-            
-            lcd.locate(0,10);
-            validateWireParams();
-            lcd.printf("%s[1]Length:%4.1fin\n\r", (optionSelected%5==1)?">":" ",wireLength);
-            lcd.printf("%s[2]L_Cut: %4.1fin\n\r",(optionSelected%5==2)?">":" ",leftIncisionDist);
-            lcd.printf("%s[3]R_Cut: %4.1fin\n\r",(optionSelected%5==3)?">":" ",rightIncisionDist);
-            lcd.printf("%s[4]Num Wires: %3i\n\r",(optionSelected%5==4)?">":" ",numWires);
-            lcdLock.unlock();
-            refreshScreen = false;
+        int percentLeft = 100*wireLeft/MAX_SPOOL_LENGTH;
+        wireLeftText.printf("%3.1f ft", wireLeft);
+        wireLeftPercent.printf("%3i%%", percentLeft);
+        if(percentLeft >= WIRE_LEVEL_MED) {
+            wireLeftBar.set(percentLeft, GREEN);
+        } else if(percentLeft >= WIRE_LEVEL_LOW) {
+            wireLeftBar.set(percentLeft, RED+GREEN);
+        } else {
+            wireLeftBar.set(percentLeft, RED);
         }
-        if(currentState == CUTTING_TWO) {
-            lcdLock.lock();
-            lcd.filled_rectangle(0,40,127,60, BLACK);
-            lcd.locate(0,4);
-            lcd.printf("Progress:\n\n\n");
-            lcd.printf("Wires Made:%3i/%i",numWires-numWiresLeft, numWires);
-            lcd.rectangle(14,40,127-14,52, WHITE);
-            
-            lcd.filled_rectangle(14,41,14+(int)(100*(1-(float)numWiresLeft/numWires)),51, GREEN);
-            lcd.locate(12,6);
-            lcd.printf("%3i%%", (int)(100*(1-(float)numWiresLeft/numWires)));
-            
-            if(numWiresLeft==0){
-                lcd.locate(9,15);
-                lcd.printf("[R]Finish");
+        
+        switch(machine.state()) {
+            case HOMING:
+            case MENU:
+                batchText.printf("[4]Run Batch (%i)", jobQueue.pending());
+                screen.show(menuPage);
+                break;
+            case CUTTING_ONE:
+                lengthText.printf("%s[1]Length:%4.1fin", (optionSelected%5==1)?">":" ", wireLength);
+                leftCutText.printf("%s[2]L_Cut: %4.1fin", (optionSelected%5==2)?">":" ", leftIncisionDist);
+                rightCutText.printf("%s[3]R_Cut: %4.1fin", (optionSelected%5==3)?">":" ", rightIncisionDist);
+                numWiresText.printf("%s[4]Num Wires: %3i", (optionSelected%5==4)?">":" ", numWires);
+                queueErrorText.printf("%s", queueError);
+                screen.show(cutSetupPage);
+                break;
+            case CUTTING_TWO: {
+                int percentMade = numWires ? (int)(100*(1-(float)numWiresLeft/numWires)) : 0;
+                wiresMadeText.printf("Wires Made:%3i/%i", numWires-numWiresLeft, numWires);
+                progressBar.set(percentMade, GREEN);
+                progressPercent.printf("%3i%%", percentMade);
+                finishText.printf("%s", numWiresLeft==0 ? "[R]Finish" : "");
+                screen.show(cutRunPage);
+                break;
             }
-            lcdLock.unlock();
-        }
-        if(currentState==SETTINGS_ONE&&stateChange){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            lcd.locate(0,3);
-            lcd.printf("Select Setting\n\r");
-            lcd.printf("[1]Reset Spool \n\r");
-            lcd.printf("[2]Feed Wire \n\r");
-            lcd.printf("[3]Move Cutter \n\r");
-            lcd.printf("[4]Move GuideMotor \n\r");
-            
-            lcd.locate(0,15);
-            lcd.printf("[L]Back");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState==SETTINGS_FEED&&stateChange){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            lcd.locate(0,3);
-            lcd.printf("[U]Feed FWD\n\r");
-            lcd.printf("[D]Feed REV\n\r");
-            
-            lcd.locate(0,15);
-            lcd.printf("[L]Back");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState==SETTINGS_CUTTER&&stateChange){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            lcd.locate(0,3);
-            lcd.printf("[U]Cutter CW\n\r");
-            lcd.printf("[D]Cutter CCW\n\r");
-            
-            lcd.locate(0,15);
-            lcd.printf("[L]Back");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState==SETTINGS_GUIDE&&stateChange){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,16,127,127, BLACK); // Clear screen
-            lcd.locate(0,3);
-            lcd.printf("[U]Inc. Angle\n\r");
-            lcd.printf("[D]Dec. Angle\n\r");
-            
-            lcd.locate(0,15);
-            lcd.printf("[L]Back");
-            lcdLock.unlock();
-            stateChange = 0;
-        }
-        if(currentState==SETTINGS_GUIDE&&refreshScreen){
-            lcdLock.lock();
-            lcd.filled_rectangle(0,48,127,56, BLACK); // Clear screen
-            lcd.locate(0,6);
-            lcd.printf("Angle: %3i", guideAngle);
-            lcdLock.unlock();
-            refreshScreen=false;
+            case SETTINGS_ONE:
+                screen.show(settingsPage);
+                break;
+            case SETTINGS_FEED:
+                fedText.printf("Moved: %5.1f in", jogCounts*FEEDER_INCH_PER_COUNT);
+                screen.show(feedPage);
+                break;
+            case SETTINGS_CUTTER:
+                screen.show(cutterPage);
+                break;
+            case SETTINGS_GUIDE:
+                angleText.printf("Angle: %3i", guideAngle);
+                screen.show(guidePage);
+                break;
+            default:
+                break;
         }
-        Thread::wait(100);
+        
+        // Only what changed since the last frame is sent
+        screen.frame();
     }
 }
 
-void updateFeederEncoderCount() {
-    Thread::yield();
-    feederEncoderCount++;
+void setupScreen() {
+    header.add(wireLeftLabel);
+    header.add(wireLeftText);
+    header.add(wireLeftBar);
+    header.add(wireLeftPercent);
+    wireLeftBar.overlay(wireLeftPercent);
+    screen.fixed(header);
+    
+    menuPage.add(menuTitle);
+    menuPage.add(menuNew);
+    menuPage.add(menuSettings);
+    menuPage.add(menuAbout);
+    menuPage.add(batchText);
+    
+    cutSetupPage.add(wireShapes);
+    cutSetupPage.add(lengthLabel);
+    cutSetupPage.add(leftLabel);
+    cutSetupPage.add(rightLabel);
+    cutSetupPage.add(lengthText);
+    cutSetupPage.add(leftCutText);
+    cutSetupPage.add(rightCutText);
+    cutSetupPage.add(numWiresText);
+    cutSetupPage.add(queueErrorText);
+    cutSetupPage.add(cutSetupKeys);
+    
+    cutRunPage.add(progressLabel);
+    cutRunPage.add(wiresMadeText);
+    cutRunPage.add(progressBar);
+    cutRunPage.add(progressPercent);
+    cutRunPage.add(finishText);
+    progressBar.overlay(progressPercent);
+    
+    settingsPage.add(settingsTitle);
+    settingsPage.add(settingsSpool);
+    settingsPage.add(settingsFeed);
+    settingsPage.add(settingsCutter);
+    settingsPage.add(settingsGuide);
+    settingsPage.add(settingsBack);
+    
+    feedPage.add(feedFwd);
+    feedPage.add(feedRev);
+    feedPage.add(fedText);
+    feedPage.add(feedBack);
+    
+    cutterPage.add(cutterCw);
+    cutterPage.add(cutterCcw);
+    cutterPage.add(cutterBack);
+    
+    guidePage.add(guideInc);
+    guidePage.add(guideDec);
+    guidePage.add(angleText);
+    guidePage.add(guideBack);
 }
 
-void feedWireUntilCount(int counts) {
-    feederEncoderCount = 0;
-    wireFeeder.enable();
-    while (feederEncoderCount < counts) {
-        wireFeeder.step(FEEDER_MOTOR_STEPS,STEPPER_REV,FEEDER_MOTOR_SPEED);
-        Thread::wait(5);
+// Queue a record of the wire for the log writer, never waits on the card
+int logCut(const Job &job, const CycleReport &report) {
+    LogRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = LOG_CUT;
+    r.job = job.id;
+    r.wire = job.done + 1;
+    r.length = job.length;
+    r.leftStrip = job.leftStrip;
+    r.rightStrip = job.rightStrip;
+    r.fed = report.fed;
+    r.cycleMs = logMs(report.cycleMs);
+    r.strokeMs = logMs(report.strokeMs);
+    if (fabs(report.fed - job.length) > LOG_LENGTH_TOLERANCE) {
+        r.errors |= LOG_ERR_LENGTH;
     }
-    wireFeeder.disable();
-}
-
-/*
-void feedWireUntilLength(float length) {
-    int steps = (int)(length*FEEDER_STEP_PER_INCH);
-    pc.printf("%f\n\r", FEEDER_STEP_PER_INCH);
-    wireFeeder.enable();
-    for(int step = 0; step < steps; step++){
-        wireFeeder.step(FULL_STEP,STEPPER_REV,FEEDER_MOTOR_SPEED);
-        Thread::wait(5);
+    if (report.faults & CYCLE_FAULT_FEED) {
+        r.errors |= LOG_ERR_FEED;
     }
-    wireFeeder.disable();
+    if (report.faults & CYCLE_FAULT_STROKE) {
+        r.errors |= LOG_ERR_STROKE;
+    }
+    cutLog.log(r);
+    return r.errors;
 }
-*/
 
-void cut() {
-    wireCutter.speed(-CUTTER_MOTOR_SPEED);    
-    while(!cutterLowerLimitSwitch) { Thread::wait(10); }
-    wireCutter.speed(CUTTER_MOTOR_SPEED);
-    while(!cutterUpperLimitSwitch) { Thread::wait(10); }
-    wireCutter.speed(0.0);
+// Status for the phone, the stream only sends what changed
+void publishCut(const Job &job, const CycleReport &report, int errors) {
+    int faults = 0;
+    if (errors & LOG_ERR_LENGTH) { faults |= FAULT_LENGTH; }
+    if (errors & LOG_ERR_FEED) { faults |= FAULT_FEED; }
+    if (errors & LOG_ERR_STROKE) { faults |= FAULT_CUTTER; }
+    if (!stateMounted) { faults |= FAULT_STATE; }
+    if (!jobFileOk) { faults |= FAULT_JOB_FILE; }
+    if (cutLog.writeErrors() > 0) { faults |= FAULT_LOG; }
+    telemetry.set(TELEMETRY_JOB, job.id);
+    telemetry.set(TELEMETRY_WIRES_DONE, numWires - numWiresLeft);
+    telemetry.set(TELEMETRY_WIRES_LEFT, numWiresLeft);
+    telemetry.set(TELEMETRY_BATCH_LEFT, jobQueue.wiresLeft());
+    telemetry.set(TELEMETRY_CYCLE_MS, report.cycleMs);
+    telemetry.set(TELEMETRY_FAULTS, faults);
 }
 
 void cutWires() {
+    Job job;
+    if(!jobQueue.next(job)) { return; }
     wireCutter.speed(CUTTER_MOTOR_SPEED);
     while(!cutterUpperLimitSwitch) { Thread::wait(10); }
     wireCutter.speed(0.0);
-    for(int i = numWiresLeft; i > 0; i--) {
-        // Feed wire until left incision
-        feedWireUntilLength(leftIncisionDist);
-        //feedWireUntilCount(leftIncisionDist/WIRE_INCREMENT);
-        // Switch servo to stripper
-        wireGuide.position(POS_STRIP);
-        // Make left incision & open back up
-        cut();
-        
-        // Feed wire until right incision
-        //feedWireUntilLength(wireLength-leftIncisionDist-rightIncisionDist);
-        feedWireUntilCount((wireLength-leftIncisionDist-rightIncisionDist)/WIRE_INCREMENT);
-        // Make right incision & open back up
-        cut();
+    // Order the batch and report what the planner saves over the fixed cycle
+    static Job jobs[JOB_QUEUE_SIZE];
+    int count = jobQueue.pendingJobs(jobs, JOB_QUEUE_SIZE);
+    int fixedMs = cutPlanner.estimate(jobs, count, guidePos, false);
+    cutPlanner.order(jobs, count, guidePos);
+    jobQueue.reorder(jobs, count);
+    pc.printf("Batch: %i ms fixed cycle, %i ms planned\n\r", fixedMs, cutPlanner.estimate(jobs, count, guidePos, true));
+    
+    // Run every queued job back to back, highest priority first
+    while(jobQueue.next(job)) {
+        wireLength = job.length;
+        leftIncisionDist = job.leftStrip;
+        rightIncisionDist = job.rightStrip;
+        numWires = job.quantity;
+        numWiresLeft = job.quantity - job.done;
         
-        // Feed wire until length
-        //feedWireUntilLength(rightIncisionDist);
-        feedWireUntilCount(rightIncisionDist/WIRE_INCREMENT);
-        // Switch servo to cutter
-        wireGuide.position(POS_CUT);
-        // Make cut & open back up
-        cut();
+        if(!cutPlanner.buildWire(job, guidePos, wireCycle)) {
+            // Incisions that overlap or a length the feeder cannot run, it would come back from next() forever
+            pc.printf("Job %i has marks out of order, removed\n\r", job.id);
+            jobQueue.remove(job.id);
+            jobFileOk = jobQueue.save();
+            continue;
+        }
+        CycleReport report = cycleExecutor.run(wireCycle);
+        wireLeft -= report.fed/12.0;
+        pc.printf("Job %i wire %i: %i ms (serial %i ms), fed %.3f in\n\r", job.id, job.done+1, report.cycleMs, report.workMs, report.fed);
+        int errors = logCut(job, report);
+        if (report.faults & CYCLE_FAULT_STROKE) {
+            // The cutter is jammed and stopped, the wire is not done and the batch stops here
+            pc.printf("Cutter missed a limit, batch stopped\n\r");
+            saveWireLeft();
+            publishCut(job, report, errors);
+            break;
+        }
         
-        wireLeft -= feederEncoderCount/8*FEEDER_WHEEL_CIRCUMFERENCE;
-        //wireLeft -= wireLength;
+        jobFileOk = jobQueue.wireDone(job.id, !stateMounted);
+        // A finished job is in the job file, so its progress is no longer needed
+        bool finished = job.done + 1 >= job.quantity;
+        stateStore.setInt(STATE_JOB_ID, finished && jobFileOk ? 0 : job.id);
+        stateStore.setInt(STATE_JOB_DONE, job.done + 1);
+        saveWireLeft();
         numWiresLeft--;
+        publishCut(job, report, errors);
+        screenEvents.post(EVENT_REDRAW);
+        if(!jobFileOk && !stateMounted) {
+            // The progress is only in RAM, a power cut now would recut wires
+            pc.printf("Job file not written, batch stopped\n\r");
+            break;
+        }
+    }
+    if(!cycleExecutor.finish()) {
+        pc.printf("Cutter missed the upper limit\n\r");
+        telemetry.set(TELEMETRY_FAULTS, FAULT_CUTTER);
+    }
+    cutLog.flush();
+}
+
+// Cut thread, runs the batches the state machine hands over so events keep being handled
+void cutBatches() {
+    while(true) {
+        Thread::signal_wait(CUT_SIGNAL);
+        cutWires();
+        cutting = false;
+#if PROFILE_BENCHMARK
+        profiler.print(pc);
+        profiler.save(PROFILE_FILE);
+#endif
+        screenEvents.post(EVENT_REDRAW);
     }
-    
+}
+
+// Start raising the cutter, the limit interrupt stops it and ends HOMING
+void homeCutter() {
+    profiler.begin(PHASE_HOME);
+    wireCutter.speed(CUTTER_MOTOR_SPEED);
+    // Already up, there is no edge to interrupt on
+    if(cutterUpperLimitSwitch) { upperLimitHit(); }
 }
 
 int main() {
+    // Check CRCs on the SD card bus, before the first file access initialises it
+    sd.set_crc(true);
+    
     // Initialize uLCD with Splash Screen
     lcd.baudrate(3000000);
     lcd.printf(" WireFactory v1.0\n\r");
@@ -440,235 +727,59 @@ int main() {
     }
     */
     
-    updateWireLeftThread.start(&updateWireLeft);
+    setupScreen();
+    machine.attach(&eventHandled);
+    updateScreenThread.start(&updateScreen);
+    screenEvents.post(EVENT_REDRAW);
     heartbeatThread.start(&heartbeat);    
-    //saveWireLeftThread.start(&saveWireLeft);
-    updateBottomScreenThread.start(&updateBottomScreen);
     
-    ble.attach(&bleIRQ,RawSerial::RxIrq);
+    blePad.attach(callback(&jobLink, &JobLink::receive));
+    blePad.start();
+    telemetry.start();
     
-    feederHallSensor.attach_asserted(&updateFeederEncoderCount);
-    feederHallSensor.attach_deasserted(&updateFeederEncoderCount);
-    feederHallSensor.setSampleFrequency(5000);
+    feederEncoder.attach(&encoderEdge);
+    cutterUpperLimitSwitch.attach_asserted(&upperLimitHit);
+    port0Inputs.setSampleFrequency(DEBOUNCE_SAMPLE_PERIOD);
+#if DEBOUNCE_BENCHMARK
+    upperLimitBench.setSampleFrequency(DEBOUNCE_SAMPLE_PERIOD);
+    lowerLimitBench.setSampleFrequency(DEBOUNCE_SAMPLE_PERIOD);
+#endif
     
-    cutterUpperLimitSwitch.setSampleFrequency(5000);
-    cutterLowerLimitSwitch.setSampleFrequency(5000);
+    // Restore the spool from the state log
+    stateMounted = stateStore.mount();
+    if(!stateMounted) {
+        led3=1;
+        telemetry.set(TELEMETRY_FAULTS, FAULT_STATE);
+    }
+    float savedWireLeft;
+    if(stateStore.getFloat(STATE_WIRE_LEFT, savedWireLeft)) { wireLeft = savedWireLeft; }
     
-    // Initialize SD Card
-    /*
-    FILE * fp = fopen("/sd/params.txt", "r");
-    if(fp != NULL) {
-        char * temp;
-        fgets(temp, 100, fp);
-        pc.printf("%s\n", temp);
-        fclose(fp);
-    } else { led3=1; }
-    */
-    //wireLength = strtod(temp, NULL);
+    cutLog.start();
+    
+    // Resume any batch left unfinished on the card, at the last wire logged
+    jobQueue.load();
+    int32_t savedJobId, savedJobDone;
+    if(stateStore.getInt(STATE_JOB_ID, savedJobId) && stateStore.getInt(STATE_JOB_DONE, savedJobDone)) {
+        jobQueue.restoreProgress(savedJobId, savedJobDone);
+    }
+    telemetry.set(TELEMETRY_BATCH_LEFT, jobQueue.wiresLeft());
+    
+    // Nothing marks before here, so calibrating may empty the ring
+    profiler.calibrate();
+    feedController.setProfiler(&profiler);
+    cycleExecutor.setProfiler(&profiler);
     
     // Initialize Motors
+    feedController.setProfile(FEEDER_START_SPEED,FEEDER_MAX_SPEED,FEEDER_ACCEL,FEEDER_JERK,FEEDER_PROFILE);
+    feedController.setStepping(FULL_STEP,STEPPER_REV);
+    feedController.setTolerance(FEED_TOLERANCE,FEED_APPROACH);
     wireGuide.calibrate(0.0015,0.0009,180);
     wireGuide.position(POS_STRIP);
+    guidePos = POS_STRIP;
     
-    wireCutter.speed(CUTTER_MOTOR_SPEED);
-    while(!cutterUpperLimitSwitch) { Thread::wait(10); }
-    wireCutter.speed(0.0);
-    // Use main thread for operation
-    while(1) {
-        switch(currentState) {
-            case MENU : {
-                if(buttonReady && currentButton == ONE_RELEASED) {
-                    currentState = CUTTING_ONE;
-                    stateChange = 1;
-                }
-                if(buttonReady && currentButton == TWO_RELEASED) {
-                    currentState = SETTINGS_ONE;
-                    stateChange = 1;
-                }
-                break; 
-            }
-            case CUTTING_ONE : {
-                if (buttonReady) {
-                    switch(currentButton) {
-                        case UP_PRESSED:
-                            if(optionSelected==1)
-                                wireLength+=WIRE_INCREMENT;
-                            if(optionSelected==2)
-                                leftIncisionDist+=WIRE_INCREMENT;
-                            if(optionSelected==3)
-                                rightIncisionDist+=WIRE_INCREMENT;
-                            if(optionSelected==4)
-                                numWires++;
-                            refreshScreen = true;
-                            break;
-                        case DOWN_PRESSED:
-                            if(optionSelected==1)
-                                wireLength-=WIRE_INCREMENT;
-                            if(optionSelected==2)
-                                leftIncisionDist-=WIRE_INCREMENT;
-                            if(optionSelected==3)
-                                rightIncisionDist-=WIRE_INCREMENT;
-                            if(optionSelected==4)
-                                numWires--;
-                            refreshScreen = true;
-                            break;
-                        case ONE_RELEASED:
-                            optionSelected=1;
-                            refreshScreen = true;
-                            break;
-                        case TWO_RELEASED:
-                            optionSelected=2;
-                            refreshScreen = true;
-                            break;
-                        case THREE_RELEASED:
-                            optionSelected=3;
-                            refreshScreen = true;
-                            break;
-                        case FOUR_RELEASED:
-                            optionSelected=4;
-                            refreshScreen = true;
-                            break;
-                        case LEFT_RELEASED:
-                            currentState = MENU;
-                            stateChange = 1;
-                            refreshScreen = true;
-                            break;
-                        case RIGHT_RELEASED:
-                            currentState = CUTTING_TWO;
-                            numWiresLeft = numWires;
-                            stateChange = 1;
-                            refreshScreen = true;
-                            break;
-                        default:
-                            refreshScreen = false;
-                            break;
-                    }
-                }
-                break;
-            }
-            case CUTTING_TWO : {
-                cutWires();
-                if(buttonReady && numWiresLeft==0 && currentButton==RIGHT_RELEASED) {
-                    currentState = MENU;
-                    stateChange = 1;
-                }
-                break;
-            }
-            case SETTINGS_ONE : {
-                if (buttonReady) {
-                    switch(currentButton) {
-                        case ONE_RELEASED:
-                                wireLeft = MAX_SPOOL_LENGTH;
-                                break;
-                        case TWO_RELEASED:
-                                currentState = SETTINGS_FEED;
-                                wireFeeder.enable();
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        case THREE_RELEASED:
-                                currentState = SETTINGS_CUTTER;
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        case FOUR_RELEASED:
-                                currentState = SETTINGS_GUIDE;
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        case LEFT_RELEASED:
-                                currentState = MENU;
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        default : 
-                            break;
-                    }
-                }
-                break;
-            }
-            case SETTINGS_FEED : {
-                if (buttonReady) {
-                    switch(currentButton) {
-                        case UP_PRESSED:
-                            while(!(currentButton==UP_RELEASED)){
-                                wireFeeder.step(FEEDER_MOTOR_STEPS,STEPPER_REV,FEEDER_MOTOR_SPEED);
-                                Thread::wait(5);
-                            }
-                            break;
-                        case DOWN_PRESSED:
-                            while(!(currentButton==DOWN_RELEASED)){
-                                wireFeeder.step(FEEDER_MOTOR_STEPS,STEPPER_FWD,FEEDER_MOTOR_SPEED);
-                                Thread::wait(5);
-                            }
-                            break;
-                        case LEFT_RELEASED:
-                                currentState = SETTINGS_ONE;
-                                wireFeeder.disable();
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        default : 
-                            break;
-                    }
-                }
-                break;
-            }
-            case SETTINGS_CUTTER : {
-                if (buttonReady) {
-                    switch(currentButton) {
-                        case UP_PRESSED:
-                            wireCutter.speed(CUTTER_MOTOR_SPEED);
-                            while(!(currentButton==UP_RELEASED)){
-                                Thread::wait(50);
-                            }
-                            wireCutter.speed(0.0);
-                            break;
-                        case DOWN_PRESSED:
-                            wireCutter.speed(-CUTTER_MOTOR_SPEED);
-                            while(!(currentButton==DOWN_RELEASED)){
-                                Thread::wait(50);
-                            }
-                            wireCutter.speed(0.0);
-                            break;
-                        case LEFT_RELEASED:
-                                currentState = SETTINGS_ONE;
-                                wireFeeder.disable();
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        default : 
-                            break;
-                    }
-                }
-                break;
-            }
-            case SETTINGS_GUIDE : {
-                if (buttonReady) {
-                    switch(currentButton) {
-                        case UP_RELEASED:
-                            wireGuide.position(++guideAngle);
-                            refreshScreen = true;
-                            break;
-                        case DOWN_RELEASED:
-                            wireGuide.position(--guideAngle);
-                            refreshScreen = true;
-                            break;
-                        case LEFT_RELEASED:
-                                currentState = SETTINGS_ONE;
-                                stateChange = 1;
-                                refreshScreen = true;
-                                break;
-                        default : 
-                            break;
-                    }
-                }
-                break;
-            }
-            default :
-                break;
-        }
-        buttonReady = 0;
-        Thread::wait(50);  
-    }
+    cutThread.start(&cutBatches);
+    
+    // Use main thread for the control state machine, it runs on events from here on
+    homeCutter();
+    machine.run(uiEvents);
 }
\ No newline at end of file
@@ -9,11 +9,65 @@
 
 // LCD Parameters
 #define SPLASH_SCREEN_LOAD_TIME 1000//ms
+#define DISPLAY_BENCHMARK 0 // print serial bytes per display frame on pc every second
 
 #define WIRE_LEVEL_MED  50//% left
 #define WIRE_LEVEL_LOW   25//% left
 #define WIRE_INCREMENT   0.2//in, Increment amount of parameters
 
+// Input Parameters
+#define DEBOUNCE_SAMPLE_PERIOD 100 // us, port sample period, pins settle after 4 samples
+#define DEBOUNCE_BENCHMARK 0 // print debounce ISR cycles per tick on pc every second
+#define ENCODER_MILESTONE_COUNTS 8 // feeder encoder edges between screen updates while jogging
+#define EVENT_BENCHMARK 0 // print events handled, dropped and the slowest dispatch on pc every second
+#define BLE_BENCHMARK 0 // print BLE frames decoded and bytes lost or skipped on pc every second
+
+// Job Parameters
+#define JOB_FILE "/sd/jobs.txt"
+#define JOB_LINK_BENCHMARK 0 // print batches and jobs uploaded over BLE on pc every second
+
+// State Parameters
+#define STATE_FILE "state.log" // on the sd file system, spool and job progress
+#define STATE_BENCHMARK 0 // print state saves and the slowest save on pc every second
+
+// Log Parameters
+#define LOG_FILE "cuts.bin" // on the sd file system, decode with TelemetryLog/decode_log.py
+#define LOG_LENGTH_TOLERANCE FEEDER_INCH_PER_COUNT // in, wires fed further than this off the spec are flagged, one encoder count
+#define LOG_BENCHMARK 0 // print records logged and dropped and sectors written on pc every second
+
+// Profile Parameters
+#define PROFILE_FILE "/sd/profile.txt"
+#define PROFILE_BENCHMARK 0 // print per-phase cycle times on pc and append them to PROFILE_FILE after each batch
+
+// Telemetry Parameters, decode with TelemetryStream/decode_telemetry.py
+#define TELEMETRY_BENCHMARK 0 // print status frames and bytes sent over BLE on pc every second
+
+typedef enum {
+    STATE_WIRE_LEFT = 0, // ft, float
+    STATE_JOB_ID    = 1, // job the progress is for, 0 for none
+    STATE_JOB_DONE  = 2  // wires of that job finished
+} StateKey;
+
+typedef enum {
+    TELEMETRY_STATE      = 0, // State
+    TELEMETRY_JOB        = 1, // job being cut
+    TELEMETRY_WIRES_DONE = 2, // wires of that job finished
+    TELEMETRY_WIRES_LEFT = 3, // wires of that job left
+    TELEMETRY_BATCH_LEFT = 4, // wires left across every job
+    TELEMETRY_SPOOL      = 5, // 0.1 ft, wire left on the spool
+    TELEMETRY_CYCLE_MS   = 6, // wall time of the last wire
+    TELEMETRY_FAULTS     = 7  // MachineFault bits
+} TelemetryField;
+
+typedef enum {
+    FAULT_LENGTH   = 0x01, // last wire fed off the spec by more than LOG_LENGTH_TOLERANCE
+    FAULT_STATE    = 0x02, // state log not mounted, progress only kept in RAM
+    FAULT_LOG      = 0x04, // cut log writes failing
+    FAULT_FEED     = 0x08, // last wire's feed saw a slip out of bounds or no encoder edges
+    FAULT_CUTTER   = 0x10, // the cutter missed a limit and was stopped, the batch stopped
+    FAULT_JOB_FILE = 0x20  // the job file could not be written, progress is in the state log or only in RAM
+} MachineFault;
+
 typedef enum {
     FULL_STEP = 0,
     HALF_STEP = 1,
@@ -27,17 +81,26 @@ typedef enum {
     STEPPER_REV = 0
 } StepperDirection;
 
-#define FEEDER_MOTOR_SPEED 10000.0
+#define FEEDER_START_SPEED 500.0 // steps/s, speed the feeder can start from standstill
+#define FEEDER_MAX_SPEED 10000.0 // steps/s, cruise speed when ramping
+#define FEEDER_ACCEL 60000.0 // steps/s^2
+#define FEEDER_JERK 3000000.0 // steps/s^3, only used by PROFILE_SCURVE
+#define FEEDER_PROFILE PROFILE_SCURVE
 #define FEEDER_MOTOR_STEPS EIGHTH_STEP
 #define FEEDER_WHEEL_DIAMETER 0.5 // inches
 #define FEEDER_WHEEL_CIRCUMFERENCE PI*FEEDER_WHEEL_DIAMETER // Inches per revolution
 #define FEEDER_RESOLUTION 200.0 // Steps per revolution
 #define FEEDER_STEP_PER_INCH (FEEDER_RESOLUTION/FEEDER_WHEEL_CIRCUMFERENCE)
+#define FEEDER_COUNTS_PER_REV 8.0 // Hall encoder edges per revolution
+#define FEEDER_INCH_PER_COUNT (FEEDER_WHEEL_CIRCUMFERENCE/FEEDER_COUNTS_PER_REV)
+#define FEED_TOLERANCE (FEEDER_INCH_PER_COUNT/2) // in, stop once the estimate is this close to the target, half an encoder count
+#define FEED_APPROACH 0.2 // in, fed at start speed at the end of each segment
 
 #define CUTTER_MOTOR_SPEED 1.0
 #define CUTTER_INCISION_COUNTS 3
 #define CUTTER_CUT_COUNTS 3
 #define CUTTER_TIME 1.0 //seconds
+#define PLAN_FEED_OVERHEAD_MS 50 // ramps and approach per feed, for batch estimates
 
 #define POS_STRIP 155
 #define POS_CUT 142
@@ -63,6 +126,12 @@ typedef enum {
 } ButtonState;
 
 typedef enum {
+    LIMIT_UPPER = 1,
+    LIMIT_LOWER = 2
+} LimitSwitch;
+
+typedef enum {
+    HOMING,
     MENU,
     CUTTING_ONE,
     CUTTING_TWO,
@@ -73,12 +142,4 @@ typedef enum {
     SETTINGS_GUIDE
 } State;
 
-typedef enum {
-    IDLE,
-    GOT_EXCLAM,
-    GOT_B,
-    GOT_BTN,
-    GOT_HIT
-} BleState;
-
 #endif
\ No newline at end of file